@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "arena.h"
+
+/*
+ * Arena memory comes in chunks.  Allocating is bumping the newest
+ * chunk's offset; when it's full a new chunk is added in front.
+ * A reset rewinds the first chunk, and if a frame overflowed it,
+ * replaces the lot with one chunk big enough for the peak - so a
+ * steady state frame makes no calls to malloc() at all.
+ *
+ * Nothing is zeroed.
+ */
+struct bres_arena_chunk {
+	struct bres_arena_chunk *next;
+	size_t size;
+	size_t off;
+	/* The data follows, aligned */
+};
+
+#define	BRES_ARENA_HDR							\
+	((sizeof(struct bres_arena_chunk) + BRES_ARENA_ALIGN - 1) &	\
+	    ~(size_t) (BRES_ARENA_ALIGN - 1))
+
+static inline size_t
+bres_arena_round(size_t n)
+{
+	return ((n + BRES_ARENA_ALIGN - 1) & ~(size_t) (BRES_ARENA_ALIGN - 1));
+}
+
+static inline uint8_t *
+bres_arena_data(struct bres_arena_chunk *c)
+{
+	return ((uint8_t *) c + BRES_ARENA_HDR);
+}
+
+static struct bres_arena_chunk *
+bres_arena_chunk_alloc(size_t size)
+{
+	struct bres_arena_chunk *c;
+	void *p;
+
+	if (posix_memalign(&p, BRES_ARENA_ALIGN, BRES_ARENA_HDR + size) != 0)
+		return NULL;
+	c = p;
+	c->next = NULL;
+	c->size = size;
+	c->off = 0;
+	return c;
+}
+
+static void
+bres_arena_free_chunks(struct bres_arena_chunk *c)
+{
+	struct bres_arena_chunk *n;
+
+	for (; c != NULL; c = n) {
+		n = c->next;
+		free(c);
+	}
+}
+
+/**
+ * Create an arena with room for size bytes before it has to grow.
+ */
+struct bres_arena *
+bres_arena_create(size_t size)
+{
+	struct bres_arena *a;
+
+	a = calloc(1, sizeof(*a));
+	if (a == NULL)
+		return NULL;
+	a->chunk_size = bres_arena_round(size > 0 ? size : 4096);
+	a->chunks = bres_arena_chunk_alloc(a->chunk_size);
+	if (a->chunks == NULL) {
+		free(a);
+		return NULL;
+	}
+	return a;
+}
+
+void
+bres_arena_destroy(struct bres_arena *a)
+{
+	if (a == NULL)
+		return;
+	bres_arena_free_chunks(a->chunks);
+	free(a);
+}
+
+/**
+ * Free everything allocated from the arena since the last reset.
+ */
+void
+bres_arena_reset(struct bres_arena *a)
+{
+	struct bres_arena_chunk *c;
+
+	if (a->used > a->peak)
+		a->peak = a->used;
+	a->used = 0;
+	a->last = NULL;
+
+	if (a->chunks->next == NULL) {
+		a->chunks->off = 0;
+		return;
+	}
+
+	/* It overflowed; next time, one chunk that fits the lot */
+	c = bres_arena_chunk_alloc(a->peak > a->chunk_size ?
+	    bres_arena_round(a->peak) : a->chunk_size);
+	if (c == NULL) {
+		/* Keep the oldest (first) chunk and carry on */
+		for (c = a->chunks; c->next != NULL; c = c->next)
+			;
+		for (; a->chunks != c; a->chunks = a->chunks->next)
+			free(a->chunks);
+		c->off = 0;
+		return;
+	}
+	bres_arena_free_chunks(a->chunks);
+	a->chunks = c;
+	a->chunk_size = c->size;
+}
+
+/**
+ * Allocate n bytes, BRES_ARENA_ALIGN aligned and not zeroed.
+ */
+void *
+bres_arena_alloc(struct bres_arena *a, size_t n)
+{
+	struct bres_arena_chunk *c = a->chunks;
+	size_t size;
+
+	n = bres_arena_round(n);
+	if (c->size - c->off < n) {
+		size = a->chunk_size > n ? a->chunk_size : n;
+		c = bres_arena_chunk_alloc(size);
+		if (c == NULL)
+			return NULL;
+		c->next = a->chunks;
+		a->chunks = c;
+	}
+	a->last = bres_arena_data(c) + c->off;
+	c->off += n;
+	a->used += n;
+	return (a->last);
+}
+
+/**
+ * Grow the arena's most recent allocation, p, to n bytes in place.
+ * Returns false if p isn't the most recent allocation or there's
+ * no room after it; the caller then allocates afresh and copies.
+ */
+bool
+bres_arena_grow(struct bres_arena *a, void *p, size_t n)
+{
+	struct bres_arena_chunk *c = a->chunks;
+	size_t start, old;
+
+	if (p == NULL || p != a->last)
+		return false;
+	start = (uint8_t *) p - bres_arena_data(c);
+	old = c->off - start;
+	n = bres_arena_round(n);
+	if (n <= old)
+		return true;
+	if (c->size - start < n)
+		return false;
+	c->off = start + n;
+	a->used += n - old;
+	return true;
+}
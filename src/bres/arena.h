@@ -0,0 +1,28 @@
+#ifndef	__ARENA_H__
+#define	__ARENA_H__
+
+/*
+ * A frame scoped bump allocator.  Allocations are never freed one
+ * at a time; bres_arena_reset() throws the lot away at once, eg at
+ * the end of each frame.
+ */
+struct bres_arena_chunk;
+
+struct bres_arena {
+	struct bres_arena_chunk *chunks;	/* newest first */
+	size_t chunk_size;
+	size_t used;		/* bytes handed out since the last reset */
+	size_t peak;		/* most bytes in use at once */
+	void *last;		/* most recent allocation, for growing */
+};
+
+/* Allocations are aligned to this */
+#define	BRES_ARENA_ALIGN		16
+
+extern	struct bres_arena *bres_arena_create(size_t size);
+extern	void bres_arena_destroy(struct bres_arena *a);
+extern	void bres_arena_reset(struct bres_arena *a);
+extern	void *bres_arena_alloc(struct bres_arena *a, size_t n);
+extern	bool bres_arena_grow(struct bres_arena *a, void *p, size_t n);
+
+#endif	/* __ARENA_H__ */
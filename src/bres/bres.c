@@ -4,6 +4,10 @@
 #include <stdbool.h>
 #include <sys/types.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "point.h"
 #include "scanline.h"
 #include "bres.h"
@@ -93,15 +97,223 @@ bres_triangle_flat(struct scanline_list *slist, int x1, int y1, int x2l,
 #endif
 }
 
+/*
+ * One edge of a flat triangle for the batch rasteriser.
+ *
+ * By row k, bres_triangle_flat()'s error loop has taken m steps,
+ * where m is the smallest m >= 0 leaving E0 + 2kD - 2Hm negative:
+ *
+ *   m = max(0, floor((E0 + 2kD) / 2H) + 1)
+ *
+ * with E0 = -H - (x2 - x1), D = |x2 - x1| and H = |y2 - y1|.
+ * Keeping the floor() as a quotient and remainder and adding the
+ * precomputed 2D / 2H and 2D % 2H each row makes that one compare
+ * per scanline rather than one loop iteration per pixel of x
+ * movement, with exactly the same result.
+ */
+struct bres_flat_edge {
+	int q, r;		/* floor((E0 + 2kD) / 2H), remainder */
+	int dq, dr;		/* 2D / 2H, 2D % 2H */
+	int mod;		/* 2H */
+	int neg;		/* -1 if x steps left, else 0 */
+};
+
+static inline void
+bres_flat_edge_init(struct bres_flat_edge *fe, int x1, int x2, int h)
+{
+	int v;
+
+	fe->neg = (x2 < x1) ? -1 : 0;
+	if (h == 0) {
+		/* A single span at x1 */
+		fe->q = -1;
+		fe->r = fe->dq = fe->dr = 0;
+		fe->mod = 1;
+		return;
+	}
+
+	fe->mod = 2 * h;
+	v = -h - (x2 - x1);
+	fe->q = v / fe->mod;
+	fe->r = v % fe->mod;
+	if (fe->r < 0) {
+		fe->q--;
+		fe->r += fe->mod;
+	}
+	fe->dq = (2 * abs(x2 - x1)) / fe->mod;
+	fe->dr = (2 * abs(x2 - x1)) % fe->mod;
+}
+
+static inline int
+bres_flat_edge_x(const struct bres_flat_edge *fe, int x1)
+{
+	int m = fe->q + 1;
+
+	if (m < 0)
+		m = 0;
+	return (x1 + ((m ^ fe->neg) - fe->neg));
+}
+
+static inline void
+bres_flat_edge_step(struct bres_flat_edge *fe)
+{
+	fe->q += fe->dq;
+	fe->r += fe->dr;
+	if (fe->r >= fe->mod) {
+		fe->q++;
+		fe->r -= fe->mod;
+	}
+}
+
+static void
+bres_triangle_flat_1(struct scanline_list *slist,
+    const struct bres_flat_triangle *t)
+{
+	struct bres_flat_edge el, er;
+	struct scanline_2d *s;
+	const int y_sign = (t->y2 < t->y1) ? -1 : 1;
+	const int h = (t->y2 - t->y1) * y_sign;
+	int k;
+
+	bres_flat_edge_init(&el, t->x1, t->x2l, h);
+	bres_flat_edge_init(&er, t->x1, t->x2r, h);
+	s = &slist->list[slist->cur];
+	for (k = 0; k <= h; k++) {
+		s[k].x1 = bres_flat_edge_x(&el, t->x1);
+		s[k].x2 = bres_flat_edge_x(&er, t->x1);
+		s[k].y = t->y1 + k * y_sign;
+		bres_flat_edge_step(&el);
+		bres_flat_edge_step(&er);
+	}
+	slist->cur += h + 1;
+}
+
+#ifdef __SSE2__
+/*
+ * Four triangles at once, one per SIMD lane; the left and right
+ * edges each get a vector.  Each triangle's spans still land in
+ * the list contiguously and in order, as if done one at a time.
+ */
+struct bres_flat_lanes {
+	__m128i q, r, dq, dr, mod, neg;
+};
+
+static inline void
+bres_flat_lanes_load(struct bres_flat_lanes *v, const struct bres_flat_edge *e)
+{
+	v->q = _mm_setr_epi32(e[0].q, e[1].q, e[2].q, e[3].q);
+	v->r = _mm_setr_epi32(e[0].r, e[1].r, e[2].r, e[3].r);
+	v->dq = _mm_setr_epi32(e[0].dq, e[1].dq, e[2].dq, e[3].dq);
+	v->dr = _mm_setr_epi32(e[0].dr, e[1].dr, e[2].dr, e[3].dr);
+	v->mod = _mm_setr_epi32(e[0].mod, e[1].mod, e[2].mod, e[3].mod);
+	v->neg = _mm_setr_epi32(e[0].neg, e[1].neg, e[2].neg, e[3].neg);
+}
+
+static inline __m128i
+bres_flat_lanes_x(const struct bres_flat_lanes *v, __m128i x1)
+{
+	__m128i m;
+
+	m = _mm_sub_epi32(v->q, _mm_set1_epi32(-1));
+	m = _mm_and_si128(m, _mm_cmpgt_epi32(m, _mm_setzero_si128()));
+	m = _mm_sub_epi32(_mm_xor_si128(m, v->neg), v->neg);
+	return (_mm_add_epi32(x1, m));
+}
+
+static inline void
+bres_flat_lanes_step(struct bres_flat_lanes *v)
+{
+	__m128i wrap;
+
+	v->q = _mm_add_epi32(v->q, v->dq);
+	v->r = _mm_add_epi32(v->r, v->dr);
+	wrap = _mm_cmpgt_epi32(v->r, _mm_sub_epi32(v->mod, _mm_set1_epi32(1)));
+	v->q = _mm_sub_epi32(v->q, wrap);
+	v->r = _mm_sub_epi32(v->r, _mm_and_si128(wrap, v->mod));
+}
+
+static void
+bres_triangle_flat_x4(struct scanline_list *slist,
+    const struct bres_flat_triangle *t)
+{
+	struct bres_flat_edge el[4], er[4];
+	struct bres_flat_lanes vl, vr;
+	struct scanline_2d *s[4];
+	int32_t xl[4] __attribute__((aligned(16)));
+	int32_t xr[4] __attribute__((aligned(16)));
+	int h[4], ys[4], j, k, maxh, off;
+	__m128i x1;
+
+	off = slist->cur;
+	maxh = 0;
+	for (j = 0; j < 4; j++) {
+		ys[j] = (t[j].y2 < t[j].y1) ? -1 : 1;
+		h[j] = (t[j].y2 - t[j].y1) * ys[j];
+		bres_flat_edge_init(&el[j], t[j].x1, t[j].x2l, h[j]);
+		bres_flat_edge_init(&er[j], t[j].x1, t[j].x2r, h[j]);
+		s[j] = &slist->list[off];
+		off += h[j] + 1;
+		if (h[j] > maxh)
+			maxh = h[j];
+	}
+	bres_flat_lanes_load(&vl, el);
+	bres_flat_lanes_load(&vr, er);
+	x1 = _mm_setr_epi32(t[0].x1, t[1].x1, t[2].x1, t[3].x1);
+
+	for (k = 0; k <= maxh; k++) {
+		_mm_store_si128((__m128i *) xl, bres_flat_lanes_x(&vl, x1));
+		_mm_store_si128((__m128i *) xr, bres_flat_lanes_x(&vr, x1));
+		for (j = 0; j < 4; j++) {
+			if (k > h[j])
+				continue;
+			s[j][k].x1 = xl[j];
+			s[j][k].x2 = xr[j];
+			s[j][k].y = t[j].y1 + k * ys[j];
+		}
+		bres_flat_lanes_step(&vl);
+		bres_flat_lanes_step(&vr);
+	}
+	slist->cur = off;
+}
+#endif
+
 /**
+ * Rasterise n flat triangles, appending exactly the spans that
+ * calling bres_triangle_flat() on each in turn would.  The list is
+ * grown as needed.
+ *
+ * Returns false if memory ran out.
+ */
+bool
+bres_triangle_flat_batch(struct scanline_list *slist,
+    const struct bres_flat_triangle *tris, int n)
+{
+	int i, total = 0;
+
+	for (i = 0; i < n; i++)
+		total += abs(tris[i].y2 - tris[i].y1) + 1;
+	if (! scanline_list_reserve(slist, total))
+		return false;
+
+	i = 0;
+#ifdef __SSE2__
+	for (; i + 4 <= n; i += 4)
+		bres_triangle_flat_x4(slist, &tris[i]);
+#endif
+	for (; i < n; i++)
+		bres_triangle_flat_1(slist, &tris[i]);
+	return true;
+}
+
+/*
  * Given a triangle (x1,y1), (x2,y2), (x3,y3), generate the
- * scan list.
+ * scan list - from the arena if one is given, else malloc()ed.
  */
-void
-bres_triangle(struct point2d *plist, struct scanline_list **slist)
+static void
+bres_triangle_alloc(struct point2d *plist, struct bres_arena *arena,
+    struct scanline_list **slist)
 {
 	struct point2d mp;
-	bool valid_mp;
 
 	int a = 0, b = 1, c = 2, t;
 
@@ -112,10 +324,13 @@ bres_triangle(struct point2d *plist, struct scanline_list **slist)
 	 * midpoint that may become two triangles.
 	 */
 	if (plist[a].y > plist[b].y) {
-		t = b; a = b; b = a;
+		t = a; a = b; b = t;
 	}
 	if (plist[b].y > plist[c].y) {
-		t = c; a = c; c = b;
+		t = b; b = c; c = t;
+	}
+	if (plist[a].y > plist[b].y) {
+		t = a; a = b; b = t;
 	}
 
 #ifdef PRINT_TRIANGLE_SETUP
@@ -126,8 +341,17 @@ bres_triangle(struct point2d *plist, struct scanline_list **slist)
 	    plist[c].x, plist[c].y);
 #endif
 
-	/* Figure out how big a scanlist to create */
-	*slist = scanline_list_alloc(plist[c].y - plist[a].y);
+	/*
+	 * Figure out how big a scanlist to create; the split case
+	 * draws row b.y in both halves.
+	 */
+	if (arena != NULL)
+		*slist = scanline_list_alloc_arena(arena,
+		    plist[c].y - plist[a].y + 2);
+	else
+		*slist = scanline_list_alloc(plist[c].y - plist[a].y + 2);
+	if (*slist == NULL)
+		return;
 
 	if (plist[b].y == plist[c].y) {
 		/* Flat bottom triangle */
@@ -154,13 +378,15 @@ bres_triangle(struct point2d *plist, struct scanline_list **slist)
 		 * at (b.y).
 		 *
 		 * The formula is mp.x = a.x + ((b.y-a.y)/(c.y-a.y))*(c.x-a.x)
-		 * To avoid using floats we do a bit of fixed point math.
+		 * Multiplying out first keeps it exact in integers; scaling
+		 * (b.y-a.y)/(c.y-a.y) by 1024 instead lost up to dx/1024
+		 * pixels.
 		 */
 		mp.y = plist[b].y;
 		dy = (plist[c].y - plist[a].y);
 		dx = (plist[c].x - plist[a].x);
-		by = (plist[b].y - plist[a].y) * 1024;
-		xinc = (((by / dy) * dx)) / 1024;
+		by = (plist[b].y - plist[a].y);
+		xinc = (int) (((int64_t) by * dx) / dy);
 		mp.x = plist[a].x + xinc;
 
 
@@ -184,6 +410,12 @@ bres_triangle(struct point2d *plist, struct scanline_list **slist)
 	}
 }
 
+void
+bres_triangle(struct point2d *plist, struct scanline_list **slist)
+{
+	bres_triangle_alloc(plist, NULL, slist);
+}
+
 void
 bres_triangle_xy(int x1, int y1, int x2, int y2, int x3, int y3,
     struct scanline_list **slist)
@@ -194,5 +426,23 @@ bres_triangle_xy(int x1, int y1, int x2, int y2, int x3, int y3,
 	p[1].x = x2; p[1].y = y2;
 	p[2].x = x3; p[2].y = y3;
 
-	bres_triangle(p, slist);
+	bres_triangle_alloc(p, NULL, slist);
+}
+
+/**
+ * bres_triangle_xy(), with the scan list allocated from a frame
+ * arena; there's no need to free it, just reset the arena when
+ * the frame is done.
+ */
+void
+bres_triangle_xy_arena(int x1, int y1, int x2, int y2, int x3, int y3,
+    struct bres_arena *arena, struct scanline_list **slist)
+{
+	struct point2d p[3];
+
+	p[0].x = x1; p[0].y = y1;
+	p[1].x = x2; p[1].y = y2;
+	p[2].x = x3; p[2].y = y3;
+
+	bres_triangle_alloc(p, arena, slist);
 }
@@ -1,9 +1,19 @@
 #ifndef	__BRES_H__
 #define	__BRES_H__
 
+/* A flat top / bottom triangle, as passed to bres_triangle_flat() */
+struct bres_flat_triangle {
+	int x1, y1;
+	int x2l, x2r, y2;
+};
+
 extern	void bres_triangle_flat(struct scanline_list *slist, int x1, int y1,
 	    int x2l, int x2r, int y2);
+extern	bool bres_triangle_flat_batch(struct scanline_list *slist,
+	    const struct bres_flat_triangle *tris, int n);
 extern	void bres_triangle_xy(int x1, int y1, int x2, int y2, int x3, int y3,
 	    struct scanline_list **slist);
+extern	void bres_triangle_xy_arena(int x1, int y1, int x2, int y2, int x3,
+	    int y3, struct bres_arena *arena, struct scanline_list **slist);
 
 #endif	/* __BRES_H__ */
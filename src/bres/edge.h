@@ -0,0 +1,149 @@
+#ifndef	__EDGE_H__
+#define	__EDGE_H__
+
+/*
+ * A polygon edge stepped down the screen one scanline at a time
+ * with an integer Bresenham error term.  Edges cover scanlines
+ * [ytop, ybot); see polygon.c for the pixel coverage rules.
+ */
+struct bres_edge {
+	int ytop, ybot;
+	/* x crossing is x + e / dy, 0 <= e < dy */
+	int x, e;
+	int dy;
+	/* Per scanline step: xstep + estep / dy */
+	int xstep, estep;
+	/* +1 for edges going down the screen, -1 going up */
+	int dir;
+};
+
+/* First pixel at or right of the crossing */
+static inline int
+bres_edge_ceil(const struct bres_edge *e)
+{
+	return (e->x + (e->e > 0));
+}
+
+static inline void
+bres_edge_init(struct bres_edge *e, const struct point2d *p0,
+    const struct point2d *p1)
+{
+	const struct point2d *top = p0, *bot = p1;
+	int dx;
+
+	e->dir = 1;
+	if (p1->y < p0->y) {
+		top = p1;
+		bot = p0;
+		e->dir = -1;
+	}
+
+	e->ytop = top->y;
+	e->ybot = bot->y;
+	e->dy = bot->y - top->y;
+	e->x = top->x;
+	e->e = 0;
+
+	/* Floor division, so the error term stays positive */
+	dx = bot->x - top->x;
+	e->xstep = dx / e->dy;
+	e->estep = dx % e->dy;
+	if (e->estep < 0) {
+		e->xstep--;
+		e->estep += e->dy;
+	}
+}
+
+/*
+ * Floor division for the subpixel setup; d > 0.
+ */
+static inline int64_t
+bres_edge_floordiv(int64_t n, int64_t d)
+{
+	return ((n >= 0) ? n / d : -((d - 1 - n) / d));
+}
+
+/*
+ * The first scanline whose pixel centre is at or below subpixel y.
+ */
+static inline int
+bres_subpixel_row(int y)
+{
+	return ((int) bres_edge_floordiv((int64_t) y -
+	    BRES_SUBPIXEL_ONE / 2 + BRES_SUBPIXEL_ONE - 1,
+	    BRES_SUBPIXEL_ONE));
+}
+
+/*
+ * As bres_edge_init(), but for 28.4 subpixel vertices sampled at
+ * pixel centres.  The edge covers the scanlines whose centres are
+ * in [top, bottom), and bres_edge_ceil() gives the first pixel whose
+ * centre is at or right of the exact crossing.  With spans covering
+ * [left, right) as usual, centres exactly on an edge belong to the
+ * shape below / right of it: a strict top-left fill rule.
+ *
+ * The crossing, in pixels, is kept as x + e / dy with dy scaled up
+ * to 16 * the subpixel height; it's exact, with no rounding to
+ * accumulate.  The edge must not be horizontal.
+ */
+static inline void
+bres_edge_init_subpixel(struct bres_edge *e, const struct point2d *p0,
+    const struct point2d *p1)
+{
+	const struct point2d *top = p0, *bot = p1;
+	int64_t n, d, dx, dy;
+
+	e->dir = 1;
+	if (p1->y < p0->y) {
+		top = p1;
+		bot = p0;
+		e->dir = -1;
+	}
+
+	e->ytop = bres_subpixel_row(top->y);
+	e->ybot = bres_subpixel_row(bot->y);
+
+	/*
+	 * At the first centre, yc, the crossing minus half a pixel is
+	 * ((top.x - 8) * dy + (yc - top.y) * dx) / (16 * dy) pixels.
+	 */
+	dx = bot->x - top->x;
+	dy = bot->y - top->y;
+	d = dy * BRES_SUBPIXEL_ONE;
+	n = (top->x - BRES_SUBPIXEL_ONE / 2) * dy +
+	    ((int64_t) e->ytop * BRES_SUBPIXEL_ONE + BRES_SUBPIXEL_ONE / 2 -
+	    top->y) * dx;
+	e->dy = (int) d;
+	e->x = (int) bres_edge_floordiv(n, d);
+	e->e = (int) (n - (int64_t) e->x * d);
+
+	/* Each scanline moves the crossing 16 * dx / (16 * dy) pixels */
+	e->xstep = (int) bres_edge_floordiv(dx, dy);
+	e->estep = (int) ((dx - e->xstep * dy) * BRES_SUBPIXEL_ONE);
+}
+
+static inline void
+bres_edge_step(struct bres_edge *e)
+{
+	e->x += e->xstep;
+	e->e += e->estep;
+	if (e->e >= e->dy) {
+		e->x++;
+		e->e -= e->dy;
+	}
+}
+
+/*
+ * Step n scanlines in one go.
+ */
+static inline void
+bres_edge_advance(struct bres_edge *e, int n)
+{
+	int64_t t;
+
+	t = e->e + (int64_t) n * e->estep;
+	e->x += n * e->xstep + (int) (t / e->dy);
+	e->e = (int) (t % e->dy);
+}
+
+#endif	/* __EDGE_H__ */
@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "scanline.h"
+#include "ellipse.h"
+
+/*
+ * Filled circles, ellipses, rings and rounded rectangles, straight
+ * to spans.
+ *
+ * An ellipse with semi-axes a and b covers the pixels whose centres
+ * are inside the ellipse with semi-axes a + 1/2 and b + 1/2 around
+ * the centre pixel's centre, so it's 2a + 1 by 2b + 1 pixels and a
+ * circle of radius r is the pixels with dx^2 + dy^2 <= r^2 + r -
+ * the inside of what the midpoint circle algorithm draws.
+ *
+ * Each row's half width is found with a midpoint style integer
+ * error term, walking out from the middle row: the half width only
+ * ever shrinks, so the whole shape is O(a + b) adds and compares.
+ * Each half width is used for the rows above and below the middle,
+ * so the work is done once for both.
+ */
+
+/*
+ * The half width w of row dy, for 2a + 1 by 2b + 1: the largest w
+ * with 4w^2 * B^2 + 4dy^2 * A^2 <= A^2 * B^2, A = 2a + 1, B = 2b + 1.
+ * e is the slack in that.
+ */
+struct bres_ellipse_walk {
+	int64_t e;
+	int64_t ka, kb;		/* 4A^2, 4B^2 */
+	int w, dy;
+};
+
+static void
+bres_ellipse_walk_init(struct bres_ellipse_walk *ew, int a, int b)
+{
+	const int64_t A = 2 * a + 1, B = 2 * b + 1;
+
+	ew->ka = 4 * A * A;
+	ew->kb = 4 * B * B;
+	ew->w = a;
+	ew->dy = 0;
+	ew->e = A * A * B * B - (int64_t) a * a * ew->kb;
+}
+
+/* On to the next row out */
+static inline void
+bres_ellipse_walk_next(struct bres_ellipse_walk *ew)
+{
+	ew->e -= ew->ka * (2 * ew->dy + 1);
+	ew->dy++;
+	while (ew->e < 0 && ew->w >= 0) {
+		ew->e += ew->kb * (2 * ew->w - 1);
+		ew->w--;
+	}
+}
+
+static bool
+bres_ellipse_check(const char *func, int a, int b)
+{
+	if (a < 0 || b < 0 || a > BRES_ELLIPSE_MAX_RADIUS ||
+	    b > BRES_ELLIPSE_MAX_RADIUS) {
+		printf("%s: radius (%d, %d) out of range\n", func, a, b);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Append a filled ellipse centred on (cx, cy) with semi-axes a and
+ * b, one span per row, top to bottom.  The list is grown as needed.
+ *
+ * Returns false if memory ran out or a radius is out of range.
+ */
+bool
+bres_ellipse(struct scanline_list *slist, int cx, int cy, int a, int b)
+{
+	struct bres_ellipse_walk ew;
+	struct scanline_2d *s;
+
+	if (! bres_ellipse_check(__func__, a, b))
+		return false;
+	if (! scanline_list_reserve(slist, 2 * b + 1))
+		return false;
+
+	/* Row dy goes at b - dy and b + dy */
+	s = &slist->list[slist->cur + b];
+	bres_ellipse_walk_init(&ew, a, b);
+	s[0].x1 = cx - ew.w;
+	s[0].x2 = cx + ew.w;
+	s[0].y = cy;
+	while (ew.dy < b) {
+		bres_ellipse_walk_next(&ew);
+		s[-ew.dy].x1 = s[ew.dy].x1 = cx - ew.w;
+		s[-ew.dy].x2 = s[ew.dy].x2 = cx + ew.w;
+		s[-ew.dy].y = cy - ew.dy;
+		s[ew.dy].y = cy + ew.dy;
+	}
+	slist->cur += 2 * b + 1;
+	return true;
+}
+
+/**
+ * Append an elliptical ring: the ellipse (cx, cy, a, b) less the
+ * one width pixels further in.  Rows through the hole have two
+ * spans, left then right.  The list is grown as needed.
+ *
+ * Returns false if memory ran out or a radius is out of range.
+ */
+bool
+bres_ellipse_ring(struct scanline_list *slist, int cx, int cy, int a, int b,
+    int width)
+{
+	struct bres_ellipse_walk eo, ei;
+	struct scanline_2d *s;
+	int top, bot, n, x1, x2, dy;
+	bool hole;
+
+	if (a - width < 0 || b - width < 0 || width <= 0)
+		return (bres_ellipse(slist, cx, cy, a, b));
+	if (! bres_ellipse_check(__func__, a, b))
+		return false;
+	if (! scanline_list_reserve(slist, 2 * (2 * b + 1)))
+		return false;
+
+	/*
+	 * Walking out from the middle, the rows above come out bottom
+	 * up: they're written backwards from the middle of the space
+	 * reserved, the rows below forwards, then the lot is moved up.
+	 */
+	s = &slist->list[slist->cur];
+	top = bot = 2 * b;
+	bres_ellipse_walk_init(&eo, a, b);
+	bres_ellipse_walk_init(&ei, a - width, b - width);
+	for (dy = 0; dy <= b; dy++) {
+		if (dy > 0) {
+			bres_ellipse_walk_next(&eo);
+			if (ei.dy < b - width)
+				bres_ellipse_walk_next(&ei);
+		}
+		hole = (dy <= b - width) && (ei.w >= 0);
+		x1 = hole ? ei.w + 1 : -eo.w;
+		x2 = eo.w;
+		if (x1 > x2)
+			continue;
+
+		/* Below (and the middle row) */
+		if (hole) {
+			s[bot].x1 = cx - x2;
+			s[bot].x2 = cx - x1;
+			s[bot++].y = cy + dy;
+		}
+		s[bot].x1 = cx + x1;
+		s[bot].x2 = cx + x2;
+		s[bot++].y = cy + dy;
+		if (dy == 0)
+			continue;
+
+		/* Above, right span first */
+		s[--top].x1 = cx + x1;
+		s[top].x2 = cx + x2;
+		s[top].y = cy - dy;
+		if (hole) {
+			s[--top].x1 = cx - x2;
+			s[top].x2 = cx - x1;
+			s[top].y = cy - dy;
+		}
+	}
+
+	n = bot - top;
+	if (top > 0)
+		memmove(s, &s[top], n * sizeof(*s));
+	slist->cur += n;
+	return true;
+}
+
+bool
+bres_circle(struct scanline_list *slist, int cx, int cy, int r)
+{
+	return (bres_ellipse(slist, cx, cy, r, r));
+}
+
+bool
+bres_circle_ring(struct scanline_list *slist, int cx, int cy, int r,
+    int width)
+{
+	return (bres_ellipse_ring(slist, cx, cy, r, r, width));
+}
+
+/**
+ * Append a w x h rectangle at (x, y) with its corners rounded to
+ * radius r (as bres_circle()), one span per row.  r is clamped so
+ * the corners fit.  The list is grown as needed.
+ *
+ * Returns false if memory ran out or r is out of range.
+ */
+bool
+bres_rounded_rect(struct scanline_list *slist, int x, int y, int w, int h,
+    int r)
+{
+	struct bres_ellipse_walk ew;
+	struct scanline_2d *s;
+	int i, inset;
+
+	if (w <= 0 || h <= 0)
+		return true;
+	if (r > (w - 1) / 2)
+		r = (w - 1) / 2;
+	if (r > (h - 1) / 2)
+		r = (h - 1) / 2;
+	if (r < 0)
+		r = 0;
+	if (! bres_ellipse_check(__func__, r, r))
+		return false;
+	if (! scanline_list_reserve(slist, h))
+		return false;
+
+	s = &slist->list[slist->cur];
+	for (i = r; i < h - r; i++) {
+		s[i].x1 = x;
+		s[i].x2 = x + w - 1;
+		s[i].y = y + i;
+	}
+
+	/* Corner row dy out from the corner centres is r - dy in */
+	bres_ellipse_walk_init(&ew, r, r);
+	while (ew.dy < r) {
+		bres_ellipse_walk_next(&ew);
+		inset = r - ew.w;
+		s[r - ew.dy].x1 = s[h - 1 - r + ew.dy].x1 = x + inset;
+		s[r - ew.dy].x2 = s[h - 1 - r + ew.dy].x2 = x + w - 1 - inset;
+		s[r - ew.dy].y = y + r - ew.dy;
+		s[h - 1 - r + ew.dy].y = y + h - 1 - r + ew.dy;
+	}
+	slist->cur += h;
+	return true;
+}
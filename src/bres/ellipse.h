@@ -0,0 +1,17 @@
+#ifndef	__ELLIPSE_H__
+#define	__ELLIPSE_H__
+
+/* Largest radius the ellipse routines take */
+#define	BRES_ELLIPSE_MAX_RADIUS		16383
+
+extern	bool bres_ellipse(struct scanline_list *slist, int cx, int cy,
+	    int a, int b);
+extern	bool bres_ellipse_ring(struct scanline_list *slist, int cx, int cy,
+	    int a, int b, int width);
+extern	bool bres_circle(struct scanline_list *slist, int cx, int cy, int r);
+extern	bool bres_circle_ring(struct scanline_list *slist, int cx, int cy,
+	    int r, int width);
+extern	bool bres_rounded_rect(struct scanline_list *slist, int x, int y,
+	    int w, int h, int r);
+
+#endif	/* __ELLIPSE_H__ */
@@ -0,0 +1,368 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "scanline.h"
+#include "fb.h"
+
+/*
+ * CPU span filling.
+ *
+ * Each span is clipped once and then filled a row at a time: pixel
+ * stores up to a 16 byte boundary, then 16 byte vector stores (or
+ * 64 bit stores without SSE2), then pixel stores for the tail.
+ * Long spans use non-temporal stores so a big fill doesn't push
+ * everything else out of the cache.
+ *
+ * The colour is replicated into a 64 bit pattern up front; since
+ * every pixel is the same, any bpp-aligned bpp bytes of it are one
+ * pixel whatever the host byte order is.
+ */
+
+static inline uint64_t
+bres_fb_pattern(int bpp, uint32_t color)
+{
+	switch (bpp) {
+	case 1:
+		return ((color & 0xff) * 0x0101010101010101ULL);
+	case 2:
+		return ((color & 0xffff) * 0x0001000100010001ULL);
+	default:
+		return (color * 0x0000000100000001ULL);
+	}
+}
+
+/*
+ * Fill nbytes (a whole number of pixels) at p.  Returns true if
+ * non-temporal stores were used, in which case the caller has to
+ * fence before anything else looks at the pixels.
+ */
+static bool
+bres_fb_fill_row(uint8_t *p, size_t nbytes, int bpp, uint64_t pat)
+{
+	bool nt = false;
+#ifdef __SSE2__
+	__m128i v;
+#endif
+
+	while (nbytes > 0 && ((uintptr_t) p & 15) != 0) {
+		memcpy(p, &pat, bpp);
+		p += bpp;
+		nbytes -= bpp;
+	}
+
+#ifdef __SSE2__
+	v = _mm_set1_epi64x(pat);
+	if (nbytes >= BRES_FB_NT_BYTES) {
+		for (; nbytes >= 64; p += 64, nbytes -= 64) {
+			_mm_stream_si128((__m128i *) p, v);
+			_mm_stream_si128((__m128i *) (p + 16), v);
+			_mm_stream_si128((__m128i *) (p + 32), v);
+			_mm_stream_si128((__m128i *) (p + 48), v);
+		}
+		nt = true;
+	}
+	for (; nbytes >= 64; p += 64, nbytes -= 64) {
+		_mm_store_si128((__m128i *) p, v);
+		_mm_store_si128((__m128i *) (p + 16), v);
+		_mm_store_si128((__m128i *) (p + 32), v);
+		_mm_store_si128((__m128i *) (p + 48), v);
+	}
+	for (; nbytes >= 16; p += 16, nbytes -= 16)
+		_mm_store_si128((__m128i *) p, v);
+#else
+	for (; nbytes >= 32; p += 32, nbytes -= 32) {
+		memcpy(p, &pat, 8);
+		memcpy(p + 8, &pat, 8);
+		memcpy(p + 16, &pat, 8);
+		memcpy(p + 24, &pat, 8);
+	}
+	for (; nbytes >= 8; p += 8, nbytes -= 8)
+		memcpy(p, &pat, 8);
+#endif
+
+	for (; nbytes > 0; p += bpp, nbytes -= bpp)
+		memcpy(p, &pat, bpp);
+	return nt;
+}
+
+static inline void
+bres_fb_fence(bool nt)
+{
+#ifdef __SSE2__
+	if (nt)
+		_mm_sfence();
+#endif
+}
+
+/**
+ * Allocate a (width x height) framebuffer with bpp bytes per pixel.
+ * Rows are padded to a multiple of 16 bytes.
+ */
+struct bres_fb *
+bres_fb_alloc(int width, int height, int bpp)
+{
+	struct bres_fb *fb;
+	void *p;
+	int stride;
+
+	stride = (width * bpp + 15) & ~15;
+	fb = calloc(1, sizeof(*fb));
+	if (fb == NULL)
+		return NULL;
+	if (posix_memalign(&p, 64, (size_t) stride * height) != 0) {
+		free(fb);
+		return NULL;
+	}
+	if (! bres_fb_init(fb, p, width, height, stride, bpp)) {
+		free(p);
+		free(fb);
+		return NULL;
+	}
+	fb->own = true;
+	bres_fb_clear(fb, 0);
+	return fb;
+}
+
+/**
+ * Set up fb to draw into caller-owned pixels, eg an SDL surface.
+ */
+bool
+bres_fb_init(struct bres_fb *fb, void *pixels, int width, int height,
+    int stride, int bpp)
+{
+	if (bpp != 1 && bpp != 2 && bpp != 4) {
+		printf("%s: unsupported pixel size %d\n", __func__, bpp);
+		return false;
+	}
+	if (stride < width * bpp || (stride % bpp) != 0 ||
+	    ((uintptr_t) pixels % bpp) != 0) {
+		printf("%s: bad stride %d / alignment\n", __func__, stride);
+		return false;
+	}
+
+	fb->pixels = pixels;
+	fb->width = width;
+	fb->height = height;
+	fb->stride = stride;
+	fb->bpp = bpp;
+	fb->own = false;
+	return true;
+}
+
+void
+bres_fb_free(struct bres_fb *fb)
+{
+	if (fb == NULL)
+		return;
+	if (fb->own) {
+		free(fb->pixels);
+		free(fb);
+	}
+}
+
+void
+bres_fb_clear(struct bres_fb *fb, uint32_t color)
+{
+	uint64_t pat = bres_fb_pattern(fb->bpp, color);
+	bool nt = false;
+	int y;
+
+	/* Padded rows are contiguous, so it's one big fill */
+	if (fb->stride == ((fb->width * fb->bpp + 15) & ~15)) {
+		nt = bres_fb_fill_row(fb->pixels,
+		    (size_t) fb->stride * fb->height, fb->bpp, pat);
+	} else {
+		for (y = 0; y < fb->height; y++)
+			nt |= bres_fb_fill_row(fb->pixels +
+			    (size_t) y * fb->stride, fb->width * fb->bpp,
+			    fb->bpp, pat);
+	}
+	bres_fb_fence(nt);
+}
+
+/*
+ * Clip an inclusive span to the framebuffer and fill it.
+ */
+static inline bool
+bres_fb_span(struct bres_fb *fb, int x1, int x2, int y, uint64_t pat)
+{
+	if (y < 0 || y >= fb->height)
+		return false;
+	if (x1 < 0)
+		x1 = 0;
+	if (x2 >= fb->width)
+		x2 = fb->width - 1;
+	if (x1 > x2)
+		return false;
+
+	return bres_fb_fill_row(fb->pixels + (size_t) y * fb->stride +
+	    x1 * fb->bpp, (size_t) (x2 - x1 + 1) * fb->bpp, fb->bpp, pat);
+}
+
+/**
+ * Fill pixels x1..x2 inclusive of row y.
+ */
+void
+bres_fb_fill_span(struct bres_fb *fb, int x1, int x2, int y, uint32_t color)
+{
+	bres_fb_fence(bres_fb_span(fb, x1, x2, y,
+	    bres_fb_pattern(fb->bpp, color)));
+}
+
+/**
+ * Fill every span in a scanline list.
+ */
+void
+bres_fb_fill_spans(struct bres_fb *fb, const struct scanline_list *sl,
+    uint32_t color)
+{
+	const struct scanline_2d *s = sl->list;
+	uint64_t pat = bres_fb_pattern(fb->bpp, color);
+	bool nt = false;
+	int i;
+
+	for (i = 0; i < sl->cur; i++)
+		nt |= bres_fb_span(fb, s[i].x1, s[i].x2, s[i].y, pat);
+	bres_fb_fence(nt);
+}
+
+/*
+ * Clip n spans' x ends to [0, w).  With SSE2, eight 16 bit ends
+ * at a time.
+ */
+static inline void
+bres_fb_clip_x(const int16_t *x1, const int16_t *x2, int16_t *cx1,
+    int16_t *cx2, int n, int w)
+{
+	int i = 0;
+#ifdef __SSE2__
+	const __m128i lo = _mm_setzero_si128();
+	const __m128i hi = _mm_set1_epi16(w - 1);
+
+	for (; i + 8 <= n; i += 8) {
+		_mm_storeu_si128((__m128i *) &cx1[i], _mm_max_epi16(lo,
+		    _mm_loadu_si128((const __m128i *) &x1[i])));
+		_mm_storeu_si128((__m128i *) &cx2[i], _mm_min_epi16(hi,
+		    _mm_loadu_si128((const __m128i *) &x2[i])));
+	}
+#endif
+	for (; i < n; i++) {
+		cx1[i] = x1[i] < 0 ? 0 : x1[i];
+		cx2[i] = x2[i] > w - 1 ? w - 1 : x2[i];
+	}
+}
+
+/**
+ * Fill every span in a structure of arrays span list.  The x ends
+ * are read and clipped a vector at a time; the framebuffer must be
+ * at most 32767 pixels wide.
+ */
+void
+bres_fb_fill_soa(struct bres_fb *fb, const struct scanline_soa *s,
+    uint32_t color)
+{
+	const struct scanline_run *r;
+	uint64_t pat = bres_fb_pattern(fb->bpp, color);
+	int16_t cx1[64], cx2[64];
+	bool nt = false;
+	int i, j, k, n, y;
+
+	for (i = 0; i < s->nruns; i++) {
+		r = &s->runs[i];
+		y = r->y;
+		for (j = 0; j < r->count; j += n) {
+			n = r->count - j < 64 ? r->count - j : 64;
+			bres_fb_clip_x(&s->x1[r->first + j],
+			    &s->x2[r->first + j], cx1, cx2, n, fb->width);
+			for (k = 0; k < n; k++, y += r->dir) {
+				if (y < 0 || y >= fb->height ||
+				    cx1[k] > cx2[k])
+					continue;
+				nt |= bres_fb_fill_row(fb->pixels +
+				    (size_t) y * fb->stride + cx1[k] * fb->bpp,
+				    (size_t) (cx2[k] - cx1[k] + 1) * fb->bpp,
+				    fb->bpp, pat);
+			}
+		}
+	}
+	bres_fb_fence(nt);
+}
+
+uint32_t
+bres_fb_get_pixel(const struct bres_fb *fb, int x, int y)
+{
+	const uint8_t *p;
+	uint16_t v16;
+	uint32_t v32;
+
+	if (x < 0 || x >= fb->width || y < 0 || y >= fb->height)
+		return 0;
+	p = fb->pixels + (size_t) y * fb->stride + x * fb->bpp;
+	switch (fb->bpp) {
+	case 1:
+		return (*p);
+	case 2:
+		memcpy(&v16, p, 2);
+		return (v16);
+	default:
+		memcpy(&v32, p, 4);
+		return (v32);
+	}
+}
+
+/**
+ * Dump the framebuffer as a binary PPM.  8 bit pixels are taken as
+ * RGB332, 16 bit as RGB565 and 32 bit as xRGB8888.
+ */
+bool
+bres_fb_write_ppm(const struct bres_fb *fb, const char *path)
+{
+	uint32_t v, r, g, b;
+	FILE *fp;
+	int x, y;
+
+	fp = fopen(path, "w");
+	if (fp == NULL) {
+		perror(path);
+		return false;
+	}
+	fprintf(fp, "P6\n%d %d\n255\n", fb->width, fb->height);
+	for (y = 0; y < fb->height; y++) {
+		for (x = 0; x < fb->width; x++) {
+			v = bres_fb_get_pixel(fb, x, y);
+			switch (fb->bpp) {
+			case 1:
+				r = (v >> 5) * 255 / 7;
+				g = ((v >> 2) & 7) * 255 / 7;
+				b = (v & 3) * 255 / 3;
+				break;
+			case 2:
+				r = (v >> 11) * 255 / 31;
+				g = ((v >> 5) & 0x3f) * 255 / 63;
+				b = (v & 0x1f) * 255 / 31;
+				break;
+			default:
+				r = (v >> 16) & 0xff;
+				g = (v >> 8) & 0xff;
+				b = v & 0xff;
+				break;
+			}
+			fputc(r, fp);
+			fputc(g, fp);
+			fputc(b, fp);
+		}
+	}
+	if (fclose(fp) != 0) {
+		perror(path);
+		return false;
+	}
+	return true;
+}
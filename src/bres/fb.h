@@ -0,0 +1,39 @@
+#ifndef	__FB_H__
+#define	__FB_H__
+
+/*
+ * A host memory framebuffer for rendering scanline lists on the CPU,
+ * eg for off-screen rendering and previews.
+ *
+ * Pixels are 1, 2 or 4 bytes; the colour passed to the fill
+ * routines is already in that format.
+ */
+struct bres_fb {
+	uint8_t *pixels;
+	int width;
+	int height;
+	int stride;		/* bytes per row */
+	int bpp;		/* bytes per pixel: 1, 2 or 4 */
+	bool own;		/* pixels were allocated by bres_fb_alloc() */
+};
+
+/* Spans at least this many bytes long bypass the cache */
+#define	BRES_FB_NT_BYTES		2048
+
+extern	struct bres_fb *bres_fb_alloc(int width, int height, int bpp);
+extern	bool bres_fb_init(struct bres_fb *fb, void *pixels, int width,
+	    int height, int stride, int bpp);
+extern	void bres_fb_free(struct bres_fb *fb);
+
+extern	void bres_fb_clear(struct bres_fb *fb, uint32_t color);
+extern	void bres_fb_fill_span(struct bres_fb *fb, int x1, int x2, int y,
+	    uint32_t color);
+extern	void bres_fb_fill_spans(struct bres_fb *fb,
+	    const struct scanline_list *sl, uint32_t color);
+extern	void bres_fb_fill_soa(struct bres_fb *fb,
+	    const struct scanline_soa *s, uint32_t color);
+extern	uint32_t bres_fb_get_pixel(const struct bres_fb *fb, int x, int y);
+
+extern	bool bres_fb_write_ppm(const struct bres_fb *fb, const char *path);
+
+#endif	/* __FB_H__ */
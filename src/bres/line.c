@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "scanline.h"
+#include "line.h"
+
+/*
+ * Lines as spans, by run-slice Bresenham.
+ *
+ * The pixels are exactly those of the classic integer Bresenham
+ * loop the REX3 model draws I_LINEs with, both ends included: for
+ * a line whose major axis has length A and minor axis B, step i
+ * (0 <= i <= A) from the start is at minor axis offset
+ *
+ *   floor((2 * B * i + A) / (2 * A))
+ *
+ * ie rounded to nearest with ties going towards the end point - so
+ * like the hardware, a line and its reverse can differ by a pixel
+ * where they tie.
+ *
+ * Rather than stepping a pixel at a time, an x major line is drawn
+ * a horizontal run at a time: run j starts at the first step whose
+ * offset reaches j, which is ceil((2j - 1) * A / (2 * B)), and the
+ * run lengths come out of a quotient / remainder pair stepped once
+ * per run.  A long shallow line is a handful of spans rather than
+ * one per pixel.  y major lines are one pixel per scanline whatever
+ * is done, so they just step x with the same error term.
+ *
+ * Thick lines sweep the thin line's pixels along the minor axis, so
+ * each scanline is still one span.
+ */
+
+/*
+ * Where run j of an x major line starts: step
+ * max(0, ceil((2j - 1) * A / (2 * B))), or A + 1 past the last run.
+ */
+struct bres_line_runs {
+	int j, jmax;
+	int q, r;		/* (2j - 1) * A / 2B, remainder */
+	int dq, dr;		/* 2A / 2B, 2A % 2B */
+	int d;			/* 2B */
+	int end;		/* A + 1 */
+};
+
+static void
+bres_line_runs_init(struct bres_line_runs *lr, int a, int b)
+{
+	lr->j = 0;
+	lr->jmax = b;
+	lr->end = a + 1;
+	lr->d = 2 * b;
+	lr->q = lr->r = lr->dq = lr->dr = 0;
+	if (b == 0)
+		return;
+	/* Run 1 */
+	lr->q = a / lr->d;
+	lr->r = a % lr->d;
+	lr->dq = a / b;
+	lr->dr = 2 * (a % b);
+}
+
+static inline int
+bres_line_runs_start(const struct bres_line_runs *lr)
+{
+	if (lr->j == 0)
+		return (0);
+	if (lr->j > lr->jmax)
+		return (lr->end);
+	return (lr->q + (lr->r > 0));
+}
+
+static inline void
+bres_line_runs_next(struct bres_line_runs *lr)
+{
+	if (lr->j++ == 0)
+		return;
+	lr->q += lr->dq;
+	lr->r += lr->dr;
+	if (lr->r >= lr->d) {
+		lr->q++;
+		lr->r -= lr->d;
+	}
+}
+
+/* Integer square root, rounded down */
+static uint64_t
+bres_line_isqrt(uint64_t v)
+{
+	uint64_t r = 0, bit = 1ULL << 62;
+
+	while (bit > v)
+		bit >>= 2;
+	while (bit != 0) {
+		if (v >= r + bit) {
+			v -= r + bit;
+			r = (r >> 1) + bit;
+		} else
+			r >>= 1;
+		bit >>= 2;
+	}
+	return (r);
+}
+
+/*
+ * How many minor axis pixels a line width pixels thick covers at
+ * each major axis step: width * length / major, to the nearest.
+ */
+static int
+bres_line_sweep(int width, int major, int minor)
+{
+	uint64_t v;
+
+	if (width <= 1 || major == 0)
+		return (1);
+	/* floor((sqrt(4 * w^2 * (M^2 + m^2)) + M) / 2M) */
+	v = bres_line_isqrt(4ULL * width * width *
+	    ((uint64_t) major * major + (uint64_t) minor * minor));
+	return ((int) ((v + major) / (2 * (uint64_t) major)));
+}
+
+static inline void
+bres_line_push(struct scanline_list *slist, int x1, int x2, int y)
+{
+	if (x1 <= x2)
+		scanline_list_push(slist, x1, x2, y);
+	else
+		scanline_list_push(slist, x2, x1, y);
+}
+
+/*
+ * An x major line (dx >= dy), swept n pixels vertically: scanline
+ * k, counting from the start in the line's y direction, covers the
+ * runs j from k - n / 2 to k + (n - 1) / 2.
+ */
+static void
+bres_line_xmajor(struct scanline_list *slist, int x1, int y1, int sx,
+    int sy, int a, int b, int n)
+{
+	struct bres_line_runs lo, hi;
+	const int h0 = (n - 1) / 2, h1 = n / 2;
+	int k, s0, s1;
+
+	bres_line_runs_init(&lo, a, b);
+	bres_line_runs_init(&hi, a, b);
+	/* hi tracks the run after the last one on the scanline */
+	bres_line_runs_next(&hi);
+
+	for (k = -h0; k <= b + h1; k++) {
+		s0 = bres_line_runs_start(&lo);
+		s1 = bres_line_runs_start(&hi) - 1;
+		bres_line_push(slist, x1 + sx * s0, x1 + sx * s1, y1 + sy * k);
+		if (k - h1 >= 0)
+			bres_line_runs_next(&lo);
+		if (hi.j <= b)
+			bres_line_runs_next(&hi);
+	}
+}
+
+/*
+ * A y major line (dy > dx), swept n pixels horizontally; one span
+ * per scanline.
+ */
+static void
+bres_line_ymajor(struct scanline_list *slist, int x1, int y1, int sx,
+    int sy, int a, int b, int n)
+{
+	const int h0 = (n - 1) / 2, h1 = n / 2;
+	int j, x, r;
+
+	/* x offset is floor((2 * a * j + b) / 2b); a < b */
+	x = 0;
+	r = b;
+	for (j = 0; j <= b; j++) {
+		bres_line_push(slist, x1 + sx * (x - h0),
+		    x1 + sx * (x + h1), y1 + sy * j);
+		r += 2 * a;
+		if (r >= 2 * b) {
+			x++;
+			r -= 2 * b;
+		}
+	}
+}
+
+/**
+ * Append the spans of a thick line from (x1, y1) to (x2, y2), both
+ * ends included.  The line's pixels are swept along its minor axis
+ * to make it width pixels thick, measured square on to the line.
+ * The list is grown as needed.
+ *
+ * Returns false if memory ran out.
+ */
+bool
+bres_line_thick(struct scanline_list *slist, int x1, int y1, int x2, int y2,
+    int width)
+{
+	const int sx = (x2 < x1) ? -1 : 1, sy = (y2 < y1) ? -1 : 1;
+	const int dx = abs(x2 - x1), dy = abs(y2 - y1);
+	int n;
+
+	if (dx >= dy) {
+		n = bres_line_sweep(width, dx, dy);
+		if (! scanline_list_reserve(slist, dy + n))
+			return false;
+		bres_line_xmajor(slist, x1, y1, sx, sy, dx, dy, n);
+	} else {
+		n = bres_line_sweep(width, dy, dx);
+		if (! scanline_list_reserve(slist, dy + 1))
+			return false;
+		bres_line_ymajor(slist, x1, y1, sx, sy, dx, dy, n);
+	}
+	return true;
+}
+
+/**
+ * Append the spans of a one pixel line from (x1, y1) to (x2, y2),
+ * both ends included; the same pixels as a REX3 I_LINE.
+ */
+bool
+bres_line(struct scanline_list *slist, int x1, int y1, int x2, int y2)
+{
+	return (bres_line_thick(slist, x1, y1, x2, y2, 1));
+}
@@ -0,0 +1,9 @@
+#ifndef	__LINE_H__
+#define	__LINE_H__
+
+extern	bool bres_line(struct scanline_list *slist, int x1, int y1, int x2,
+	    int y2);
+extern	bool bres_line_thick(struct scanline_list *slist, int x1, int y1,
+	    int x2, int y2, int width);
+
+#endif	/* __LINE_H__ */
@@ -0,0 +1,334 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "point.h"
+#include "scanline.h"
+#include "edge.h"
+#include "mesh.h"
+
+/*
+ * Triangle strips and indexed triangle meshes.
+ *
+ * Neighbouring triangles share edges - one per triangle in a strip,
+ * most of them in a typical mesh - so rather than walking every
+ * triangle's edges from scratch, each edge is walked once and its
+ * per-scanline pixel crossings are cached, keyed by its (unordered)
+ * pair of vertex indexes.  Triangles then just pair up the cached
+ * crossings of their long edge and their two short edges.
+ *
+ * The coverage rules are the same as bres_polygon(): a triangle
+ * covers scanlines [ytop, ybot) and pixels [xleft, xright) of each,
+ * so triangles sharing an edge never both draw it.  A mesh's spans
+ * are the same as drawing each triangle with bres_polygon().
+ *
+ * The _subpixel variants take 28.4 fixed point vertices and sample
+ * at pixel centres with a strict top-left rule (see edge.h), so
+ * meshes with fractional vertices are covered exactly once too.
+ */
+
+struct bres_mesh_edge {
+	int v0, v1;		/* vertex indexes, v0 < v1 */
+	int ytop, ybot;
+	int off;		/* first crossing in the xs[] pool */
+	int next;		/* hash chain; -1 terminated */
+};
+
+struct bres_mesh_cache {
+	const struct point2d *pts;
+	bool subpixel;
+
+	struct bres_mesh_edge *edges;
+	int nedges, maxedges;
+
+	/* First pixel at or right of each edge's crossing, per scanline */
+	int *xs;
+	int nxs, maxxs;
+
+	int *hash;
+	int hashmask;
+};
+
+static bool
+bres_mesh_cache_init(struct bres_mesh_cache *mc, const struct point2d *pts,
+    int nedges, bool subpixel)
+{
+	int i, size;
+
+	mc->pts = pts;
+	mc->subpixel = subpixel;
+	mc->nedges = 0;
+	mc->maxedges = nedges > 16 ? nedges : 16;
+	mc->nxs = 0;
+	mc->maxxs = mc->maxedges * 16;
+
+	for (size = 16; size < mc->maxedges * 2; size *= 2)
+		;
+	mc->hashmask = size - 1;
+
+	mc->edges = calloc(mc->maxedges, sizeof(*mc->edges));
+	mc->xs = calloc(mc->maxxs, sizeof(int));
+	mc->hash = calloc(size, sizeof(int));
+	if (mc->edges == NULL || mc->xs == NULL || mc->hash == NULL) {
+		free(mc->edges);
+		free(mc->xs);
+		free(mc->hash);
+		return false;
+	}
+	for (i = 0; i < size; i++)
+		mc->hash[i] = -1;
+	return true;
+}
+
+static void
+bres_mesh_cache_free(struct bres_mesh_cache *mc)
+{
+	free(mc->edges);
+	free(mc->xs);
+	free(mc->hash);
+}
+
+/*
+ * The first scanline at or below y.
+ */
+static inline int
+bres_mesh_row(const struct bres_mesh_cache *mc, int y)
+{
+	return (mc->subpixel ? bres_subpixel_row(y) : y);
+}
+
+/*
+ * Walk edge (v0, v1) into the cache.
+ */
+static int
+bres_mesh_edge_walk(struct bres_mesh_cache *mc, int v0, int v1, int h)
+{
+	struct bres_mesh_edge *me, *ne;
+	struct bres_edge e;
+	int n, y, *nx;
+
+	if (mc->nedges == mc->maxedges) {
+		ne = realloc(mc->edges, mc->maxedges * 2 * sizeof(*ne));
+		if (ne == NULL)
+			return (-1);
+		mc->edges = ne;
+		mc->maxedges *= 2;
+	}
+
+	if (mc->subpixel)
+		bres_edge_init_subpixel(&e, &mc->pts[v0], &mc->pts[v1]);
+	else
+		bres_edge_init(&e, &mc->pts[v0], &mc->pts[v1]);
+	n = e.ybot - e.ytop;
+	if (mc->nxs + n > mc->maxxs) {
+		while (mc->nxs + n > mc->maxxs)
+			mc->maxxs *= 2;
+		nx = realloc(mc->xs, mc->maxxs * sizeof(int));
+		if (nx == NULL)
+			return (-1);
+		mc->xs = nx;
+	}
+
+	me = &mc->edges[mc->nedges];
+	me->v0 = v0;
+	me->v1 = v1;
+	me->ytop = e.ytop;
+	me->ybot = e.ybot;
+	me->off = mc->nxs;
+	for (y = 0; y < n; y++) {
+		mc->xs[mc->nxs++] = bres_edge_ceil(&e);
+		bres_edge_step(&e);
+	}
+
+	me->next = mc->hash[h];
+	mc->hash[h] = mc->nedges;
+	return (mc->nedges++);
+}
+
+/*
+ * Find (or walk) the non-horizontal edge between vertexes a and b;
+ * returns its index or -1 if memory ran out.
+ */
+static int
+bres_mesh_edge(struct bres_mesh_cache *mc, int a, int b)
+{
+	int h, i, t;
+
+	if (a > b) {
+		t = a;
+		a = b;
+		b = t;
+	}
+	h = ((uint32_t) a * 2654435761U ^ (uint32_t) b) & mc->hashmask;
+	for (i = mc->hash[h]; i >= 0; i = mc->edges[i].next)
+		if (mc->edges[i].v0 == a && mc->edges[i].v1 == b)
+			return (i);
+	return (bres_mesh_edge_walk(mc, a, b, h));
+}
+
+/*
+ * Spans for scanlines [ys, ye) between two cached edges.
+ */
+static void
+bres_mesh_half(struct bres_mesh_cache *mc, struct scanline_list *slist,
+    int el, int es, int ys, int ye)
+{
+	const int *xs = mc->xs;
+	int lo, so, y, x0, x1, t;
+
+	/* Index into xs[] by scanline */
+	lo = mc->edges[el].off - mc->edges[el].ytop;
+	so = mc->edges[es].off - mc->edges[es].ytop;
+	for (y = ys; y < ye; y++) {
+		x0 = xs[lo + y];
+		x1 = xs[so + y];
+		if (x0 > x1) {
+			t = x0;
+			x0 = x1;
+			x1 = t;
+		}
+		if (x1 > x0)
+			scanline_list_push(slist, x0, x1 - 1, y);
+	}
+}
+
+static bool
+bres_mesh_triangle(struct bres_mesh_cache *mc, struct scanline_list *slist,
+    int a, int b, int c)
+{
+	const struct point2d *p = mc->pts;
+	int t, elong, eab, ebc, ya, yb, yc;
+
+	/* Sort by y */
+	if (p[a].y > p[b].y) {
+		t = a; a = b; b = t;
+	}
+	if (p[b].y > p[c].y) {
+		t = b; b = c; c = t;
+	}
+	if (p[a].y > p[b].y) {
+		t = a; a = b; b = t;
+	}
+
+	/* Edges that don't cross a scanline are never walked */
+	ya = bres_mesh_row(mc, p[a].y);
+	yb = bres_mesh_row(mc, p[b].y);
+	yc = bres_mesh_row(mc, p[c].y);
+	if (ya == yc)
+		return true;
+
+	if (! scanline_list_reserve(slist, yc - ya))
+		return false;
+
+	elong = bres_mesh_edge(mc, a, c);
+	if (elong < 0)
+		return false;
+	if (ya != yb) {
+		eab = bres_mesh_edge(mc, a, b);
+		if (eab < 0)
+			return false;
+		bres_mesh_half(mc, slist, elong, eab, ya, yb);
+	}
+	if (yb != yc) {
+		ebc = bres_mesh_edge(mc, b, c);
+		if (ebc < 0)
+			return false;
+		bres_mesh_half(mc, slist, elong, ebc, yb, yc);
+	}
+	return true;
+}
+
+static bool
+bres_mesh_strip(struct scanline_list *slist, const struct point2d *pts,
+    int npts, bool subpixel)
+{
+	struct bres_mesh_cache mc;
+	bool ret = true;
+	int i;
+
+	if (npts < 3)
+		return true;
+	if (! bres_mesh_cache_init(&mc, pts, npts * 2, subpixel))
+		return false;
+	for (i = 0; i + 2 < npts && ret; i++)
+		ret = bres_mesh_triangle(&mc, slist, i, i + 1, i + 2);
+	bres_mesh_cache_free(&mc);
+	return ret;
+}
+
+static bool
+bres_mesh_indexed(struct scanline_list *slist, const struct point2d *pts,
+    int npts, const int *indices, int ntris, bool subpixel)
+{
+	struct bres_mesh_cache mc;
+	bool ret = true;
+	int i;
+
+	for (i = 0; i < ntris * 3; i++) {
+		if (indices[i] < 0 || indices[i] >= npts) {
+			printf("%s: index %d (%d) out of range\n", __func__,
+			    i, indices[i]);
+			return false;
+		}
+	}
+
+	if (ntris <= 0)
+		return true;
+	if (! bres_mesh_cache_init(&mc, pts, ntris * 3, subpixel))
+		return false;
+	for (i = 0; i < ntris && ret; i++)
+		ret = bres_mesh_triangle(&mc, slist, indices[i * 3],
+		    indices[i * 3 + 1], indices[i * 3 + 2]);
+	bres_mesh_cache_free(&mc);
+	return ret;
+}
+
+/**
+ * Scan convert a triangle strip - triangle i is pts[i], pts[i + 1],
+ * pts[i + 2] - appending each triangle's spans to slist in turn.
+ * The list is grown as needed.
+ *
+ * Returns false if memory ran out.
+ */
+bool
+bres_triangle_strip(struct scanline_list *slist, const struct point2d *pts,
+    int npts)
+{
+	return (bres_mesh_strip(slist, pts, npts, false));
+}
+
+/**
+ * Scan convert ntris indexed triangles - triangle i is
+ * pts[indices[i * 3 + 0..2]] - appending each triangle's spans to
+ * slist in turn.  The list is grown as needed.
+ *
+ * Returns false if memory ran out or an index is out of range.
+ */
+bool
+bres_triangle_mesh(struct scanline_list *slist, const struct point2d *pts,
+    int npts, const int *indices, int ntris)
+{
+	return (bres_mesh_indexed(slist, pts, npts, indices, ntris, false));
+}
+
+/**
+ * bres_triangle_strip() with 28.4 subpixel vertices.
+ */
+bool
+bres_triangle_strip_subpixel(struct scanline_list *slist,
+    const struct point2d *pts, int npts)
+{
+	return (bres_mesh_strip(slist, pts, npts, true));
+}
+
+/**
+ * bres_triangle_mesh() with 28.4 subpixel vertices.
+ */
+bool
+bres_triangle_mesh_subpixel(struct scanline_list *slist,
+    const struct point2d *pts, int npts, const int *indices, int ntris)
+{
+	return (bres_mesh_indexed(slist, pts, npts, indices, ntris, true));
+}
@@ -0,0 +1,15 @@
+#ifndef	__MESH_H__
+#define	__MESH_H__
+
+extern	bool bres_triangle_strip(struct scanline_list *slist,
+	    const struct point2d *pts, int npts);
+extern	bool bres_triangle_mesh(struct scanline_list *slist,
+	    const struct point2d *pts, int npts, const int *indices,
+	    int ntris);
+extern	bool bres_triangle_strip_subpixel(struct scanline_list *slist,
+	    const struct point2d *pts, int npts);
+extern	bool bres_triangle_mesh_subpixel(struct scanline_list *slist,
+	    const struct point2d *pts, int npts, const int *indices,
+	    int ntris);
+
+#endif	/* __MESH_H__ */
@@ -9,4 +9,12 @@ struct point3d {
 	int x, y, z;
 };
 
+/*
+ * Subpixel coordinates, for the _subpixel rasterisers: 28.4 fixed
+ * point, so a pixel is 16 units and its centre is at +8.
+ */
+#define	BRES_SUBPIXEL_BITS		4
+#define	BRES_SUBPIXEL_ONE		(1 << BRES_SUBPIXEL_BITS)
+#define	BRES_INT_TO_SUBPIXEL(v)		((v) * BRES_SUBPIXEL_ONE)
+
 #endif	/* __POINT_H__ */
@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "point.h"
+#include "scanline.h"
+#include "polygon.h"
+#include "edge.h"
+
+/*
+ * General polygon scan conversion - simple, concave and
+ * self-intersecting polygons, with either fill rule.
+ *
+ * This is the classic edge table / active edge list approach:
+ *
+ * + every non-horizontal edge goes into the edge table, sorted
+ *   by its top y;
+ * + each scanline, edges starting there join the active edge list
+ *   and edges that have ended leave it;
+ * + the active edges are kept sorted by their x crossing (an
+ *   insertion sort, since the order barely changes from one
+ *   scanline to the next, only where edges cross);
+ * + spans are emitted between crossings according to the fill rule;
+ * + each active edge then steps its x to the next scanline with
+ *   an integer Bresenham error term, no division per scanline.
+ *
+ * Vertices are at integer pixel positions.  A pixel (x, y) is
+ * inside when the point (x, y) is: edges cover scanlines
+ * [ytop, ybottom) and a span covers pixels [xleft, xright), so
+ * polygons that share an edge don't both draw it and nothing is
+ * drawn twice.
+ */
+
+static int
+bres_edge_cmp_ytop(const void *a, const void *b)
+{
+	const struct bres_edge *ea = a, *eb = b;
+
+	return (ea->ytop - eb->ytop);
+}
+
+/*
+ * Is edge a's crossing left of edge b's?
+ */
+static inline bool
+bres_edge_left_of(const struct bres_edge *a, const struct bres_edge *b)
+{
+	if (a->x != b->x)
+		return (a->x < b->x);
+	return ((int64_t) a->e * b->dy < (int64_t) b->e * a->dy);
+}
+
+/*
+ * Emit [x1, x2) on scanline y, merging it with the previous span
+ * if they touch.
+ */
+static bool
+bres_polygon_span(struct scanline_list *slist, int x1, int x2, int y,
+    int first)
+{
+	struct scanline_2d *prev;
+
+	if (x2 <= x1)
+		return true;
+	if (slist->cur > first) {
+		prev = &slist->list[slist->cur - 1];
+		if (prev->x2 + 1 >= x1) {
+			if (x2 - 1 > prev->x2)
+				prev->x2 = x2 - 1;
+			return true;
+		}
+	}
+	if (! scanline_list_reserve(slist, 1))
+		return false;
+	return scanline_list_push(slist, x1, x2 - 1, y);
+}
+
+/**
+ * Scan convert a polygon with npts vertices (the last one joins
+ * back to the first) and append its spans to slist, top to bottom
+ * and left to right.  The list is grown as needed.
+ *
+ * Returns false if memory ran out.
+ */
+bool
+bres_polygon(struct scanline_list *slist, const struct point2d *pts,
+    int npts, BresFillRule rule)
+{
+	struct bres_edge *edges, **active, *t;
+	int nedges, nactive, next, i, j, y, wind, xl, first;
+	bool ret = true;
+
+	if (npts < 3)
+		return true;
+
+	edges = calloc(npts, sizeof(*edges));
+	active = calloc(npts, sizeof(*active));
+	if (edges == NULL || active == NULL) {
+		free(edges);
+		free(active);
+		return false;
+	}
+
+	/* Edge table; horizontal edges never cross a scanline */
+	nedges = 0;
+	for (i = 0; i < npts; i++) {
+		j = (i + 1) % npts;
+		if (pts[i].y == pts[j].y)
+			continue;
+		bres_edge_init(&edges[nedges++], &pts[i], &pts[j]);
+	}
+	if (nedges == 0)
+		goto done;
+	qsort(edges, nedges, sizeof(*edges), bres_edge_cmp_ytop);
+
+	nactive = 0;
+	next = 0;
+	for (y = edges[0].ytop; nactive > 0 || next < nedges; y++) {
+		/* Drop finished edges */
+		for (i = 0, j = 0; i < nactive; i++)
+			if (active[i]->ybot > y)
+				active[j++] = active[i];
+		nactive = j;
+
+		/* Add new ones */
+		while (next < nedges && edges[next].ytop == y)
+			active[nactive++] = &edges[next++];
+
+		/* Keep them sorted by crossing */
+		for (i = 1; i < nactive; i++) {
+			t = active[i];
+			for (j = i; j > 0 && bres_edge_left_of(t, active[j - 1]);
+			    j--)
+				active[j] = active[j - 1];
+			active[j] = t;
+		}
+
+		first = slist->cur;
+		if (rule == BresFillRuleEvenOdd) {
+			for (i = 0; i + 1 < nactive; i += 2)
+				if (! bres_polygon_span(slist,
+				    bres_edge_ceil(active[i]),
+				    bres_edge_ceil(active[i + 1]), y, first))
+					ret = false;
+		} else {
+			wind = 0;
+			xl = 0;
+			for (i = 0; i < nactive; i++) {
+				if (wind == 0)
+					xl = bres_edge_ceil(active[i]);
+				wind += active[i]->dir;
+				if (wind == 0 && ! bres_polygon_span(slist, xl,
+				    bres_edge_ceil(active[i]), y, first))
+					ret = false;
+			}
+		}
+
+		for (i = 0; i < nactive; i++)
+			bres_edge_step(active[i]);
+	}
+
+done:
+	free(edges);
+	free(active);
+	return ret;
+}
@@ -0,0 +1,14 @@
+#ifndef	__POLYGON_H__
+#define	__POLYGON_H__
+
+typedef enum {
+	/* Inside where a ray crosses an odd number of edges */
+	BresFillRuleEvenOdd = 0,
+	/* Inside where the edges wind around a non-zero number of times */
+	BresFillRuleNonZero = 1,
+} BresFillRule;
+
+extern	bool bres_polygon(struct scanline_list *slist,
+	    const struct point2d *pts, int npts, BresFillRule rule);
+
+#endif	/* __POLYGON_H__ */
@@ -0,0 +1,575 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/param.h>
+
+#include "point.h"
+#include "scanline.h"
+#include "edge.h"
+#include "raster_mt.h"
+
+/*
+ * Tile binned, multithreaded triangle rasterisation.
+ *
+ * The screen is cut into tiles and each triangle is binned into the
+ * tiles its bounding box touches.  The tiles are then rasterised by
+ * a pool of worker threads: each worker starts with its own queue of
+ * tiles and steals from the back of the others' queues when it runs
+ * out.  A tile is only ever rasterised by one worker, into its own
+ * span list, so there's no locking on the rasteriser side.  Each
+ * worker sorts its tile's spans by y and the calling thread then
+ * merges the tiles back together in y order, rejoining spans that
+ * were cut at a tile boundary.
+ *
+ * The coverage rules are the same as bres_polygon() and
+ * bres_triangle_mesh(), clipped to the screen; the merged list
+ * covers exactly the same pixels, the same number of times.
+ *
+ * The caller's thread is worker 0, so nthreads = 1 is a plain
+ * serial binned rasteriser.
+ */
+
+struct bres_raster_tile {
+	/* [x0, x1) x [y0, y1), clipped to the screen */
+	int x0, y0, x1, y1;
+	/* Triangles binned here are bins[bin_off .. bin_off + bin_count) */
+	int bin_off, bin_count;
+	struct scanline_list *sl;
+	/* Once sorted, row y's spans start at sl->list[rowstart[y - y0]] */
+	int rowstart[BRES_RASTER_MT_TILE_H + 1];
+};
+
+struct bres_raster_queue {
+	pthread_mutex_t lock;
+	int *tiles;
+	int head, tail;
+	uint64_t nsteals;
+};
+
+struct bres_raster_worker {
+	struct bres_raster_mt *rm;
+	int id;
+	pthread_t thread;
+	/* Scratch for sorting a tile's spans */
+	struct scanline_2d *scratch;
+	int nscratch;
+	uint64_t ntiles;
+};
+
+struct bres_raster_mt {
+	int width, height;
+	int ntx, nty, ntiles;
+	struct bres_raster_tile *tiles;
+
+	int *bins;
+	int maxbins;
+
+	int nthreads;
+	int nstarted;		/* worker threads actually running */
+	struct bres_raster_worker *workers;
+	struct bres_raster_queue *queues;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cv_start;
+	pthread_cond_t cv_done;
+	uint64_t gen;
+	int nbusy;
+	bool quit;
+	bool failed;
+
+	/* The current job */
+	const struct point2d *pts;
+	const int *indices;
+};
+
+/*
+ * Spans for one triangle, clipped to a tile.
+ */
+static bool
+bres_raster_mt_tri(const struct point2d *p, struct bres_raster_tile *t,
+    int a, int b, int c)
+{
+	struct bres_edge el, es;
+	int tmp, y, ys, ye, yh, x0, x1;
+
+	if (p[a].y > p[b].y) {
+		tmp = a; a = b; b = tmp;
+	}
+	if (p[b].y > p[c].y) {
+		tmp = b; b = c; c = tmp;
+	}
+	if (p[a].y > p[b].y) {
+		tmp = a; a = b; b = tmp;
+	}
+
+	ys = MAX(p[a].y, t->y0);
+	ye = MIN(p[c].y, t->y1);
+	if (ys >= ye)
+		return true;
+	if (! scanline_list_reserve(t->sl, ye - ys))
+		return false;
+
+	bres_edge_init(&el, &p[a], &p[c]);
+	bres_edge_advance(&el, ys - p[a].y);
+
+	for (y = ys; y < ye; ) {
+		/* Upper half against a-b, then lower half against b-c */
+		if (y < p[b].y) {
+			bres_edge_init(&es, &p[a], &p[b]);
+			bres_edge_advance(&es, y - p[a].y);
+			yh = MIN(p[b].y, ye);
+		} else {
+			bres_edge_init(&es, &p[b], &p[c]);
+			bres_edge_advance(&es, y - p[b].y);
+			yh = ye;
+		}
+		for (; y < yh; y++) {
+			x0 = bres_edge_ceil(&el);
+			x1 = bres_edge_ceil(&es);
+			if (x0 > x1) {
+				tmp = x0; x0 = x1; x1 = tmp;
+			}
+			x0 = MAX(x0, t->x0);
+			x1 = MIN(x1, t->x1);
+			if (x1 > x0)
+				scanline_list_push(t->sl, x0, x1 - 1, y);
+			bres_edge_step(&el);
+			bres_edge_step(&es);
+		}
+	}
+	return true;
+}
+
+/*
+ * Counting sort a finished tile's spans by y; spans on the same row
+ * keep their triangle order.
+ */
+static bool
+bres_raster_mt_sort(struct bres_raster_worker *w, struct bres_raster_tile *t)
+{
+	struct scanline_list *sl = t->sl;
+	struct scanline_2d *ns;
+	int i, r, nrows = t->y1 - t->y0, pos[BRES_RASTER_MT_TILE_H];
+
+	if (w->nscratch < sl->cur) {
+		ns = realloc(w->scratch, sl->cur * sizeof(*ns));
+		if (ns == NULL)
+			return false;
+		w->scratch = ns;
+		w->nscratch = sl->cur;
+	}
+
+	memset(t->rowstart, 0, sizeof(t->rowstart));
+	for (i = 0; i < sl->cur; i++)
+		t->rowstart[sl->list[i].y - t->y0 + 1]++;
+	for (r = 0; r < nrows; r++) {
+		t->rowstart[r + 1] += t->rowstart[r];
+		pos[r] = t->rowstart[r];
+	}
+	for (i = 0; i < sl->cur; i++)
+		w->scratch[pos[sl->list[i].y - t->y0]++] = sl->list[i];
+	memcpy(sl->list, w->scratch, sl->cur * sizeof(*ns));
+	return true;
+}
+
+static bool
+bres_raster_mt_tile(struct bres_raster_worker *w, struct bres_raster_tile *t)
+{
+	struct bres_raster_mt *rm = w->rm;
+	const int *tri;
+	int i;
+
+	t->sl->cur = 0;
+	for (i = 0; i < t->bin_count; i++) {
+		tri = &rm->indices[rm->bins[t->bin_off + i] * 3];
+		if (! bres_raster_mt_tri(rm->pts, t, tri[0], tri[1], tri[2]))
+			return false;
+	}
+	w->ntiles++;
+	return bres_raster_mt_sort(w, t);
+}
+
+/*
+ * Next tile for worker id: its own queue from the front, then steal
+ * from the back of everyone else's.  Returns -1 when there's nothing
+ * left anywhere.
+ */
+static int
+bres_raster_mt_next(struct bres_raster_mt *rm, int id)
+{
+	struct bres_raster_queue *q;
+	int i, t = -1;
+
+	for (i = 0; i < rm->nthreads && t < 0; i++) {
+		q = &rm->queues[(id + i) % rm->nthreads];
+		pthread_mutex_lock(&q->lock);
+		if (q->head < q->tail) {
+			if (i == 0)
+				t = q->tiles[q->head++];
+			else {
+				t = q->tiles[--q->tail];
+				q->nsteals++;
+			}
+		}
+		pthread_mutex_unlock(&q->lock);
+	}
+	return (t);
+}
+
+static void
+bres_raster_mt_work(struct bres_raster_worker *w)
+{
+	struct bres_raster_mt *rm = w->rm;
+	int t;
+
+	while ((t = bres_raster_mt_next(rm, w->id)) >= 0) {
+		if (! bres_raster_mt_tile(w, &rm->tiles[t])) {
+			pthread_mutex_lock(&rm->lock);
+			rm->failed = true;
+			pthread_mutex_unlock(&rm->lock);
+		}
+	}
+}
+
+static void *
+bres_raster_mt_thread(void *arg)
+{
+	struct bres_raster_worker *w = arg;
+	struct bres_raster_mt *rm = w->rm;
+	uint64_t gen = 0;
+
+	pthread_mutex_lock(&rm->lock);
+	for (;;) {
+		while (rm->gen == gen && ! rm->quit)
+			pthread_cond_wait(&rm->cv_start, &rm->lock);
+		if (rm->quit)
+			break;
+		gen = rm->gen;
+		pthread_mutex_unlock(&rm->lock);
+
+		bres_raster_mt_work(w);
+
+		pthread_mutex_lock(&rm->lock);
+		if (--rm->nbusy == 0)
+			pthread_cond_signal(&rm->cv_done);
+	}
+	pthread_mutex_unlock(&rm->lock);
+	return NULL;
+}
+
+/**
+ * Create a rasteriser for a (width x height) screen with nthreads
+ * workers, including the calling thread.
+ */
+struct bres_raster_mt *
+bres_raster_mt_create(int nthreads, int width, int height)
+{
+	struct bres_raster_mt *rm;
+	struct bres_raster_tile *t;
+	int i, tx, ty;
+
+	if (nthreads < 1)
+		nthreads = 1;
+
+	rm = calloc(1, sizeof(*rm));
+	if (rm == NULL)
+		return NULL;
+	rm->width = width;
+	rm->height = height;
+	rm->ntx = (width + BRES_RASTER_MT_TILE_W - 1) / BRES_RASTER_MT_TILE_W;
+	rm->nty = (height + BRES_RASTER_MT_TILE_H - 1) / BRES_RASTER_MT_TILE_H;
+	rm->ntiles = rm->ntx * rm->nty;
+	rm->nthreads = nthreads;
+	pthread_mutex_init(&rm->lock, NULL);
+	pthread_cond_init(&rm->cv_start, NULL);
+	pthread_cond_init(&rm->cv_done, NULL);
+
+	rm->tiles = calloc(rm->ntiles, sizeof(*rm->tiles));
+	rm->workers = calloc(nthreads, sizeof(*rm->workers));
+	rm->queues = calloc(nthreads, sizeof(*rm->queues));
+	if (rm->tiles == NULL || rm->workers == NULL || rm->queues == NULL)
+		goto fail;
+	for (i = 0; i < nthreads; i++) {
+		pthread_mutex_init(&rm->queues[i].lock, NULL);
+		rm->queues[i].tiles = calloc(rm->ntiles, sizeof(int));
+		if (rm->queues[i].tiles == NULL)
+			goto fail;
+		rm->workers[i].rm = rm;
+		rm->workers[i].id = i;
+	}
+
+	for (ty = 0; ty < rm->nty; ty++) {
+		for (tx = 0; tx < rm->ntx; tx++) {
+			t = &rm->tiles[ty * rm->ntx + tx];
+			t->x0 = tx * BRES_RASTER_MT_TILE_W;
+			t->y0 = ty * BRES_RASTER_MT_TILE_H;
+			t->x1 = MIN(t->x0 + BRES_RASTER_MT_TILE_W, width);
+			t->y1 = MIN(t->y0 + BRES_RASTER_MT_TILE_H, height);
+			t->sl = scanline_list_alloc(BRES_RASTER_MT_TILE_H * 4);
+			if (t->sl == NULL)
+				goto fail;
+		}
+	}
+
+	/* Worker 0 is whoever calls bres_raster_mt_triangles() */
+	for (i = 1; i < nthreads; i++) {
+		if (pthread_create(&rm->workers[i].thread, NULL,
+		    bres_raster_mt_thread, &rm->workers[i]) != 0) {
+			printf("%s: pthread_create failed\n", __func__);
+			goto fail;
+		}
+		rm->nstarted++;
+	}
+	return rm;
+
+fail:
+	bres_raster_mt_free(rm);
+	return NULL;
+}
+
+void
+bres_raster_mt_free(struct bres_raster_mt *rm)
+{
+	int i;
+
+	if (rm == NULL)
+		return;
+
+	pthread_mutex_lock(&rm->lock);
+	rm->quit = true;
+	pthread_cond_broadcast(&rm->cv_start);
+	pthread_mutex_unlock(&rm->lock);
+	for (i = 1; i <= rm->nstarted; i++)
+		pthread_join(rm->workers[i].thread, NULL);
+
+	if (rm->tiles != NULL)
+		for (i = 0; i < rm->ntiles; i++)
+			scanline_list_free(rm->tiles[i].sl);
+	if (rm->workers != NULL)
+		for (i = 0; i < rm->nthreads; i++)
+			free(rm->workers[i].scratch);
+	if (rm->queues != NULL) {
+		for (i = 0; i < rm->nthreads; i++) {
+			free(rm->queues[i].tiles);
+			pthread_mutex_destroy(&rm->queues[i].lock);
+		}
+	}
+	pthread_cond_destroy(&rm->cv_start);
+	pthread_cond_destroy(&rm->cv_done);
+	pthread_mutex_destroy(&rm->lock);
+	free(rm->tiles);
+	free(rm->workers);
+	free(rm->queues);
+	free(rm->bins);
+	free(rm);
+}
+
+/*
+ * Tile range a triangle's bounding box touches; false if it's
+ * empty or off screen.
+ */
+static bool
+bres_raster_mt_bbox(struct bres_raster_mt *rm, const struct point2d *p,
+    const int *tri, int *tx0, int *ty0, int *tx1, int *ty1)
+{
+	const struct point2d *a = &p[tri[0]], *b = &p[tri[1]], *c = &p[tri[2]];
+	int xmin, xmax, ymin, ymax;
+
+	/* Spans cover [xmin, xmax) on scanlines [ymin, ymax) at most */
+	xmin = MAX(MIN(a->x, MIN(b->x, c->x)), 0);
+	xmax = MIN(MAX(a->x, MAX(b->x, c->x)), rm->width);
+	ymin = MAX(MIN(a->y, MIN(b->y, c->y)), 0);
+	ymax = MIN(MAX(a->y, MAX(b->y, c->y)), rm->height);
+	if (xmin >= xmax || ymin >= ymax)
+		return false;
+
+	*tx0 = xmin / BRES_RASTER_MT_TILE_W;
+	*tx1 = (xmax - 1) / BRES_RASTER_MT_TILE_W;
+	*ty0 = ymin / BRES_RASTER_MT_TILE_H;
+	*ty1 = (ymax - 1) / BRES_RASTER_MT_TILE_H;
+	return true;
+}
+
+/*
+ * Bin every triangle into the tiles it touches: count, then fill.
+ */
+static bool
+bres_raster_mt_bin(struct bres_raster_mt *rm, int ntris)
+{
+	int i, n, tx, ty, tx0, ty0, tx1, ty1, *nb;
+	struct bres_raster_tile *t;
+
+	for (i = 0; i < rm->ntiles; i++)
+		rm->tiles[i].bin_count = 0;
+	for (i = 0; i < ntris; i++) {
+		if (! bres_raster_mt_bbox(rm, rm->pts, &rm->indices[i * 3],
+		    &tx0, &ty0, &tx1, &ty1))
+			continue;
+		for (ty = ty0; ty <= ty1; ty++)
+			for (tx = tx0; tx <= tx1; tx++)
+				rm->tiles[ty * rm->ntx + tx].bin_count++;
+	}
+
+	n = 0;
+	for (i = 0; i < rm->ntiles; i++) {
+		rm->tiles[i].bin_off = n;
+		n += rm->tiles[i].bin_count;
+		rm->tiles[i].bin_count = 0;
+	}
+	if (n > rm->maxbins) {
+		nb = realloc(rm->bins, n * sizeof(int));
+		if (nb == NULL)
+			return false;
+		rm->bins = nb;
+		rm->maxbins = n;
+	}
+
+	for (i = 0; i < ntris; i++) {
+		if (! bres_raster_mt_bbox(rm, rm->pts, &rm->indices[i * 3],
+		    &tx0, &ty0, &tx1, &ty1))
+			continue;
+		for (ty = ty0; ty <= ty1; ty++) {
+			for (tx = tx0; tx <= tx1; tx++) {
+				t = &rm->tiles[ty * rm->ntx + tx];
+				rm->bins[t->bin_off + t->bin_count++] = i;
+			}
+		}
+	}
+	return true;
+}
+
+/*
+ * Append the tiles' spans to slist in y order, rejoining spans
+ * that a tile boundary cut in two.
+ */
+static bool
+bres_raster_mt_merge(struct bres_raster_mt *rm, struct scanline_list *slist)
+{
+	const struct bres_raster_tile *row, *t;
+	const struct scanline_2d *s;
+	struct scanline_2d *last;
+	int i, n, tx, ty, y, first;
+
+	n = 0;
+	for (i = 0; i < rm->ntiles; i++)
+		if (rm->tiles[i].bin_count > 0)
+			n += rm->tiles[i].sl->cur;
+	if (! scanline_list_reserve(slist, n))
+		return false;
+
+	first = slist->cur;
+	for (ty = 0; ty < rm->nty; ty++) {
+		row = &rm->tiles[ty * rm->ntx];
+		for (y = row->y0; y < row->y1; y++) {
+			for (tx = 0; tx < rm->ntx; tx++) {
+				t = &row[tx];
+				if (t->bin_count == 0)
+					continue;
+				for (i = t->rowstart[y - t->y0];
+				    i < t->rowstart[y - t->y0 + 1]; i++) {
+					s = &t->sl->list[i];
+					if (s->x1 == t->x0 && slist->cur > first) {
+						last = &slist->list[slist->cur - 1];
+						if (last->y == y &&
+						    last->x2 + 1 == s->x1) {
+							last->x2 = s->x2;
+							continue;
+						}
+					}
+					scanline_list_push(slist, s->x1, s->x2,
+					    y);
+				}
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * Scan convert ntris indexed triangles (see bres_triangle_mesh())
+ * across the worker pool and append the spans, clipped to the
+ * screen, to slist in y order.
+ *
+ * Returns false if memory ran out or an index is out of range.
+ */
+bool
+bres_raster_mt_triangles(struct bres_raster_mt *rm,
+    struct scanline_list *slist, const struct point2d *pts, int npts,
+    const int *indices, int ntris)
+{
+	struct bres_raster_queue *q;
+	int i, n, per;
+
+	for (i = 0; i < ntris * 3; i++) {
+		if (indices[i] < 0 || indices[i] >= npts) {
+			printf("%s: index %d (%d) out of range\n", __func__,
+			    i, indices[i]);
+			return false;
+		}
+	}
+
+	rm->pts = pts;
+	rm->indices = indices;
+	rm->failed = false;
+	if (! bres_raster_mt_bin(rm, ntris))
+		return false;
+
+	/*
+	 * Hand each worker a contiguous run of the busy tiles, so
+	 * neighbouring tiles (and the triangles they share) tend to
+	 * stay on one CPU until someone has to steal.
+	 */
+	n = 0;
+	for (i = 0; i < rm->ntiles; i++)
+		if (rm->tiles[i].bin_count > 0)
+			n++;
+	per = (n + rm->nthreads - 1) / rm->nthreads;
+	for (i = 0; i < rm->nthreads; i++)
+		rm->queues[i].head = rm->queues[i].tail = 0;
+	n = 0;
+	for (i = 0; i < rm->ntiles; i++) {
+		if (rm->tiles[i].bin_count == 0)
+			continue;
+		q = &rm->queues[n++ / per];
+		q->tiles[q->tail++] = i;
+	}
+
+	pthread_mutex_lock(&rm->lock);
+	rm->nbusy = rm->nthreads - 1;
+	rm->gen++;
+	pthread_cond_broadcast(&rm->cv_start);
+	pthread_mutex_unlock(&rm->lock);
+
+	bres_raster_mt_work(&rm->workers[0]);
+
+	pthread_mutex_lock(&rm->lock);
+	while (rm->nbusy > 0)
+		pthread_cond_wait(&rm->cv_done, &rm->lock);
+	pthread_mutex_unlock(&rm->lock);
+
+	if (rm->failed)
+		return false;
+	return bres_raster_mt_merge(rm, slist);
+}
+
+/**
+ * Tiles rasterised and tiles stolen from another worker's queue,
+ * since the rasteriser was created.
+ */
+void
+bres_raster_mt_stats(const struct bres_raster_mt *rm, uint64_t *ntiles,
+    uint64_t *nsteals)
+{
+	int i;
+
+	*ntiles = 0;
+	*nsteals = 0;
+	for (i = 0; i < rm->nthreads; i++) {
+		*ntiles += rm->workers[i].ntiles;
+		*nsteals += rm->queues[i].nsteals;
+	}
+}
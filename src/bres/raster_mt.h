@@ -0,0 +1,19 @@
+#ifndef	__RASTER_MT_H__
+#define	__RASTER_MT_H__
+
+/* Screen tile size for bres_raster_mt */
+#define	BRES_RASTER_MT_TILE_W		128
+#define	BRES_RASTER_MT_TILE_H		64
+
+struct bres_raster_mt;
+
+extern	struct bres_raster_mt *bres_raster_mt_create(int nthreads,
+	    int width, int height);
+extern	void bres_raster_mt_free(struct bres_raster_mt *rm);
+extern	bool bres_raster_mt_triangles(struct bres_raster_mt *rm,
+	    struct scanline_list *slist, const struct point2d *pts, int npts,
+	    const int *indices, int ntris);
+extern	void bres_raster_mt_stats(const struct bres_raster_mt *rm,
+	    uint64_t *ntiles, uint64_t *nsteals);
+
+#endif	/* __RASTER_MT_H__ */
@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include "point.h"
+#include "scanline.h"
+#include "polygon.h"
+#include "fb.h"
+
+/*
+ * Headless rendering through the CPU span filler: rasterise a
+ * scene of spinning polygons into a host framebuffer, optionally
+ * dumping each frame as a PPM, and time the span fills against
+ * a plain bounds checked pixel at a time loop (what sdl.c does).
+ * The spans are also converted to the structure of arrays format,
+ * checked for surviving the round trip, and filled from that.
+ */
+
+#define	NSHAPES		24
+
+static uint64_t
+render_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+/* A colour in the framebuffer's pixel format */
+static uint32_t
+render_color(int bpp, int r, int g, int b)
+{
+	switch (bpp) {
+	case 1:
+		return ((r & 0xe0) | ((g & 0xe0) >> 3) | (b >> 6));
+	case 2:
+		return (((r & 0xf8) << 8) | ((g & 0xfc) << 3) | (b >> 3));
+	default:
+		return ((r << 16) | (g << 8) | b);
+	}
+}
+
+/*
+ * The reference: one bounds checked store per pixel.
+ */
+static void
+render_spans_slow(struct bres_fb *fb, const struct scanline_list *sl,
+    uint32_t color)
+{
+	uint8_t *p;
+	int i, x;
+
+	for (i = 0; i < sl->cur; i++) {
+		for (x = sl->list[i].x1; x <= sl->list[i].x2; x++) {
+			if (x < 0 || x >= fb->width || sl->list[i].y < 0 ||
+			    sl->list[i].y >= fb->height)
+				continue;
+			p = fb->pixels + (size_t) sl->list[i].y * fb->stride +
+			    x * fb->bpp;
+			switch (fb->bpp) {
+			case 1:
+				*p = color;
+				break;
+			case 2:
+				*(uint16_t *) p = color;
+				break;
+			default:
+				*(uint32_t *) p = color;
+				break;
+			}
+		}
+	}
+}
+
+/*
+ * Build frame f's shapes: a full screen backdrop band (long spans,
+ * partly off screen) then a ring of spinning triangles and stars.
+ */
+static void
+render_scene(struct scanline_list **sl, uint32_t *colors, int bpp,
+    int w, int h, int f)
+{
+	struct point2d pts[10];
+	double a, cx, cy, r, rr;
+	int i, j, n;
+
+	for (i = 0; i < NSHAPES; i++) {
+		sl[i]->cur = 0;
+		if (i == 0) {
+			pts[0].x = -50;
+			pts[0].y = h / 4 + (f % 20);
+			pts[1].x = w + 50;
+			pts[1].y = h / 4;
+			pts[2].x = w + 50;
+			pts[2].y = (h * 3) / 4;
+			pts[3].x = -50;
+			pts[3].y = (h * 3) / 4 - (f % 20);
+			n = 4;
+		} else {
+			a = (i * 2 * M_PI) / (NSHAPES - 1);
+			cx = w / 2 + (w / 3) * cos(a);
+			cy = h / 2 + (h / 3) * sin(a);
+			r = 20 + (i % 5) * 12;
+			n = (i & 1) ? 3 : 10;
+			for (j = 0; j < n; j++) {
+				a = (j * 2 * M_PI) / n + f * 0.05 * (i % 3 + 1);
+				/* Stars alternate outer and inner points */
+				rr = (n == 10 && (j & 1)) ? r / 2.5 : r;
+				pts[j].x = (int) (cx + rr * cos(a));
+				pts[j].y = (int) (cy + rr * sin(a));
+			}
+		}
+		if (! bres_polygon(sl[i], pts, n, BresFillRuleNonZero)) {
+			fprintf(stderr, "bres_polygon failed\n");
+			exit(1);
+		}
+		colors[i] = render_color(bpp, (i * 53) & 0xff,
+		    (i * 101 + 64) & 0xff, (i * 31 + 128) & 0xff);
+	}
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: render [-b bytes/pixel] [-n frames] "
+	    "[-o prefix] [-s WxH]\n");
+	fprintf(stderr, "  -b: 1, 2 or 4 (default 4)\n");
+	fprintf(stderr, "  -o: write each frame to prefix-NNNN.ppm\n");
+	exit(127);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct scanline_list *sl[NSHAPES], *back;
+	struct scanline_soa *soa[NSHAPES];
+	struct bres_fb *fb, *ref, *sfb;
+	uint32_t colors[NSHAPES];
+	uint64_t t, t_fast = 0, t_slow = 0, t_soa = 0, npix = 0, t_clear;
+	uint64_t nspans = 0, nruns = 0;
+	const char *prefix = NULL;
+	char path[1024];
+	int ch, i, f, y, bpp = 4, nframes = 100, w = 1280, h = 1024;
+	bool ok = true;
+
+	while ((ch = getopt(argc, argv, "b:n:o:s:")) != -1) {
+		switch (ch) {
+		case 'b':
+			bpp = atoi(optarg);
+			break;
+		case 'n':
+			nframes = atoi(optarg);
+			break;
+		case 'o':
+			prefix = optarg;
+			break;
+		case 's':
+			if (sscanf(optarg, "%dx%d", &w, &h) != 2)
+				usage();
+			break;
+		default:
+			usage();
+		}
+	}
+
+	fb = bres_fb_alloc(w, h, bpp);
+	ref = bres_fb_alloc(w, h, bpp);
+	sfb = bres_fb_alloc(w, h, bpp);
+	if (fb == NULL || ref == NULL || sfb == NULL)
+		usage();
+	for (i = 0; i < NSHAPES; i++) {
+		sl[i] = scanline_list_alloc(h);
+		soa[i] = scanline_soa_alloc(h);
+		if (sl[i] == NULL || soa[i] == NULL) {
+			fprintf(stderr, "span list alloc failed\n");
+			exit(1);
+		}
+	}
+	back = scanline_list_alloc(h);
+	if (back == NULL) {
+		fprintf(stderr, "scanline_list_alloc failed\n");
+		exit(1);
+	}
+
+	/* What a straight memory fill of the frame costs */
+	t = render_ns();
+	for (f = 0; f < nframes; f++)
+		bres_fb_clear(fb, f);
+	t_clear = render_ns() - t;
+
+	for (f = 0; f < nframes; f++) {
+		render_scene(sl, colors, bpp, w, h, f);
+
+		bres_fb_clear(fb, 0);
+		bres_fb_clear(ref, 0);
+		bres_fb_clear(sfb, 0);
+
+		for (i = 0; i < NSHAPES; i++) {
+			soa[i]->cur = 0;
+			soa[i]->nruns = 0;
+			back->cur = 0;
+			if (! scanline_soa_from_list(soa[i], sl[i]) ||
+			    ! scanline_soa_to_list(back, soa[i])) {
+				fprintf(stderr, "span conversion failed\n");
+				exit(1);
+			}
+			if (back->cur != sl[i]->cur || memcmp(back->list,
+			    sl[i]->list, back->cur * sizeof(*back->list))) {
+				printf("render: frame %d shape %d differs after "
+				    "conversion\n", f, i);
+				ok = false;
+			}
+			nspans += soa[i]->cur;
+			nruns += soa[i]->nruns;
+		}
+
+		t = render_ns();
+		for (i = 0; i < NSHAPES; i++)
+			bres_fb_fill_spans(fb, sl[i], colors[i]);
+		t_fast += render_ns() - t;
+
+		t = render_ns();
+		for (i = 0; i < NSHAPES; i++)
+			render_spans_slow(ref, sl[i], colors[i]);
+		t_slow += render_ns() - t;
+
+		t = render_ns();
+		for (i = 0; i < NSHAPES; i++)
+			bres_fb_fill_soa(sfb, soa[i], colors[i]);
+		t_soa += render_ns() - t;
+
+		for (i = 0; i < NSHAPES; i++)
+			for (y = 0; y < sl[i]->cur; y++)
+				npix += sl[i]->list[y].x2 -
+				    sl[i]->list[y].x1 + 1;
+
+		for (y = 0; y < h && ok; y++) {
+			if (memcmp(fb->pixels + (size_t) y * fb->stride,
+			    ref->pixels + (size_t) y * ref->stride,
+			    w * bpp) != 0 ||
+			    memcmp(sfb->pixels + (size_t) y * sfb->stride,
+			    ref->pixels + (size_t) y * ref->stride,
+			    w * bpp) != 0) {
+				printf("render: frame %d row %d differs from "
+				    "the reference\n", f, y);
+				ok = false;
+			}
+		}
+
+		if (prefix != NULL) {
+			snprintf(path, sizeof(path), "%s-%04d.ppm", prefix, f);
+			if (! bres_fb_write_ppm(fb, path))
+				ok = false;
+		}
+	}
+
+	printf("render: %dx%d, %d bytes/pixel, %d frames, %llu pixels\n",
+	    w, h, bpp, nframes, (unsigned long long) npix);
+	printf("render: spans: %llu us (%.0f MB/s), per pixel: %llu us "
+	    "(%.0f MB/s), clear: %.0f MB/s\n",
+	    (unsigned long long) t_fast / 1000,
+	    (double) npix * bpp * 1000.0 / (t_fast + 1),
+	    (unsigned long long) t_slow / 1000,
+	    (double) npix * bpp * 1000.0 / (t_slow + 1),
+	    (double) w * h * bpp * nframes * 1000.0 / (t_clear + 1));
+	printf("render: soa spans: %llu us (%.0f MB/s); %llu spans in %llu "
+	    "runs, %llu bytes against %llu\n",
+	    (unsigned long long) t_soa / 1000,
+	    (double) npix * bpp * 1000.0 / (t_soa + 1),
+	    (unsigned long long) nspans, (unsigned long long) nruns,
+	    (unsigned long long) (nspans * 2 * sizeof(int16_t) +
+	    nruns * sizeof(struct scanline_run)),
+	    (unsigned long long) (nspans * sizeof(struct scanline_2d)));
+	printf("render: %s\n", ok ? "OK" : "FAILED");
+
+	for (i = 0; i < NSHAPES; i++) {
+		scanline_list_free(sl[i]);
+		scanline_soa_free(soa[i]);
+	}
+	scanline_list_free(back);
+	bres_fb_free(fb);
+	bres_fb_free(ref);
+	bres_fb_free(sfb);
+	exit(ok ? 0 : 1);
+}
@@ -0,0 +1,334 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "scanline.h"
+#include "arena.h"
+#include "sbuf.h"
+
+/*
+ * Span buffer (s-buffer) hidden surface removal.
+ *
+ * Each scanline keeps a list of the visible segments so far, sorted
+ * by x and not overlapping, each with the depth and tag of the span
+ * it came from.  An incoming span is walked along its row's list:
+ * the gaps it covers become new segments, the parts of nearer
+ * segments it crosses are dropped, and the parts of further ones
+ * are split off and taken over.  A span that's entirely hidden
+ * costs a walk and nothing else, so nothing hidden is ever drawn.
+ *
+ * On equal depths the later span wins, same as drawing in order.
+ * Neighbouring segments from the same span are merged back up, so
+ * the lists stay about as long as the number of visible pieces.
+ *
+ * Segments come from an arena and are recycled through a free list
+ * when merged; bres_sbuf_reset() throws them all away at once.
+ */
+
+struct bres_sbuf_seg {
+	int x1, x2;		/* inclusive */
+	int depth;
+	int tag;
+	struct bres_sbuf_seg *next;
+};
+
+struct bres_sbuf {
+	int width, height;
+	struct bres_sbuf_seg **rows;
+	struct bres_sbuf_seg *free;
+	struct bres_arena *arena;
+
+	int nsegs;		/* segments in use */
+	uint64_t npixels;	/* on-screen pixels added */
+	uint64_t nvisible;	/* pixels handed back by the last resolve */
+};
+
+/**
+ * Create a span buffer for a (width x height) screen; spans outside
+ * it are clipped off.
+ */
+struct bres_sbuf *
+bres_sbuf_create(int width, int height)
+{
+	struct bres_sbuf *sb;
+
+	if (width <= 0 || height <= 0) {
+		printf("%s: bad size %dx%d\n", __func__, width, height);
+		return NULL;
+	}
+
+	sb = calloc(1, sizeof(*sb));
+	if (sb == NULL)
+		return NULL;
+	sb->width = width;
+	sb->height = height;
+	sb->rows = calloc(height, sizeof(*sb->rows));
+	/* Room for a few segments a row before the arena grows */
+	sb->arena = bres_arena_create(height * 8 * sizeof(struct bres_sbuf_seg));
+	if (sb->rows == NULL || sb->arena == NULL) {
+		bres_sbuf_free(sb);
+		return NULL;
+	}
+	return sb;
+}
+
+void
+bres_sbuf_free(struct bres_sbuf *sb)
+{
+	if (sb == NULL)
+		return;
+	if (sb->arena != NULL)
+		bres_arena_destroy(sb->arena);
+	free(sb->rows);
+	free(sb);
+}
+
+/**
+ * Empty the span buffer, eg at the start of each frame.
+ */
+void
+bres_sbuf_reset(struct bres_sbuf *sb)
+{
+	memset(sb->rows, 0, sb->height * sizeof(*sb->rows));
+	sb->free = NULL;
+	sb->nsegs = 0;
+	sb->npixels = 0;
+	sb->nvisible = 0;
+	bres_arena_reset(sb->arena);
+}
+
+static inline struct bres_sbuf_seg *
+bres_sbuf_seg_alloc(struct bres_sbuf *sb)
+{
+	struct bres_sbuf_seg *s;
+
+	s = sb->free;
+	if (s != NULL)
+		sb->free = s->next;
+	else
+		s = bres_arena_alloc(sb->arena, sizeof(*s));
+	if (s != NULL)
+		sb->nsegs++;
+	return (s);
+}
+
+static inline void
+bres_sbuf_seg_free(struct bres_sbuf *sb, struct bres_sbuf_seg *s)
+{
+	s->next = sb->free;
+	sb->free = s;
+	sb->nsegs--;
+}
+
+/*
+ * Can x1 .. (depth, tag) just extend prev?
+ */
+static inline bool
+bres_sbuf_joins(const struct bres_sbuf_seg *prev, int x1, int depth, int tag)
+{
+	return (prev != NULL && prev->x2 + 1 == x1 && prev->depth == depth &&
+	    prev->tag == tag);
+}
+
+/*
+ * Make x1 .. x2 visible at *pp, just after prev: extend prev if it
+ * can be, otherwise link in a new segment.  Returns the segment now
+ * ending at x2, or NULL if memory ran out.
+ */
+static struct bres_sbuf_seg *
+bres_sbuf_put(struct bres_sbuf *sb, struct bres_sbuf_seg *prev,
+    struct bres_sbuf_seg **pp, int x1, int x2, int depth, int tag)
+{
+	struct bres_sbuf_seg *n;
+
+	if (bres_sbuf_joins(prev, x1, depth, tag)) {
+		prev->x2 = x2;
+		return (prev);
+	}
+	n = bres_sbuf_seg_alloc(sb);
+	if (n == NULL)
+		return NULL;
+	n->x1 = x1;
+	n->x2 = x2;
+	n->depth = depth;
+	n->tag = tag;
+	n->next = *pp;
+	*pp = n;
+	return (n);
+}
+
+/*
+ * Split s at x: s keeps .. x - 1, and the returned segment (linked
+ * in after it) gets x .. .
+ */
+static struct bres_sbuf_seg *
+bres_sbuf_split(struct bres_sbuf *sb, struct bres_sbuf_seg *s, int x)
+{
+	struct bres_sbuf_seg *n;
+
+	n = bres_sbuf_seg_alloc(sb);
+	if (n == NULL)
+		return NULL;
+	*n = *s;
+	n->x1 = x;
+	s->x2 = x - 1;
+	s->next = n;
+	return (n);
+}
+
+/*
+ * Add x1 .. x2 (clipped, x1 <= x2) to row y.
+ */
+static bool
+bres_sbuf_row(struct bres_sbuf *sb, int y, int x1, int x2, int depth,
+    int tag)
+{
+	struct bres_sbuf_seg **pp = &sb->rows[y], *prev = NULL, *s, *n;
+	int e;
+
+	while ((s = *pp) != NULL && x1 <= x2) {
+		if (s->x2 < x1) {
+			prev = s;
+			pp = &s->next;
+			continue;
+		}
+		if (s->x1 > x2)
+			break;
+
+		if (s->x1 > x1) {
+			/* The gap before s is visible */
+			n = bres_sbuf_put(sb, prev, pp, x1, s->x1 - 1, depth,
+			    tag);
+			if (n == NULL)
+				return false;
+			prev = n;
+			pp = &n->next;
+			x1 = s->x1;
+			continue;
+		}
+
+		/* s covers x1 */
+		e = s->x2 < x2 ? s->x2 : x2;
+		if (s->depth < depth) {
+			/* ... and is in front */
+			prev = s;
+			pp = &s->next;
+			x1 = e + 1;
+			continue;
+		}
+
+		/* Take x1 .. e of s over */
+		if (s->x1 < x1) {
+			n = bres_sbuf_split(sb, s, x1);
+			if (n == NULL)
+				return false;
+			prev = s;
+			s = n;
+		}
+		if (s->x2 > e && bres_sbuf_split(sb, s, e + 1) == NULL)
+			return false;
+		if (bres_sbuf_joins(prev, x1, depth, tag)) {
+			prev->x2 = e;
+			prev->next = s->next;
+			bres_sbuf_seg_free(sb, s);
+		} else {
+			s->depth = depth;
+			s->tag = tag;
+			prev = s;
+		}
+		pp = &prev->next;
+		x1 = e + 1;
+	}
+
+	if (x1 <= x2 && bres_sbuf_put(sb, prev, pp, x1, x2, depth, tag) == NULL)
+		return false;
+	return true;
+}
+
+/**
+ * Add a shape's spans at the given depth; smaller depths are nearer.
+ * The tag says which output list bres_sbuf_resolve() puts the
+ * shape's visible pieces in.  Spans can be in any order, and x1 may
+ * be past x2.
+ *
+ * Returns false if memory ran out (the buffer is still consistent
+ * but the shape may be partly added) or the tag is negative.
+ */
+bool
+bres_sbuf_add(struct bres_sbuf *sb, const struct scanline_list *slist,
+    int depth, int tag)
+{
+	const struct scanline_2d *s;
+	int i, x1, x2;
+
+	if (tag < 0) {
+		printf("%s: bad tag %d\n", __func__, tag);
+		return false;
+	}
+
+	for (i = 0; i < slist->cur; i++) {
+		s = &slist->list[i];
+		if (s->y < 0 || s->y >= sb->height)
+			continue;
+		x1 = s->x1 < s->x2 ? s->x1 : s->x2;
+		x2 = s->x1 < s->x2 ? s->x2 : s->x1;
+		if (x1 < 0)
+			x1 = 0;
+		if (x2 >= sb->width)
+			x2 = sb->width - 1;
+		if (x1 > x2)
+			continue;
+		sb->npixels += x2 - x1 + 1;
+		if (! bres_sbuf_row(sb, s->y, x1, x2, depth, tag))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Append the visible pieces of everything added since the last reset
+ * to out[tag], in y order.  out[] has nout lists; a NULL list drops
+ * that tag's spans (eg for a shape only there to hide others).
+ *
+ * Returns false if memory ran out or a tag is past the end of out[].
+ */
+bool
+bres_sbuf_resolve(struct bres_sbuf *sb, struct scanline_list **out, int nout)
+{
+	const struct bres_sbuf_seg *s;
+	int y;
+
+	sb->nvisible = 0;
+	for (y = 0; y < sb->height; y++) {
+		for (s = sb->rows[y]; s != NULL; s = s->next) {
+			if (s->tag >= nout) {
+				printf("%s: tag %d out of range\n", __func__,
+				    s->tag);
+				return false;
+			}
+			if (out[s->tag] == NULL)
+				continue;
+			if (! scanline_list_reserve(out[s->tag], 1))
+				return false;
+			scanline_list_push(out[s->tag], s->x1, s->x2, y);
+			sb->nvisible += s->x2 - s->x1 + 1;
+		}
+	}
+	return true;
+}
+
+/**
+ * How many on-screen pixels were added, how many the last resolve
+ * handed back, and how many segments are in use.
+ */
+void
+bres_sbuf_stats(const struct bres_sbuf *sb, uint64_t *npixels,
+    uint64_t *nvisible, int *nsegs)
+{
+	*npixels = sb->npixels;
+	*nvisible = sb->nvisible;
+	*nsegs = sb->nsegs;
+}
@@ -0,0 +1,24 @@
+#ifndef	__SBUF_H__
+#define	__SBUF_H__
+
+/*
+ * A span buffer: hidden surface removal on spans, for drawing
+ * overlapping shapes without a depth buffer.
+ *
+ * Each shape's spans go in with a depth (smaller is nearer) and a
+ * tag; bres_sbuf_resolve() then hands back just the visible pieces,
+ * sorted out by tag, so every pixel is drawn once.
+ */
+struct bres_sbuf;
+
+extern	struct bres_sbuf *bres_sbuf_create(int width, int height);
+extern	void bres_sbuf_free(struct bres_sbuf *sb);
+extern	void bres_sbuf_reset(struct bres_sbuf *sb);
+extern	bool bres_sbuf_add(struct bres_sbuf *sb,
+	    const struct scanline_list *slist, int depth, int tag);
+extern	bool bres_sbuf_resolve(struct bres_sbuf *sb,
+	    struct scanline_list **out, int nout);
+extern	void bres_sbuf_stats(const struct bres_sbuf *sb, uint64_t *npixels,
+	    uint64_t *nvisible, int *nsegs);
+
+#endif	/* __SBUF_H__ */
@@ -2,9 +2,12 @@
 #include <stdlib.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 #include <sys/types.h>
 
 #include "scanline.h"
+#include "arena.h"
 
 struct scanline_list *
 scanline_list_alloc(int count)
@@ -25,15 +28,76 @@ scanline_list_alloc(int count)
 	return l;
 }
 
+/*
+ * Allocate a list from an arena: no zeroing, no malloc() in the
+ * common case, and it grows in place while it's the newest thing
+ * in the arena.  Freeing it does nothing; it goes away when the
+ * arena is reset.
+ */
+struct scanline_list *
+scanline_list_alloc_arena(struct bres_arena *a, int count)
+{
+	struct scanline_list *l;
+
+	l = bres_arena_alloc(a, sizeof(*l));
+	if (l == NULL)
+		return NULL;
+
+	l->count = count;
+	l->cur = 0;
+	l->arena = a;
+	l->list = bres_arena_alloc(a, count * sizeof(struct scanline_2d));
+	if (l->list == NULL)
+		return NULL;
+	return l;
+}
+
 void
 scanline_list_free(struct scanline_list *l)
 {
-	if (l == NULL)
+	if (l == NULL || l->arena != NULL)
 		return;
 	free(l->list);
 	free(l);
 }
 
+/*
+ * Make room for at least n more entries, growing the list if needed.
+ */
+bool
+scanline_list_reserve(struct scanline_list *l, int n)
+{
+	struct scanline_2d *nl;
+	int count;
+
+	if (l->cur + n <= l->count)
+		return true;
+
+	count = l->count > 0 ? l->count : 16;
+	while (count < l->cur + n)
+		count *= 2;
+	if (l->arena != NULL) {
+		if (! bres_arena_grow(l->arena, l->list,
+		    count * sizeof(struct scanline_2d))) {
+			nl = bres_arena_alloc(l->arena,
+			    count * sizeof(struct scanline_2d));
+			if (nl == NULL)
+				return false;
+			memcpy(nl, l->list, l->cur * sizeof(struct scanline_2d));
+			l->list = nl;
+		}
+		l->count = count;
+		return true;
+	}
+
+	nl = realloc(l->list, count * sizeof(struct scanline_2d));
+	if (nl == NULL)
+		return false;
+	l->list = nl;
+	l->count = count;
+	return true;
+}
+
 bool
 scanline_list_push(struct scanline_list *l, int x1, int x2, int y)
 {
@@ -60,3 +124,147 @@ scanline_list_print(const struct scanline_list *l, const char *pfx)
 		    l->list[i].y);
 	}
 }
+
+struct scanline_soa *
+scanline_soa_alloc(int count)
+{
+	struct scanline_soa *s;
+
+	s = calloc(1, sizeof(*s));
+	if (s == NULL)
+		return NULL;
+	if (! scanline_soa_reserve(s, count > 0 ? count : 16)) {
+		scanline_soa_free(s);
+		return NULL;
+	}
+	return s;
+}
+
+void
+scanline_soa_free(struct scanline_soa *s)
+{
+	if (s == NULL)
+		return;
+	free(s->x1);
+	free(s->x2);
+	free(s->runs);
+	free(s);
+}
+
+/*
+ * Make room for at least n more spans, and runs for them.
+ */
+bool
+scanline_soa_reserve(struct scanline_soa *s, int n)
+{
+	struct scanline_run *nr;
+	int16_t *nx;
+	int count;
+
+	if (s->cur + n > s->count) {
+		count = s->count > 0 ? s->count : 16;
+		while (count < s->cur + n)
+			count *= 2;
+		nx = realloc(s->x1, count * sizeof(int16_t));
+		if (nx == NULL)
+			return false;
+		s->x1 = nx;
+		nx = realloc(s->x2, count * sizeof(int16_t));
+		if (nx == NULL)
+			return false;
+		s->x2 = nx;
+		s->count = count;
+	}
+
+	if (s->nruns + n > s->maxruns) {
+		count = s->maxruns > 0 ? s->maxruns : 16;
+		while (count < s->nruns + n)
+			count *= 2;
+		nr = realloc(s->runs, count * sizeof(struct scanline_run));
+		if (nr == NULL)
+			return false;
+		s->runs = nr;
+		s->maxruns = count;
+	}
+	return true;
+}
+
+/*
+ * Append a span, extending the last run if it's on the next
+ * scanline in the run's direction.  Like scanline_list_push(), the
+ * room has to have been reserved; this also fails if x1 or x2
+ * don't fit in 16 bits.
+ */
+bool
+scanline_soa_push(struct scanline_soa *s, int x1, int x2, int y)
+{
+	struct scanline_run *r = NULL;
+
+	if (s->cur >= s->count || x1 < INT16_MIN || x1 > INT16_MAX ||
+	    x2 < INT16_MIN || x2 > INT16_MAX)
+		return false;
+
+	if (s->nruns > 0)
+		r = &s->runs[s->nruns - 1];
+	if (r != NULL && r->count == 1 && (y == r->y + 1 || y == r->y - 1))
+		r->dir = y - r->y;
+	if (r != NULL && y == r->y + r->dir * r->count) {
+		r->count++;
+	} else {
+		if (s->nruns >= s->maxruns)
+			return false;
+		r = &s->runs[s->nruns++];
+		r->y = y;
+		r->dir = 1;
+		r->first = s->cur;
+		r->count = 1;
+	}
+
+	s->x1[s->cur] = x1;
+	s->x2[s->cur] = x2;
+	s->cur++;
+	return true;
+}
+
+/*
+ * Append a list's spans.  Returns false, having appended nothing,
+ * if memory ran out or an x doesn't fit in 16 bits - the caller
+ * then sticks with the list.
+ */
+bool
+scanline_soa_from_list(struct scanline_soa *s, const struct scanline_list *l)
+{
+	int i;
+
+	for (i = 0; i < l->cur; i++) {
+		if (l->list[i].x1 < INT16_MIN || l->list[i].x1 > INT16_MAX ||
+		    l->list[i].x2 < INT16_MIN || l->list[i].x2 > INT16_MAX)
+			return false;
+	}
+	if (! scanline_soa_reserve(s, l->cur))
+		return false;
+	for (i = 0; i < l->cur; i++)
+		scanline_soa_push(s, l->list[i].x1, l->list[i].x2,
+		    l->list[i].y);
+	return true;
+}
+
+/*
+ * Append the spans back onto a list, in the same order.
+ */
+bool
+scanline_soa_to_list(struct scanline_list *l, const struct scanline_soa *s)
+{
+	const struct scanline_run *r;
+	int i, j;
+
+	if (! scanline_list_reserve(l, s->cur))
+		return false;
+	for (i = 0; i < s->nruns; i++) {
+		r = &s->runs[i];
+		for (j = 0; j < r->count; j++)
+			scanline_list_push(l, s->x1[r->first + j],
+			    s->x2[r->first + j], r->y + j * r->dir);
+	}
+	return true;
+}
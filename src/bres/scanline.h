@@ -9,12 +9,50 @@ struct scanline_list {
 	int count;
 	int cur;
 	struct scanline_2d *list;
+	/* Non-NULL if allocated by scanline_list_alloc_arena() */
+	struct bres_arena *arena;
+};
+
+/*
+ * The same spans as a structure of arrays, for consumers that want
+ * to vectorise: x ends are 16 bits, and y is kept once per run of
+ * spans on consecutive scanlines rather than once per span.
+ *
+ * Span i of a run (first <= i < first + count) is x1[i] .. x2[i]
+ * on scanline y + (i - first) * dir.
+ */
+struct scanline_run {
+	int y;
+	int dir;		/* +1 down the screen, -1 up */
+	int first;
+	int count;
+};
+
+struct scanline_soa {
+	int count;		/* spans allocated */
+	int cur;		/* spans used */
+	int16_t *x1, *x2;
+	int maxruns;
+	int nruns;
+	struct scanline_run *runs;
 };
 
 extern	struct scanline_list *scanline_list_alloc(int count);
+extern	struct scanline_list *scanline_list_alloc_arena(struct bres_arena *a,
+	    int count);
 extern	void scanline_list_free(struct scanline_list *);
+extern	bool scanline_list_reserve(struct scanline_list *, int n);
 extern	bool scanline_list_push(struct scanline_list *, int x1, int x2, int y);
 extern	void scanline_list_print(const struct scanline_list *l,
 	    const char *pfx);
 
+extern	struct scanline_soa *scanline_soa_alloc(int count);
+extern	void scanline_soa_free(struct scanline_soa *s);
+extern	bool scanline_soa_reserve(struct scanline_soa *s, int n);
+extern	bool scanline_soa_push(struct scanline_soa *s, int x1, int x2, int y);
+extern	bool scanline_soa_from_list(struct scanline_soa *s,
+	    const struct scanline_list *l);
+extern	bool scanline_soa_to_list(struct scanline_list *l,
+	    const struct scanline_soa *s);
+
 #endif	/* __SCANLINE_H__ */
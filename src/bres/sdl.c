@@ -7,6 +7,8 @@
 #include "point.h"
 #include "scanline.h"
 #include "bres.h"
+#include "fb.h"
+#include "arena.h"
 
 #define WIDTH 800
 #define HEIGHT 600
@@ -15,6 +17,9 @@ SDL_Window* window;
 SDL_Surface* surface;
 
 uint32_t* pixels;
+struct bres_fb fb;
+/* Span lists for the frame being drawn; reset once it's up */
+struct bres_arena *arena;
 bool keys[512];
 
 uint32_t rgb(uint8_t r, uint8_t g, uint8_t b) {
@@ -26,17 +31,19 @@ void pixel(int x, int y, uint32_t color) {
     pixels[y * WIDTH + x] = color;
 }
 
+/*
+ * The span ends are drawn in their own colours so the edges stand
+ * out; the middle goes through the CPU span filler.
+ */
 void span(int x1, int x2, int y1, uint32_t lc, uint32_t rc, uint32_t mc)
 {
-	int i;
-	for (i = x1; i <= x2; i++) {
-		if (i == x1)
-			pixel(i, y1, lc);
-		else if (i == x2)
-			pixel(i, y1, rc);
-		else
-			pixel(i, y1, mc);
-	}
+	if (x2 < x1)
+		return;
+	if (x2 - x1 > 1)
+		bres_fb_fill_span(&fb, x1 + 1, x2 - 1, y1, mc);
+	pixel(x1, y1, lc);
+	if (x2 != x1)
+		pixel(x2, y1, rc);
 }
 
 void
@@ -46,7 +53,7 @@ do_triangle(int x1, int y1, int x2, int y2, int x3, int y3,
 	struct scanline_list *sl = NULL;
 	int i;
 
-	bres_triangle_xy(x1, y1, x2, y2, x3, y3, &sl);
+	bres_triangle_xy_arena(x1, y1, x2, y2, x3, y3, arena, &sl);
 
 	if (sl == NULL)
 		return;
@@ -56,9 +63,6 @@ do_triangle(int x1, int y1, int x2, int y2, int x3, int y3,
 	}
 
 //	scanline_list_print(sl, "triangle: ");
-
-	scanline_list_free(sl);
-
 }
 
 void
@@ -68,7 +72,7 @@ do_flat_triangle(int x1, int y1, int x2l, int x2r, int y2,
 	struct scanline_list *sl = NULL;
 	int i;
 
-	sl = scanline_list_alloc(1000);
+	sl = scanline_list_alloc_arena(arena, 1000);
 	if (sl == NULL)
 		return;
 
@@ -79,9 +83,6 @@ do_flat_triangle(int x1, int y1, int x2l, int x2r, int y2,
 	}
 
 	scanline_list_print(sl, "triangle: ");
-
-	scanline_list_free(sl);
-
 }
 
 
@@ -96,6 +97,8 @@ main(int argc, const char *argv[])
 	    SDL_WINDOWPOS_UNDEFINED, WIDTH, HEIGHT, SDL_WINDOW_SHOWN);
 	surface = SDL_GetWindowSurface(window);
 	pixels = (uint32_t*)surface->pixels;
+	bres_fb_init(&fb, pixels, WIDTH, HEIGHT, surface->pitch, 4);
+	arena = bres_arena_create(64 * 1024);
 
 
 /* clear screen */
@@ -119,6 +122,8 @@ do_triangle(250, 50, 150, 300, 400, 550, 0x0000ff, 0x00ff00, 0xff0000);
 // Flat top
 //do_flat_triangle(400, 400, 300, 600, 200, 0x0000ff, 0x00ff00, 0xff0000);
 
+bres_arena_reset(arena);
+
 SDL_UnlockSurface(surface);
 SDL_UpdateWindowSurface(window);
 
@@ -130,6 +135,7 @@ while (!quit) {
     else if (e.type == SDL_KEYUP) keys[e.key.keysym.scancode] = false;
 }
 
+bres_arena_destroy(arena);
 SDL_DestroyWindow(window);
 SDL_Quit();
 }
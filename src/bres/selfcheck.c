@@ -0,0 +1,1194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <err.h>
+#include <math.h>
+#include <sys/param.h>
+
+#include "point.h"
+#include "scanline.h"
+#include "bres.h"
+#include "polygon.h"
+#include "mesh.h"
+#include "raster_mt.h"
+#include "arena.h"
+#include "line.h"
+#include "ellipse.h"
+#include "sbuf.h"
+
+/*
+ * Self checks for the CPU rasterisers, each against a slow reference
+ * (a brute force inside test, or drawing the same thing another way)
+ * on a fixed pseudo-random scene.  These need no display; the timing
+ * of the same scenes lives in the newport server's benchmarks.
+ */
+
+#ifndef	nitems
+#define	nitems(x)	(sizeof((x)) / sizeof((x)[0]))
+#endif
+
+/*
+ * Is pixel (x, y) inside the polygon?  The slow way, for checking
+ * bres_polygon(): count / wind the edge crossings at or left of x.
+ */
+static bool
+polygon_inside(const struct point2d *pts, int npts, BresFillRule rule,
+    int x, int y)
+{
+	const struct point2d *a, *b, *t;
+	int i, n = 0, dir;
+
+	for (i = 0; i < npts; i++) {
+		a = &pts[i];
+		b = &pts[(i + 1) % npts];
+		dir = 1;
+		if (b->y < a->y) {
+			t = a; a = b; b = t;
+			dir = -1;
+		}
+		if (y < a->y || y >= b->y)
+			continue;
+		if ((int64_t) a->x * (b->y - a->y) +
+		    (int64_t) (y - a->y) * (b->x - a->x) <=
+		    (int64_t) x * (b->y - a->y))
+			n += (rule == BresFillRuleEvenOdd) ? 1 : dir;
+	}
+	return (rule == BresFillRuleEvenOdd) ? (n & 1) : (n != 0);
+}
+
+/*
+ * Check a polygon's spans against polygon_inside() over its bounding
+ * box (plus a pixel), including that no pixel is covered twice.
+ */
+static bool
+polygon_check(const char *name, const struct point2d *pts, int npts,
+    BresFillRule rule, const struct scanline_list *sl)
+{
+	int xmin = INT_MAX, ymin = INT_MAX, xmax = INT_MIN, ymax = INT_MIN;
+	int i, x, y, w, h, bad = 0;
+	uint8_t *cov;
+
+	for (i = 0; i < npts; i++) {
+		xmin = MIN(xmin, pts[i].x - 1);
+		xmax = MAX(xmax, pts[i].x + 1);
+		ymin = MIN(ymin, pts[i].y - 1);
+		ymax = MAX(ymax, pts[i].y + 1);
+	}
+	w = xmax - xmin + 1;
+	h = ymax - ymin + 1;
+	cov = calloc(w * h, 1);
+	if (cov == NULL)
+		err(1, "%s: calloc", __func__);
+
+	for (i = 0; i < sl->cur; i++)
+		for (x = sl->list[i].x1; x <= sl->list[i].x2; x++)
+			cov[(sl->list[i].y - ymin) * w + (x - xmin)]++;
+
+	for (y = ymin; y <= ymax; y++) {
+		for (x = xmin; x <= xmax; x++) {
+			if (cov[(y - ymin) * w + (x - xmin)] ==
+			    polygon_inside(pts, npts, rule, x, y))
+				continue;
+			if (bad++ == 0)
+				printf("selfcheck: polygon: %s: (%d,%d) "
+				    "covered %d times\n", name, x, y,
+				    cov[(y - ymin) * w + (x - xmin)]);
+		}
+	}
+	free(cov);
+	return (bad == 0);
+}
+
+/*
+ * Polygon scan conversion: a self-intersecting star with both fill
+ * rules and a many sided "map" outline, checked against a brute
+ * force inside test.
+ */
+static bool
+check_polygon(void)
+{
+	const int nmap = 600;
+	struct point2d star[5], *map;
+	struct scanline_list *sl;
+	bool ret = true;
+	double a, r;
+	int i;
+
+	sl = scanline_list_alloc(1024);
+	map = calloc(nmap, sizeof(*map));
+	if (sl == NULL || map == NULL)
+		err(1, "%s: alloc", __func__);
+
+	/* Pentagram; the middle is a hole with the even-odd rule */
+	for (i = 0; i < 5; i++) {
+		a = (i * 2 * 2 * M_PI) / 5 - M_PI / 2;
+		star[i].x = 320 + (int) (300 * cos(a));
+		star[i].y = 320 + (int) (300 * sin(a));
+	}
+	/* A wobbly coastline with a few deep inlets */
+	for (i = 0; i < nmap; i++) {
+		a = (i * 2 * M_PI) / nmap;
+		r = 300 + 60 * sin(a * 7) + 25 * sin(a * 31) +
+		    ((i % 97) < 3 ? -200 : 0);
+		map[i].x = 960 + (int) (r * cos(a));
+		map[i].y = 512 + (int) (r * sin(a));
+	}
+
+	sl->cur = 0;
+	bres_polygon(sl, star, 5, BresFillRuleEvenOdd);
+	ret &= polygon_check("star even-odd", star, 5, BresFillRuleEvenOdd,
+	    sl);
+	sl->cur = 0;
+	bres_polygon(sl, star, 5, BresFillRuleNonZero);
+	ret &= polygon_check("star nonzero", star, 5, BresFillRuleNonZero,
+	    sl);
+	sl->cur = 0;
+	bres_polygon(sl, map, nmap, BresFillRuleNonZero);
+	ret &= polygon_check("map", map, nmap, BresFillRuleNonZero, sl);
+
+	scanline_list_free(sl);
+	free(map);
+	return ret;
+}
+
+/*
+ * Spans from drawing each of ntris triangles with bres_polygon(),
+ * which is what bres_triangle_mesh() has to match.
+ */
+static void
+mesh_reference(struct scanline_list *sl, const struct point2d *pts,
+    const int *idx, int ntris)
+{
+	struct point2d tri[3];
+	int i, j;
+
+	for (i = 0; i < ntris; i++) {
+		for (j = 0; j < 3; j++)
+			tri[j] = pts[idx[i * 3 + j]];
+		if (! bres_polygon(sl, tri, 3, BresFillRuleNonZero))
+			err(1, "%s: bres_polygon", __func__);
+	}
+}
+
+static bool
+mesh_compare(const char *name, const struct scanline_list *a,
+    const struct scanline_list *b)
+{
+	int i;
+
+	if (a->cur != b->cur) {
+		printf("selfcheck: mesh: %s: %d spans, expected %d\n", name,
+		    a->cur, b->cur);
+		return false;
+	}
+	for (i = 0; i < a->cur; i++) {
+		if (a->list[i].x1 != b->list[i].x1 ||
+		    a->list[i].x2 != b->list[i].x2 ||
+		    a->list[i].y != b->list[i].y) {
+			printf("selfcheck: mesh: %s: span %d is (%d..%d, %d), "
+			    "expected (%d..%d, %d)\n", name, i,
+			    a->list[i].x1, a->list[i].x2, a->list[i].y,
+			    b->list[i].x1, b->list[i].x2, b->list[i].y);
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Triangle strips and meshes: a jittered grid mesh and a zig-zag
+ * strip, checked against drawing each triangle on its own, and the
+ * grid for covering every pixel exactly once.
+ */
+static bool
+check_mesh(void)
+{
+	const int gw = 48, gh = 40, cw = 24, ch = 24, gx = 40, gy = 32;
+	const int npts = (gw + 1) * (gh + 1), ntris = gw * gh * 2;
+	const int nstrip = 200;
+	struct point2d *pts, *strip;
+	struct scanline_list *sl, *ref;
+	uint8_t *cov;
+	bool ret = true;
+	int *idx, *sidx, i, x, y, n, bad;
+
+	pts = calloc(npts, sizeof(*pts));
+	idx = calloc(ntris * 3, sizeof(int));
+	strip = calloc(nstrip, sizeof(*strip));
+	sidx = calloc((nstrip - 2) * 3, sizeof(int));
+	cov = calloc(gw * cw * gh * ch, 1);
+	sl = scanline_list_alloc(1024);
+	ref = scanline_list_alloc(1024);
+	if (pts == NULL || idx == NULL || strip == NULL || sidx == NULL ||
+	    cov == NULL || sl == NULL || ref == NULL)
+		err(1, "%s: alloc", __func__);
+
+	/* Interior vertices are jittered; the border stays straight */
+	for (y = 0; y <= gh; y++) {
+		for (x = 0; x <= gw; x++) {
+			i = y * (gw + 1) + x;
+			pts[i].x = gx + x * cw;
+			pts[i].y = gy + y * ch;
+			if (x > 0 && x < gw && y > 0 && y < gh) {
+				pts[i].x += (int) (9 * sin(i * 1.7));
+				pts[i].y += (int) (9 * cos(i * 2.3));
+			}
+		}
+	}
+	n = 0;
+	for (y = 0; y < gh; y++) {
+		for (x = 0; x < gw; x++) {
+			i = y * (gw + 1) + x;
+			idx[n++] = i;
+			idx[n++] = i + 1;
+			idx[n++] = i + gw + 1;
+			idx[n++] = i + 1;
+			idx[n++] = i + gw + 2;
+			idx[n++] = i + gw + 1;
+		}
+	}
+	for (i = 0; i < nstrip; i++) {
+		strip[i].x = 20 + (i / 2) * 12 + (int) (5 * sin(i));
+		strip[i].y = 980 - (i & 1) * 30 - (int) (20 * sin(i / 9.0));
+	}
+	for (i = 0; i + 2 < nstrip; i++) {
+		sidx[i * 3] = i;
+		sidx[i * 3 + 1] = i + 1;
+		sidx[i * 3 + 2] = i + 2;
+	}
+
+	if (! bres_triangle_mesh(sl, pts, npts, idx, ntris))
+		err(1, "%s: bres_triangle_mesh", __func__);
+	mesh_reference(ref, pts, idx, ntris);
+	ret &= mesh_compare("grid", sl, ref);
+
+	/* Watertight: every pixel of the grid exactly once */
+	for (i = 0; i < sl->cur; i++)
+		for (x = sl->list[i].x1; x <= sl->list[i].x2; x++)
+			cov[(sl->list[i].y - gy) * gw * cw + (x - gx)]++;
+	bad = 0;
+	for (i = 0; i < gw * cw * gh * ch; i++) {
+		if (cov[i] != 1 && bad++ == 0)
+			printf("selfcheck: mesh: grid: (%d,%d) covered %d "
+			    "times\n", gx + i % (gw * cw), gy + i / (gw * cw),
+			    cov[i]);
+	}
+	ret &= (bad == 0);
+
+	sl->cur = 0;
+	ref->cur = 0;
+	if (! bres_triangle_strip(sl, strip, nstrip))
+		err(1, "%s: bres_triangle_strip", __func__);
+	mesh_reference(ref, strip, sidx, nstrip - 2);
+	ret &= mesh_compare("strip", sl, ref);
+
+	scanline_list_free(sl);
+	scanline_list_free(ref);
+	free(cov);
+	free(sidx);
+	free(strip);
+	free(idx);
+	free(pts);
+	return ret;
+}
+
+/*
+ * Is the centre of pixel (x, y) inside a 28.4 triangle?  Count the
+ * edges crossing the centre's scanline at or left of it, counting
+ * an edge on scanlines [top, bottom) - the top-left rule, done the
+ * slow way.
+ */
+static bool
+subpixel_inside(const struct point2d *p, int x, int y)
+{
+	const struct point2d *top, *bot;
+	int64_t xc, yc;
+	int i, n = 0;
+
+	xc = (int64_t) x * BRES_SUBPIXEL_ONE + BRES_SUBPIXEL_ONE / 2;
+	yc = (int64_t) y * BRES_SUBPIXEL_ONE + BRES_SUBPIXEL_ONE / 2;
+	for (i = 0; i < 3; i++) {
+		top = &p[i];
+		bot = &p[(i + 1) % 3];
+		if (top->y == bot->y)
+			continue;
+		if (bot->y < top->y) {
+			top = bot;
+			bot = &p[i];
+		}
+		if (yc < top->y || yc >= bot->y)
+			continue;
+		/* crossing <= xc */
+		if ((yc - top->y) * (bot->x - top->x) <=
+		    (xc - top->x) * (bot->y - top->y))
+			n++;
+	}
+	return ((n & 1) != 0);
+}
+
+/*
+ * Count how many times each pixel of a (w x h) box at (x0, y0) is
+ * covered; it all has to be exactly once.
+ */
+static bool
+subpixel_watertight(const char *name, const struct scanline_list *sl,
+    uint8_t *cov, int x0, int y0, int w, int h)
+{
+	int i, x, bad = 0;
+
+	memset(cov, 0, w * h);
+	for (i = 0; i < sl->cur; i++)
+		for (x = sl->list[i].x1; x <= sl->list[i].x2; x++)
+			cov[(sl->list[i].y - y0) * w + (x - x0)]++;
+	for (i = 0; i < w * h; i++) {
+		if (cov[i] != 1 && bad++ == 0)
+			printf("selfcheck: subpixel: %s: (%d,%d) covered %d "
+			    "times\n", name, x0 + i % w, y0 + i / w, cov[i]);
+	}
+	return (bad == 0);
+}
+
+/*
+ * Subpixel meshes: random triangles against subpixel_inside(), then
+ * a grid with fractional jitter and a fan round a fractional centre,
+ * which have to cover every pixel exactly once.
+ */
+static bool
+check_subpixel(void)
+{
+	const int gw = 48, gh = 40, cw = 24, ch = 24, gx = 40, gy = 32;
+	const int npts = (gw + 1) * (gh + 1), ntris = gw * gh * 2;
+	const int w = gw * cw, h = gh * ch, nfan = 37;
+	struct point2d *pts, tri[3], fan[nfan * 4 + 1];
+	struct scanline_list *sl;
+	uint8_t *cov;
+	bool ret = true;
+	int *idx, fidx[nfan * 4 * 3], i, j, x, y, n, bad;
+
+	pts = calloc(npts, sizeof(*pts));
+	idx = calloc(ntris * 3, sizeof(int));
+	cov = calloc(w * h, 1);
+	sl = scanline_list_alloc(1024);
+	if (pts == NULL || idx == NULL || cov == NULL || sl == NULL)
+		err(1, "%s: alloc", __func__);
+
+	/* Random triangles, some tiny, some flat, all fractional */
+	srandom(5678);
+	bad = 0;
+	for (i = 0; i < 2000 && bad == 0; i++) {
+		n = (i % 3 == 0) ? 24 : 24 * BRES_SUBPIXEL_ONE;
+		for (j = 0; j < 3; j++) {
+			tri[j].x = 32 * BRES_SUBPIXEL_ONE + random() % n;
+			tri[j].y = 32 * BRES_SUBPIXEL_ONE + random() % n;
+		}
+		if (i % 7 == 0)
+			tri[2].y = tri[1].y;
+		sl->cur = 0;
+		if (! bres_triangle_mesh_subpixel(sl, tri, 3,
+		    (const int[]) { 0, 1, 2 }, 1))
+			err(1, "%s: bres_triangle_mesh_subpixel", __func__);
+		memset(cov, 0, 64 * 64);
+		for (j = 0; j < sl->cur; j++)
+			for (x = sl->list[j].x1; x <= sl->list[j].x2; x++)
+				cov[sl->list[j].y * 64 + x]++;
+		for (j = 0; j < 64 * 64; j++) {
+			if (cov[j] != subpixel_inside(tri, j % 64, j / 64) &&
+			    bad++ == 0)
+				printf("selfcheck: subpixel: triangle %d: (%d,%d) "
+				    "covered %d times\n", i, j % 64, j / 64,
+				    cov[j]);
+		}
+	}
+	ret &= (bad == 0);
+
+	/* The grid; the border stays on whole pixels */
+	for (y = 0; y <= gh; y++) {
+		for (x = 0; x <= gw; x++) {
+			i = y * (gw + 1) + x;
+			pts[i].x = BRES_INT_TO_SUBPIXEL(gx + x * cw);
+			pts[i].y = BRES_INT_TO_SUBPIXEL(gy + y * ch);
+			if (x > 0 && x < gw && y > 0 && y < gh) {
+				pts[i].x += (int) (150 * sin(i * 1.7));
+				pts[i].y += (int) (150 * cos(i * 2.3));
+			}
+		}
+	}
+	n = 0;
+	for (y = 0; y < gh; y++) {
+		for (x = 0; x < gw; x++) {
+			i = y * (gw + 1) + x;
+			idx[n++] = i;
+			idx[n++] = i + 1;
+			idx[n++] = i + gw + 1;
+			idx[n++] = i + 1;
+			idx[n++] = i + gw + 2;
+			idx[n++] = i + gw + 1;
+		}
+	}
+	sl->cur = 0;
+	if (! bres_triangle_mesh_subpixel(sl, pts, npts, idx, ntris))
+		err(1, "%s: bres_triangle_mesh_subpixel", __func__);
+	ret &= subpixel_watertight("grid", sl, cov, gx, gy, w, h);
+
+	/* The fan: the same outline, around an off-centre point */
+	for (i = 0; i < nfan; i++) {
+		fan[i].x = gx + w * i / nfan;
+		fan[i].y = gy;
+		fan[nfan + i].x = gx + w;
+		fan[nfan + i].y = gy + h * i / nfan;
+		fan[nfan * 2 + i].x = gx + w - w * i / nfan;
+		fan[nfan * 2 + i].y = gy + h;
+		fan[nfan * 3 + i].x = gx;
+		fan[nfan * 3 + i].y = gy + h - h * i / nfan;
+	}
+	for (i = 0; i < nfan * 4; i++) {
+		fan[i].x = BRES_INT_TO_SUBPIXEL(fan[i].x);
+		fan[i].y = BRES_INT_TO_SUBPIXEL(fan[i].y);
+		fidx[i * 3] = nfan * 4;
+		fidx[i * 3 + 1] = i;
+		fidx[i * 3 + 2] = (i + 1) % (nfan * 4);
+	}
+	fan[nfan * 4].x = BRES_INT_TO_SUBPIXEL(gx + w / 3) + 5;
+	fan[nfan * 4].y = BRES_INT_TO_SUBPIXEL(gy + h / 2) + 11;
+	sl->cur = 0;
+	if (! bres_triangle_mesh_subpixel(sl, fan, nfan * 4 + 1, fidx,
+	    nfan * 4))
+		err(1, "%s: bres_triangle_mesh_subpixel", __func__);
+	ret &= subpixel_watertight("fan", sl, cov, gx, gy, w, h);
+
+	scanline_list_free(sl);
+	free(cov);
+	free(idx);
+	free(pts);
+	return ret;
+}
+
+/*
+ * Count how many times each on-screen pixel of a span list is covered.
+ */
+static void
+raster_mt_coverage(const struct scanline_list *sl, uint8_t *cov, int w, int h)
+{
+	int i, x;
+
+	memset(cov, 0, w * h);
+	for (i = 0; i < sl->cur; i++) {
+		if (sl->list[i].y < 0 || sl->list[i].y >= h)
+			continue;
+		for (x = MAX(sl->list[i].x1, 0); x <= MIN(sl->list[i].x2, w - 1);
+		    x++)
+			cov[sl->list[i].y * w + x]++;
+	}
+}
+
+/*
+ * Tile binned multithreaded rasterisation of a big random scene,
+ * checked against bres_triangle_mesh() for covering the same pixels
+ * the same number of times and for coming out in y order, with one
+ * worker and with several.
+ */
+static bool
+check_raster_mt(void)
+{
+	const int w = 1280, h = 1024, ntris = 20000, nthreads = 4;
+	struct bres_raster_mt *rm[2];
+	struct scanline_list *sl, *ref;
+	struct point2d *pts;
+	uint8_t *cov, *refcov;
+	bool ret = true;
+	int *idx, i, j, r, cx, cy;
+
+	pts = calloc(ntris * 3, sizeof(*pts));
+	idx = calloc(ntris * 3, sizeof(int));
+	cov = malloc(w * h);
+	refcov = malloc(w * h);
+	sl = scanline_list_alloc(1024);
+	ref = scanline_list_alloc(1024);
+	rm[0] = bres_raster_mt_create(1, w, h);
+	rm[1] = bres_raster_mt_create(nthreads, w, h);
+	if (pts == NULL || idx == NULL || cov == NULL || refcov == NULL ||
+	    sl == NULL || ref == NULL || rm[0] == NULL || rm[1] == NULL)
+		err(1, "%s: alloc", __func__);
+
+	/* Mostly small triangles, some big ones, some hanging off screen */
+	srandom(1234);
+	for (i = 0; i < ntris; i++) {
+		r = (i % 50 == 0) ? 300 : 8 + random() % 40;
+		cx = random() % (w + 100) - 50;
+		cy = random() % (h + 100) - 50;
+		for (j = 0; j < 3; j++) {
+			pts[i * 3 + j].x = cx + random() % (2 * r) - r;
+			pts[i * 3 + j].y = cy + random() % (2 * r) - r;
+			idx[i * 3 + j] = i * 3 + j;
+		}
+	}
+
+	if (! bres_triangle_mesh(ref, pts, ntris * 3, idx, ntris))
+		err(1, "%s: bres_triangle_mesh", __func__);
+	raster_mt_coverage(ref, refcov, w, h);
+	for (j = 0; j < 2; j++) {
+		sl->cur = 0;
+		if (! bres_raster_mt_triangles(rm[j], sl, pts, ntris * 3, idx,
+		    ntris))
+			err(1, "%s: bres_raster_mt_triangles", __func__);
+		for (i = 1; i < sl->cur; i++) {
+			if (sl->list[i].y < sl->list[i - 1].y) {
+				printf("selfcheck: raster_mt: span %d (y %d) "
+				    "is out of order\n", i, sl->list[i].y);
+				ret = false;
+				break;
+			}
+		}
+		raster_mt_coverage(sl, cov, w, h);
+		for (i = 0; i < w * h; i++) {
+			if (cov[i] != refcov[i]) {
+				printf("selfcheck: raster_mt: %d threads: (%d,%d) "
+				    "covered %d times, expected %d\n",
+				    j == 0 ? 1 : nthreads, i % w, i / w, cov[i],
+				    refcov[i]);
+				ret = false;
+				break;
+			}
+		}
+	}
+
+	bres_raster_mt_free(rm[0]);
+	bres_raster_mt_free(rm[1]);
+	scanline_list_free(sl);
+	scanline_list_free(ref);
+	free(refcov);
+	free(cov);
+	free(idx);
+	free(pts);
+	return ret;
+}
+
+/*
+ * Flat top / bottom triangles: a pile of random ones (including
+ * zero height and zero width ones) through the batch path, checked
+ * span for span against bres_triangle_flat().
+ */
+static bool
+check_flat(void)
+{
+	const int ntris = 10000;
+	struct bres_flat_triangle *tris;
+	struct scanline_list *sl, *ref;
+	bool ret = true;
+	int i, n, h, w;
+
+	tris = calloc(ntris, sizeof(*tris));
+	sl = scanline_list_alloc(1024);
+	ref = scanline_list_alloc(1024);
+	if (tris == NULL || sl == NULL || ref == NULL)
+		err(1, "%s: alloc", __func__);
+
+	srandom(4321);
+	n = 0;
+	for (i = 0; i < ntris; i++) {
+		h = (i % 100 == 0) ? 400 : random() % 48;
+		w = (i % 100 == 1) ? 600 : 1 + random() % 64;
+		tris[i].x1 = random() % 1280;
+		tris[i].y1 = random() % 1024;
+		tris[i].y2 = tris[i].y1 + ((i & 1) ? -h : h);
+		tris[i].x2l = tris[i].x1 - random() % w;
+		tris[i].x2r = tris[i].x1 + random() % w - w / 4;
+		if (tris[i].x2r < tris[i].x2l)
+			tris[i].x2r = tris[i].x2l;
+		n += h + 1;
+	}
+
+	if (! scanline_list_reserve(ref, n))
+		err(1, "%s: scanline_list_reserve", __func__);
+	for (i = 0; i < ntris; i++)
+		bres_triangle_flat(ref, tris[i].x1, tris[i].y1, tris[i].x2l,
+		    tris[i].x2r, tris[i].y2);
+	if (! bres_triangle_flat_batch(sl, tris, ntris))
+		err(1, "%s: bres_triangle_flat_batch", __func__);
+	if (sl->cur != ref->cur) {
+		printf("selfcheck: flat: %d spans, expected %d\n", sl->cur,
+		    ref->cur);
+		ret = false;
+	}
+	for (i = 0; i < sl->cur && ret; i++) {
+		if (sl->list[i].x1 != ref->list[i].x1 ||
+		    sl->list[i].x2 != ref->list[i].x2 ||
+		    sl->list[i].y != ref->list[i].y) {
+			printf("selfcheck: flat: span %d is (%d..%d, %d), "
+			    "expected (%d..%d, %d)\n", i,
+			    sl->list[i].x1, sl->list[i].x2, sl->list[i].y,
+			    ref->list[i].x1, ref->list[i].x2, ref->list[i].y);
+			ret = false;
+		}
+	}
+
+	scanline_list_free(sl);
+	scanline_list_free(ref);
+	free(tris);
+	return ret;
+}
+
+static bool
+arena_compare(const struct scanline_list *a, const struct scanline_list *b,
+    int tri)
+{
+	int i;
+
+	if (a == NULL || b == NULL || a->cur != b->cur) {
+		printf("selfcheck: arena: triangle %d: lists differ\n", tri);
+		return false;
+	}
+	for (i = 0; i < a->cur; i++) {
+		if (a->list[i].x1 != b->list[i].x1 ||
+		    a->list[i].x2 != b->list[i].x2 ||
+		    a->list[i].y != b->list[i].y) {
+			printf("selfcheck: arena: triangle %d: span %d differs\n",
+			    tri, i);
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Per triangle scan lists from malloc() against a frame arena.  A
+ * frame of small random triangles is drawn both ways and compared,
+ * through a tiny arena (so chunks overflow and lists have to move
+ * to grow) and a default sized one, for two frames each so the
+ * reset gets used.
+ */
+static bool
+check_arena(void)
+{
+	const int ntris = 20000;
+	struct scanline_list *sl, *asl, *tsl;
+	struct bres_arena *arena[2];
+	struct point2d *pts;
+	bool ret = true;
+	int i, j, k, f, r, cx, cy;
+
+	pts = calloc(ntris * 3, sizeof(*pts));
+	arena[0] = bres_arena_create(256);
+	arena[1] = bres_arena_create(0);
+	if (pts == NULL || arena[0] == NULL || arena[1] == NULL)
+		err(1, "%s: alloc", __func__);
+
+	srandom(2468);
+	for (i = 0; i < ntris; i++) {
+		r = 4 + random() % 24;
+		cx = random() % 1280;
+		cy = random() % 1024;
+		for (j = 0; j < 3; j++) {
+			pts[i * 3 + j].x = cx + random() % (2 * r) - r;
+			pts[i * 3 + j].y = cy + random() % (2 * r) - r;
+		}
+	}
+
+	for (k = 0; k < 2; k++) {
+		for (f = 0; f < 2 && ret; f++) {
+			for (i = 0; i < ntris && ret; i++) {
+				bres_triangle_xy(pts[i * 3].x, pts[i * 3].y,
+				    pts[i * 3 + 1].x, pts[i * 3 + 1].y,
+				    pts[i * 3 + 2].x, pts[i * 3 + 2].y, &sl);
+				bres_triangle_xy_arena(pts[i * 3].x,
+				    pts[i * 3].y, pts[i * 3 + 1].x,
+				    pts[i * 3 + 1].y, pts[i * 3 + 2].x,
+				    pts[i * 3 + 2].y, arena[k], &asl);
+				ret &= arena_compare(sl, asl, i);
+
+				/* Grow it in place, then after another list */
+				if (ret && (i % 16) == 0) {
+					if (! scanline_list_reserve(asl,
+					    asl->count + 8))
+						err(1, "%s: reserve", __func__);
+					tsl = scanline_list_alloc_arena(arena[k],
+					    4);
+					if (tsl == NULL || ! scanline_list_reserve(
+					    asl, asl->count * 2 + 64))
+						err(1, "%s: reserve", __func__);
+					ret &= arena_compare(sl, asl, i);
+				}
+				scanline_list_free(sl);
+				scanline_list_free(asl);
+			}
+			bres_arena_reset(arena[k]);
+		}
+	}
+
+	bres_arena_destroy(arena[0]);
+	bres_arena_destroy(arena[1]);
+	free(pts);
+	return ret;
+}
+
+/*
+ * The REX3 model's I_LINE loop, a pixel at a time, as one pixel
+ * spans.
+ */
+static void
+linespans_reference(struct scanline_list *sl, int x, int y, int xe, int ye)
+{
+	int dx, dy, sx, sy, e, e2;
+
+	dx = abs(xe - x);
+	dy = -abs(ye - y);
+	sx = (x < xe) ? 1 : -1;
+	sy = (y < ye) ? 1 : -1;
+	e = dx + dy;
+
+	if (! scanline_list_reserve(sl, dx - dy + 1))
+		err(1, "%s: scanline_list_reserve", __func__);
+	for (;;) {
+		scanline_list_push(sl, x, x, y);
+		if (x == xe && y == ye)
+			break;
+		e2 = 2 * e;
+		if (e2 >= dy) {
+			e += dy;
+			x += sx;
+		}
+		if (e2 <= dx) {
+			e += dx;
+			y += sy;
+		}
+	}
+}
+
+/*
+ * Mark a span list's pixels with bit, in a 1024x1024 map centred on
+ * (0, 0); returns how many were already marked with it.
+ */
+static int
+linespans_mark(uint8_t *map, const struct scanline_list *sl, uint8_t bit)
+{
+	int i, x, n = 0;
+
+	for (i = 0; i < sl->cur; i++) {
+		for (x = sl->list[i].x1; x <= sl->list[i].x2; x++) {
+			n += (map[(sl->list[i].y + 512) * 1024 + x + 512] &
+			    bit) != 0;
+			map[(sl->list[i].y + 512) * 1024 + x + 512] |= bit;
+		}
+	}
+	return (n);
+}
+
+/*
+ * Run-slice lines: random lines checked pixel for pixel against the
+ * I_LINE loop, and thick lines checked for one span per scanline and
+ * for covering the thin line.
+ */
+static bool
+check_linespans(void)
+{
+	const int nlines = 2000;
+	struct scanline_list *sl, *ref;
+	uint8_t *map;
+	int *lines, i, j, r, x0, y0, x1, y1, y;
+	bool ret = true;
+
+	lines = calloc(nlines * 4, sizeof(int));
+	map = calloc(1024 * 1024, 1);
+	sl = scanline_list_alloc(1024);
+	ref = scanline_list_alloc(1024);
+	if (lines == NULL || map == NULL || sl == NULL || ref == NULL)
+		err(1, "%s: alloc", __func__);
+
+	/* Mostly long shallow or steep lines, like UI and CAD work */
+	srandom(1357);
+	for (i = 0; i < nlines; i++) {
+		r = (i % 10 == 0) ? 8 : 480;
+		for (j = 0; j < 4; j++)
+			lines[i * 4 + j] = random() % (2 * r) - r;
+		if (i % 3 != 2)
+			lines[i * 4 + 3] = lines[i * 4 + 1] + random() % 40 - 20;
+	}
+
+	for (i = 0; i < nlines && ret; i++) {
+		x0 = MIN(lines[i * 4], lines[i * 4 + 2]) - 16 + 512;
+		x1 = MAX(lines[i * 4], lines[i * 4 + 2]) + 16 + 512;
+		y0 = MIN(lines[i * 4 + 1], lines[i * 4 + 3]) - 16 + 512;
+		y1 = MAX(lines[i * 4 + 1], lines[i * 4 + 3]) + 16 + 512;
+		for (y = y0; y <= y1; y++)
+			memset(&map[y * 1024 + x0], 0, x1 - x0 + 1);
+		sl->cur = 0;
+		ref->cur = 0;
+		if (! bres_line(sl, lines[i * 4], lines[i * 4 + 1],
+		    lines[i * 4 + 2], lines[i * 4 + 3]))
+			err(1, "%s: bres_line", __func__);
+		linespans_reference(ref, lines[i * 4], lines[i * 4 + 1],
+		    lines[i * 4 + 2], lines[i * 4 + 3]);
+		linespans_mark(map, ref, 1);
+		if (linespans_mark(map, sl, 2) != 0) {
+			printf("selfcheck: linespans: line %d draws a pixel "
+			    "twice\n", i);
+			ret = false;
+		}
+		for (j = y0 * 1024; j <= y1 * 1024 + x1 && ret; j++) {
+			if (j % 1024 < x0 || j % 1024 > x1)
+				continue;
+			if (map[j] == 1 || map[j] == 2) {
+				printf("selfcheck: linespans: line %d: (%d,%d) "
+				    "is %s\n", i, j % 1024 - 512, j / 1024 - 512,
+				    map[j] == 1 ? "missing" : "extra");
+				ret = false;
+			}
+		}
+
+		/* Thick: one span a scanline, over the thin line */
+		sl->cur = 0;
+		if (! bres_line_thick(sl, lines[i * 4], lines[i * 4 + 1],
+		    lines[i * 4 + 2], lines[i * 4 + 3], 1 + i % 9))
+			err(1, "%s: bres_line_thick", __func__);
+		for (j = 1; j < sl->cur && ret; j++) {
+			if (sl->list[j].y == sl->list[j - 1].y) {
+				printf("selfcheck: linespans: thick line %d has "
+				    "two spans on scanline %d\n", i,
+				    sl->list[j].y);
+				ret = false;
+			}
+		}
+		if (ret && linespans_mark(map, sl, 4) != 0) {
+			printf("selfcheck: linespans: thick line %d draws a "
+			    "pixel twice\n", i);
+			ret = false;
+		}
+		for (j = y0 * 1024; j <= y1 * 1024 + x1 && ret; j++) {
+			if (j % 1024 < x0 || j % 1024 > x1)
+				continue;
+			if (map[j] == 3) {
+				printf("selfcheck: linespans: thick line %d "
+				    "misses (%d,%d)\n", i, j % 1024 - 512,
+				    j / 1024 - 512);
+				ret = false;
+			}
+		}
+	}
+
+	scanline_list_free(sl);
+	scanline_list_free(ref);
+	free(map);
+	free(lines);
+	return ret;
+}
+
+/*
+ * Is (dx, dy) from the centre inside the 2a + 1 by 2b + 1 ellipse?
+ */
+static bool
+ellipse_inside(int dx, int dy, int a, int b)
+{
+	const int64_t A = 2 * a + 1, B = 2 * b + 1;
+
+	if (a < 0 || b < 0)
+		return false;
+	return (4 * (int64_t) dx * dx * B * B + 4 * (int64_t) dy * dy * A * A <=
+	    A * A * B * B);
+}
+
+/*
+ * Check a span list against a per pixel test over a box: every
+ * pixel inside exactly once, nothing else, spans in y order.
+ */
+static bool
+ellipse_compare(const char *name, const struct scanline_list *sl,
+    int x0, int y0, int w, int h, bool (*inside)(int, int, const int *),
+    const int *args)
+{
+	uint8_t *cov;
+	bool ret = true;
+	int i, x, y;
+
+	cov = calloc(w * h, 1);
+	if (cov == NULL)
+		err(1, "%s: calloc", __func__);
+	for (i = 0; i < sl->cur; i++) {
+		if ((i > 0 && sl->list[i].y < sl->list[i - 1].y) ||
+		    sl->list[i].y < y0 || sl->list[i].y >= y0 + h ||
+		    sl->list[i].x1 < x0 || sl->list[i].x2 >= x0 + w) {
+			printf("selfcheck: ellipse: %s: bad span %d (%d..%d, "
+			    "%d)\n", name, i, sl->list[i].x1, sl->list[i].x2,
+			    sl->list[i].y);
+			free(cov);
+			return false;
+		}
+		for (x = sl->list[i].x1; x <= sl->list[i].x2; x++)
+			cov[(sl->list[i].y - y0) * w + x - x0]++;
+	}
+	for (y = 0; y < h && ret; y++) {
+		for (x = 0; x < w && ret; x++) {
+			if (cov[y * w + x] != inside(x0 + x, y0 + y, args)) {
+				printf("selfcheck: ellipse: %s: (%d,%d) covered %d "
+				    "times\n", name, x0 + x, y0 + y,
+				    cov[y * w + x]);
+				ret = false;
+			}
+		}
+	}
+	free(cov);
+	return ret;
+}
+
+/* args: cx, cy, a, b, ring width (0 for filled) */
+static bool
+ellipse_inside_args(int x, int y, const int *args)
+{
+	const int dx = x - args[0], dy = y - args[1];
+
+	if (! ellipse_inside(dx, dy, args[2], args[3]))
+		return false;
+	if (args[4] <= 0 || args[2] < args[4] || args[3] < args[4])
+		return true;
+	return (! ellipse_inside(dx, dy, args[2] - args[4],
+	    args[3] - args[4]));
+}
+
+/* args: x, y, w, h, r (already clamped) */
+static bool
+rounded_rect_inside_args(int x, int y, const int *args)
+{
+	const int rx = args[0], ry = args[1], w = args[2], h = args[3];
+	const int r = args[4];
+	int cx, cy;
+
+	if (x < rx || x >= rx + w || y < ry || y >= ry + h)
+		return false;
+	cx = (x < rx + r) ? rx + r : (x > rx + w - 1 - r) ? rx + w - 1 - r : x;
+	cy = (y < ry + r) ? ry + r : (y > ry + h - 1 - r) ? ry + h - 1 - r : y;
+	return (ellipse_inside(x - cx, y - cy, r, r));
+}
+
+/*
+ * Circles, ellipses, rings and rounded rectangles: random ones of
+ * each checked pixel for pixel against the inside tests.
+ */
+static bool
+check_ellipse(void)
+{
+	struct scanline_list *sl;
+	bool ret = true;
+	int args[5], i, r;
+	char name[64];
+
+	sl = scanline_list_alloc(1024);
+	if (sl == NULL)
+		err(1, "%s: scanline_list_alloc", __func__);
+
+	srandom(97531);
+	for (i = 0; i < 400 && ret; i++) {
+		args[0] = random() % 200 - 100;
+		args[1] = random() % 200 - 100;
+		args[2] = (i % 4 == 0) ? random() % 4 : random() % 120;
+		args[3] = (i % 2 == 0) ? args[2] : random() % 120;
+		args[4] = (i % 3 == 0) ? 0 : 1 + random() % 20;
+		sl->cur = 0;
+		if (args[4] == 0 && args[2] == args[3])
+			ret &= bres_circle(sl, args[0], args[1], args[2]);
+		else if (args[4] == 0)
+			ret &= bres_ellipse(sl, args[0], args[1], args[2],
+			    args[3]);
+		else if (args[2] == args[3])
+			ret &= bres_circle_ring(sl, args[0], args[1], args[2],
+			    args[4]);
+		else
+			ret &= bres_ellipse_ring(sl, args[0], args[1],
+			    args[2], args[3], args[4]);
+		snprintf(name, sizeof(name), "(%d,%d) %dx%d/%d", args[0],
+		    args[1], args[2], args[3], args[4]);
+		ret &= ellipse_compare(name, sl, args[0] - args[2],
+		    args[1] - args[3], 2 * args[2] + 1, 2 * args[3] + 1,
+		    ellipse_inside_args, args);
+
+		args[2] = 1 + random() % 150;
+		args[3] = 1 + random() % 150;
+		r = random() % 60;
+		sl->cur = 0;
+		ret &= bres_rounded_rect(sl, args[0], args[1], args[2],
+		    args[3], r);
+		args[4] = MAX(0, MIN(r, MIN((args[2] - 1) / 2,
+		    (args[3] - 1) / 2)));
+		snprintf(name, sizeof(name), "rect (%d,%d) %dx%d r %d",
+		    args[0], args[1], args[2], args[3], r);
+		ret &= ellipse_compare(name, sl, args[0], args[1], args[2],
+		    args[3], rounded_rect_inside_args, args);
+	}
+
+	scanline_list_free(sl);
+	return ret;
+}
+
+/*
+ * Span buffer hidden surface removal on a stack of overlapping
+ * windows and dials: the visible spans are checked against drawing
+ * everything far to near (each pixel has to come back exactly once,
+ * for its nearest shape).
+ */
+static bool
+check_sbuf(void)
+{
+	const int w = 1280, h = 1024, nshapes = 80;
+	struct scanline_list **shape, **vis;
+	struct bres_sbuf *sb;
+	int16_t *owner;
+	uint8_t *cov;
+	bool ret = true;
+	int *depth, *order, i, j, k, x, y;
+
+	shape = calloc(nshapes, sizeof(*shape));
+	vis = calloc(nshapes, sizeof(*vis));
+	depth = calloc(nshapes, sizeof(int));
+	order = calloc(nshapes, sizeof(int));
+	owner = malloc(w * h * sizeof(int16_t));
+	cov = malloc(w * h);
+	sb = bres_sbuf_create(w, h);
+	if (shape == NULL || vis == NULL || depth == NULL || order == NULL ||
+	    owner == NULL || cov == NULL || sb == NULL)
+		err(1, "%s: alloc", __func__);
+
+	/* Windows and dials at shuffled depths */
+	srandom(24680);
+	for (i = 0; i < nshapes; i++)
+		depth[i] = i;
+	for (i = nshapes - 1; i > 0; i--) {
+		j = random() % (i + 1);
+		k = depth[i];
+		depth[i] = depth[j];
+		depth[j] = k;
+	}
+	for (i = 0; i < nshapes; i++) {
+		shape[i] = scanline_list_alloc(256);
+		vis[i] = scanline_list_alloc(256);
+		if (shape[i] == NULL || vis[i] == NULL)
+			err(1, "%s: scanline_list_alloc", __func__);
+		if (i % 4 == 0) {
+			k = 20 + random() % 120;
+			x = k + random() % (w - 2 * k);
+			y = k + random() % (h - 2 * k);
+			ret &= bres_circle(shape[i], x, y, k);
+		} else {
+			j = 100 + random() % 400;
+			k = 80 + random() % 300;
+			x = random() % (w - j);
+			y = random() % (h - k);
+			ret &= bres_rounded_rect(shape[i], x, y, j, k,
+			    random() % 16);
+		}
+		order[nshapes - 1 - depth[i]] = i;
+	}
+
+	/* Far to near, a pixel at a time */
+	for (i = 0; i < w * h; i++)
+		owner[i] = -1;
+	for (j = 0; j < nshapes; j++) {
+		k = order[j];
+		for (i = 0; i < shape[k]->cur; i++) {
+			y = shape[k]->list[i].y;
+			if (y < 0 || y >= h)
+				continue;
+			for (x = MAX(shape[k]->list[i].x1, 0);
+			    x <= MIN(shape[k]->list[i].x2, w - 1); x++)
+				owner[y * w + x] = k;
+		}
+	}
+
+	/* Shapes go in in submission order, not depth order */
+	for (i = 0; i < nshapes; i++)
+		ret &= bres_sbuf_add(sb, shape[i], depth[i], i);
+	ret &= bres_sbuf_resolve(sb, vis, nshapes);
+	memset(cov, 0, w * h);
+	for (k = 0; k < nshapes && ret; k++) {
+		for (i = 0; i < vis[k]->cur && ret; i++) {
+			y = vis[k]->list[i].y;
+			if (i > 0 && y < vis[k]->list[i - 1].y) {
+				printf("selfcheck: sbuf: shape %d span %d "
+				    "(y %d) is out of order\n", k, i, y);
+				ret = false;
+			}
+			for (x = vis[k]->list[i].x1;
+			    x <= vis[k]->list[i].x2 && ret; x++) {
+				if (x < 0 || x >= w || y < 0 || y >= h ||
+				    cov[y * w + x]++ != 0 ||
+				    owner[y * w + x] != k) {
+					printf("selfcheck: sbuf: (%d,%d) from "
+					    "shape %d, expected %d\n", x, y,
+					    k, (x < 0 || x >= w || y < 0 ||
+					    y >= h) ? -1 : owner[y * w + x]);
+					ret = false;
+				}
+			}
+		}
+	}
+	for (i = 0; i < w * h && ret; i++) {
+		if (owner[i] >= 0 && cov[i] == 0) {
+			printf("selfcheck: sbuf: (%d,%d) of shape %d is "
+			    "missing\n", i % w, i / w, owner[i]);
+			ret = false;
+		}
+	}
+
+	for (i = 0; i < nshapes; i++) {
+		scanline_list_free(shape[i]);
+		scanline_list_free(vis[i]);
+	}
+	bres_sbuf_free(sb);
+	free(cov);
+	free(owner);
+	free(order);
+	free(depth);
+	free(vis);
+	free(shape);
+	return ret;
+}
+
+static const struct {
+	const char *name;
+	bool (*fn)(void);
+} checks[] = {
+	{ "polygon", check_polygon },
+	{ "mesh", check_mesh },
+	{ "subpixel", check_subpixel },
+	{ "raster_mt", check_raster_mt },
+	{ "flat", check_flat },
+	{ "arena", check_arena },
+	{ "linespans", check_linespans },
+	{ "ellipse", check_ellipse },
+	{ "sbuf", check_sbuf },
+};
+
+/*
+ * Run the named checks, or all of them; exits non-zero if any fail.
+ */
+int
+main(int argc, char *argv[])
+{
+	int i, j, nrun = 0, nfail = 0;
+	bool ok;
+
+	for (j = 1; j < argc; j++) {
+		for (i = 0; i < (int) nitems(checks); i++)
+			if (strcmp(argv[j], checks[i].name) == 0)
+				break;
+		if (i == (int) nitems(checks)) {
+			fprintf(stderr, "usage: selfcheck [name ...]\n");
+			exit(127);
+		}
+	}
+
+	for (i = 0; i < (int) nitems(checks); i++) {
+		for (j = 1; j < argc; j++)
+			if (strcmp(argv[j], checks[i].name) == 0)
+				break;
+		if (argc > 1 && j == argc)
+			continue;
+		ok = checks[i].fn();
+		printf("selfcheck: %s: %s\n", checks[i].name, ok ? "OK" : "FAILED");
+		nrun++;
+		if (! ok)
+			nfail++;
+	}
+	printf("selfcheck: %d of %d passed\n", nrun - nfail, nrun);
+	exit(nfail == 0 ? 0 : 1);
+}
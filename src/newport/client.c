@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <string.h>
+#include <err.h>
+#include <time.h>
+
+#include "newport_proto.h"
+#include "newport_client.h"
+
+/*
+ * A small drawing server client; draws a test pattern a few times
+ * and reports how long it took.
+ */
+
+static void
+draw_frame(struct newport_client *cl, int frame)
+{
+	uint32_t *img, off;
+	int x, y, w, h;
+
+	w = cl->fb_width;
+	h = cl->fb_height;
+
+	newport_client_fill(cl, 0, 0, w, h, 0);
+
+	/* A grid of filled boxes */
+	for (y = 0; y + 32 <= h; y += 40)
+		for (x = 0; x + 32 <= w; x += 40)
+			newport_client_fill(cl, x, y, 32, 32,
+			    (x * 7 + y * 3 + frame) & 0xff);
+
+	/* Some lines */
+	for (x = 0; x < w; x += 64)
+		newport_client_line(cl, x, 0, w - 1 - x, h - 1, 0xff);
+
+	/* A gradient, written straight into the shared image area */
+	img = newport_client_image_alloc(cl, 64 * 64, &off);
+	if (img != NULL) {
+		for (y = 0; y < 64; y++)
+			for (x = 0; x < 64; x++)
+				img[y * 64 + x] = (x + y + frame) & 0xff;
+		newport_client_upload(cl, 16, 16, 64, 64, off, 64);
+		newport_client_blit(cl, 16, 16, 96, 16, 64, 64);
+	}
+
+	newport_client_kick(cl);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct newport_client *cl;
+	struct timespec ts_start, ts_end;
+	const char *path = NEWPORT_PROTO_SOCKET;
+	uint64_t ts;
+	int i, nframes = 10;
+
+	if (argc > 1)
+		path = argv[1];
+	if (argc > 2)
+		nframes = strtoul(argv[2], NULL, 0);
+
+	cl = newport_client_connect(path);
+	if (cl == NULL)
+		exit(127);
+	printf("client: connected, framebuffer is %dx%d\n", cl->fb_width,
+	    cl->fb_height);
+
+	clock_gettime(CLOCK_MONOTONIC, &ts_start);
+	for (i = 0; i < nframes; i++)
+		draw_frame(cl, i);
+	newport_client_sync(cl);
+	clock_gettime(CLOCK_MONOTONIC, &ts_end);
+
+	ts = (ts_end.tv_sec * 1000000) + (ts_end.tv_nsec / 1000);
+	ts = ts - ((ts_start.tv_sec * 1000000) + (ts_start.tv_nsec / 1000));
+	printf("client: %d frames in %llu milliseconds, %u commands "
+	    "rejected\n", nframes, (unsigned long long) ts / 1000,
+	    newport_client_errors(cl));
+
+	i = newport_client_errors(cl);
+	newport_client_close(cl);
+	exit(i == 0 ? 0 : 1);
+}
@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <sched.h>
+#include <err.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+
+#include "newport_proto.h"
+#include "newport_client.h"
+
+/*
+ * Client side of the local drawing server protocol.
+ *
+ * Commands are written straight into the shared ring and only
+ * published (and the server woken up) by newport_client_kick(),
+ * so a batch of commands costs one socket write.
+ */
+
+static int
+newport_client_recv_hello(int sock, struct newport_proto_hello *hello)
+{
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	union {
+		struct cmsghdr hdr;
+		char buf[CMSG_SPACE(sizeof(int))];
+	} cbuf;
+	int fd = -1;
+
+	bzero(&msg, sizeof(msg));
+	iov.iov_base = hello;
+	iov.iov_len = sizeof(*hello);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf.buf;
+	msg.msg_controllen = sizeof(cbuf.buf);
+
+	if (recvmsg(sock, &msg, 0) != sizeof(*hello)) {
+		warn("%s: recvmsg", __func__);
+		return -1;
+	}
+
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+	    cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET &&
+		    cmsg->cmsg_type == SCM_RIGHTS)
+			memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+	}
+	return fd;
+}
+
+struct newport_client *
+newport_client_connect(const char *path)
+{
+	struct newport_client *cl;
+	struct newport_proto_hello hello;
+	struct sockaddr_un sun;
+	int shm_fd;
+
+	cl = calloc(1, sizeof(*cl));
+	if (cl == NULL)
+		return NULL;
+
+	cl->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (cl->fd < 0) {
+		warn("%s: socket", __func__);
+		goto error;
+	}
+
+	bzero(&sun, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	snprintf(sun.sun_path, sizeof(sun.sun_path), "%s", path);
+	if (connect(cl->fd, (struct sockaddr *) &sun, sizeof(sun)) != 0) {
+		warn("%s: connect(%s)", __func__, path);
+		goto error;
+	}
+
+	shm_fd = newport_client_recv_hello(cl->fd, &hello);
+	if (shm_fd < 0)
+		goto error;
+	if (hello.magic != NEWPORT_PROTO_MAGIC ||
+	    hello.version != NEWPORT_PROTO_VERSION) {
+		printf("%s: unknown server protocol (0x%08x, %u)\n", __func__,
+		    hello.magic, hello.version);
+		close(shm_fd);
+		goto error;
+	}
+
+	cl->shm_size = hello.shm_size;
+	cl->shm = mmap(NULL, cl->shm_size, PROT_READ | PROT_WRITE,
+	    MAP_SHARED, shm_fd, 0);
+	close(shm_fd);
+	if (cl->shm == MAP_FAILED) {
+		cl->shm = NULL;
+		warn("%s: mmap", __func__);
+		goto error;
+	}
+
+	cl->hdr = cl->shm;
+	cl->ring = (void *) ((char *) cl->shm + cl->hdr->ring_offset);
+	cl->image = (void *) ((char *) cl->shm + cl->hdr->image_offset);
+	cl->fb_width = hello.fb_width;
+	cl->fb_height = hello.fb_height;
+	cl->head = atomic_load(&cl->hdr->head);
+	cl->image_next = 0;
+
+	return cl;
+
+error:
+	newport_client_close(cl);
+	return NULL;
+}
+
+void
+newport_client_close(struct newport_client *cl)
+{
+	if (cl == NULL)
+		return;
+	if (cl->shm != NULL)
+		munmap(cl->shm, cl->shm_size);
+	if (cl->fd >= 0)
+		close(cl->fd);
+	free(cl);
+}
+
+/*
+ * Publish everything written so far and poke the server.
+ */
+void
+newport_client_kick(struct newport_client *cl)
+{
+	char c = 0;
+
+	atomic_store_explicit(&cl->hdr->head, cl->head, memory_order_release);
+	/* If the server has gone away, say so rather than SIGPIPE */
+	if (send(cl->fd, &c, 1, MSG_NOSIGNAL) != 1)
+		warn("%s: send", __func__);
+}
+
+/*
+ * Wait until the server has consumed everything submitted so far.
+ */
+void
+newport_client_sync(struct newport_client *cl)
+{
+	newport_client_kick(cl);
+	while (atomic_load_explicit(&cl->hdr->tail, memory_order_acquire) !=
+	    cl->head)
+		sched_yield();
+}
+
+uint32_t
+newport_client_errors(struct newport_client *cl)
+{
+	return atomic_load(&cl->hdr->nerrors);
+}
+
+static struct newport_proto_cmd *
+newport_client_cmd_alloc(struct newport_client *cl, NewportProtoCmdType type)
+{
+	struct newport_proto_cmd *cmd;
+
+	/* Ring full; hand what we have to the server and wait */
+	if (cl->head - atomic_load_explicit(&cl->hdr->tail,
+	    memory_order_acquire) >= cl->hdr->ring_entries) {
+		newport_client_kick(cl);
+		while (cl->head - atomic_load_explicit(&cl->hdr->tail,
+		    memory_order_acquire) >= cl->hdr->ring_entries)
+			sched_yield();
+	}
+
+	cmd = &cl->ring[cl->head & (cl->hdr->ring_entries - 1)];
+	bzero(cmd, sizeof(*cmd));
+	cmd->type = type;
+	cl->head++;
+	return cmd;
+}
+
+void
+newport_client_fill(struct newport_client *cl, int x, int y, int w, int h,
+    uint32_t color)
+{
+	struct newport_proto_cmd *cmd;
+
+	cmd = newport_client_cmd_alloc(cl, NewportProtoCmdFill);
+	cmd->x = x;
+	cmd->y = y;
+	cmd->w = w;
+	cmd->h = h;
+	cmd->color = color;
+}
+
+void
+newport_client_blit(struct newport_client *cl, int xs, int ys, int xd,
+    int yd, int w, int h)
+{
+	struct newport_proto_cmd *cmd;
+
+	cmd = newport_client_cmd_alloc(cl, NewportProtoCmdBlit);
+	cmd->x = xs;
+	cmd->y = ys;
+	cmd->x2 = xd;
+	cmd->y2 = yd;
+	cmd->w = w;
+	cmd->h = h;
+}
+
+void
+newport_client_line(struct newport_client *cl, int x1, int y1, int x2,
+    int y2, uint32_t color)
+{
+	struct newport_proto_cmd *cmd;
+
+	cmd = newport_client_cmd_alloc(cl, NewportProtoCmdLine);
+	cmd->x = x1;
+	cmd->y = y1;
+	cmd->x2 = x2;
+	cmd->y2 = y2;
+	cmd->color = color;
+}
+
+/*
+ * Allocate space for npixels in the shared image area.  The caller
+ * writes its pixels there and then submits newport_client_upload()
+ * with the returned offset; there's no copy on either side.
+ *
+ * When the image area is full this waits for the server to consume
+ * all outstanding uploads and then starts again from the beginning.
+ */
+uint32_t *
+newport_client_image_alloc(struct newport_client *cl, uint32_t npixels,
+    uint32_t *offset)
+{
+	if (npixels > cl->hdr->image_size)
+		return NULL;
+
+	if (cl->hdr->image_size - cl->image_next < npixels) {
+		newport_client_sync(cl);
+		cl->image_next = 0;
+	}
+
+	*offset = cl->image_next;
+	cl->image_next += npixels;
+	return cl->image + *offset;
+}
+
+void
+newport_client_upload(struct newport_client *cl, int x, int y, int w, int h,
+    uint32_t offset, uint32_t stride)
+{
+	struct newport_proto_cmd *cmd;
+
+	cmd = newport_client_cmd_alloc(cl, NewportProtoCmdUpload);
+	cmd->x = x;
+	cmd->y = y;
+	cmd->w = w;
+	cmd->h = h;
+	cmd->offset = offset;
+	cmd->stride = stride;
+}
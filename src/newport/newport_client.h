@@ -0,0 +1,39 @@
+#ifndef	__NEWPORT_CLIENT_H__
+#define	__NEWPORT_CLIENT_H__
+
+struct newport_client {
+	int fd;
+	void *shm;
+	size_t shm_size;
+	struct newport_proto_shm *hdr;
+	struct newport_proto_cmd *ring;
+	uint32_t *image;
+
+	int fb_width;
+	int fb_height;
+
+	/* Local copy of head; published with newport_client_kick() */
+	uint32_t head;
+	/* Next free pixel in the image area */
+	uint32_t image_next;
+};
+
+extern	struct newport_client *newport_client_connect(const char *path);
+extern	void newport_client_close(struct newport_client *cl);
+
+extern	void newport_client_fill(struct newport_client *cl, int x, int y,
+	    int w, int h, uint32_t color);
+extern	void newport_client_blit(struct newport_client *cl, int xs, int ys,
+	    int xd, int yd, int w, int h);
+extern	void newport_client_line(struct newport_client *cl, int x1, int y1,
+	    int x2, int y2, uint32_t color);
+extern	uint32_t *newport_client_image_alloc(struct newport_client *cl,
+	    uint32_t npixels, uint32_t *offset);
+extern	void newport_client_upload(struct newport_client *cl, int x, int y,
+	    int w, int h, uint32_t offset, uint32_t stride);
+
+extern	void newport_client_kick(struct newport_client *cl);
+extern	void newport_client_sync(struct newport_client *cl);
+extern	uint32_t newport_client_errors(struct newport_client *cl);
+
+#endif	/* __NEWPORT_CLIENT_H__ */
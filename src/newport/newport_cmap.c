@@ -0,0 +1,236 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <strings.h>
+
+#include "newport_regs.h"
+#include "newport_ctx.h"
+#include "newport_hwops.h"
+#include "newport_ops.h"
+#include "newport_cmap.h"
+
+/*
+ * CI8 colour map allocation.
+ *
+ * Allocating into a free entry updates the lookup table in place -
+ * each cell just checks whether the new colour is closer than what
+ * it has.  Evicting an entry can take cells away from it, so that
+ * marks the table stale and it's rebuilt on the next lookup.
+ */
+
+static inline uint32_t
+newport_cmap_dist(uint32_t a, uint32_t b)
+{
+	int dr = (int) ((a >> 16) & 0xff) - (int) ((b >> 16) & 0xff);
+	int dg = (int) ((a >> 8) & 0xff) - (int) ((b >> 8) & 0xff);
+	int db = (int) (a & 0xff) - (int) (b & 0xff);
+
+	return (dr * dr + dg * dg + db * db);
+}
+
+/*
+ * Offer entry idx to every LUT cell; cells take it if it's closer
+ * to their centre than what they have.
+ */
+static void
+newport_cmap_lut_add(struct newport_cmap *cm, int idx)
+{
+	uint32_t c, d;
+	int i, r, g, b;
+
+	i = 0;
+	for (r = 0; r < 32; r++) {
+		for (g = 0; g < 32; g++) {
+			for (b = 0; b < 32; b++, i++) {
+				c = (r << 19) | (g << 11) | (b << 3) | 0x040404;
+				d = newport_cmap_dist(c, cm->rgb[idx]);
+				if (d < cm->lut_dist[i]) {
+					cm->lut_dist[i] = d;
+					cm->lut[i] = idx;
+				}
+			}
+		}
+	}
+}
+
+void
+newport_cmap_lut_rebuild(struct newport_cmap *cm)
+{
+	int i;
+
+	for (i = 0; i < NEWPORT_CMAP_LUT_SIZE; i++) {
+		cm->lut[i] = cm->first;
+		cm->lut_dist[i] = UINT32_MAX;
+	}
+	for (i = cm->first; i < cm->first + cm->count; i++)
+		if (cm->valid[i])
+			newport_cmap_lut_add(cm, i);
+	cm->lut_stale = false;
+}
+
+/**
+ * Create a colour map manager for CI entries [first, first + count)
+ * of the CMAP table at base.  Nothing is written to the hardware
+ * until colours are allocated.
+ */
+struct newport_cmap *
+newport_cmap_create(struct gfx_ctx *dc, uint32_t base, int first, int count)
+{
+	struct newport_cmap *cm;
+
+	if (first < 0 || count <= 0 || first + count > NEWPORT_CMAP_NENTRIES) {
+		printf("%s: bad entry range %d + %d\n", __func__, first, count);
+		return NULL;
+	}
+
+	cm = calloc(1, sizeof(*cm));
+	if (cm == NULL)
+		return NULL;
+
+	cm->dc = dc;
+	cm->base = base;
+	cm->first = first;
+	cm->count = count;
+	newport_cmap_lut_rebuild(cm);
+	return cm;
+}
+
+void
+newport_cmap_destroy(struct newport_cmap *cm)
+{
+	free(cm);
+}
+
+/**
+ * Allocate (or take another reference to) an entry for an RGB888
+ * colour and return its CI index.
+ *
+ * When every entry is taken and referenced the colour can't be
+ * added; the nearest existing entry is referenced and returned
+ * instead, so the caller can always pair this with
+ * newport_cmap_release().
+ */
+int
+newport_cmap_alloc(struct newport_cmap *cm, uint32_t rgb)
+{
+	int i, idx = -1, victim = -1;
+
+	rgb &= 0xffffff;
+	cm->clock++;
+	cm->nallocs++;
+
+	for (i = cm->first; i < cm->first + cm->count; i++) {
+		if (! cm->valid[i]) {
+			if (idx < 0)
+				idx = i;
+			continue;
+		}
+		if (cm->rgb[i] == rgb) {
+			cm->refcnt[i]++;
+			cm->stamp[i] = cm->clock;
+			cm->nhits++;
+			return (i);
+		}
+		if (cm->refcnt[i] == 0 &&
+		    (victim < 0 || cm->stamp[i] < cm->stamp[victim]))
+			victim = i;
+	}
+
+	if (idx < 0) {
+		if (victim < 0) {
+			cm->nfull++;
+			idx = newport_cmap_lookup(cm, rgb);
+			cm->refcnt[idx]++;
+			return (idx);
+		}
+		idx = victim;
+		cm->nevictions++;
+		cm->lut_stale = true;
+	} else
+		cm->nvalid++;
+
+	cm->rgb[idx] = rgb;
+	cm->refcnt[idx] = 1;
+	cm->stamp[idx] = cm->clock;
+	cm->valid[idx] = true;
+
+	newport_cmap_setrgb(cm->dc, cm->base + idx, (rgb >> 16) & 0xff,
+	    (rgb >> 8) & 0xff, rgb & 0xff);
+
+	if (! cm->lut_stale)
+		newport_cmap_lut_add(cm, idx);
+	return (idx);
+}
+
+/**
+ * Drop a reference.  The entry keeps its colour (and keeps matching
+ * lookups) until it's evicted.
+ */
+void
+newport_cmap_release(struct newport_cmap *cm, int idx)
+{
+	if (idx < cm->first || idx >= cm->first + cm->count ||
+	    ! cm->valid[idx] || cm->refcnt[idx] == 0) {
+		printf("%s: releasing unreferenced entry %d\n", __func__, idx);
+		return;
+	}
+	cm->refcnt[idx]--;
+}
+
+/**
+ * Map n RGB888 pixels to CI8 through the lookup table.
+ */
+void
+newport_cmap_convert(struct newport_cmap *cm, const uint32_t *in,
+    uint8_t *out, int n)
+{
+	const uint8_t *lut;
+	int i;
+
+	if (cm->lut_stale)
+		newport_cmap_lut_rebuild(cm);
+	lut = cm->lut;
+
+	for (i = 0; i < n; i++)
+		out[i] = lut[newport_cmap_lut_index(in[i])];
+}
+
+struct newport_cmap_upload {
+	struct newport_cmap *cm;
+	const uint32_t *pixels;
+	int stride;
+	int wi;
+};
+
+static void
+newport_cmap_upload_row(void *arg, int y, uint8_t *row)
+{
+	struct newport_cmap_upload *cu = arg;
+
+	newport_cmap_convert(cu->cm, &cu->pixels[y * cu->stride], row,
+	    cu->wi);
+}
+
+/**
+ * Convert a (wi x he) RGB888 image to CI8 and upload it to (x1, y1).
+ */
+bool
+newport_cmap_upload_image(struct newport_cmap *cm, int x1, int y1, int wi,
+    int he, const uint32_t *pixels, int stride)
+{
+	struct newport_cmap_upload cu;
+
+	if (cm->dc->fb_mode != NewportBppModeCi8) {
+		printf("%s: fb mode %d isn't CI8\n", __func__,
+		    cm->dc->fb_mode);
+		return false;
+	}
+
+	cu.cm = cm;
+	cu.pixels = pixels;
+	cu.stride = stride;
+	cu.wi = wi;
+	return newport_upload_image_rows(cm->dc, x1, y1, wi, he,
+	    newport_cmap_upload_row, &cu);
+}
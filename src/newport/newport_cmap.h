@@ -0,0 +1,81 @@
+#ifndef	__NEWPORT_CMAP_H__
+#define	__NEWPORT_CMAP_H__
+
+#define	NEWPORT_CMAP_NENTRIES		256
+
+/* RGB -> index lookup table resolution; 5 bits per channel */
+#define	NEWPORT_CMAP_LUT_BITS		5
+#define	NEWPORT_CMAP_LUT_SIZE		\
+	(1 << (NEWPORT_CMAP_LUT_BITS * 3))
+
+/*
+ * A CI8 colour map manager.
+ *
+ * Entries are allocated for the colours an application actually uses
+ * and reference counted.  Released entries stay in the map (and keep
+ * matching lookups) until they're evicted, least recently allocated
+ * first, to make room for a new colour.
+ *
+ * The 32x32x32 lookup table maps an RGB colour to the nearest
+ * allocated entry with a single load.
+ */
+struct newport_cmap {
+	struct gfx_ctx *dc;
+
+	/* CMAP table base and the CI range this map manages */
+	uint32_t base;
+	int first;
+	int count;
+
+	uint32_t rgb[NEWPORT_CMAP_NENTRIES];
+	uint32_t refcnt[NEWPORT_CMAP_NENTRIES];
+	uint64_t stamp[NEWPORT_CMAP_NENTRIES];
+	bool valid[NEWPORT_CMAP_NENTRIES];
+	int nvalid;
+	uint64_t clock;
+
+	/* Nearest entry, and its squared distance, for each LUT cell */
+	uint8_t lut[NEWPORT_CMAP_LUT_SIZE];
+	uint32_t lut_dist[NEWPORT_CMAP_LUT_SIZE];
+	/* An entry was replaced; the LUT needs rebuilding from scratch */
+	bool lut_stale;
+
+	/* Counters */
+	uint64_t nallocs;
+	uint64_t nhits;
+	uint64_t nevictions;
+	uint64_t nfull;
+};
+
+static inline int
+newport_cmap_lut_index(uint32_t rgb)
+{
+	return (((rgb >> 19) & 0x1f) << 10) | (((rgb >> 11) & 0x1f) << 5) |
+	    ((rgb >> 3) & 0x1f);
+}
+
+extern	struct newport_cmap *newport_cmap_create(struct gfx_ctx *dc,
+	    uint32_t base, int first, int count);
+extern	void newport_cmap_destroy(struct newport_cmap *cm);
+
+extern	int newport_cmap_alloc(struct newport_cmap *cm, uint32_t rgb);
+extern	void newport_cmap_release(struct newport_cmap *cm, int idx);
+extern	void newport_cmap_lut_rebuild(struct newport_cmap *cm);
+
+/*
+ * Nearest allocated entry for an RGB888 colour.
+ */
+static inline uint8_t
+newport_cmap_lookup(struct newport_cmap *cm, uint32_t rgb)
+{
+	if (cm->lut_stale)
+		newport_cmap_lut_rebuild(cm);
+	return (cm->lut[newport_cmap_lut_index(rgb)]);
+}
+
+extern	void newport_cmap_convert(struct newport_cmap *cm,
+	    const uint32_t *in, uint8_t *out, int n);
+extern	bool newport_cmap_upload_image(struct newport_cmap *cm, int x1,
+	    int y1, int wi, int he, const uint32_t *pixels, int stride);
+
+#endif	/* __NEWPORT_CMAP_H__ */
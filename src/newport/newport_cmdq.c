@@ -0,0 +1,344 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <strings.h>
+#include <sched.h>
+#include <errno.h>
+#include <err.h>
+
+#include "newport_regs.h"
+#include "newport_ctx.h"
+#include "newport_regio.h"
+#include "newport_hwops.h"
+#include "newport_ops.h"
+#include "newport_cmdq.h"
+#include "newport_stats.h"
+
+/*
+ * Multi-producer single-consumer drawing command queue.
+ *
+ * This is a bounded ring of slots, each with its own sequence number
+ * (the scheme from Dmitry Vyukov's bounded MPMC queue, with the
+ * consumer side simplified since there's only one.)
+ *
+ * + A producer claims a slot by CAS'ing enq_pos forward, fills in the
+ *   command and then publishes it by storing seq = pos + 1.
+ * + The submitter only ever looks at the slot at deq_pos; if it's not
+ *   yet published it stops there, so commands are submitted in the
+ *   order their slots were claimed.  Since a single thread claims its
+ *   slots in program order, per-producer ordering is preserved.
+ * + Once the submitter has copied a command out, it recycles the slot
+ *   by storing seq = pos + nslots.
+ *
+ * Only the submitter thread touches the gfx_ctx, so none of the
+ * drawing code needs to know about threads.
+ */
+
+#define	NEWPORT_CMDQ_SPIN	128
+
+struct newport_cmdq *
+newport_cmdq_create(struct gfx_ctx *dc, int nslots)
+{
+	struct newport_cmdq *q;
+	uint64_t i, n;
+
+	/* Round up to a power of two */
+	for (n = 2; n < (uint64_t) nslots; n <<= 1)
+		;
+
+	q = calloc(1, sizeof(*q));
+	if (q == NULL)
+		return NULL;
+	q->slots = calloc(n, sizeof(struct newport_cmdq_slot));
+	if (q->slots == NULL) {
+		free(q);
+		return NULL;
+	}
+
+	q->dc = dc;
+	q->mask = n - 1;
+	q->batch_size = 64;
+	q->last_type = NewportCmdNone;
+	for (i = 0; i < n; i++)
+		atomic_init(&q->slots[i].seq, i);
+	atomic_init(&q->enq_pos, 0);
+	atomic_init(&q->done_pos, 0);
+	atomic_init(&q->stop, false);
+	q->deq_pos = 0;
+
+	return q;
+}
+
+void
+newport_cmdq_destroy(struct newport_cmdq *q)
+{
+	if (q == NULL)
+		return;
+	if (q->thread_running)
+		newport_cmdq_stop(q);
+	free(q->slots);
+	free(q);
+}
+
+/*
+ * Try to enqueue a command.  Returns false if the queue is full.
+ *
+ * This is safe to call from any number of threads.
+ */
+bool
+newport_cmdq_try_enqueue(struct newport_cmdq *q, const struct newport_cmd *cmd)
+{
+	struct newport_cmdq_slot *slot;
+	uint64_t pos, seq;
+	int64_t dif;
+
+	pos = atomic_load_explicit(&q->enq_pos, memory_order_relaxed);
+	for (;;) {
+		slot = &q->slots[pos & q->mask];
+		seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+		dif = (int64_t) seq - (int64_t) pos;
+		if (dif == 0) {
+			if (atomic_compare_exchange_weak_explicit(&q->enq_pos,
+			    &pos, pos + 1, memory_order_relaxed,
+			    memory_order_relaxed))
+				break;
+		} else if (dif < 0) {
+			/* The submitter hasn't recycled this slot yet */
+			return false;
+		} else {
+			pos = atomic_load_explicit(&q->enq_pos,
+			    memory_order_relaxed);
+		}
+	}
+
+	slot->cmd = *cmd;
+	atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+	return true;
+}
+
+/*
+ * Enqueue a command, waiting for the submitter if the queue is full.
+ */
+void
+newport_cmdq_enqueue(struct newport_cmdq *q, const struct newport_cmd *cmd)
+{
+	int spin = 0;
+
+	while (! newport_cmdq_try_enqueue(q, cmd)) {
+		if (++spin < NEWPORT_CMDQ_SPIN)
+			continue;
+		/* XXX ew; same as rex3_wait_gfifo() */
+		sched_yield();
+	}
+}
+
+void
+newport_cmdq_fill(struct newport_cmdq *q, int x, int y, int w, int h,
+    uint32_t color)
+{
+	struct newport_cmd cmd;
+
+	cmd.type = NewportCmdFill;
+	cmd.fill.x = x;
+	cmd.fill.y = y;
+	cmd.fill.w = w;
+	cmd.fill.h = h;
+	cmd.fill.color = color;
+	newport_cmdq_enqueue(q, &cmd);
+}
+
+void
+newport_cmdq_blit(struct newport_cmdq *q, int xs, int ys, int xd, int yd,
+    int w, int h, uint32_t rop)
+{
+	struct newport_cmd cmd;
+
+	cmd.type = NewportCmdBlit;
+	cmd.blit.xs = xs;
+	cmd.blit.ys = ys;
+	cmd.blit.xd = xd;
+	cmd.blit.yd = yd;
+	cmd.blit.w = w;
+	cmd.blit.h = h;
+	cmd.blit.rop = rop;
+	newport_cmdq_enqueue(q, &cmd);
+}
+
+void
+newport_cmdq_upload(struct newport_cmdq *q, int x, int y, int w, int h,
+    const uint32_t *pixels, int stride, newport_cmd_done_cb *done_cb,
+    void *done_arg)
+{
+	struct newport_cmd cmd;
+
+	cmd.type = NewportCmdUpload;
+	cmd.upload.x = x;
+	cmd.upload.y = y;
+	cmd.upload.w = w;
+	cmd.upload.h = h;
+	cmd.upload.pixels = pixels;
+	cmd.upload.stride = stride;
+	cmd.upload.done_cb = done_cb;
+	cmd.upload.done_arg = done_arg;
+	newport_cmdq_enqueue(q, &cmd);
+}
+
+/*
+ * Run a single command on the hardware.
+ *
+ * Back to back fills share a single newport_fill_rectangle_setup();
+ * anything else reprograms DRAWMODE0/DRAWMODE1 so the next fill
+ * has to set them up again.
+ */
+static void
+newport_cmdq_run(struct newport_cmdq *q, const struct newport_cmd *cmd)
+{
+	struct gfx_ctx *dc = q->dc;
+
+	switch (cmd->type) {
+	case NewportCmdFill:
+		if (q->last_type != NewportCmdFill)
+			newport_fill_rectangle_setup(dc);
+		newport_fill_rectangle(dc, cmd->fill.x, cmd->fill.y,
+		    cmd->fill.w, cmd->fill.h, cmd->fill.color);
+		break;
+	case NewportCmdBlit:
+		newport_bitblt(dc, cmd->blit.xs, cmd->blit.ys,
+		    cmd->blit.xd, cmd->blit.yd, cmd->blit.w, cmd->blit.h,
+		    cmd->blit.rop);
+		break;
+	case NewportCmdUpload:
+		newport_upload_image(dc, cmd->upload.x, cmd->upload.y,
+		    cmd->upload.w, cmd->upload.h, cmd->upload.pixels,
+		    cmd->upload.stride);
+		if (cmd->upload.done_cb != NULL)
+			cmd->upload.done_cb(cmd->upload.done_arg);
+		break;
+	default:
+		printf("%s: unknown command type (%d)\n", __func__,
+		    cmd->type);
+		return;
+	}
+	q->last_type = cmd->type;
+}
+
+/*
+ * Run up to batch_size published commands.  Returns how many were run.
+ *
+ * This must only be called from the submitter.
+ */
+int
+newport_cmdq_drain(struct newport_cmdq *q)
+{
+	struct newport_cmdq_slot *slot;
+	struct newport_cmd cmd;
+	uint64_t pos;
+	int n;
+
+	for (n = 0; n < q->batch_size; n++) {
+		pos = q->deq_pos;
+		slot = &q->slots[pos & q->mask];
+		if (atomic_load_explicit(&slot->seq, memory_order_acquire) !=
+		    pos + 1)
+			break;
+
+		/* Copy it out so the slot can be recycled straight away */
+		cmd = slot->cmd;
+		atomic_store_explicit(&slot->seq, pos + q->mask + 1,
+		    memory_order_release);
+		q->deq_pos = pos + 1;
+
+		newport_cmdq_run(q, &cmd);
+	}
+
+	if (n > 0)
+		atomic_store_explicit(&q->done_pos, q->deq_pos,
+		    memory_order_release);
+	return (n);
+}
+
+/*
+ * Wait until everything enqueued before this call has been
+ * submitted to the hardware.
+ *
+ * This only waits for submission; it doesn't wait for the REX3
+ * to finish drawing.
+ */
+void
+newport_cmdq_flush(struct newport_cmdq *q)
+{
+	uint64_t target;
+
+	target = atomic_load_explicit(&q->enq_pos, memory_order_acquire);
+
+	if (! q->thread_running) {
+		while (atomic_load_explicit(&q->done_pos,
+		    memory_order_acquire) < target)
+			newport_cmdq_drain(q);
+		return;
+	}
+
+	while (atomic_load_explicit(&q->done_pos, memory_order_acquire) <
+	    target)
+		sched_yield();
+}
+
+static void *
+newport_cmdq_thread(void *arg)
+{
+	struct newport_cmdq *q = arg;
+	int idle = 0;
+
+	for (;;) {
+		newport_stats_poll(q->dc);
+
+		if (newport_cmdq_drain(q) > 0) {
+			idle = 0;
+			continue;
+		}
+
+		/* Only exit once everything published has been run */
+		if (atomic_load_explicit(&q->stop, memory_order_acquire) &&
+		    q->deq_pos == atomic_load_explicit(&q->enq_pos,
+		    memory_order_acquire))
+			break;
+
+		if (++idle >= NEWPORT_CMDQ_SPIN)
+			sched_yield();
+	}
+	return (NULL);
+}
+
+/*
+ * Start the submitter thread.  From here on only the submitter
+ * may touch the gfx_ctx until newport_cmdq_stop() is called.
+ */
+bool
+newport_cmdq_start(struct newport_cmdq *q)
+{
+	int ret;
+
+	atomic_store(&q->stop, false);
+	ret = pthread_create(&q->thread, NULL, newport_cmdq_thread, q);
+	if (ret != 0) {
+		errno = ret;
+		warn("%s: pthread_create", __func__);
+		return false;
+	}
+	q->thread_running = true;
+	return true;
+}
+
+/*
+ * Stop the submitter thread once the queue has drained.
+ */
+void
+newport_cmdq_stop(struct newport_cmdq *q)
+{
+	if (! q->thread_running)
+		return;
+	atomic_store_explicit(&q->stop, true, memory_order_release);
+	pthread_join(q->thread, NULL);
+	q->thread_running = false;
+}
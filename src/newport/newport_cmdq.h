@@ -0,0 +1,95 @@
+#ifndef	__NEWPORT_CMDQ_H__
+#define	__NEWPORT_CMDQ_H__
+
+#include <stdatomic.h>
+#include <pthread.h>
+
+typedef enum {
+	NewportCmdNone = 0,
+	NewportCmdFill = 1,
+	NewportCmdBlit = 2,
+	NewportCmdUpload = 3,
+} NewportCmdType;
+
+typedef void newport_cmd_done_cb(void *arg);
+
+struct newport_cmd {
+	NewportCmdType type;
+	union {
+		struct {
+			int x, y, w, h;
+			uint32_t color;
+		} fill;
+		struct {
+			int xs, ys, xd, yd, w, h;
+			uint32_t rop;
+		} blit;
+		struct {
+			int x, y, w, h;
+			/* Must stay valid until done_cb is called */
+			const uint32_t *pixels;
+			int stride;
+			newport_cmd_done_cb *done_cb;
+			void *done_arg;
+		} upload;
+	};
+};
+
+struct newport_cmdq_slot {
+	_Atomic uint64_t seq;
+	struct newport_cmd cmd;
+};
+
+/*
+ * A bounded multi-producer, single-consumer command queue.
+ *
+ * Any number of threads may enqueue commands; exactly one thread
+ * (the submitter) owns the gfx_ctx and drains the queue.
+ */
+struct newport_cmdq {
+	struct gfx_ctx *dc;
+
+	struct newport_cmdq_slot *slots;
+	uint64_t mask;
+
+	/* Producer side; claimed with CAS */
+	_Atomic uint64_t enq_pos __attribute__((aligned(64)));
+
+	/* Consumer side; only touched by the submitter */
+	uint64_t deq_pos __attribute__((aligned(64)));
+	NewportCmdType last_type;
+
+	/* Number of commands fully submitted to the hardware */
+	_Atomic uint64_t done_pos __attribute__((aligned(64)));
+
+	/* Maximum number of commands to run before publishing done_pos */
+	int batch_size;
+
+	pthread_t thread;
+	bool thread_running;
+	atomic_bool stop;
+};
+
+extern	struct newport_cmdq *newport_cmdq_create(struct gfx_ctx *dc,
+	    int nslots);
+extern	void newport_cmdq_destroy(struct newport_cmdq *q);
+
+extern	bool newport_cmdq_try_enqueue(struct newport_cmdq *q,
+	    const struct newport_cmd *cmd);
+extern	void newport_cmdq_enqueue(struct newport_cmdq *q,
+	    const struct newport_cmd *cmd);
+extern	void newport_cmdq_fill(struct newport_cmdq *q, int x, int y,
+	    int w, int h, uint32_t color);
+extern	void newport_cmdq_blit(struct newport_cmdq *q, int xs, int ys,
+	    int xd, int yd, int w, int h, uint32_t rop);
+extern	void newport_cmdq_upload(struct newport_cmdq *q, int x, int y,
+	    int w, int h, const uint32_t *pixels, int stride,
+	    newport_cmd_done_cb *done_cb, void *done_arg);
+
+extern	int newport_cmdq_drain(struct newport_cmdq *q);
+extern	void newport_cmdq_flush(struct newport_cmdq *q);
+
+extern	bool newport_cmdq_start(struct newport_cmdq *q);
+extern	void newport_cmdq_stop(struct newport_cmdq *q);
+
+#endif	/* __NEWPORT_CMDQ_H__ */
@@ -9,6 +9,7 @@ typedef enum {
 	NewportBppModeRgb12 = 2,
 	NewportBppModeRgb24 = 3,
 	NewportBppModeCi8 = 4,
+	NewportBppModeCi4 = 5,
 } NewportBppMode;
 
 typedef enum {
@@ -17,6 +18,61 @@ typedef enum {
 	NewportDoubleBufferB = 2,
 } NewportDoubleBufferMode;
 
+/* REX3 register classes, for the register IO counters */
+typedef enum {
+	NewportRegClassMode = 0,	/* DRAWMODE*, patterns, STALL0, SETUP */
+	NewportRegClassCoord = 1,	/* X/Y start, end, move */
+	NewportRegClassColor = 2,	/* colour iterators, WRMASK, COLORI */
+	NewportRegClassHostRW = 3,	/* HOSTRW0/1 pixel data */
+	NewportRegClassDcb = 4,		/* DCBMODE / DCBDATA */
+	NewportRegClassConfig = 5,	/* clipping, CONFIG, STATUS, ... */
+	NewportRegClassMax = 6,
+} NewportRegClass;
+
+/* Primitive types, for the primitive / pixel counters */
+typedef enum {
+	NewportPrimFill = 0,
+	NewportPrimSpan = 1,
+	NewportPrimLine = 2,
+	NewportPrimBlit = 3,
+	NewportPrimUpload = 4,
+	NewportPrimMax = 5,
+} NewportPrim;
+
+/*
+ * Performance counters.  These are plain increments on the paths
+ * that already touch the hardware; anything needing a timestamp is
+ * only done once we know we're going to have to wait anyway.
+ */
+struct newport_stats {
+	uint64_t reg_writes[NewportRegClassMax];
+	uint64_t reg_reads[NewportRegClassMax];
+	/* Writes with the GO bit set */
+	uint64_t go_writes;
+
+	/* GFIFO reservations; how many had to poll, and for how long */
+	uint64_t gfifo_waits;
+	uint64_t gfifo_stalls;
+	uint64_t gfifo_stall_ns;
+	/* Waits for the whole pipeline to go idle */
+	uint64_t gfifo_idle_waits;
+	uint64_t gfifo_idle_ns;
+	uint64_t bfifo_waits;
+
+	/* Fences emitted, and waits that found theirs still pending */
+	uint64_t fence_emits;
+	uint64_t fence_stalls;
+	uint64_t fence_stall_ns;
+
+	/* DCB transactions (DCBMODE writes) */
+	uint64_t dcb_xfers;
+
+	uint64_t prims[NewportPrimMax];
+	uint64_t pixels[NewportPrimMax];
+};
+
+struct newport_sim;
+
 struct gfx_ctx {
 	int fd;
 	void *addr;
@@ -38,8 +94,17 @@ struct gfx_ctx {
 
 	bool log_regio;
 
+	/* If not NULL, register IO goes to an in-memory REX3 model */
+	struct newport_sim *sim;
+
 	/* how many entries are in the FIFO */
 	int gfifo_left;
+
+	/* Last fence emitted, and last one known to have completed */
+	uint64_t fence_seq;
+	uint64_t fence_done;
+
+	struct newport_stats stats;
 };
 
 #endif	/* __NEWPORT_CTX_H__ */
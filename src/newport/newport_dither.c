@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <strings.h>
+
+#include <sys/param.h>
+
+#include "newport_regs.h"
+#include "newport_ctx.h"
+#include "newport_ops.h"
+#include "newport_dither.h"
+
+/*
+ * RGB888 -> 8 bit dithering for image uploads.
+ *
+ * DRAW operations get the REX3's own dither when drawing into an
+ * 8 bit RGB framebuffer, but host pixels pushed through HOSTRW
+ * don't, so uploads are dithered here and written as raw 8 bit
+ * framebuffer pixels.
+ *
+ * The Indy's MIPS CPUs don't have a SIMD unit, so the ordered
+ * dither works on all three channels of a pixel at once in a
+ * 32 bit word (a per-byte saturating add of a packed threshold),
+ * a row at a time, with the threshold pattern for the row hoisted
+ * out of the loop.
+ */
+
+/* 4x4 Bayer matrix */
+static const uint8_t newport_dither_bayer[4][4] = {
+	{  0,  8,  2, 10 },
+	{ 12,  4, 14,  6 },
+	{  3, 11,  1,  9 },
+	{ 15,  7, 13,  5 },
+};
+
+/*
+ * The same, scaled to each channel's quantisation step (32 for the
+ * 3 bit red / green, 64 for the 2 bit blue) and packed as 0x00RRGGBB.
+ */
+#define	NEWPORT_DITHER_T(n)	\
+	(((n) * 2) << 16 | ((n) * 2) << 8 | ((n) * 4))
+
+static const uint32_t newport_dither_thresh[4][4] = {
+	{ NEWPORT_DITHER_T(0), NEWPORT_DITHER_T(8),
+	  NEWPORT_DITHER_T(2), NEWPORT_DITHER_T(10) },
+	{ NEWPORT_DITHER_T(12), NEWPORT_DITHER_T(4),
+	  NEWPORT_DITHER_T(14), NEWPORT_DITHER_T(6) },
+	{ NEWPORT_DITHER_T(3), NEWPORT_DITHER_T(11),
+	  NEWPORT_DITHER_T(1), NEWPORT_DITHER_T(9) },
+	{ NEWPORT_DITHER_T(15), NEWPORT_DITHER_T(7),
+	  NEWPORT_DITHER_T(13), NEWPORT_DITHER_T(5) },
+};
+
+/* RGB332 -> interleaved framebuffer RGB8 */
+static uint8_t newport_dither_fb332[256];
+static bool newport_dither_fb332_valid = false;
+
+static void
+newport_dither_setup(void)
+{
+	uint32_t rgb;
+	int v;
+
+	if (newport_dither_fb332_valid)
+		return;
+
+	for (v = 0; v < 256; v++) {
+		rgb = ((v & 0xe0) << 16) | ((v & 0x1c) << 11) |
+		    ((v & 0x03) << 6);
+		newport_dither_fb332[v] =
+		    newport_calc_rgb888_to_fb_rgb332(rgb);
+	}
+	newport_dither_fb332_valid = true;
+}
+
+/*
+ * Per-byte saturating add of two 0x00RRGGBB words.
+ */
+static inline uint32_t
+newport_dither_addsat(uint32_t p, uint32_t t)
+{
+	uint32_t s, o;
+
+	s = ((p & 0x7f7f7f) + (t & 0x7f7f7f)) ^ ((p ^ t) & 0x808080);
+	o = ((p & t) | ((p | t) & ~s)) & 0x808080;
+	return (s | ((o >> 7) * 0xff));
+}
+
+static inline uint8_t
+newport_dither_pack332(uint32_t s)
+{
+	return ((s >> 16) & 0xe0) | ((s >> 11) & 0x1c) | ((s >> 6) & 0x03);
+}
+
+/* Expand a quantised channel back out the same way the CI cmap does */
+static inline int
+newport_dither_expand3(int q)
+{
+	return ((q << 5) | (q << 2) | (q >> 1));
+}
+
+static inline int
+newport_dither_expand2(int q)
+{
+	return (q * 0x55);
+}
+
+/**
+ * Ordered dither a single pixel.  This is the straightforward
+ * per-channel version of what newport_dither_row() does.
+ */
+uint8_t
+newport_dither_pixel(uint32_t rgb, int x, int y, NewportDitherFmt fmt)
+{
+	int t, r, g, b;
+	uint8_t v;
+
+	newport_dither_setup();
+
+	t = newport_dither_bayer[y & 3][x & 3];
+	r = MIN(((rgb >> 16) & 0xff) + t * 2, 255);
+	g = MIN(((rgb >> 8) & 0xff) + t * 2, 255);
+	b = MIN((rgb & 0xff) + t * 4, 255);
+
+	v = (r & 0xe0) | ((g & 0xe0) >> 3) | ((b & 0xc0) >> 6);
+	if (fmt == NewportDitherFmtFbRgb332)
+		return (newport_dither_fb332[v]);
+	return (v);
+}
+
+/**
+ * Ordered dither n RGB888 pixels starting at (x, y) to 8 bit pixels.
+ */
+void
+newport_dither_row(const uint32_t *in, uint8_t *out, int n, int x, int y,
+    NewportDitherFmt fmt)
+{
+	const uint32_t *row = newport_dither_thresh[y & 3];
+	const uint32_t t0 = row[x & 3], t1 = row[(x + 1) & 3];
+	const uint32_t t2 = row[(x + 2) & 3], t3 = row[(x + 3) & 3];
+	const uint8_t *lut = newport_dither_fb332;
+	int i;
+
+	newport_dither_setup();
+
+#define	NEWPORT_DITHER_PIX(i, t)					\
+	newport_dither_pack332(newport_dither_addsat((in[i]) & 0xffffff, t))
+
+	if (fmt == NewportDitherFmtFbRgb332) {
+		for (i = 0; i + 4 <= n; i += 4) {
+			out[i] = lut[NEWPORT_DITHER_PIX(i, t0)];
+			out[i + 1] = lut[NEWPORT_DITHER_PIX(i + 1, t1)];
+			out[i + 2] = lut[NEWPORT_DITHER_PIX(i + 2, t2)];
+			out[i + 3] = lut[NEWPORT_DITHER_PIX(i + 3, t3)];
+		}
+		for (; i < n; i++)
+			out[i] = lut[NEWPORT_DITHER_PIX(i, row[(x + i) & 3])];
+	} else {
+		for (i = 0; i + 4 <= n; i += 4) {
+			out[i] = NEWPORT_DITHER_PIX(i, t0);
+			out[i + 1] = NEWPORT_DITHER_PIX(i + 1, t1);
+			out[i + 2] = NEWPORT_DITHER_PIX(i + 2, t2);
+			out[i + 3] = NEWPORT_DITHER_PIX(i + 3, t3);
+		}
+		for (; i < n; i++)
+			out[i] = NEWPORT_DITHER_PIX(i, row[(x + i) & 3]);
+	}
+#undef	NEWPORT_DITHER_PIX
+}
+
+bool
+newport_dither_fs_init(struct newport_dither_fs *fs, int width)
+{
+	fs->width = width;
+	fs->err_cur = calloc((width + 2) * 3, sizeof(int16_t));
+	fs->err_next = calloc((width + 2) * 3, sizeof(int16_t));
+	if (fs->err_cur == NULL || fs->err_next == NULL) {
+		newport_dither_fs_free(fs);
+		return false;
+	}
+	return true;
+}
+
+void
+newport_dither_fs_free(struct newport_dither_fs *fs)
+{
+	free(fs->err_cur);
+	free(fs->err_next);
+	fs->err_cur = fs->err_next = NULL;
+}
+
+/**
+ * Floyd-Steinberg dither the next row of a fs->width wide image.
+ * Errors are kept in 1/16ths.
+ */
+void
+newport_dither_row_fs(struct newport_dither_fs *fs, const uint32_t *in,
+    uint8_t *out, NewportDitherFmt fmt)
+{
+	int16_t *ec, *en, *tmp;
+	int x, c, v, q, e, val[3];
+
+	newport_dither_setup();
+
+	for (x = 0; x < fs->width; x++) {
+		ec = &fs->err_cur[(x + 1) * 3];
+		en = &fs->err_next[(x + 1) * 3];
+		for (c = 0; c < 3; c++) {
+			v = (in[x] >> (16 - c * 8)) & 0xff;
+			v += ec[c] / 16;
+			v = MAX(0, MIN(255, v));
+			if (c < 2) {
+				q = v >> 5;
+				e = v - newport_dither_expand3(q);
+			} else {
+				q = v >> 6;
+				e = v - newport_dither_expand2(q);
+			}
+			val[c] = q;
+
+			ec[c + 3] += e * 7;
+			en[c - 3] += e * 3;
+			en[c] += e * 5;
+			en[c + 3] += e;
+		}
+		v = (val[0] << 5) | (val[1] << 2) | val[2];
+		out[x] = (fmt == NewportDitherFmtFbRgb332) ?
+		    newport_dither_fb332[v] : v;
+	}
+
+	tmp = fs->err_cur;
+	fs->err_cur = fs->err_next;
+	fs->err_next = tmp;
+	bzero(fs->err_next, (fs->width + 2) * 3 * sizeof(int16_t));
+}
+
+struct newport_dither_upload {
+	const uint32_t *pixels;
+	int stride;
+	int x1, y1, wi;
+	NewportDitherFmt fmt;
+	NewportDitherMethod method;
+	struct newport_dither_fs fs;
+};
+
+static void
+newport_dither_upload_row(void *arg, int y, uint8_t *row)
+{
+	struct newport_dither_upload *du = arg;
+
+	if (du->method == NewportDitherDiffuse)
+		newport_dither_row_fs(&du->fs, &du->pixels[y * du->stride],
+		    row, du->fmt);
+	else
+		newport_dither_row(&du->pixels[y * du->stride], row, du->wi,
+		    du->x1, du->y1 + y, du->fmt);
+}
+
+/**
+ * Dither a (wi x he) RGB888 image down to 8 bits and upload it to
+ * (x1, y1).
+ *
+ * This only makes sense for the 8 bit framebuffer modes: fb_mode Rgb8
+ * gets native interleaved RGB8 pixels, fb_mode Ci8 gets indexes into
+ * the RGB332 CI table.  The rows are dithered as they're pushed out
+ * by newport_upload_image_rows().
+ */
+bool
+newport_upload_image_dither(struct gfx_ctx *dc, int x1, int y1, int wi,
+    int he, const uint32_t *pixels, int stride, NewportDitherMethod method)
+{
+	struct newport_dither_upload du;
+	bool ret;
+
+	switch (dc->fb_mode) {
+	case NewportBppModeRgb8:
+		du.fmt = NewportDitherFmtFbRgb332;
+		break;
+	case NewportBppModeCi8:
+		du.fmt = NewportDitherFmtCi332;
+		break;
+	default:
+		printf("%s: fb mode %d isn't an 8 bit mode\n", __func__,
+		    dc->fb_mode);
+		return false;
+	}
+
+	if (wi <= 0 || he <= 0)
+		return true;
+
+	du.pixels = pixels;
+	du.stride = stride;
+	du.x1 = x1;
+	du.y1 = y1;
+	du.wi = wi;
+	du.method = method;
+	if (method == NewportDitherDiffuse &&
+	    ! newport_dither_fs_init(&du.fs, wi))
+		return false;
+
+	ret = newport_upload_image_rows(dc, x1, y1, wi, he,
+	    newport_dither_upload_row, &du);
+
+	if (method == NewportDitherDiffuse)
+		newport_dither_fs_free(&du.fs);
+	return ret;
+}
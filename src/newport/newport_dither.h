@@ -0,0 +1,44 @@
+#ifndef	__NEWPORT_DITHER_H__
+#define	__NEWPORT_DITHER_H__
+
+/* 8 bit output pixel formats */
+typedef enum {
+	/* Native interleaved 8 bit RGB framebuffer pixels (fb_mode Rgb8) */
+	NewportDitherFmtFbRgb332 = 0,
+	/* RGB332 indexes into the CI table from newport_setup_hw_ci_cmap() */
+	NewportDitherFmtCi332 = 1,
+} NewportDitherFmt;
+
+typedef enum {
+	/* 4x4 Bayer ordered dither */
+	NewportDitherOrdered = 0,
+	/* Floyd-Steinberg error diffusion; serial, so slower */
+	NewportDitherDiffuse = 1,
+} NewportDitherMethod;
+
+/*
+ * Error diffusion state, carried from one row to the next.
+ * Per channel errors for the current and next row, with a guard
+ * pixel either side.
+ */
+struct newport_dither_fs {
+	int width;
+	int16_t *err_cur;
+	int16_t *err_next;
+};
+
+extern	uint8_t newport_dither_pixel(uint32_t rgb, int x, int y,
+	    NewportDitherFmt fmt);
+extern	void newport_dither_row(const uint32_t *in, uint8_t *out, int n,
+	    int x, int y, NewportDitherFmt fmt);
+
+extern	bool newport_dither_fs_init(struct newport_dither_fs *fs, int width);
+extern	void newport_dither_fs_free(struct newport_dither_fs *fs);
+extern	void newport_dither_row_fs(struct newport_dither_fs *fs,
+	    const uint32_t *in, uint8_t *out, NewportDitherFmt fmt);
+
+extern	bool newport_upload_image_dither(struct gfx_ctx *dc, int x1, int y1,
+	    int wi, int he, const uint32_t *pixels, int stride,
+	    NewportDitherMethod method);
+
+#endif	/* __NEWPORT_DITHER_H__ */
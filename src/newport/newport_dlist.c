@@ -0,0 +1,390 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <strings.h>
+
+#include <sys/param.h>
+
+#include "newport_regs.h"
+#include "newport_ctx.h"
+#include "newport_regio.h"
+#include "newport_hwops.h"
+#include "newport_ops.h"
+#include "newport_fence.h"
+#include "newport_dlist.h"
+
+/*
+ * Display lists.
+ *
+ * Recording an operation works out the exact register writes the
+ * immediate mode call would do (using the gfx_ctx pixel modes at
+ * record time), drops state register writes that wouldn't change
+ * anything, and appends the rest to the list.
+ *
+ * Replaying is then just reserving FIFO space a FIFO's worth at a
+ * time and writing the registers out.  The list is self contained -
+ * the first write to each state register is always recorded - but
+ * it leaves the REX3 in whatever state the last operation needed,
+ * so callers have to redo e.g. newport_fill_rectangle_setup()
+ * before going back to immediate mode fills.
+ *
+ * If memory runs out the list is marked as such and records nothing
+ * more; room for a whole operation is made before any of it is
+ * recorded, so the list never holds half an operation.  Replaying a
+ * list that ran out of memory does nothing.
+ */
+
+#define	NEWPORT_DLIST_FILL_DRAWMODE1		\
+	(REX3_DRAWMODE1_PLANES_RGB |		\
+	 REX3_DRAWMODE1_COMPARE_LT |		\
+	 REX3_DRAWMODE1_COMPARE_EQ |		\
+	 REX3_DRAWMODE1_COMPARE_GT)
+
+/* Most register writes any one operation records */
+#define	NEWPORT_DLIST_OP_WRITES			8
+
+static int
+newport_dlist_state_slot(uint32_t rexreg)
+{
+	switch (rexreg) {
+	case REX3_REG_DRAWMODE0:
+		return (0);
+	case REX3_REG_DRAWMODE1:
+		return (1);
+	case REX3_REG_WRMASK:
+		return (2);
+	case REX3_REG_CLIPMODE:
+		return (3);
+	case REX3_REG_COLORI:
+		return (4);
+	case REX3_REG_COLORVRAM:
+		return (5);
+	case REX3_REG_COLORBACK:
+		return (6);
+	case REX3_REG_ZPATTERN:
+		return (7);
+	default:
+		return (-1);
+	}
+}
+
+struct newport_dlist *
+newport_dlist_create(struct gfx_ctx *dc)
+{
+	struct newport_dlist *dl;
+
+	dl = calloc(1, sizeof(*dl));
+	if (dl == NULL)
+		return NULL;
+	dl->dc = dc;
+	return dl;
+}
+
+void
+newport_dlist_destroy(struct newport_dlist *dl)
+{
+	if (dl == NULL)
+		return;
+	free(dl->regs);
+	free(dl->vals);
+	free(dl);
+}
+
+/*
+ * Empty the list, keeping its storage around for re-recording.
+ */
+void
+newport_dlist_reset(struct newport_dlist *dl)
+{
+	dl->count = 0;
+	dl->state_valid = 0;
+	dl->nops = 0;
+	dl->nrejected = 0;
+	dl->nomem = false;
+}
+
+static bool
+newport_dlist_grow(struct newport_dlist *dl, int n)
+{
+	uint16_t *regs;
+	uint32_t *vals;
+	int size;
+
+	if (dl->count + n <= dl->size)
+		return true;
+
+	size = MAX(dl->size * 2, 256);
+	while (size < dl->count + n)
+		size *= 2;
+
+	regs = realloc(dl->regs, size * sizeof(uint16_t));
+	if (regs == NULL)
+		goto nomem;
+	dl->regs = regs;
+	vals = realloc(dl->vals, size * sizeof(uint32_t));
+	if (vals == NULL)
+		goto nomem;
+	dl->vals = vals;
+	dl->size = size;
+	return true;
+
+nomem:
+	if (! dl->nomem)
+		printf("%s: out of memory\n", __func__);
+	dl->nomem = true;
+	return false;
+}
+
+/*
+ * Make room for a whole operation.  Once the list has run out of
+ * memory this always fails, so nothing after the failure is recorded.
+ */
+static bool
+newport_dlist_begin(struct newport_dlist *dl)
+{
+	if (dl->nomem)
+		return false;
+	return newport_dlist_grow(dl, NEWPORT_DLIST_OP_WRITES);
+}
+
+/*
+ * Record a register write.  Writes to tracked state registers
+ * that don't change the value are dropped.
+ */
+void
+newport_dlist_write_reg(struct newport_dlist *dl, uint32_t rexreg,
+    uint32_t val)
+{
+	int slot;
+
+	if (dl->nomem)
+		return;
+	slot = newport_dlist_state_slot(rexreg);
+	if (slot >= 0 && (dl->state_valid & (1U << slot)) &&
+	    dl->state_val[slot] == val)
+		return;
+	/* Only remember the state once the write is really recorded */
+	if (! newport_dlist_grow(dl, 1))
+		return;
+	if (slot >= 0) {
+		dl->state_valid |= (1U << slot);
+		dl->state_val[slot] = val;
+	}
+	dl->regs[dl->count] = rexreg;
+	dl->vals[dl->count] = val;
+	dl->count++;
+}
+
+void
+newport_dlist_set_wrmask(struct newport_dlist *dl, uint32_t planemask)
+{
+	newport_dlist_write_reg(dl, REX3_REG_WRMASK,
+	    newport_calc_wrmode(dl->dc, planemask));
+}
+
+void
+newport_dlist_set_clipmode(struct newport_dlist *dl, uint32_t clipmode)
+{
+	newport_dlist_write_reg(dl, REX3_REG_CLIPMODE, clipmode);
+}
+
+/*
+ * Make sure the list sets up the write mask and clip mode before the
+ * first drawing operation, the same way newport_fill_rectangle_setup()
+ * does.
+ */
+static void
+newport_dlist_default_state(struct newport_dlist *dl)
+{
+	if ((dl->state_valid &
+	    (1U << newport_dlist_state_slot(REX3_REG_CLIPMODE))) == 0)
+		newport_dlist_set_clipmode(dl, 0x1e00);
+	if ((dl->state_valid &
+	    (1U << newport_dlist_state_slot(REX3_REG_WRMASK))) == 0)
+		newport_dlist_set_wrmask(dl, 0xffffffff);
+}
+
+static inline bool
+newport_dlist_coord_ok(int x, int y)
+{
+	return (x >= 0 && x <= NEWPORT_DLIST_COORD_MAX &&
+	    y >= 0 && y <= NEWPORT_DLIST_COORD_MAX);
+}
+
+static bool
+newport_dlist_check(struct newport_dlist *dl, int x1, int y1, int x2, int y2)
+{
+	if (newport_dlist_coord_ok(x1, y1) && newport_dlist_coord_ok(x2, y2))
+		return true;
+	dl->nrejected++;
+	return false;
+}
+
+void
+newport_dlist_fill_rectangle(struct newport_dlist *dl, int x1, int y1,
+    int wi, int he, uint32_t color)
+{
+	int x2 = x1 + wi - 1;
+	int y2 = y1 + he - 1;
+
+	if (wi <= 0 || he <= 0 || ! newport_dlist_check(dl, x1, y1, x2, y2))
+		return;
+	if (! newport_dlist_begin(dl))
+		return;
+
+	newport_dlist_default_state(dl);
+	newport_dlist_write_reg(dl, REX3_REG_DRAWMODE1,
+	    newport_calc_drawmode1(dl->dc) |
+	    NEWPORT_DLIST_FILL_DRAWMODE1 |
+	    REX3_DRAWMODE1_LO_SRC);
+	newport_dlist_write_reg(dl, REX3_REG_DRAWMODE0,
+	    REX3_DRAWMODE0_OPCODE_DRAW |
+	    REX3_DRAWMODE0_ADRMODE_BLOCK | REX3_DRAWMODE0_DOSETUP |
+	    REX3_DRAWMODE0_STOPONX | REX3_DRAWMODE0_STOPONY);
+	newport_dlist_write_reg(dl, REX3_REG_COLORI,
+	    newport_calc_colori_color(dl->dc, color));
+	newport_dlist_write_reg(dl, REX3_REG_XYSTARTI,
+	    (x1 << REX3_XYSTARTI_XSHIFT) | y1);
+	newport_dlist_write_reg(dl, REX3_REG_XYENDI | REX3_REG_GO,
+	    (x2 << REX3_XYENDI_XSHIFT) | y2);
+	dl->nops++;
+}
+
+void
+newport_dlist_fill_span(struct newport_dlist *dl, int x1, int x2, int y,
+    uint32_t color)
+{
+	int t;
+
+	if (x2 < x1) {
+		t = x1; x1 = x2; x2 = t;
+	}
+	if (! newport_dlist_check(dl, x1, y, x2, y))
+		return;
+	if (! newport_dlist_begin(dl))
+		return;
+
+	newport_dlist_default_state(dl);
+	newport_dlist_write_reg(dl, REX3_REG_DRAWMODE1,
+	    newport_calc_drawmode1(dl->dc) |
+	    NEWPORT_DLIST_FILL_DRAWMODE1 |
+	    REX3_DRAWMODE1_LO_SRC);
+	newport_dlist_write_reg(dl, REX3_REG_DRAWMODE0,
+	    REX3_DRAWMODE0_OPCODE_DRAW |
+	    REX3_DRAWMODE0_ADRMODE_SPAN | REX3_DRAWMODE0_DOSETUP |
+	    REX3_DRAWMODE0_STOPONX);
+	newport_dlist_write_reg(dl, REX3_REG_COLORI,
+	    newport_calc_colori_color(dl->dc, color));
+	newport_dlist_write_reg(dl, REX3_REG_XYSTARTI,
+	    (x1 << REX3_XYSTARTI_XSHIFT) | y);
+	newport_dlist_write_reg(dl, REX3_REG_XYENDI | REX3_REG_GO,
+	    (x2 << REX3_XYENDI_XSHIFT) | y);
+	dl->nops++;
+}
+
+void
+newport_dlist_line(struct newport_dlist *dl, int x1, int y1, int x2, int y2,
+    uint32_t color)
+{
+	if (! newport_dlist_check(dl, x1, y1, x2, y2))
+		return;
+	if (! newport_dlist_begin(dl))
+		return;
+
+	newport_dlist_default_state(dl);
+	newport_dlist_write_reg(dl, REX3_REG_DRAWMODE1,
+	    newport_calc_drawmode1(dl->dc) |
+	    NEWPORT_DLIST_FILL_DRAWMODE1 |
+	    REX3_DRAWMODE1_LO_SRC);
+	newport_dlist_write_reg(dl, REX3_REG_DRAWMODE0,
+	    REX3_DRAWMODE0_OPCODE_DRAW |
+	    REX3_DRAWMODE0_ADRMODE_I_LINE | REX3_DRAWMODE0_DOSETUP |
+	    REX3_DRAWMODE0_STOPONX | REX3_DRAWMODE0_STOPONY);
+	newport_dlist_write_reg(dl, REX3_REG_COLORI,
+	    newport_calc_colori_color(dl->dc, color));
+	newport_dlist_write_reg(dl, REX3_REG_XYSTARTI,
+	    (x1 << REX3_XYSTARTI_XSHIFT) | y1);
+	newport_dlist_write_reg(dl, REX3_REG_XYENDI | REX3_REG_GO,
+	    (x2 << REX3_XYENDI_XSHIFT) | y2);
+	dl->nops++;
+}
+
+/*
+ * Record a screen to screen copy; see newport_bitblt().
+ */
+void
+newport_dlist_bitblt(struct newport_dlist *dl, int xs, int ys, int xd,
+    int yd, int wi, int he, uint32_t rop)
+{
+	int xe, ye;
+	uint32_t tmp;
+
+	if (wi <= 0 || he <= 0 ||
+	    ! newport_dlist_check(dl, xs, ys, xs + wi - 1, ys + he - 1) ||
+	    ! newport_dlist_check(dl, xd, yd, xd + wi - 1, yd + he - 1))
+		return;
+	if (! newport_dlist_begin(dl))
+		return;
+
+	if (yd > ys) {
+		ye = ys;
+		yd += he - 1;
+		ys += he - 1;
+	} else
+		ye = ys + he - 1;
+
+	if (xd > xs) {
+		xe = xs;
+		xd += wi - 1;
+		xs += wi - 1;
+	} else
+		xe = xs + wi - 1;
+
+	newport_dlist_default_state(dl);
+	newport_dlist_write_reg(dl, REX3_REG_DRAWMODE0,
+	    REX3_DRAWMODE0_OPCODE_SCR2SCR |
+	    REX3_DRAWMODE0_ADRMODE_BLOCK | REX3_DRAWMODE0_DOSETUP |
+	    REX3_DRAWMODE0_STOPONX | REX3_DRAWMODE0_STOPONY);
+	newport_dlist_write_reg(dl, REX3_REG_DRAWMODE1,
+	    newport_calc_drawmode1(dl->dc) |
+	    NEWPORT_DLIST_FILL_DRAWMODE1 |
+	    (rop & REX3_DRAWMODE1_LOGICOP_MASK));
+	newport_dlist_write_reg(dl, REX3_REG_XYSTARTI,
+	    (xs << REX3_XYSTARTI_XSHIFT) | ys);
+	newport_dlist_write_reg(dl, REX3_REG_XYENDI,
+	    (xe << REX3_XYENDI_XSHIFT) | ye);
+
+	tmp = (yd - ys) & 0xffff;
+	tmp |= (xd - xs) << REX3_XYMOVE_XSHIFT;
+	newport_dlist_write_reg(dl, REX3_REG_XYMOVE | REX3_REG_GO, tmp);
+	dl->nops++;
+}
+
+/*
+ * Replay a recorded display list.  Returns a fence for it, so the
+ * caller can tell when the hardware has finished drawing it, or
+ * NEWPORT_FENCE_NONE if the list ran out of memory while it was
+ * being recorded and so isn't complete.
+ */
+newport_fence_t
+newport_dlist_replay(struct gfx_ctx *dc, const struct newport_dlist *dl)
+{
+	const uint16_t *regs = dl->regs;
+	const uint32_t *vals = dl->vals;
+	int i, n, end;
+
+	if (dl->nomem) {
+		printf("%s: list ran out of memory recording, not replaying\n",
+		    __func__);
+		return (NEWPORT_FENCE_NONE);
+	}
+
+	for (i = 0; i < dl->count; ) {
+		n = MIN(dl->count - i, NEWPORT_GFIFO_ENTRIES);
+		rex3_wait_gfifo(dc, n);
+		for (end = i + n; i < end; i++)
+			rex3_write(dc, regs[i], vals[i]);
+	}
+	return (newport_fence_emit(dc));
+}
@@ -0,0 +1,60 @@
+#ifndef	__NEWPORT_DLIST_H__
+#define	__NEWPORT_DLIST_H__
+
+/* Number of REX3 state registers tracked for redundant write removal */
+#define	NEWPORT_DLIST_NSTATE		8
+
+/* Coordinates have to fit the 12 bit XYWIN window */
+#define	NEWPORT_DLIST_COORD_MAX		4095
+
+/*
+ * A recorded display list.
+ *
+ * This is the final list of register writes, stored as two parallel
+ * arrays (16 bit register offset including the GO bit, 32 bit value).
+ * All the colour / mode calculations, validation and redundant state
+ * removal happen at record time.
+ */
+struct newport_dlist {
+	/* Used for the newport_calc_* conversions at record time */
+	struct gfx_ctx *dc;
+
+	uint16_t *regs;
+	uint32_t *vals;
+	int count;
+	int size;
+
+	/* Last value recorded for each tracked state register */
+	uint32_t state_val[NEWPORT_DLIST_NSTATE];
+	uint32_t state_valid;
+
+	/* Number of operations recorded / dropped at record time */
+	int nops;
+	int nrejected;
+	bool nomem;
+};
+
+extern	struct newport_dlist *newport_dlist_create(struct gfx_ctx *dc);
+extern	void newport_dlist_destroy(struct newport_dlist *dl);
+extern	void newport_dlist_reset(struct newport_dlist *dl);
+
+extern	void newport_dlist_write_reg(struct newport_dlist *dl,
+	    uint32_t rexreg, uint32_t val);
+extern	void newport_dlist_set_wrmask(struct newport_dlist *dl,
+	    uint32_t planemask);
+extern	void newport_dlist_set_clipmode(struct newport_dlist *dl,
+	    uint32_t clipmode);
+
+extern	void newport_dlist_fill_rectangle(struct newport_dlist *dl,
+	    int x1, int y1, int wi, int he, uint32_t color);
+extern	void newport_dlist_fill_span(struct newport_dlist *dl, int x1,
+	    int x2, int y, uint32_t color);
+extern	void newport_dlist_line(struct newport_dlist *dl, int x1, int y1,
+	    int x2, int y2, uint32_t color);
+extern	void newport_dlist_bitblt(struct newport_dlist *dl, int xs, int ys,
+	    int xd, int yd, int wi, int he, uint32_t rop);
+
+extern	newport_fence_t newport_dlist_replay(struct gfx_ctx *dc,
+	    const struct newport_dlist *dl);
+
+#endif	/* __NEWPORT_DLIST_H__ */
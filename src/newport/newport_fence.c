@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "newport_regs.h"
+#include "newport_ctx.h"
+#include "newport_regio.h"
+#include "newport_hwops.h"
+#include "newport_stats.h"
+#include "newport_fence.h"
+
+/*
+ * Fences.
+ *
+ * Drawing is just register writes into the GFIFO, which the REX3
+ * runs in order, so nothing needs to wait for the pipeline to drain
+ * unless the CPU is about to depend on the result - reading pixels
+ * back, reusing memory the hardware is still working from, timing
+ * something, or reprogramming the display side over the DCB.
+ *
+ * The REX3 has no completion counter to write a sequence number
+ * into, so a fence completes when the pipeline is seen idle: an
+ * idle pipeline means everything written before that status read
+ * has been drawn, which retires every fence emitted so far.
+ * rex3_wait_gfifo() and rex3_wait_gfifo_idle() retire fences too
+ * whenever they happen to see the pipeline idle.
+ */
+
+static inline bool
+newport_fence_idle(struct gfx_ctx *dc)
+{
+	return ((rex3_read(dc, REX3_REG_STATUS) &
+	    (REX3_STATUS_GFXBUSY | REX3_STATUS_PIPELEVEL_MASK)) == 0);
+}
+
+/**
+ * Mark the end of a batch of drawing and return its fence.
+ */
+newport_fence_t
+newport_fence_emit(struct gfx_ctx *dc)
+{
+	dc->stats.fence_emits++;
+	return (++dc->fence_seq);
+}
+
+/**
+ * Has the drawing before fence f completed?  This doesn't wait; at
+ * most it reads the status register once.
+ */
+bool
+newport_fence_done(struct gfx_ctx *dc, newport_fence_t f)
+{
+	if (f <= dc->fence_done)
+		return true;
+	if (! newport_fence_idle(dc))
+		return false;
+	dc->fence_done = dc->fence_seq;
+	return true;
+}
+
+/**
+ * Wait for the drawing before fence f to complete.
+ */
+void
+newport_fence_wait(struct gfx_ctx *dc, newport_fence_t f)
+{
+	uint64_t t_start;
+
+	if (newport_fence_done(dc, f))
+		return;
+
+	dc->stats.fence_stalls++;
+	t_start = newport_stats_now_ns();
+	while (! newport_fence_idle(dc))
+		;
+	dc->fence_done = dc->fence_seq;
+	dc->gfifo_left = NEWPORT_GFIFO_ENTRIES;
+	dc->stats.fence_stall_ns += newport_stats_now_ns() - t_start;
+}
+
+/**
+ * Wait for everything drawn so far; for the places that really do
+ * need the pipeline drained.
+ */
+void
+newport_fence_sync(struct gfx_ctx *dc)
+{
+	newport_fence_wait(dc, newport_fence_emit(dc));
+}
@@ -0,0 +1,17 @@
+#ifndef	__NEWPORT_FENCE_H__
+#define	__NEWPORT_FENCE_H__
+
+/*
+ * A fence is the sequence number of a submitted batch of drawing.
+ * Zero is never emitted, so it can be used as "no fence".
+ */
+typedef uint64_t newport_fence_t;
+
+#define	NEWPORT_FENCE_NONE	0
+
+extern	newport_fence_t newport_fence_emit(struct gfx_ctx *dc);
+extern	bool newport_fence_done(struct gfx_ctx *dc, newport_fence_t f);
+extern	void newport_fence_wait(struct gfx_ctx *dc, newport_fence_t f);
+extern	void newport_fence_sync(struct gfx_ctx *dc);
+
+#endif	/* __NEWPORT_FENCE_H__ */
@@ -0,0 +1,465 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <err.h>
+
+#include <sys/param.h>
+
+#include "newport_regs.h"
+#include "newport_ctx.h"
+#include "newport_regio.h"
+#include "newport_hwops.h"
+#include "newport_ops.h"
+#include "newport_fillpath.h"
+#include "newport_stats.h"
+#include "newport_fence.h"
+
+/*
+ * Fill path selection.
+ *
+ * There are three ways to solid fill a rectangle and which one is
+ * cheapest depends on the size of the fill and on whether the REX3
+ * already has the right fill state loaded.  Calibration times each
+ * path over a grid of power-of-two sizes and the dispatcher then
+ * picks the cheapest path for each fill, charging the setup cost
+ * for any path whose state isn't currently loaded.  Fills between
+ * the calibrated sizes are costed by interpolating between the four
+ * surrounding grid points, as rounding to a power of two would be
+ * up to 2x out.
+ *
+ * The dispatcher only knows about state it loaded itself; callers
+ * that draw anything else in between need to call
+ * newport_fillpath_invalidate().
+ */
+
+static const char *newport_fillpath_names[NewportFillPathMax] = {
+	"fast", "block", "span",
+};
+
+/* Roughly this many pixels per calibration cell */
+#define	NEWPORT_FILLPATH_CAL_PIXELS	(1 << 18)
+#define	NEWPORT_FILLPATH_CAL_MIN_ITERS	4
+#define	NEWPORT_FILLPATH_CAL_MAX_ITERS	256
+#define	NEWPORT_FILLPATH_CAL_SETUP_ITERS	64
+
+/* Biggest fill the cost extrapolation is done for */
+#define	NEWPORT_FILLPATH_MAX_SIZE	4096
+
+/*
+ * Where n falls between the calibration sizes: between bucket b and
+ * b + 1, num / den of the way along.  Sizes past the last bucket are
+ * extrapolated along the last two.
+ */
+static void
+newport_fillpath_bucket(int n, int *b, int64_t *num, int64_t *den)
+{
+	n = MIN(MAX(n, 1), NEWPORT_FILLPATH_MAX_SIZE);
+	for (*b = 0; (n >> (*b + 1)) != 0 &&
+	    *b < NEWPORT_FILLPATH_NBUCKETS - 2; (*b)++)
+		;
+	*num = n - (1 << *b);
+	*den = 1 << *b;
+}
+
+const char *
+newport_fillpath_name(NewportFillPath p)
+{
+	if (p < 0 || p >= NewportFillPathMax)
+		return ("none");
+	return (newport_fillpath_names[p]);
+}
+
+/*
+ * Span fill state; like newport_fill_rectangle_setup() but with
+ * DRAWMODE0 set up for single row spans.
+ */
+static void
+newport_fillpath_span_setup(struct gfx_ctx *dc)
+{
+	rex3_wait_gfifo(dc, 4);
+
+	rex3_write(dc, REX3_REG_DRAWMODE1,
+	    newport_calc_drawmode1(dc) |
+	    REX3_DRAWMODE1_PLANES_RGB |
+	    REX3_DRAWMODE1_COMPARE_LT |
+	    REX3_DRAWMODE1_COMPARE_EQ |
+	    REX3_DRAWMODE1_COMPARE_GT |
+	    REX3_DRAWMODE1_LO_SRC);
+	rex3_write(dc, REX3_REG_CLIPMODE, 0x1e00);
+	rex3_write(dc, REX3_REG_WRMASK, newport_calc_wrmode(dc, 0xffffffff));
+	rex3_write(dc, REX3_REG_DRAWMODE0, REX3_DRAWMODE0_OPCODE_DRAW |
+	    REX3_DRAWMODE0_ADRMODE_SPAN | REX3_DRAWMODE0_DOSETUP |
+	    REX3_DRAWMODE0_STOPONX);
+}
+
+static void
+newport_fillpath_span_fill(struct gfx_ctx *dc, int x1, int y1, int wi,
+    int he, uint32_t color)
+{
+	int x2 = x1 + wi - 1;
+	int y;
+
+	rex3_wait_gfifo(dc, 1);
+	rex3_write(dc, REX3_REG_COLORI, newport_calc_colori_color(dc, color));
+	for (y = y1; y < y1 + he; y++) {
+		rex3_wait_gfifo(dc, 2);
+		rex3_write(dc, REX3_REG_XYSTARTI,
+		    (x1 << REX3_XYSTARTI_XSHIFT) | y);
+		rex3_write_go(dc, REX3_REG_XYENDI,
+		    (x2 << REX3_XYENDI_XSHIFT) | y);
+	}
+
+	newport_stats_prim(dc, NewportPrimFill, wi * he);
+}
+
+static void
+newport_fillpath_load_state(struct newport_fillpath *fp, NewportFillPath p)
+{
+	if (fp->loaded == p)
+		return;
+
+	switch (p) {
+	case NewportFillPathBlock:
+		newport_fill_rectangle_setup(fp->dc);
+		break;
+	case NewportFillPathSpan:
+		newport_fillpath_span_setup(fp->dc);
+		break;
+	default:
+		/* The fast path sets itself up every time */
+		break;
+	}
+	fp->loaded = p;
+}
+
+static void
+newport_fillpath_do_fill(struct newport_fillpath *fp, NewportFillPath p,
+    int x1, int y1, int wi, int he, uint32_t color)
+{
+	newport_fillpath_load_state(fp, p);
+
+	switch (p) {
+	case NewportFillPathFast:
+		newport_fill_rectangle_fast(fp->dc, x1, y1, wi, he, color);
+		break;
+	case NewportFillPathBlock:
+		newport_fill_rectangle(fp->dc, x1, y1, wi, he, color);
+		break;
+	case NewportFillPathSpan:
+		newport_fillpath_span_fill(fp->dc, x1, y1, wi, he, color);
+		break;
+	default:
+		break;
+	}
+	fp->nfills[p]++;
+}
+
+/**
+ * Initialise a dispatcher.  Until a profile is loaded or calibrated
+ * every fill goes down the block path, which is what the callers
+ * used to hand-pick most of the time anyway.
+ */
+void
+newport_fillpath_init(struct newport_fillpath *fp, struct gfx_ctx *dc)
+{
+	bzero(fp, sizeof(*fp));
+	fp->dc = dc;
+	fp->loaded = NewportFillPathNone;
+}
+
+/**
+ * The caller drew something else; the REX3 fill state is unknown.
+ */
+void
+newport_fillpath_invalidate(struct newport_fillpath *fp)
+{
+	fp->loaded = NewportFillPathNone;
+}
+
+/**
+ * Time every fill path over the size grid.
+ *
+ * This draws all over the top left 1024x1024 of the framebuffer.
+ * Each cell is timed from a loaded fill state through to the FIFO
+ * being idle again, so the posted writes are paid for.
+ */
+bool
+newport_fillpath_calibrate(struct newport_fillpath *fp)
+{
+	struct newport_fillpath_profile *prof = &fp->prof;
+	uint64_t t;
+	int p, wb, hb, w, h, i, iters;
+
+	prof->valid = false;
+
+	for (p = 0; p < NewportFillPathMax; p++) {
+		if (p == NewportFillPathFast) {
+			prof->setup_ns[p] = 0;
+			continue;
+		}
+		t = newport_stats_now_ns();
+		for (i = 0; i < NEWPORT_FILLPATH_CAL_SETUP_ITERS; i++) {
+			fp->loaded = NewportFillPathNone;
+			newport_fillpath_load_state(fp, p);
+		}
+		newport_fence_sync(fp->dc);
+		t = newport_stats_now_ns() - t;
+		prof->setup_ns[p] = t / NEWPORT_FILLPATH_CAL_SETUP_ITERS;
+	}
+
+	for (p = 0; p < NewportFillPathMax; p++) {
+		for (wb = 0; wb < NEWPORT_FILLPATH_NBUCKETS; wb++) {
+			for (hb = 0; hb < NEWPORT_FILLPATH_NBUCKETS; hb++) {
+				w = 1 << wb;
+				h = 1 << hb;
+				iters = NEWPORT_FILLPATH_CAL_PIXELS / (w * h);
+				iters = MAX(iters,
+				    NEWPORT_FILLPATH_CAL_MIN_ITERS);
+				iters = MIN(iters,
+				    NEWPORT_FILLPATH_CAL_MAX_ITERS);
+
+				fp->loaded = NewportFillPathNone;
+				newport_fillpath_load_state(fp, p);
+				newport_fence_sync(fp->dc);
+
+				t = newport_stats_now_ns();
+				for (i = 0; i < iters; i++)
+					newport_fillpath_do_fill(fp, p, 0, 0,
+					    w, h, i & 0xff);
+				newport_fence_sync(fp->dc);
+				t = newport_stats_now_ns() - t;
+
+				prof->fill_ns[p][wb][hb] =
+				    MIN(t / iters, UINT32_MAX);
+			}
+		}
+		fp->nfills[p] = 0;
+	}
+
+	fp->loaded = NewportFillPathNone;
+	prof->fb_mode = fp->dc->fb_mode;
+	prof->valid = true;
+	return true;
+}
+
+/**
+ * Write the profile out as text; one line per path per width bucket.
+ */
+bool
+newport_fillpath_save(const struct newport_fillpath *fp, const char *path)
+{
+	const struct newport_fillpath_profile *prof = &fp->prof;
+	FILE *f;
+	int p, wb, hb;
+
+	if (! prof->valid) {
+		printf("%s: no profile to save\n", __func__);
+		return false;
+	}
+
+	f = fopen(path, "w");
+	if (f == NULL) {
+		warn("%s: fopen(%s)", __func__, path);
+		return false;
+	}
+
+	fprintf(f, "# newport fill path profile; nanoseconds per fill\n");
+	fprintf(f, "# fill <path> <width bucket> <cost for height "
+	    "1, 2, 4 .. %d>\n", 1 << (NEWPORT_FILLPATH_NBUCKETS - 1));
+	fprintf(f, "version %d\n", NEWPORT_FILLPATH_PROFILE_VERSION);
+	fprintf(f, "buckets %d\n", NEWPORT_FILLPATH_NBUCKETS);
+	fprintf(f, "fbmode %d\n", prof->fb_mode);
+	for (p = 0; p < NewportFillPathMax; p++)
+		fprintf(f, "setup %s %u\n", newport_fillpath_names[p],
+		    prof->setup_ns[p]);
+	for (p = 0; p < NewportFillPathMax; p++) {
+		for (wb = 0; wb < NEWPORT_FILLPATH_NBUCKETS; wb++) {
+			fprintf(f, "fill %s %d", newport_fillpath_names[p],
+			    wb);
+			for (hb = 0; hb < NEWPORT_FILLPATH_NBUCKETS; hb++)
+				fprintf(f, " %u", prof->fill_ns[p][wb][hb]);
+			fprintf(f, "\n");
+		}
+	}
+
+	if (fclose(f) != 0) {
+		warn("%s: fclose(%s)", __func__, path);
+		return false;
+	}
+	return true;
+}
+
+static int
+newport_fillpath_lookup(const char *name)
+{
+	int p;
+
+	for (p = 0; p < NewportFillPathMax; p++)
+		if (strcmp(name, newport_fillpath_names[p]) == 0)
+			return (p);
+	return (-1);
+}
+
+/**
+ * Load a profile written by newport_fillpath_save().
+ *
+ * The profile is only used if it is complete and was calibrated
+ * for the framebuffer mode the context is currently using;
+ * otherwise the dispatcher stays on the block path.
+ */
+bool
+newport_fillpath_load(struct newport_fillpath *fp, const char *path)
+{
+	struct newport_fillpath_profile prof;
+	uint32_t seen[NewportFillPathMax];
+	char line[512], *tok, *last;
+	FILE *f;
+	int p, wb, hb, lineno = 0, nsetup = 0;
+	bool ret = false;
+
+	f = fopen(path, "r");
+	if (f == NULL) {
+		warn("%s: fopen(%s)", __func__, path);
+		return false;
+	}
+
+	bzero(&prof, sizeof(prof));
+	bzero(seen, sizeof(seen));
+	prof.fb_mode = NewportBppModeUndefined;
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+		lineno++;
+		tok = strtok_r(line, " \t\n", &last);
+		if (tok == NULL || tok[0] == '#')
+			continue;
+
+		if (strcmp(tok, "version") == 0) {
+			tok = strtok_r(NULL, " \t\n", &last);
+			if (tok == NULL ||
+			    atoi(tok) != NEWPORT_FILLPATH_PROFILE_VERSION)
+				goto bad;
+		} else if (strcmp(tok, "buckets") == 0) {
+			tok = strtok_r(NULL, " \t\n", &last);
+			if (tok == NULL ||
+			    atoi(tok) != NEWPORT_FILLPATH_NBUCKETS)
+				goto bad;
+		} else if (strcmp(tok, "fbmode") == 0) {
+			tok = strtok_r(NULL, " \t\n", &last);
+			if (tok == NULL)
+				goto bad;
+			prof.fb_mode = atoi(tok);
+		} else if (strcmp(tok, "setup") == 0) {
+			tok = strtok_r(NULL, " \t\n", &last);
+			if (tok == NULL ||
+			    (p = newport_fillpath_lookup(tok)) < 0)
+				goto bad;
+			tok = strtok_r(NULL, " \t\n", &last);
+			if (tok == NULL)
+				goto bad;
+			prof.setup_ns[p] = strtoul(tok, NULL, 10);
+			nsetup++;
+		} else if (strcmp(tok, "fill") == 0) {
+			tok = strtok_r(NULL, " \t\n", &last);
+			if (tok == NULL ||
+			    (p = newport_fillpath_lookup(tok)) < 0)
+				goto bad;
+			tok = strtok_r(NULL, " \t\n", &last);
+			if (tok == NULL)
+				goto bad;
+			wb = atoi(tok);
+			if (wb < 0 || wb >= NEWPORT_FILLPATH_NBUCKETS)
+				goto bad;
+			for (hb = 0; hb < NEWPORT_FILLPATH_NBUCKETS; hb++) {
+				tok = strtok_r(NULL, " \t\n", &last);
+				if (tok == NULL)
+					goto bad;
+				prof.fill_ns[p][wb][hb] =
+				    strtoul(tok, NULL, 10);
+			}
+			seen[p] |= 1U << wb;
+		} else
+			goto bad;
+	}
+
+	for (p = 0; p < NewportFillPathMax; p++) {
+		if (seen[p] != (1U << NEWPORT_FILLPATH_NBUCKETS) - 1) {
+			printf("%s: %s: missing %s fill costs\n", __func__,
+			    path, newport_fillpath_names[p]);
+			goto done;
+		}
+	}
+	if (nsetup < NewportFillPathMax) {
+		printf("%s: %s: missing setup costs\n", __func__, path);
+		goto done;
+	}
+	if (prof.fb_mode != fp->dc->fb_mode) {
+		printf("%s: %s: calibrated for framebuffer mode %d, "
+		    "not %d\n", __func__, path, prof.fb_mode,
+		    fp->dc->fb_mode);
+		goto done;
+	}
+
+	prof.valid = true;
+	fp->prof = prof;
+	ret = true;
+	goto done;
+
+bad:
+	printf("%s: %s:%d: bad profile line\n", __func__, path, lineno);
+done:
+	fclose(f);
+	return ret;
+}
+
+/**
+ * Pick the cheapest path for a wi x he fill given the current state.
+ */
+NewportFillPath
+newport_fillpath_choose(const struct newport_fillpath *fp, int wi, int he)
+{
+	const struct newport_fillpath_profile *prof = &fp->prof;
+	NewportFillPath p, best = NewportFillPathBlock;
+	int64_t cost, best_cost = INT64_MAX, nw, dw, nh, dh;
+	int wb, hb;
+
+	if (! prof->valid)
+		return (NewportFillPathBlock);
+
+	newport_fillpath_bucket(wi, &wb, &nw, &dw);
+	newport_fillpath_bucket(he, &hb, &nh, &dh);
+	for (p = 0; p < NewportFillPathMax; p++) {
+		/* Bilinear between the four neighbouring grid points */
+		cost = ((int64_t) prof->fill_ns[p][wb][hb] * (dw - nw) *
+		    (dh - nh) +
+		    (int64_t) prof->fill_ns[p][wb + 1][hb] * nw * (dh - nh) +
+		    (int64_t) prof->fill_ns[p][wb][hb + 1] * (dw - nw) * nh +
+		    (int64_t) prof->fill_ns[p][wb + 1][hb + 1] * nw * nh) /
+		    (dw * dh);
+		/* Extrapolating noisy timings could go below nothing */
+		cost = MAX(cost, 0);
+		if (fp->loaded != p)
+			cost += prof->setup_ns[p];
+		if (cost < best_cost) {
+			best_cost = cost;
+			best = p;
+		}
+	}
+	return (best);
+}
+
+/**
+ * Solid fill a rectangle using whichever path is cheapest.
+ */
+void
+newport_fillpath_fill(struct newport_fillpath *fp, int x1, int y1, int wi,
+    int he, uint32_t color)
+{
+	if (wi <= 0 || he <= 0)
+		return;
+
+	newport_fillpath_do_fill(fp, newport_fillpath_choose(fp, wi, he),
+	    x1, y1, wi, he, color);
+}
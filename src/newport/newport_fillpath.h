@@ -0,0 +1,71 @@
+#ifndef	__NEWPORT_FILLPATH_H__
+#define	__NEWPORT_FILLPATH_H__
+
+/* Default profile file written by calibration */
+#define	NEWPORT_FILLPATH_PROFILE	"newport_fill.prof"
+
+#define	NEWPORT_FILLPATH_PROFILE_VERSION	1
+
+/*
+ * Width / height buckets are powers of two, 1 .. 1024.  Costs for
+ * sizes in between are interpolated; anything bigger is extrapolated
+ * from the last two buckets.
+ */
+#define	NEWPORT_FILLPATH_NBUCKETS	11
+
+typedef enum {
+	/* newport_fill_rectangle_fast(); FASTCLEAR, full setup each time */
+	NewportFillPathFast = 0,
+	/* newport_fill_rectangle_setup() + newport_fill_rectangle() */
+	NewportFillPathBlock = 1,
+	/* One ADRMODE_SPAN draw per row */
+	NewportFillPathSpan = 2,
+	NewportFillPathMax = 3,
+
+	/* No fill state is known to be loaded */
+	NewportFillPathNone = -1,
+} NewportFillPath;
+
+/*
+ * Cost profile, in nanoseconds.
+ *
+ * setup_ns is what it costs to load a path's fill state (zero for
+ * the fast path, which does it on every call); fill_ns is the cost
+ * of a single fill once the state is loaded.
+ */
+struct newport_fillpath_profile {
+	bool valid;
+	/* The framebuffer mode this was calibrated in */
+	NewportBppMode fb_mode;
+	uint32_t setup_ns[NewportFillPathMax];
+	uint32_t fill_ns[NewportFillPathMax][NEWPORT_FILLPATH_NBUCKETS]
+	    [NEWPORT_FILLPATH_NBUCKETS];
+};
+
+struct newport_fillpath {
+	struct gfx_ctx *dc;
+	struct newport_fillpath_profile prof;
+
+	/* Which path's state the REX3 currently has loaded */
+	NewportFillPath loaded;
+
+	/* How many fills went down each path */
+	uint64_t nfills[NewportFillPathMax];
+};
+
+extern	void newport_fillpath_init(struct newport_fillpath *fp,
+	    struct gfx_ctx *dc);
+extern	bool newport_fillpath_calibrate(struct newport_fillpath *fp);
+extern	bool newport_fillpath_save(const struct newport_fillpath *fp,
+	    const char *path);
+extern	bool newport_fillpath_load(struct newport_fillpath *fp,
+	    const char *path);
+extern	const char *newport_fillpath_name(NewportFillPath p);
+
+extern	NewportFillPath newport_fillpath_choose(
+	    const struct newport_fillpath *fp, int wi, int he);
+extern	void newport_fillpath_fill(struct newport_fillpath *fp, int x1,
+	    int y1, int wi, int he, uint32_t color);
+extern	void newport_fillpath_invalidate(struct newport_fillpath *fp);
+
+#endif	/* __NEWPORT_FILLPATH_H__ */
@@ -5,7 +5,6 @@
 #include <stdint.h>
 #include <fcntl.h>
 #include <strings.h>
-#include <dev/wscons/wsconsio.h>
 #include <err.h>
 #include <sched.h>
 
@@ -16,6 +15,8 @@
 #include "newport_ctx.h"
 #include "newport_regio.h"
 #include "newport_hwops.h"
+#include "newport_stats.h"
+#include "newport_fence.h"
 
 /*
  * These are the hardware operation calls for the various component
@@ -46,11 +47,14 @@ void
 rex3_wait_gfifo(struct gfx_ctx *dc, int nentries)
 {
 	uint32_t fifo_level, reg;
+	uint64_t t_start = 0;
 
 	/* Ensure we don't shoot past the fifo depth */
 	if (nentries > NEWPORT_GFIFO_ENTRIES)
 		nentries = NEWPORT_GFIFO_ENTRIES;
 
+	dc->stats.gfifo_waits++;
+
 	/* If we have enough slots left, then return it */
 	if (nentries <= dc->gfifo_left) {
 		dc->gfifo_left -= nentries;
@@ -61,6 +65,9 @@ rex3_wait_gfifo(struct gfx_ctx *dc, int nentries)
 	while (true) {
 		reg = rex3_read(dc, REX3_REG_STATUS);
 		if ((reg & REX3_STATUS_GFXBUSY) == 0) {
+			/* Idle; everything fenced so far has completed */
+			if ((reg & REX3_STATUS_PIPELEVEL_MASK) == 0)
+				dc->fence_done = dc->fence_seq;
 			dc->gfifo_left = NEWPORT_GFIFO_ENTRIES - nentries;
 			break;
 		}
@@ -75,21 +82,41 @@ rex3_wait_gfifo(struct gfx_ctx *dc, int nentries)
 			dc->gfifo_left = fifo_level - nentries;
 			break;
 		}
+
+		/* Only time it once we know we're actually stalling */
+		if (t_start == 0) {
+			t_start = newport_stats_now_ns();
+			dc->stats.gfifo_stalls++;
+		}
 		/* XXX ew */
 		sched_yield();
 	}
+	if (t_start != 0)
+		dc->stats.gfifo_stall_ns += newport_stats_now_ns() - t_start;
 }
 
 /*
  * Fully wait for the graphics FIFO to be idle and then
  * reserve some FIFO slots.
+ *
+ * Only use this where there's a real dependency on the drawing
+ * having finished; see newport_fence.c.
  */
 void
 rex3_wait_gfifo_idle(struct gfx_ctx *dc, int nentries)
 {
-	while (rex3_read(dc, REX3_REG_STATUS) &
-	    (REX3_STATUS_GFXBUSY | REX3_STATUS_PIPELEVEL_MASK))
-		;
+	uint64_t t_start;
+
+	dc->stats.gfifo_idle_waits++;
+	if (rex3_read(dc, REX3_REG_STATUS) &
+	    (REX3_STATUS_GFXBUSY | REX3_STATUS_PIPELEVEL_MASK)) {
+		t_start = newport_stats_now_ns();
+		while (rex3_read(dc, REX3_REG_STATUS) &
+		    (REX3_STATUS_GFXBUSY | REX3_STATUS_PIPELEVEL_MASK))
+			;
+		dc->stats.gfifo_idle_ns += newport_stats_now_ns() - t_start;
+	}
+	dc->fence_done = dc->fence_seq;
 	dc->gfifo_left = NEWPORT_GFIFO_ENTRIES - nentries;
 }
 
@@ -102,6 +129,7 @@ rex3_wait_gfifo_idle(struct gfx_ctx *dc, int nentries)
 void
 rex3_wait_bfifo(struct gfx_ctx *dc)
 {
+	dc->stats.bfifo_waits++;
 	while (rex3_read(dc, REX3_REG_STATUS) &
 	    (REX3_STATUS_BACKBUSY | REX3_STATUS_BPIPELEVEL_MASK))
 		;
@@ -438,6 +466,9 @@ newport_setup_hw_xmap9_modes(struct gfx_ctx *dc, uint32_t mode_mask)
 {
 	int i;
 
+	/* Don't change how pixels are displayed under pending drawing */
+	newport_fence_sync(dc);
+
 	for (i = 0; i < 32; i++) {
 		xmap9_write_mode(dc, i, mode_mask);
 	}
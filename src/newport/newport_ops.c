@@ -5,9 +5,9 @@
 #include <stdint.h>
 #include <fcntl.h>
 #include <strings.h>
-#include <dev/wscons/wsconsio.h>
 #include <err.h>
 
+#include <sys/param.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 
@@ -16,6 +16,9 @@
 #include "newport_regio.h"
 #include "newport_hwops.h"
 #include "newport_ops.h"
+#include "newport_stats.h"
+
+#include "scanline.h"
 
 /*
  * Determine the DRAWMODE1 configuration to use.
@@ -26,36 +29,53 @@
 uint32_t
 newport_calc_drawmode1(struct gfx_ctx *ctx)
 {
+	uint32_t hd, dither;
+
 	switch (ctx->pixel_mode) {
 	case NewportBppModeRgb24:	/* input pixels are RGB888 */
-		if (ctx->fb_mode == NewportBppModeRgb24) { /* FB pixels are rgb888 */
+	case NewportBppModeRgb12:	/* input pixels are RGB444 */
+		hd = (ctx->pixel_mode == NewportBppModeRgb24) ?
+		    REX3_DRAWMODE1_HD_HD24 : REX3_DRAWMODE1_HD_HD12;
+		/* XXX TODO: make DITHER a flag? */
+		dither = (ctx->pixel_mode == NewportBppModeRgb24) ?
+		    REX3_DRAWMODE1_DITHER : 0;
+
+		switch (ctx->fb_mode) {
+		case NewportBppModeRgb24:	/* FB pixels are rgb888 */
 			return
 			    REX3_DRAWMODE1_DD_DD24 |
 			    REX3_DRAWMODE1_RWPACKED |
 			    REX3_DRAWMODE1_RGBMODE |
-			    REX3_DRAWMODE1_HD_HD24;
-
-		} else if (ctx->fb_mode == NewportBppModeRgb8) { /* FB pixels are rgb8 */
-			/* XXX TODO: make DITHER a flag? */
+			    hd;
+		case NewportBppModeRgb12:	/* FB pixels are rgb444 */
+			return
+			    REX3_DRAWMODE1_DD_DD12 |
+			    REX3_DRAWMODE1_RWPACKED |
+			    REX3_DRAWMODE1_RGBMODE |
+			    dither |
+			    hd;
+		case NewportBppModeRgb8:	/* FB pixels are rgb8 */
 			return
 			    REX3_DRAWMODE1_DD_DD8 |
 			    REX3_DRAWMODE1_RWPACKED |
 			    REX3_DRAWMODE1_RGBMODE |
 			    REX3_DRAWMODE1_DITHER |
-			    REX3_DRAWMODE1_HD_HD24;
-		} else {
+			    hd;
+		default:
 			goto unknown;
 		}
 	case NewportBppModeCi8:
-		/* Always just assume input/output is 8 bit for now */
+	case NewportBppModeCi4:
+		/* 8 bit output unless the framebuffer is 4 bit CI */
 		return
-		    REX3_DRAWMODE1_DD_DD8 |
+		    ((ctx->fb_mode == NewportBppModeCi4) ?
+		      REX3_DRAWMODE1_DD_DD4 : REX3_DRAWMODE1_DD_DD8) |
 		    REX3_DRAWMODE1_RWPACKED |
-		    REX3_DRAWMODE1_HD_HD8;
+		    ((ctx->pixel_mode == NewportBppModeCi4) ?
+		      REX3_DRAWMODE1_HD_HD4 : REX3_DRAWMODE1_HD_HD8);
 
 	case NewportBppModeRgb8:
-	case NewportBppModeRgb12:
-		/* These two are unimplemented */
+		/* This is unimplemented */
 	case NewportBppModeUndefined:
 		goto unknown;
 	}
@@ -96,6 +116,8 @@ newport_calc_wrmode(struct gfx_ctx *ctx, uint32_t planemask)
 		return (0xffffff);
 	case NewportBppModeCi8:
 		return (0xff);
+	case NewportBppModeCi4:
+		return (0xf);
 	case NewportBppModeUndefined:
 		printf("%s: called on Undefined\n", __func__);
 		return (0xffffff);
@@ -155,6 +177,47 @@ newport_calc_rgb888_to_fb_rgb332(uint32_t color)
 	return newport_calc_rgb888_to_fb_rgb888(color) & 0xff;
 }
 
+/**
+ * Map 24 bit RGB pixel to 12 bit RGB framebuffer format.
+ *
+ * Like the 8 bit format, this is the 24 bit format truncated; the
+ * low 12 bits are the high 4 bits of each component.
+ */
+uint32_t
+newport_calc_rgb888_to_fb_rgb444(uint32_t color)
+{
+	return newport_calc_rgb888_to_fb_rgb888(color) & 0xfff;
+}
+
+/**
+ * Expand a 12 bit RGB (0x0RGB) pixel out to RGB888.
+ */
+uint32_t
+newport_calc_rgb444_to_rgb888(uint32_t color)
+{
+	return (((color >> 8) & 0xf) * 0x11) << 16
+	    | (((color >> 4) & 0xf) * 0x11) << 8
+	    | ((color & 0xf) * 0x11);
+}
+
+/*
+ * The incoming pixel as RGB888, for the RGB input pixel modes.
+ */
+static inline uint32_t
+newport_calc_input_rgb888(struct gfx_ctx *ctx, uint32_t color)
+{
+	if (ctx->pixel_mode == NewportBppModeRgb12)
+		return newport_calc_rgb444_to_rgb888(color);
+	return (color);
+}
+
+static inline bool
+newport_calc_input_is_rgb(struct gfx_ctx *ctx)
+{
+	return (ctx->pixel_mode == NewportBppModeRgb24 ||
+	    ctx->pixel_mode == NewportBppModeRgb12);
+}
+
 /**
  * Map 24 bit RGB pixel format to the HOSTRW format (BGR).
  *
@@ -171,7 +234,7 @@ newport_calc_rgb888_to_bgr888(uint32_t color)
 /*
  * Calculate the colour to use for COLORVRAM.
  *
- * The input is either RGB888, RGB332 or CI8.
+ * The input is either RGB888, RGB444, CI8 or CI4.
  *
  * This uses the raw output pixel format, not the HOSTRW
  * input pixel format or (I think) the COLORI RGB layout.
@@ -182,14 +245,26 @@ newport_calc_colorvram(struct gfx_ctx *ctx, uint32_t color)
 {
 
 	switch (ctx->fb_mode) {
-	case NewportBppModeCi8:	/* output is ci8, assume ci8 in */
+	case NewportBppModeCi8:	/* output is ci8, assume ci8/ci4 in */
 		return (color & 0xff);
-	case NewportBppModeRgb24:	/* output is rgb24, assume rgb24 in for now */
-		return newport_calc_rgb888_to_fb_rgb888(color);
+	case NewportBppModeCi4:	/* output is ci4, assume ci8/ci4 in */
+		return (color & 0xf);
+	case NewportBppModeRgb24:	/* output is rgb24, assume rgb in for now */
+		return newport_calc_rgb888_to_fb_rgb888(
+		    newport_calc_input_rgb888(ctx, color));
+	case NewportBppModeRgb12:
+		/* Output is rgb12, input is either rgb12 or rgb24 */
+		if (newport_calc_input_is_rgb(ctx)) {
+			return newport_calc_rgb888_to_fb_rgb444(
+			    newport_calc_input_rgb888(ctx, color));
+		} else {
+			break;
+		}
 	case NewportBppModeRgb8:
-		/* Output is rgb8, input is either rgb8 or rgb24 */
-		if (ctx->pixel_mode == NewportBppModeRgb24) {
-			return newport_calc_rgb888_to_fb_rgb332(color);
+		/* Output is rgb8, input is either rgb12 or rgb24 */
+		if (newport_calc_input_is_rgb(ctx)) {
+			return newport_calc_rgb888_to_fb_rgb332(
+			    newport_calc_input_rgb888(ctx, color));
 		} else {
 			break;
 		}
@@ -203,14 +278,28 @@ newport_calc_colorvram(struct gfx_ctx *ctx, uint32_t color)
 }
 
 /**
- * The HOSTRW packed colour is either ABGR-8888 or CI-8.
+ * The HOSTRW packed colour is ABGR-8888, BGR-444, CI-8 or CI-4,
+ * depending on the host depth newport_calc_drawmode1() picked.
  * Any other format has to be converted to these.
  */
 uint32_t
 newport_calc_hostrw_color(struct gfx_ctx *ctx, uint32_t color)
 {
-	/* XXX for now */
-	return (color);
+	switch (ctx->pixel_mode) {
+	case NewportBppModeRgb24:
+		return newport_calc_rgb888_to_bgr888(color);
+	case NewportBppModeRgb12:
+		return ((color & 0x00f) << 8)
+		    | (color & 0x0f0)
+		    | ((color & 0xf00) >> 8);
+	case NewportBppModeCi8:
+		return (color & 0xff);
+	case NewportBppModeCi4:
+		return (color & 0xf);
+	default:
+		/* XXX for now */
+		return (color);
+	}
 }
 
 /**
@@ -219,22 +308,28 @@ newport_calc_hostrw_color(struct gfx_ctx *ctx, uint32_t color)
  *
  * The COLORI register is either CI or BGR888.
  *
- * So for CI it's just returned as-is, but for 8/12 bit colour
+ * So for CI it's just returned as-is, but for 12 bit colour
  * it will need to be expanded out to RGB888 and then converted
- * to BGR888.
+ * to BGR888.  The REX3 does the (dithered) reduction to the
+ * framebuffer depth.
  */
 uint32_t
 newport_calc_colori_color(struct gfx_ctx *ctx, uint32_t color)
 {
 	switch (ctx->fb_mode) {
-	case NewportBppModeCi8:	/* output is ci8, assume ci8 in */
+	case NewportBppModeCi8:	/* output is ci8, assume ci8/ci4 in */
 		return (color & 0xff);
-	case NewportBppModeRgb24:	/* output is rgb24, assume rgb24 in for now */
-		return newport_calc_rgb888_to_bgr888(color);
+	case NewportBppModeCi4:	/* output is ci4, assume ci8/ci4 in */
+		return (color & 0xf);
+	case NewportBppModeRgb24:	/* output is rgb24, assume rgb in for now */
+		return newport_calc_rgb888_to_bgr888(
+		    newport_calc_input_rgb888(ctx, color));
+	case NewportBppModeRgb12:
 	case NewportBppModeRgb8:
-		/* Output is bgr888, only handle rgb24 input for now */
-		if (ctx->pixel_mode == NewportBppModeRgb24) {
-			return newport_calc_rgb888_to_bgr888(color);
+		/* Output is bgr888, only handle rgb12/rgb24 input for now */
+		if (newport_calc_input_is_rgb(ctx)) {
+			return newport_calc_rgb888_to_bgr888(
+			    newport_calc_input_rgb888(ctx, color));
 		} else {
 			break;
 		}
@@ -247,6 +342,49 @@ newport_calc_colori_color(struct gfx_ctx *ctx, uint32_t color)
 	return (color);
 }
 
+/**
+ * Bulk version of newport_calc_colori_color(); the pixel format
+ * decision is made once for the whole array.
+ */
+void
+newport_calc_colori_colors(struct gfx_ctx *ctx, const uint32_t *in,
+    uint32_t *out, int n)
+{
+	int i;
+
+	switch (ctx->fb_mode) {
+	case NewportBppModeCi8:
+		for (i = 0; i < n; i++)
+			out[i] = in[i] & 0xff;
+		return;
+	case NewportBppModeCi4:
+		for (i = 0; i < n; i++)
+			out[i] = in[i] & 0xf;
+		return;
+	case NewportBppModeRgb24:
+	case NewportBppModeRgb12:
+	case NewportBppModeRgb8:
+		if (ctx->pixel_mode == NewportBppModeRgb24) {
+			for (i = 0; i < n; i++)
+				out[i] = newport_calc_rgb888_to_bgr888(in[i]);
+			return;
+		}
+		if (ctx->pixel_mode == NewportBppModeRgb12) {
+			for (i = 0; i < n; i++)
+				out[i] = newport_calc_rgb888_to_bgr888(
+				    newport_calc_rgb444_to_rgb888(in[i]));
+			return;
+		}
+		break;
+	default:
+		break;
+	}
+
+	/* Let the single pixel path complain about it */
+	for (i = 0; i < n; i++)
+		out[i] = newport_calc_colori_color(ctx, in[i]);
+}
+
 /**
  * Solid fill a rectangle with the given color value.
  *
@@ -266,18 +404,17 @@ newport_fill_rectangle_fast(struct gfx_ctx *dc, int x1, int y1, int wi,
 
 	drawmode1 = newport_calc_drawmode1(dc);
 
-	rex3_wait_gfifo_idle(dc, 0);
+	/*
+	 * The GFIFO is run in order, so the state changes only need
+	 * FIFO space, not a drained pipeline.
+	 */
+	rex3_wait_gfifo(dc, 7);
 
-	/* This stalls the pipeline */
 	rex3_write(dc, REX3_REG_DRAWMODE0, REX3_DRAWMODE0_OPCODE_DRAW |
 	    REX3_DRAWMODE0_ADRMODE_BLOCK | REX3_DRAWMODE0_DOSETUP |
 	    REX3_DRAWMODE0_STOPONX | REX3_DRAWMODE0_STOPONY);
 	rex3_write(dc, REX3_REG_CLIPMODE, 0x1e00);
 	rex3_write(dc, REX3_REG_WRMASK, newport_calc_wrmode(dc, 0xffffffff));
-
-
-	/* These do not stall the pipeline */
-	rex3_wait_gfifo(dc, 4);
 	rex3_write(dc, REX3_REG_DRAWMODE1,
 	    drawmode1 |
 	    REX3_DRAWMODE1_PLANES_RGB |
@@ -291,6 +428,8 @@ newport_fill_rectangle_fast(struct gfx_ctx *dc, int x1, int y1, int wi,
 
 	rex3_write_go(dc, REX3_REG_XYENDI, (x2 << REX3_XYENDI_XSHIFT) | y2);
 	dc->log_regio = false;
+
+	newport_stats_prim(dc, NewportPrimFill, wi * he);
 }
 
 /**
@@ -307,9 +446,8 @@ newport_fill_rectangle_setup(struct gfx_ctx *dc)
 {
 	uint32_t drawmode1;
 
-	// TODO: do I need to stall the graphics pipeline here?
-	// Will the write to drawmode1 do it for us?
-	rex3_wait_gfifo_idle(dc, 0);
+	/* FIFO space only; the GFIFO is run in order */
+	rex3_wait_gfifo(dc, 4);
 
 	drawmode1 = newport_calc_drawmode1(dc);
 	rex3_write(dc, REX3_REG_DRAWMODE1,
@@ -324,10 +462,10 @@ newport_fill_rectangle_setup(struct gfx_ctx *dc)
 	rex3_write(dc, REX3_REG_WRMASK, newport_calc_wrmode(dc, 0xffffffff));
 
 	/*
-	 * This doesn't stall the pipeline; but we're not needing
-	 * to change the state for each rectangle. Eg, if we were
-	 * using the colour iterators, we would likely need to
-	 * set DOSETUP to clear the iterator state between each fill.
+	 * Set once here rather than per rectangle, as nothing in it
+	 * changes between fills.  Eg, if we were using the colour
+	 * iterators, we would likely need to set DOSETUP to clear the
+	 * iterator state between each fill.
 	 */
 	rex3_write(dc, REX3_REG_DRAWMODE0, REX3_DRAWMODE0_OPCODE_DRAW |
 	    REX3_DRAWMODE0_ADRMODE_BLOCK | REX3_DRAWMODE0_DOSETUP |
@@ -359,18 +497,583 @@ newport_fill_rectangle(struct gfx_ctx *dc, int x1, int y1, int wi,
 	rex3_write(dc, REX3_REG_XYSTARTI, (x1 << REX3_XYSTARTI_XSHIFT) | y1);
 	rex3_write_go(dc, REX3_REG_XYENDI, (x2 << REX3_XYENDI_XSHIFT) | y2);
 	dc->log_regio = false;
+
+	newport_stats_prim(dc, NewportPrimFill, wi * he);
 }
 
-#if 0
+static int
+newport_fill_rect_cmp(const void *a, const void *b)
+{
+	uint64_t ka = *(const uint64_t *) a;
+	uint64_t kb = *(const uint64_t *) b;
+
+	return (ka < kb) ? -1 : (ka > kb);
+}
+
+/**
+ * Solid fill an array of rectangles.
+ *
+ * Like newport_fill_rectangle(), this expects
+ * newport_fill_rectangle_setup() to have been called first.
+ *
+ * The colours are converted in bulk and COLORI is only written when
+ * it changes.  If the caller passes NEWPORT_FILL_ANY_ORDER (ie the
+ * rectangles don't overlap, or painter order doesn't matter) then
+ * the rectangles are grouped by colour first so COLORI is written
+ * once per colour.
+ *
+ * FIFO slots are reserved for as many rectangles as fit in the FIFO
+ * at once rather than three at a time.
+ */
+void
+newport_fill_rectangles(struct gfx_ctx *dc, const struct newport_rect *rects,
+    int n, uint32_t flags)
+{
+	uint32_t color[NEWPORT_FILL_RECTS_CHUNK];
+	uint32_t colori[NEWPORT_FILL_RECTS_CHUNK];
+	uint64_t order[NEWPORT_FILL_RECTS_CHUNK];
+	const struct newport_rect *r;
+	uint32_t cur_colori = 0, prev;
+	bool have_colori = false, have_prev;
+	int base, cnt, i, j, nw, need, idx;
+
+	for (base = 0; base < n; base += cnt) {
+		cnt = MIN(n - base, NEWPORT_FILL_RECTS_CHUNK);
+
+		for (i = 0; i < cnt; i++)
+			color[i] = rects[base + i].color;
+		newport_calc_colori_colors(dc, color, colori, cnt);
+
+		/* Sort key is colour then original index */
+		for (i = 0; i < cnt; i++)
+			order[i] = ((uint64_t) colori[i] << 32) | i;
+		if (flags & NEWPORT_FILL_ANY_ORDER)
+			qsort(order, cnt, sizeof(order[0]),
+			    newport_fill_rect_cmp);
+
+		for (i = 0; i < cnt; ) {
+			/*
+			 * Work out exactly how many FIFO slots the next
+			 * FIFO's worth of rectangles need.
+			 */
+			nw = 0;
+			prev = cur_colori;
+			have_prev = have_colori;
+			for (j = i; j < cnt; j++) {
+				idx = order[j] & 0xffffffff;
+				need = 2;
+				if (! have_prev || colori[idx] != prev)
+					need++;
+				if (nw + need > NEWPORT_GFIFO_ENTRIES)
+					break;
+				nw += need;
+				prev = colori[idx];
+				have_prev = true;
+			}
+			rex3_wait_gfifo(dc, nw);
+
+			for (; i < j; i++) {
+				idx = order[i] & 0xffffffff;
+				r = &rects[base + idx];
+				if (! have_colori || colori[idx] != cur_colori) {
+					cur_colori = colori[idx];
+					have_colori = true;
+					rex3_write(dc, REX3_REG_COLORI, cur_colori);
+				}
+				rex3_write(dc, REX3_REG_XYSTARTI,
+				    (r->x << REX3_XYSTARTI_XSHIFT) | r->y);
+				rex3_write_go(dc, REX3_REG_XYENDI,
+				    ((r->x + r->w - 1) << REX3_XYENDI_XSHIFT) |
+				    (r->y + r->h - 1));
+				newport_stats_prim(dc, NewportPrimFill,
+				    r->w * r->h);
+			}
+		}
+	}
+}
+
+/*
+ * A FIFO's worth of pending register writes, so a caller can queue
+ * up writes and reserve exactly the right number of FIFO slots.
+ */
+struct newport_wrbatch {
+	int count;
+	uint32_t reg[NEWPORT_GFIFO_ENTRIES];
+	uint32_t val[NEWPORT_GFIFO_ENTRIES];
+};
 
 static void
+newport_wrbatch_flush(struct gfx_ctx *dc, struct newport_wrbatch *b)
+{
+	int i;
+
+	if (b->count == 0)
+		return;
+	rex3_wait_gfifo(dc, b->count);
+	for (i = 0; i < b->count; i++)
+		rex3_write(dc, b->reg[i], b->val[i]);
+	b->count = 0;
+}
+
+/*
+ * Make sure there's room for n more writes in the batch.
+ */
+static inline void
+newport_wrbatch_reserve(struct gfx_ctx *dc, struct newport_wrbatch *b, int n)
+{
+	if (b->count + n > NEWPORT_GFIFO_ENTRIES)
+		newport_wrbatch_flush(dc, b);
+}
+
+static inline void
+newport_wrbatch_add(struct newport_wrbatch *b, uint32_t reg, uint32_t val)
+{
+	b->reg[b->count] = reg;
+	b->val[b->count] = val;
+	b->count++;
+}
+
+/**
+ * Solid fill a list of spans, eg from the bres rasteriser.
+ *
+ * Runs of spans on consecutive scanlines with the same x1/x2 are sent
+ * as a single BLOCK fill; everything else goes out as a SPAN fill.
+ * DRAWMODE1 / WRMASK / CLIPMODE / COLORI are set up once for the
+ * whole list, DRAWMODE0 only when flipping between BLOCK and SPAN,
+ * and FIFO slots are reserved a FIFO's worth at a time.
+ */
+void
+newport_fill_spans(struct gfx_ctx *dc, const struct scanline_list *sl,
+    uint32_t color)
+{
+	const uint32_t dm0_block = REX3_DRAWMODE0_OPCODE_DRAW |
+	    REX3_DRAWMODE0_ADRMODE_BLOCK | REX3_DRAWMODE0_DOSETUP |
+	    REX3_DRAWMODE0_STOPONX | REX3_DRAWMODE0_STOPONY;
+	const uint32_t dm0_span = REX3_DRAWMODE0_OPCODE_DRAW |
+	    REX3_DRAWMODE0_ADRMODE_SPAN | REX3_DRAWMODE0_DOSETUP |
+	    REX3_DRAWMODE0_STOPONX;
+	const struct scanline_2d *s = sl->list;
+	struct newport_wrbatch b;
+	uint32_t dm0, cur_dm0 = 0;
+	int i, j, dir, x1, x2, y1, y2;
+
+	if (sl->cur == 0)
+		return;
+
+	b.count = 0;
+	newport_wrbatch_add(&b, REX3_REG_DRAWMODE1,
+	    newport_calc_drawmode1(dc) |
+	    REX3_DRAWMODE1_PLANES_RGB |
+	    REX3_DRAWMODE1_COMPARE_LT |
+	    REX3_DRAWMODE1_COMPARE_EQ |
+	    REX3_DRAWMODE1_COMPARE_GT |
+	    REX3_DRAWMODE1_LO_SRC);
+	newport_wrbatch_add(&b, REX3_REG_CLIPMODE, 0x1e00);
+	newport_wrbatch_add(&b, REX3_REG_WRMASK,
+	    newport_calc_wrmode(dc, 0xffffffff));
+	newport_wrbatch_add(&b, REX3_REG_COLORI,
+	    newport_calc_colori_color(dc, color));
+
+	for (i = 0; i < sl->cur; i = j) {
+		x1 = MIN(s[i].x1, s[i].x2);
+		x2 = MAX(s[i].x1, s[i].x2);
+		y1 = y2 = s[i].y;
+
+		/*
+		 * Extend the run while the next span is on the next
+		 * scanline (either direction; flat top triangles walk
+		 * upwards) with the same extent.
+		 */
+		dir = 0;
+		for (j = i + 1; j < sl->cur; j++) {
+			if (MIN(s[j].x1, s[j].x2) != x1 ||
+			    MAX(s[j].x1, s[j].x2) != x2)
+				break;
+			if (dir == 0 && (s[j].y == y2 + 1 || s[j].y == y2 - 1))
+				dir = s[j].y - y2;
+			if (dir == 0 || s[j].y != y2 + dir)
+				break;
+			y2 = s[j].y;
+		}
+		if (y2 < y1) {
+			int t = y1; y1 = y2; y2 = t;
+		}
+
+		dm0 = (j - i > 1) ? dm0_block : dm0_span;
+		newport_wrbatch_reserve(dc, &b, (dm0 != cur_dm0) ? 3 : 2);
+		if (dm0 != cur_dm0) {
+			newport_wrbatch_add(&b, REX3_REG_DRAWMODE0, dm0);
+			cur_dm0 = dm0;
+		}
+		newport_wrbatch_add(&b, REX3_REG_XYSTARTI,
+		    (x1 << REX3_XYSTARTI_XSHIFT) | y1);
+		newport_wrbatch_add(&b, REX3_REG_XYENDI | REX3_REG_GO,
+		    (x2 << REX3_XYENDI_XSHIFT) | y2);
+
+		newport_stats_prim(dc, NewportPrimSpan,
+		    (x2 - x1 + 1) * (y2 - y1 + 1));
+	}
+	newport_wrbatch_flush(dc, &b);
+}
+
+/**
+ * Build a 32x32 pattern from an 8x8 one (bit 7 of each byte is the
+ * leftmost pixel) by replicating it.
+ */
+void
+newport_pattern_init_8x8(struct newport_pattern *pat, const uint8_t bits[8])
+{
+	int y;
+
+	for (y = 0; y < 32; y++)
+		pat->rows[y] = bits[y & 7] * 0x01010101U;
+}
+
+/**
+ * Fill a rectangle with a one bit stipple pattern: set bits are drawn
+ * in fg, clear bits in bg with NEWPORT_PATTERN_OPAQUE or not at all
+ * otherwise.  The pattern is anchored to the screen origin so
+ * neighbouring fills line up.
+ *
+ * The REX3 expands the pattern itself: the fill is sent as BLOCK
+ * fills at most 32 pixels wide with ENZPATTERN set, and each GO
+ * write to ZPATTERN draws the next row.  So it's one register write
+ * per row per 32 pixel column instead of uploading the expanded
+ * pixels through HOSTRW.
+ */
+void
+newport_fill_pattern(struct gfx_ctx *dc, int x1, int y1, int wi, int he,
+    const struct newport_pattern *pat, uint32_t fg, uint32_t bg,
+    uint32_t flags)
+{
+	struct newport_wrbatch b;
+	uint32_t dm0, row;
+	int x, y, x2, y2, xe, sh;
+
+	if (wi <= 0 || he <= 0)
+		return;
+	x2 = x1 + wi - 1;
+	y2 = y1 + he - 1;
+
+	dm0 = REX3_DRAWMODE0_OPCODE_DRAW | REX3_DRAWMODE0_ADRMODE_BLOCK |
+	    REX3_DRAWMODE0_DOSETUP | REX3_DRAWMODE0_STOPONX |
+	    REX3_DRAWMODE0_ENZPATTERN;
+	if (flags & NEWPORT_PATTERN_OPAQUE)
+		dm0 |= REX3_DRAWMODE0_ZPOPAQUE;
+
+	b.count = 0;
+	newport_wrbatch_add(&b, REX3_REG_DRAWMODE1,
+	    newport_calc_drawmode1(dc) |
+	    REX3_DRAWMODE1_PLANES_RGB |
+	    REX3_DRAWMODE1_COMPARE_LT |
+	    REX3_DRAWMODE1_COMPARE_EQ |
+	    REX3_DRAWMODE1_COMPARE_GT |
+	    REX3_DRAWMODE1_LO_SRC);
+	newport_wrbatch_add(&b, REX3_REG_CLIPMODE, 0x1e00);
+	newport_wrbatch_add(&b, REX3_REG_WRMASK,
+	    newport_calc_wrmode(dc, 0xffffffff));
+	newport_wrbatch_add(&b, REX3_REG_DRAWMODE0, dm0);
+	newport_wrbatch_add(&b, REX3_REG_COLORI,
+	    newport_calc_colori_color(dc, fg));
+	if (flags & NEWPORT_PATTERN_OPAQUE)
+		newport_wrbatch_add(&b, REX3_REG_COLORBACK,
+		    newport_calc_colori_color(dc, bg));
+
+	/* Columns end on 32 pixel screen boundaries */
+	for (x = x1; x <= x2; x = xe + 1) {
+		xe = MIN(x | 31, x2);
+		sh = x & 31;
+
+		newport_wrbatch_reserve(dc, &b, 2);
+		newport_wrbatch_add(&b, REX3_REG_XYSTARTI,
+		    (x << REX3_XYSTARTI_XSHIFT) | y1);
+		newport_wrbatch_add(&b, REX3_REG_XYENDI,
+		    (xe << REX3_XYENDI_XSHIFT) | y2);
+
+		for (y = y1; y <= y2; y++) {
+			/* Line the pattern's MSB up with the column start */
+			row = pat->rows[y & 31];
+			if (sh != 0)
+				row = (row << sh) | (row >> (32 - sh));
+			newport_wrbatch_reserve(dc, &b, 1);
+			newport_wrbatch_add(&b, REX3_REG_ZPATTERN | REX3_REG_GO,
+			    row);
+		}
+	}
+	newport_wrbatch_flush(dc, &b);
+
+	newport_stats_prim(dc, NewportPrimFill, wi * he);
+}
+
+/**
+ * Draw a single pixel wide line from (x1, y1) to (x2, y2), inclusive.
+ *
+ * This uses the REX3 integer line mode, so the hardware does the
+ * Bresenham setup for us.
+ */
+void
+newport_draw_line(struct gfx_ctx *dc, int x1, int y1, int x2, int y2,
+    uint32_t color)
+{
+	rex3_wait_gfifo(dc, 6);
+	rex3_write(dc, REX3_REG_DRAWMODE0, REX3_DRAWMODE0_OPCODE_DRAW |
+	    REX3_DRAWMODE0_ADRMODE_I_LINE | REX3_DRAWMODE0_DOSETUP |
+	    REX3_DRAWMODE0_STOPONX | REX3_DRAWMODE0_STOPONY);
+	rex3_write(dc, REX3_REG_DRAWMODE1,
+	    newport_calc_drawmode1(dc) |
+	    REX3_DRAWMODE1_PLANES_RGB |
+	    REX3_DRAWMODE1_COMPARE_LT |
+	    REX3_DRAWMODE1_COMPARE_EQ |
+	    REX3_DRAWMODE1_COMPARE_GT |
+	    REX3_DRAWMODE1_LO_SRC);
+	rex3_write(dc, REX3_REG_COLORI, newport_calc_colori_color(dc, color));
+	rex3_write(dc, REX3_REG_XYSTARTI, (x1 << REX3_XYSTARTI_XSHIFT) | y1);
+	rex3_write_go(dc, REX3_REG_XYENDI, (x2 << REX3_XYENDI_XSHIFT) | y2);
+
+	newport_stats_prim(dc, NewportPrimLine,
+	    MAX(abs(x2 - x1), abs(y2 - y1)) + 1);
+}
+
+/*
+ * Antialiased lines only work when the REX3 is blending RGB pixels;
+ * CI framebuffers (or CI input colours) get plain integer lines.
+ */
+static bool
+newport_aa_supported(struct gfx_ctx *dc)
+{
+	if (! newport_calc_input_is_rgb(dc))
+		return false;
+	return (dc->fb_mode == NewportBppModeRgb24 ||
+	    dc->fb_mode == NewportBppModeRgb12 ||
+	    dc->fb_mode == NewportBppModeRgb8);
+}
+
+static inline int
+newport_subpixel_round(int v)
+{
+	return ((v + NEWPORT_SUBPIXEL_ONE / 2) >> NEWPORT_SUBPIXEL_BITS);
+}
+
+static inline uint32_t
+newport_aa_coord(int v)
+{
+	return ((uint32_t) v << REX3_COORD_SHIFT);
+}
+
+static inline int
+newport_aa_npixels(int x1, int y1, int x2, int y2)
+{
+	return (MAX(abs(newport_subpixel_round(x2) -
+	    newport_subpixel_round(x1)), abs(newport_subpixel_round(y2) -
+	    newport_subpixel_round(y1))) + 1);
+}
+
+/*
+ * Queue the state for a run of antialiased lines.  The A_LINE
+ * engine turns each pixel's coverage into the source alpha, which
+ * is then blended over the framebuffer.
+ */
+static void
+newport_aa_setup(struct gfx_ctx *dc, struct newport_wrbatch *b,
+    uint32_t dm0)
+{
+	newport_wrbatch_add(b, REX3_REG_DRAWMODE1,
+	    newport_calc_drawmode1(dc) |
+	    REX3_DRAWMODE1_PLANES_RGB |
+	    REX3_DRAWMODE1_COMPARE_LT |
+	    REX3_DRAWMODE1_COMPARE_EQ |
+	    REX3_DRAWMODE1_COMPARE_GT |
+	    REX3_DRAWMODE1_LO_SRC |
+	    REX3_DRAWMODE1_BLEND |
+	    REX3_DRAWMODE1_SFACTOR_SA |
+	    REX3_DRAWMODE1_DFACTOR_MSA);
+	newport_wrbatch_add(b, REX3_REG_CLIPMODE, 0x1e00);
+	newport_wrbatch_add(b, REX3_REG_WRMASK,
+	    newport_calc_wrmode(dc, 0xffffffff));
+	newport_wrbatch_add(b, REX3_REG_COLORALPHA, 0xff << REX3_COLOR_SHIFT);
+	newport_wrbatch_add(b, REX3_REG_DRAWMODE0, dm0);
+}
+
+/*
+ * Queue a colour change; four writes.
+ */
+static void
+newport_aa_color(struct gfx_ctx *dc, struct newport_wrbatch *b,
+    uint32_t color)
+{
+	uint32_t rgb = newport_calc_input_rgb888(dc, color);
+
+	newport_wrbatch_add(b, REX3_REG_COLORI,
+	    newport_calc_colori_color(dc, color));
+	newport_wrbatch_add(b, REX3_REG_COLORRED,
+	    ((rgb >> 16) & 0xff) << REX3_COLOR_SHIFT);
+	newport_wrbatch_add(b, REX3_REG_COLORGREEN,
+	    ((rgb >> 8) & 0xff) << REX3_COLOR_SHIFT);
+	newport_wrbatch_add(b, REX3_REG_COLORBLUE,
+	    (rgb & 0xff) << REX3_COLOR_SHIFT);
+}
+
+/*
+ * Queue the endpoints of one line; the YEND write starts it.
+ */
+static void
+newport_aa_segment(struct newport_wrbatch *b, int x1, int y1, int x2,
+    int y2)
+{
+	newport_wrbatch_add(b, REX3_REG_XSTART, newport_aa_coord(x1));
+	newport_wrbatch_add(b, REX3_REG_YSTART, newport_aa_coord(y1));
+	newport_wrbatch_add(b, REX3_REG_XEND, newport_aa_coord(x2));
+	newport_wrbatch_add(b, REX3_REG_YEND | REX3_REG_GO,
+	    newport_aa_coord(y2));
+}
+
+static uint32_t
+newport_aa_drawmode0(uint32_t flags)
+{
+	uint32_t dm0;
+
+	dm0 = REX3_DRAWMODE0_OPCODE_DRAW | REX3_DRAWMODE0_ADRMODE_A_LINE |
+	    REX3_DRAWMODE0_DOSETUP | REX3_DRAWMODE0_STOPONX |
+	    REX3_DRAWMODE0_STOPONY;
+	if (flags & NEWPORT_AA_ENDPTFILTER)
+		dm0 |= REX3_DRAWMODE0_ENDPTFILTER;
+	return (dm0);
+}
+
+/**
+ * Draw a batch of antialiased lines.  Endpoints are in subpixel
+ * (12.4 fixed point) units, with integer values on pixel centres.
+ *
+ * The blend state is set up once for the batch, the colour only
+ * when it changes, and each line is then four register writes.
+ * With NEWPORT_AA_ENDPTFILTER the endpoint pixels are faded by how
+ * much of them the line actually covers.
+ */
+void
+newport_draw_lines_aa(struct gfx_ctx *dc, const struct newport_aa_line *lines,
+    int n, uint32_t flags)
+{
+	const struct newport_aa_line *l;
+	struct newport_wrbatch b;
+	uint64_t npix = 0;
+	uint32_t color = 0;
+	int i;
+
+	if (n <= 0)
+		return;
+
+	if (! newport_aa_supported(dc)) {
+		for (i = 0; i < n; i++) {
+			l = &lines[i];
+			newport_draw_line(dc, newport_subpixel_round(l->x1),
+			    newport_subpixel_round(l->y1),
+			    newport_subpixel_round(l->x2),
+			    newport_subpixel_round(l->y2), l->color);
+		}
+		return;
+	}
+
+	b.count = 0;
+	newport_aa_setup(dc, &b, newport_aa_drawmode0(flags));
+	for (i = 0; i < n; i++) {
+		l = &lines[i];
+		if (i == 0 || l->color != color) {
+			newport_wrbatch_reserve(dc, &b, 8);
+			newport_aa_color(dc, &b, l->color);
+			color = l->color;
+		} else
+			newport_wrbatch_reserve(dc, &b, 4);
+		newport_aa_segment(&b, l->x1, l->y1, l->x2, l->y2);
+		npix += newport_aa_npixels(l->x1, l->y1, l->x2, l->y2);
+	}
+	newport_wrbatch_flush(dc, &b);
+
+	newport_stats_prim(dc, NewportPrimLine, npix);
+}
+
+/**
+ * Draw a single antialiased line; see newport_draw_lines_aa().
+ */
+void
+newport_draw_line_aa(struct gfx_ctx *dc, int x1, int y1, int x2, int y2,
+    uint32_t color, uint32_t flags)
+{
+	struct newport_aa_line l;
+
+	l.x1 = x1;
+	l.y1 = y1;
+	l.x2 = x2;
+	l.y2 = y2;
+	l.color = color;
+	newport_draw_lines_aa(dc, &l, 1, flags);
+}
+
+/**
+ * Draw an antialiased polyline through npts subpixel points.
+ *
+ * Every segment after the first skips its first pixel so the joints
+ * aren't blended twice.  NEWPORT_AA_ENDPTFILTER only makes sense for
+ * the two open ends, but the REX3 applies it to every segment, so
+ * it's only used when there's a single segment.
+ */
+void
+newport_draw_polyline_aa(struct gfx_ctx *dc, const struct newport_subpoint *pts,
+    int npts, uint32_t color, uint32_t flags)
+{
+	struct newport_wrbatch b;
+	uint64_t npix = 0;
+	uint32_t dm0;
+	int i;
+
+	if (npts < 2)
+		return;
+
+	if (! newport_aa_supported(dc)) {
+		for (i = 1; i < npts; i++)
+			newport_draw_line(dc,
+			    newport_subpixel_round(pts[i - 1].x),
+			    newport_subpixel_round(pts[i - 1].y),
+			    newport_subpixel_round(pts[i].x),
+			    newport_subpixel_round(pts[i].y), color);
+		return;
+	}
+
+	if (npts > 2)
+		flags &= ~NEWPORT_AA_ENDPTFILTER;
+	dm0 = newport_aa_drawmode0(flags);
+
+	b.count = 0;
+	newport_aa_setup(dc, &b, dm0);
+	newport_aa_color(dc, &b, color);
+	for (i = 1; i < npts; i++) {
+		newport_wrbatch_reserve(dc, &b, 5);
+		if (i == 2)
+			newport_wrbatch_add(&b, REX3_REG_DRAWMODE0,
+			    dm0 | REX3_DRAWMODE0_SKIPFIRST);
+		newport_aa_segment(&b, pts[i - 1].x, pts[i - 1].y,
+		    pts[i].x, pts[i].y);
+		npix += newport_aa_npixels(pts[i - 1].x, pts[i - 1].y,
+		    pts[i].x, pts[i].y);
+	}
+	newport_wrbatch_flush(dc, &b);
+
+	newport_stats_prim(dc, NewportPrimLine, npix);
+}
+
+/**
+ * Screen to screen copy of a (wi x he) block from (xs, ys) to (xd, yd)
+ * using the given logic op (REX3_DRAWMODE1_LO_*).
+ *
+ * The copy direction is picked so overlapping source/destination
+ * blocks copy correctly.
+ */
+void
 newport_bitblt(struct gfx_ctx *dc, int xs, int ys, int xd,
-    int yd, int wi, int he, int rop)
+    int yd, int wi, int he, uint32_t rop)
 {
 	int xe, ye;
 	uint32_t tmp;
 
-	rex3_wait_gfifo(dc);
 	if (yd > ys) {
 		/* need to copy bottom up */
 		ye = ys;
@@ -387,18 +1090,17 @@ newport_bitblt(struct gfx_ctx *dc, int xs, int ys, int xd,
 	} else
 		xe = xs + wi - 1;
 
+	rex3_wait_gfifo(dc, 5);
 	rex3_write(dc, REX3_REG_DRAWMODE0, REX3_DRAWMODE0_OPCODE_SCR2SCR |
 	    REX3_DRAWMODE0_ADRMODE_BLOCK | REX3_DRAWMODE0_DOSETUP |
 	    REX3_DRAWMODE0_STOPONX | REX3_DRAWMODE0_STOPONY);
 	rex3_write(dc, REX3_REG_DRAWMODE1,
-	    REX3_DRAWMODE1_PLANES_CI |
-	    REX3_DRAWMODE1_DD_DD8 |
-	    REX3_DRAWMODE1_RWPACKED |
-	    REX3_DRAWMODE1_HD_HD8 |
+	    newport_calc_drawmode1(dc) |
+	    REX3_DRAWMODE1_PLANES_RGB |
 	    REX3_DRAWMODE1_COMPARE_LT |
 	    REX3_DRAWMODE1_COMPARE_EQ |
 	    REX3_DRAWMODE1_COMPARE_GT |
-	    ((rop << 28) & REX3_DRAWMODE1_LOGICOP_MASK));
+	    (rop & REX3_DRAWMODE1_LOGICOP_MASK));
 	rex3_write(dc, REX3_REG_XYSTARTI, (xs << REX3_XYSTARTI_XSHIFT) | ys);
 	rex3_write(dc, REX3_REG_XYENDI, (xe << REX3_XYENDI_XSHIFT) | ye);
 
@@ -406,8 +1108,179 @@ newport_bitblt(struct gfx_ctx *dc, int xs, int ys, int xd,
 	tmp |= (xd - xs) << REX3_XYMOVE_XSHIFT;
 
 	rex3_write_go(dc, REX3_REG_XYMOVE, tmp);
+
+	newport_stats_prim(dc, NewportPrimBlit, wi * he);
+}
+
+/**
+ * Upload a (wi x he) image from host memory to (x1, y1).
+ *
+ * The source pixels are in ctx->pixel_mode format, one per uint32_t,
+ * with stride given in pixels.  They're pushed through HOSTRW0 in
+ * packed mode, most significant pixel first, continuing across rows:
+ * eight 4 bit, four 8 bit or two 12 bit (in 16 bit halves) host
+ * pixels per write, or one 24 bit pixel.
+ */
+void
+newport_upload_image(struct gfx_ctx *dc, int x1, int y1, int wi, int he,
+    const uint32_t *pixels, int stride)
+{
+	uint32_t drawmode1, word, pix;
+	int x2 = x1 + wi - 1;
+	int y2 = y1 + he - 1;
+	int x, y, npix, ppw, bits, nwords, nleft;
+
+	drawmode1 = newport_calc_drawmode1(dc);
+	switch (drawmode1 & REX3_DRAWMODE1_HD_MASK) {
+	case REX3_DRAWMODE1_HD_HD4:
+		bits = 4;
+		break;
+	case REX3_DRAWMODE1_HD_HD8:
+		bits = 8;
+		break;
+	case REX3_DRAWMODE1_HD_HD12:
+		bits = 16;
+		break;
+	default:
+		bits = 32;
+		break;
+	}
+	ppw = 32 / bits;
+
+	rex3_wait_gfifo(dc, 4);
+	rex3_write(dc, REX3_REG_DRAWMODE0, REX3_DRAWMODE0_OPCODE_DRAW |
+	    REX3_DRAWMODE0_ADRMODE_BLOCK | REX3_DRAWMODE0_DOSETUP |
+	    REX3_DRAWMODE0_STOPONX | REX3_DRAWMODE0_STOPONY |
+	    REX3_DRAWMODE0_COLORHOST);
+	rex3_write(dc, REX3_REG_DRAWMODE1,
+	    drawmode1 |
+	    REX3_DRAWMODE1_PLANES_RGB |
+	    REX3_DRAWMODE1_COMPARE_LT |
+	    REX3_DRAWMODE1_COMPARE_EQ |
+	    REX3_DRAWMODE1_COMPARE_GT |
+	    REX3_DRAWMODE1_LO_SRC);
+	rex3_write(dc, REX3_REG_XYSTARTI, (x1 << REX3_XYSTARTI_XSHIFT) | y1);
+	rex3_write(dc, REX3_REG_XYENDI, (x2 << REX3_XYENDI_XSHIFT) | y2);
+
+	/*
+	 * Reserve FIFO slots a FIFO's worth at a time rather than
+	 * checking for each pixel word.
+	 */
+	nleft = (wi * he + ppw - 1) / ppw;
+	nwords = 0;
+	npix = 0;
+	word = 0;
+	for (y = 0; y < he; y++) {
+		for (x = 0; x < wi; x++) {
+			pix = newport_calc_hostrw_color(dc,
+			    pixels[y * stride + x]);
+			if (ppw == 1)
+				word = pix;
+			else
+				word = (word << bits) |
+				    (pix & ((1U << bits) - 1));
+			if (++npix < ppw)
+				continue;
+			if (nwords == 0) {
+				nwords = MIN(nleft, NEWPORT_GFIFO_ENTRIES);
+				rex3_wait_gfifo(dc, nwords);
+			}
+			rex3_write_go(dc, REX3_REG_HOSTRW0, word);
+			nwords--;
+			nleft--;
+			npix = 0;
+			word = 0;
+		}
+	}
+
+	/* Flush the final partial word */
+	if (npix != 0) {
+		word <<= bits * (ppw - npix);
+		if (nwords == 0)
+			rex3_wait_gfifo(dc, 1);
+		rex3_write_go(dc, REX3_REG_HOSTRW0, word);
+	}
+
+	newport_stats_prim(dc, NewportPrimUpload, wi * he);
+}
+
+/**
+ * Upload a (wi x he) image of raw 8 bit framebuffer / CI pixels
+ * to (x1, y1), generating it a row at a time.
+ *
+ * row_cb is called for each row in turn to fill in wi bytes; the
+ * pixels are written as-is (DD8 / HD8, no RGBMODE), four to a
+ * HOSTRW write, packed the same way as newport_upload_image().
+ * This is for callers doing their own conversion to 8 bits (eg
+ * dithering, palette lookups) without a whole-image buffer.
+ */
+bool
+newport_upload_image_rows(struct gfx_ctx *dc, int x1, int y1, int wi,
+    int he, newport_upload_row_cb *row_cb, void *arg)
+{
+	uint8_t *row;
+	uint32_t word = 0;
+	int x, y, npix = 0, nwords = 0, nleft;
+	int x2 = x1 + wi - 1;
+	int y2 = y1 + he - 1;
+
+	if (wi <= 0 || he <= 0)
+		return true;
+
+	row = malloc(wi);
+	if (row == NULL)
+		return false;
+
+	rex3_wait_gfifo(dc, 4);
+	rex3_write(dc, REX3_REG_DRAWMODE0, REX3_DRAWMODE0_OPCODE_DRAW |
+	    REX3_DRAWMODE0_ADRMODE_BLOCK | REX3_DRAWMODE0_DOSETUP |
+	    REX3_DRAWMODE0_STOPONX | REX3_DRAWMODE0_STOPONY |
+	    REX3_DRAWMODE0_COLORHOST);
+	rex3_write(dc, REX3_REG_DRAWMODE1,
+	    REX3_DRAWMODE1_DD_DD8 |
+	    REX3_DRAWMODE1_RWPACKED |
+	    REX3_DRAWMODE1_HD_HD8 |
+	    REX3_DRAWMODE1_PLANES_RGB |
+	    REX3_DRAWMODE1_COMPARE_LT |
+	    REX3_DRAWMODE1_COMPARE_EQ |
+	    REX3_DRAWMODE1_COMPARE_GT |
+	    REX3_DRAWMODE1_LO_SRC);
+	rex3_write(dc, REX3_REG_XYSTARTI, (x1 << REX3_XYSTARTI_XSHIFT) | y1);
+	rex3_write(dc, REX3_REG_XYENDI, (x2 << REX3_XYENDI_XSHIFT) | y2);
+
+	nleft = (wi * he + 3) / 4;
+	for (y = 0; y < he; y++) {
+		row_cb(arg, y, row);
+
+		for (x = 0; x < wi; x++) {
+			word = (word << 8) | row[x];
+			if (++npix < 4)
+				continue;
+			if (nwords == 0) {
+				nwords = MIN(nleft, NEWPORT_GFIFO_ENTRIES);
+				rex3_wait_gfifo(dc, nwords);
+			}
+			rex3_write_go(dc, REX3_REG_HOSTRW0, word);
+			nwords--;
+			nleft--;
+			npix = 0;
+			word = 0;
+		}
+	}
+
+	/* Flush the final partial word */
+	if (npix != 0) {
+		word <<= 8 * (4 - npix);
+		if (nwords == 0)
+			rex3_wait_gfifo(dc, 1);
+		rex3_write_go(dc, REX3_REG_HOSTRW0, word);
+	}
+
+	free(row);
+
+	newport_stats_prim(dc, NewportPrimUpload, wi * he);
+	return true;
 }
-#endif
 
 bool
 newport_setup_hw(struct gfx_ctx *dc)
@@ -457,6 +1330,17 @@ newport_setup_hw(struct gfx_ctx *dc)
 		newport_setup_hw_xmap9_modes(dc, XMAP9_MODE_GAMMA_BYPASS |
 		    XMAP9_MODE_PIXSIZE_24BPP | XMAP9_MODE_PIXMODE_RGB2);
 		break;
+	case NewportBppModeRgb12:
+		printf("%s: Configuring output 12 bit RGB\n", __func__);
+		newport_setup_hw_xmap9_modes(dc, XMAP9_MODE_GAMMA_BYPASS |
+		    XMAP9_MODE_PIXSIZE_12BPP | XMAP9_MODE_PIXMODE_RGB2);
+		break;
+	case NewportBppModeCi4:
+		printf("%s: Configuring output 4 bit CI\n", __func__);
+		/* Uses the first 16 entries of the CI table below */
+		newport_setup_hw_xmap9_modes(dc, XMAP9_MODE_GAMMA_BYPASS |
+		    XMAP9_MODE_PIXSIZE_4BPP | XMAP9_MODE_PIXMODE_CI);
+		break;
 	case NewportBppModeCi8:
 		printf("%s: Configuring output 8 bit CI\n", __func__);
 		/*
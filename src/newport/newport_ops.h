@@ -1,6 +1,56 @@
 #ifndef	__NEWPORT_OPS_H__
 #define	__NEWPORT_OPS_H__
 
+struct scanline_list;
+
+struct newport_rect {
+	int x, y, w, h;
+	uint32_t color;
+};
+
+/* A 32x32 one bit pattern; bit 31 of each row is the leftmost pixel */
+struct newport_pattern {
+	uint32_t rows[32];
+};
+
+/* newport_fill_pattern() draws clear pattern bits in the background */
+#define	NEWPORT_PATTERN_OPAQUE		0x00000001
+
+/* newport_fill_rectangles() may reorder the rectangles */
+#define	NEWPORT_FILL_ANY_ORDER		0x00000001
+
+/*
+ * Subpixel coordinates for the antialiased line calls: 12.4 fixed
+ * point, with integer values on pixel centres.
+ */
+#define	NEWPORT_SUBPIXEL_BITS		4
+#define	NEWPORT_SUBPIXEL_ONE		(1 << NEWPORT_SUBPIXEL_BITS)
+#define	NEWPORT_INT_TO_SUBPIXEL(v)	((v) * NEWPORT_SUBPIXEL_ONE)
+
+struct newport_subpoint {
+	int x, y;
+};
+
+struct newport_aa_line {
+	int x1, y1, x2, y2;
+	uint32_t color;
+};
+
+/* Fade antialiased line endpoints by their subpixel coverage */
+#define	NEWPORT_AA_ENDPTFILTER		0x00000001
+
+/* Fills in one row of raw 8 bit pixels for newport_upload_image_rows() */
+typedef void newport_upload_row_cb(void *arg, int y, uint8_t *row);
+
+/* How many rectangles newport_fill_rectangles() converts / sorts at once */
+#define	NEWPORT_FILL_RECTS_CHUNK	256
+
+extern	uint32_t newport_calc_rgb888_to_fb_rgb888(uint32_t color);
+extern	uint32_t newport_calc_rgb888_to_fb_rgb332(uint32_t color);
+extern	uint32_t newport_calc_rgb888_to_fb_rgb444(uint32_t color);
+extern	uint32_t newport_calc_rgb444_to_rgb888(uint32_t color);
+extern	uint32_t newport_calc_rgb888_to_bgr888(uint32_t color);
+
 extern	uint32_t newport_calc_drawmode1(struct gfx_ctx *ctx);
 extern	uint32_t newport_calc_wrmode(struct gfx_ctx *ctx,
 	    uint32_t planemask);
@@ -10,6 +60,8 @@ extern	uint32_t newport_calc_hostrw_color(struct gfx_ctx *ctx,
 	    uint32_t color);
 extern	uint32_t newport_calc_colori_color(struct gfx_ctx *ctx,
 	    uint32_t color);
+extern	void newport_calc_colori_colors(struct gfx_ctx *ctx,
+	    const uint32_t *in, uint32_t *out, int n);
 
 extern	void newport_fill_rectangle_fast(struct gfx_ctx *dc, int x1, int y1,
 	    int wi, int he, uint32_t color);
@@ -17,6 +69,32 @@ extern	void newport_fill_rectangle_fast(struct gfx_ctx *dc, int x1, int y1,
 extern	void newport_fill_rectangle_setup(struct gfx_ctx *dc);
 extern	void newport_fill_rectangle(struct gfx_ctx *dc, int x1, int y1,
 	    int wi, int he, uint32_t color);
+extern	void newport_fill_rectangles(struct gfx_ctx *dc,
+	    const struct newport_rect *rects, int n, uint32_t flags);
+extern	void newport_fill_spans(struct gfx_ctx *dc,
+	    const struct scanline_list *sl, uint32_t color);
+
+extern	void newport_pattern_init_8x8(struct newport_pattern *pat,
+	    const uint8_t bits[8]);
+extern	void newport_fill_pattern(struct gfx_ctx *dc, int x1, int y1,
+	    int wi, int he, const struct newport_pattern *pat, uint32_t fg,
+	    uint32_t bg, uint32_t flags);
+
+extern	void newport_draw_line(struct gfx_ctx *dc, int x1, int y1,
+	    int x2, int y2, uint32_t color);
+extern	void newport_draw_lines_aa(struct gfx_ctx *dc,
+	    const struct newport_aa_line *lines, int n, uint32_t flags);
+extern	void newport_draw_line_aa(struct gfx_ctx *dc, int x1, int y1,
+	    int x2, int y2, uint32_t color, uint32_t flags);
+extern	void newport_draw_polyline_aa(struct gfx_ctx *dc,
+	    const struct newport_subpoint *pts, int npts, uint32_t color,
+	    uint32_t flags);
+extern	void newport_bitblt(struct gfx_ctx *dc, int xs, int ys, int xd,
+	    int yd, int wi, int he, uint32_t rop);
+extern	void newport_upload_image(struct gfx_ctx *dc, int x1, int y1,
+	    int wi, int he, const uint32_t *pixels, int stride);
+extern	bool newport_upload_image_rows(struct gfx_ctx *dc, int x1, int y1,
+	    int wi, int he, newport_upload_row_cb *row_cb, void *arg);
 
 extern	bool newport_setup_hw(struct gfx_ctx *dc);
 
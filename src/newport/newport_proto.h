@@ -0,0 +1,86 @@
+#ifndef	__NEWPORT_PROTO_H__
+#define	__NEWPORT_PROTO_H__
+
+#include <stdatomic.h>
+
+/*
+ * Local drawing server protocol.
+ *
+ * A client connects to the server's UNIX socket and is handed a
+ * file descriptor for a shared memory region (SCM_RIGHTS) along with
+ * a struct newport_proto_hello.  The region holds a
+ * struct newport_proto_shm header, a single producer / single consumer
+ * ring of struct newport_proto_cmd and an image upload area.
+ *
+ * The client writes commands into the ring and pixel data into the
+ * image area, then bumps head.  The server runs commands straight
+ * out of the shared memory and bumps tail as it goes; once tail has
+ * passed an upload the client may reuse its pixels.
+ *
+ * Writing a byte to the socket wakes up the server; it's only needed
+ * once per batch of commands, not per command.
+ */
+
+#define	NEWPORT_PROTO_MAGIC		0x4e505254	/* NPRT */
+#define	NEWPORT_PROTO_VERSION		1
+#define	NEWPORT_PROTO_SOCKET		"/tmp/newport.sock"
+
+#define	NEWPORT_PROTO_RING_ENTRIES	4096
+
+typedef enum {
+	NewportProtoCmdNone = 0,
+	NewportProtoCmdFill = 1,
+	NewportProtoCmdBlit = 2,
+	NewportProtoCmdLine = 3,
+	NewportProtoCmdUpload = 4,
+} NewportProtoCmdType;
+
+/*
+ * A single command; 32 bytes.
+ *
+ * fill:   (x, y, w, h) in color
+ * blit:   (x, y, w, h) to (x2, y2)
+ * line:   (x, y) to (x2, y2) in color
+ * upload: (x, y, w, h) from image area pixel offset / stride
+ */
+struct newport_proto_cmd {
+	uint32_t type;
+	uint32_t color;
+	int16_t x, y;
+	int16_t w, h;
+	int16_t x2, y2;
+	uint32_t offset;
+	uint32_t stride;
+	uint32_t pad;
+};
+
+struct newport_proto_shm {
+	uint32_t magic;
+	uint32_t version;
+
+	/* Power of two */
+	uint32_t ring_entries;
+	/* Byte offsets from the start of the mapping */
+	uint32_t ring_offset;
+	uint32_t image_offset;
+	/* Image area size, in uint32_t pixels */
+	uint32_t image_size;
+
+	/* Written by the client */
+	_Atomic uint32_t head __attribute__((aligned(64)));
+
+	/* Written by the server */
+	_Atomic uint32_t tail __attribute__((aligned(64)));
+	/* Commands the server refused to run */
+	_Atomic uint32_t nerrors;
+};
+
+struct newport_proto_hello {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t shm_size;
+	uint32_t fb_width;
+	uint32_t fb_height;
+};
+
+#endif	/* __NEWPORT_PROTO_H__ */
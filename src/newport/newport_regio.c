@@ -5,7 +5,6 @@
 #include <stdint.h>
 #include <fcntl.h>
 #include <strings.h>
-#include <dev/wscons/wsconsio.h>
 #include <err.h>
 
 #include <sys/ioctl.h>
@@ -14,6 +13,8 @@
 #include "newport_regs.h"
 #include "newport_ctx.h"
 #include "newport_regio.h"
+#include "newport_sim.h"
+#include "newport_stats.h"
 
 /*
  * Note: I'm mmap()'ing the rex3 registers at 0x0, not 0xf0000.
@@ -27,6 +28,17 @@ rex3_write(struct gfx_ctx *ctx, uint32_t rexreg, uint32_t val)
 	if (ctx->log_regio)
 		printf("%s: 0x%04x <- 0x%08x\n", __func__, rexreg, val);
 
+	ctx->stats.reg_writes[newport_stats_regclass(rexreg)]++;
+	if (rexreg & REX3_REG_GO)
+		ctx->stats.go_writes++;
+	if (rexreg == REX3_REG_DCBMODE)
+		ctx->stats.dcb_xfers++;
+
+	if (ctx->sim != NULL) {
+		newport_sim_write(ctx->sim, rexreg, val);
+		return;
+	}
+
 	reg = (volatile uint32_t *)(((char *) ctx->addr) + rexreg);
 	*reg = val;
 }
@@ -37,8 +49,14 @@ rex3_read(struct gfx_ctx *ctx, uint32_t rexreg)
 	volatile uint32_t *reg;
 	uint32_t val;
 
-	reg = (volatile uint32_t *)(((char *) ctx->addr) + rexreg);
-	val = *reg;
+	ctx->stats.reg_reads[newport_stats_regclass(rexreg)]++;
+
+	if (ctx->sim != NULL) {
+		val = newport_sim_read(ctx->sim, rexreg);
+	} else {
+		reg = (volatile uint32_t *)(((char *) ctx->addr) + rexreg);
+		val = *reg;
+	}
 	if (ctx->log_regio)
 		printf("%s: 0x%04x -> 0x%08x\n", __func__, rexreg, val);
 	return (val);
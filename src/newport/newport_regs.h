@@ -158,7 +158,16 @@
 
 #define REX3_REG_SETUP			0x0030  
 
+/*
+ * Fractional coordinates (XSTART etc) are signed fixed point with
+ * four fraction bits, sitting at bit 7 of the register.
+ */
 #define REX3_REG_XSTART			0x0100
+#define REX3_REG_YSTART			0x0104
+#define REX3_REG_XEND			0x0108
+#define REX3_REG_YEND			0x010c
+#define  REX3_COORD_FRAC_BITS		4
+#define  REX3_COORD_SHIFT		7
 
 #define REX3_REG_XYMOVE			0x0114
 #define  REX3_XYMOVE_XSHIFT		16
@@ -171,6 +180,13 @@
 #define REX3_REG_XYENDI			0x0154
 #define  REX3_XYENDI_XSHIFT		16
 
+/* Colour / alpha iterators, 8.11 fixed point */
+#define REX3_REG_COLORRED		0x0200
+#define REX3_REG_COLORALPHA		0x0204
+#define REX3_REG_COLORGREEN		0x0208
+#define REX3_REG_COLORBLUE		0x020c
+#define  REX3_COLOR_SHIFT		11
+
 #define REX3_REG_WRMASK			0x0220
 
 #define REX3_REG_COLORI			0x0224
@@ -307,7 +323,9 @@
 #define  XMAP9_MODE_PIXMODE_RGB0	0x000100
 #define  XMAP9_MODE_PIXMODE_RGB1	0x000200
 #define  XMAP9_MODE_PIXMODE_RGB2	0x000300
+#define  XMAP9_MODE_PIXSIZE_4BPP	0x000000
 #define  XMAP9_MODE_PIXSIZE_8BPP	0x000400
+#define  XMAP9_MODE_PIXSIZE_12BPP	0x000800
 #define  XMAP9_MODE_PIXSIZE_24BPP	0x000c00
 #define XMAP9_DCBCRS_MODE_SELECT	7
 
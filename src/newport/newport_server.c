@@ -0,0 +1,478 @@
+/* For memfd_create() and file sealing on Linux */
+#define	_GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <string.h>
+#include <strings.h>
+#include <poll.h>
+#include <errno.h>
+#include <err.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+
+#include "newport_regs.h"
+#include "newport_ctx.h"
+#include "newport_regio.h"
+#include "newport_hwops.h"
+#include "newport_ops.h"
+#include "newport_proto.h"
+#include "newport_server.h"
+#include "newport_stats.h"
+
+/*
+ * The local drawing server.
+ *
+ * This owns the gfx_ctx and runs commands out of each client's
+ * shared memory ring.  Clients are untrusted: every command is copied
+ * out of the ring before it's checked, so a client scribbling over
+ * the ring can't change a command after it has been validated.
+ * Pixel data for uploads is read straight out of the image area;
+ * the worst a client can do there is change its own pixels.
+ */
+
+static int newport_server_shm_seq;
+
+/*
+ * Create the shared memory for a client.  The client gets a read /
+ * write descriptor for it, so where the OS can, it's sealed at its
+ * size first: a client that could shrink it would have the server
+ * take a SIGBUS the next time it read the ring.
+ */
+static int
+newport_server_shm_create(size_t size)
+{
+	char name[64];
+	int fd;
+
+	snprintf(name, sizeof(name), "/newport.%d.%d", (int) getpid(),
+	    newport_server_shm_seq++);
+#ifdef MFD_ALLOW_SEALING
+	fd = memfd_create(name + 1, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd < 0) {
+		warn("%s: memfd_create", __func__);
+		return -1;
+	}
+#else
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0) {
+		warn("%s: shm_open", __func__);
+		return -1;
+	}
+	/* Only the file descriptors keep it around */
+	shm_unlink(name);
+#endif
+
+	if (ftruncate(fd, size) != 0) {
+		warn("%s: ftruncate", __func__);
+		close(fd);
+		return -1;
+	}
+#ifdef MFD_ALLOW_SEALING
+	if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW |
+	    F_SEAL_SEAL) != 0) {
+		warn("%s: F_ADD_SEALS", __func__);
+		close(fd);
+		return -1;
+	}
+#endif
+	return fd;
+}
+
+static bool
+newport_server_send_hello(int sock, int shm_fd,
+    const struct newport_proto_hello *hello)
+{
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	union {
+		struct cmsghdr hdr;
+		char buf[CMSG_SPACE(sizeof(int))];
+	} cbuf;
+
+	bzero(&msg, sizeof(msg));
+	bzero(&cbuf, sizeof(cbuf));
+	iov.iov_base = (void *) hello;
+	iov.iov_len = sizeof(*hello);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf.buf;
+	msg.msg_controllen = sizeof(cbuf.buf);
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &shm_fd, sizeof(int));
+
+	/* A client that's already gone mustn't SIGPIPE the server */
+	if (sendmsg(sock, &msg, MSG_NOSIGNAL) != sizeof(*hello)) {
+		warn("%s: sendmsg", __func__);
+		return false;
+	}
+	return true;
+}
+
+static void
+newport_server_client_free(struct newport_server_client *cl)
+{
+	if (cl->shm != NULL)
+		munmap(cl->shm, cl->shm_size);
+	if (cl->fd >= 0)
+		close(cl->fd);
+	bzero(cl, sizeof(*cl));
+	cl->fd = -1;
+}
+
+static void
+newport_server_accept(struct newport_server *srv)
+{
+	struct newport_server_client *cl;
+	struct newport_proto_hello hello;
+	size_t ring_size, image_size;
+	int fd, shm_fd;
+
+	fd = accept(srv->listen_fd, NULL, NULL);
+	if (fd < 0) {
+		warn("%s: accept", __func__);
+		return;
+	}
+	if (srv->nclients >= NEWPORT_SERVER_MAX_CLIENTS) {
+		printf("%s: too many clients\n", __func__);
+		close(fd);
+		return;
+	}
+
+	cl = &srv->clients[srv->nclients];
+	bzero(cl, sizeof(*cl));
+	cl->fd = fd;
+
+	ring_size = NEWPORT_PROTO_RING_ENTRIES *
+	    sizeof(struct newport_proto_cmd);
+	image_size = (size_t) srv->fb_width * srv->fb_height;
+	cl->shm_size = 4096 + ring_size + image_size * sizeof(uint32_t);
+
+	shm_fd = newport_server_shm_create(cl->shm_size);
+	if (shm_fd < 0)
+		goto error;
+	cl->shm = mmap(NULL, cl->shm_size, PROT_READ | PROT_WRITE,
+	    MAP_SHARED, shm_fd, 0);
+	if (cl->shm == MAP_FAILED) {
+		cl->shm = NULL;
+		warn("%s: mmap", __func__);
+		close(shm_fd);
+		goto error;
+	}
+
+	cl->ring_entries = NEWPORT_PROTO_RING_ENTRIES;
+	cl->image_size = image_size;
+
+	cl->hdr = cl->shm;
+	cl->hdr->magic = NEWPORT_PROTO_MAGIC;
+	cl->hdr->version = NEWPORT_PROTO_VERSION;
+	cl->hdr->ring_entries = cl->ring_entries;
+	cl->hdr->ring_offset = 4096;
+	cl->hdr->image_offset = 4096 + ring_size;
+	cl->hdr->image_size = cl->image_size;
+	atomic_store(&cl->hdr->head, 0);
+	atomic_store(&cl->hdr->tail, 0);
+	atomic_store(&cl->hdr->nerrors, 0);
+	cl->ring = (void *) ((char *) cl->shm + cl->hdr->ring_offset);
+	cl->image = (void *) ((char *) cl->shm + cl->hdr->image_offset);
+
+	hello.magic = NEWPORT_PROTO_MAGIC;
+	hello.version = NEWPORT_PROTO_VERSION;
+	hello.shm_size = cl->shm_size;
+	hello.fb_width = srv->fb_width;
+	hello.fb_height = srv->fb_height;
+	if (! newport_server_send_hello(fd, shm_fd, &hello)) {
+		close(shm_fd);
+		goto error;
+	}
+	close(shm_fd);
+
+	srv->nclients++;
+	printf("%s: client %d connected\n", __func__, fd);
+	return;
+
+error:
+	newport_server_client_free(cl);
+}
+
+static void
+newport_server_disconnect(struct newport_server *srv, int idx)
+{
+	struct newport_server_client *cl = &srv->clients[idx];
+
+	printf("%s: client %d: %llu commands, %llu rejected\n", __func__,
+	    cl->fd, (unsigned long long) cl->ncmds,
+	    (unsigned long long) cl->nerrors);
+
+	newport_server_client_free(cl);
+	srv->nclients--;
+	if (idx != srv->nclients) {
+		srv->clients[idx] = srv->clients[srv->nclients];
+		srv->clients[srv->nclients].fd = -1;
+	}
+}
+
+static inline bool
+newport_server_rect_ok(struct newport_server *srv, int x, int y, int w, int h)
+{
+	return (w > 0 && h > 0 && x >= 0 && y >= 0 &&
+	    x + w <= srv->fb_width && y + h <= srv->fb_height);
+}
+
+static inline bool
+newport_server_point_ok(struct newport_server *srv, int x, int y)
+{
+	return (x >= 0 && y >= 0 && x < srv->fb_width && y < srv->fb_height);
+}
+
+static bool
+newport_server_validate(struct newport_server *srv,
+    struct newport_server_client *cl, const struct newport_proto_cmd *cmd)
+{
+	uint64_t last;
+
+	switch (cmd->type) {
+	case NewportProtoCmdFill:
+		return newport_server_rect_ok(srv, cmd->x, cmd->y, cmd->w,
+		    cmd->h);
+	case NewportProtoCmdBlit:
+		return (newport_server_rect_ok(srv, cmd->x, cmd->y, cmd->w,
+		    cmd->h) && newport_server_rect_ok(srv, cmd->x2, cmd->y2,
+		    cmd->w, cmd->h));
+	case NewportProtoCmdLine:
+		return (newport_server_point_ok(srv, cmd->x, cmd->y) &&
+		    newport_server_point_ok(srv, cmd->x2, cmd->y2));
+	case NewportProtoCmdUpload:
+		if (! newport_server_rect_ok(srv, cmd->x, cmd->y, cmd->w,
+		    cmd->h))
+			return false;
+		if (cmd->stride < (uint32_t) cmd->w)
+			return false;
+		/* The last pixel read has to be inside the image area */
+		last = (uint64_t) cmd->offset +
+		    (uint64_t) (cmd->h - 1) * cmd->stride + cmd->w;
+		return (last <= cl->image_size);
+	default:
+		return false;
+	}
+}
+
+static void
+newport_server_exec(struct newport_server *srv,
+    struct newport_server_client *cl, const struct newport_proto_cmd *cmd)
+{
+	struct gfx_ctx *dc = srv->dc;
+
+	switch (cmd->type) {
+	case NewportProtoCmdFill:
+		if (srv->last_type != NewportProtoCmdFill)
+			newport_fill_rectangle_setup(dc);
+		newport_fill_rectangle(dc, cmd->x, cmd->y, cmd->w, cmd->h,
+		    cmd->color);
+		break;
+	case NewportProtoCmdBlit:
+		newport_bitblt(dc, cmd->x, cmd->y, cmd->x2, cmd->y2, cmd->w,
+		    cmd->h, REX3_DRAWMODE1_LO_SRC);
+		break;
+	case NewportProtoCmdLine:
+		newport_draw_line(dc, cmd->x, cmd->y, cmd->x2, cmd->y2,
+		    cmd->color);
+		break;
+	case NewportProtoCmdUpload:
+		newport_upload_image(dc, cmd->x, cmd->y, cmd->w, cmd->h,
+		    cl->image + cmd->offset, cmd->stride);
+		break;
+	}
+	srv->last_type = cmd->type;
+}
+
+/*
+ * Run up to batch_size commands from the given client.
+ * Returns how many commands were consumed.
+ */
+static int
+newport_server_run_client(struct newport_server *srv,
+    struct newport_server_client *cl)
+{
+	struct newport_proto_cmd cmd;
+	uint32_t head, tail, mask;
+	int n;
+
+	mask = cl->ring_entries - 1;
+	head = atomic_load_explicit(&cl->hdr->head, memory_order_acquire);
+	tail = cl->tail;
+
+	/* A client that's pushed head too far has lost its ring */
+	if (head - tail > cl->ring_entries) {
+		cl->tail = head;
+		atomic_store_explicit(&cl->hdr->tail, head,
+		    memory_order_release);
+		cl->nerrors++;
+		atomic_fetch_add(&cl->hdr->nerrors, 1);
+		return (0);
+	}
+
+	for (n = 0; n < srv->batch_size && tail != head; n++, tail++) {
+		/*
+		 * Take a private copy and keep the compiler from going
+		 * back to the shared ring for it after validation.
+		 */
+		memcpy(&cmd, &cl->ring[tail & mask], sizeof(cmd));
+		atomic_signal_fence(memory_order_seq_cst);
+		if (! newport_server_validate(srv, cl, &cmd)) {
+			cl->nerrors++;
+			atomic_fetch_add_explicit(&cl->hdr->nerrors, 1,
+			    memory_order_relaxed);
+			continue;
+		}
+		newport_server_exec(srv, cl, &cmd);
+		cl->ncmds++;
+	}
+
+	if (n > 0) {
+		cl->tail = tail;
+		atomic_store_explicit(&cl->hdr->tail, tail,
+		    memory_order_release);
+	}
+	return (n);
+}
+
+bool
+newport_server_init(struct newport_server *srv, struct gfx_ctx *dc,
+    const char *path, int fb_width, int fb_height)
+{
+	struct sockaddr_un sun;
+	int i;
+
+	bzero(srv, sizeof(*srv));
+	srv->dc = dc;
+	srv->path = path;
+	srv->fb_width = fb_width;
+	srv->fb_height = fb_height;
+	srv->batch_size = 256;
+	srv->last_type = NewportProtoCmdNone;
+	for (i = 0; i < NEWPORT_SERVER_MAX_CLIENTS; i++)
+		srv->clients[i].fd = -1;
+
+	if (strlen(path) >= sizeof(sun.sun_path)) {
+		printf("%s: socket path too long\n", __func__);
+		return false;
+	}
+
+	srv->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (srv->listen_fd < 0) {
+		warn("%s: socket", __func__);
+		return false;
+	}
+
+	bzero(&sun, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	snprintf(sun.sun_path, sizeof(sun.sun_path), "%s", path);
+	unlink(path);
+	if (bind(srv->listen_fd, (struct sockaddr *) &sun, sizeof(sun)) != 0) {
+		warn("%s: bind(%s)", __func__, path);
+		goto error;
+	}
+	if (listen(srv->listen_fd, 8) != 0) {
+		warn("%s: listen", __func__);
+		goto error;
+	}
+	return true;
+
+error:
+	close(srv->listen_fd);
+	srv->listen_fd = -1;
+	return false;
+}
+
+/*
+ * Serve clients until newport_server_stop() is called.
+ */
+void
+newport_server_run(struct newport_server *srv)
+{
+	struct pollfd pfd[NEWPORT_SERVER_MAX_CLIENTS + 1];
+	char buf[256];
+	bool busy = false;
+	ssize_t r;
+	int i, n;
+
+	while (! srv->stop) {
+		newport_stats_poll(srv->dc);
+
+		pfd[0].fd = srv->listen_fd;
+		pfd[0].events = POLLIN;
+		for (i = 0; i < srv->nclients; i++) {
+			pfd[i + 1].fd = srv->clients[i].fd;
+			pfd[i + 1].events = POLLIN;
+		}
+		n = srv->nclients;
+
+		/* Don't sleep if there was work last time around */
+		if (poll(pfd, n + 1, busy ? 0 : 100) < 0) {
+			if (errno != EINTR)
+				warn("%s: poll", __func__);
+			continue;
+		}
+
+		/* Work backwards so disconnects don't shuffle pfd[] */
+		for (i = n - 1; i >= 0; i--) {
+			if ((pfd[i + 1].revents & (POLLIN | POLLHUP)) == 0)
+				continue;
+			/* Doorbells carry no data; just drain them */
+			r = read(srv->clients[i].fd, buf, sizeof(buf));
+			if (r <= 0) {
+				/* Run whatever it left behind first */
+				while (newport_server_run_client(srv,
+				    &srv->clients[i]) > 0)
+					;
+				newport_server_disconnect(srv, i);
+			}
+		}
+
+		if (pfd[0].revents & POLLIN)
+			newport_server_accept(srv);
+
+		/* Round robin a batch from each client */
+		busy = false;
+		for (i = 0; i < srv->nclients; i++) {
+			if (newport_server_run_client(srv,
+			    &srv->clients[i]) > 0)
+				busy = true;
+		}
+	}
+}
+
+/*
+ * Ask newport_server_run() to return.  Safe to call from a
+ * signal handler.
+ */
+void
+newport_server_stop(struct newport_server *srv)
+{
+	srv->stop = 1;
+}
+
+void
+newport_server_close(struct newport_server *srv)
+{
+	while (srv->nclients > 0)
+		newport_server_disconnect(srv, srv->nclients - 1);
+	if (srv->listen_fd >= 0) {
+		close(srv->listen_fd);
+		srv->listen_fd = -1;
+		unlink(srv->path);
+	}
+}
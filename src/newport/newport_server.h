@@ -0,0 +1,54 @@
+#ifndef	__NEWPORT_SERVER_H__
+#define	__NEWPORT_SERVER_H__
+
+#include <signal.h>
+
+#define	NEWPORT_SERVER_MAX_CLIENTS	16
+
+struct newport_server_client {
+	int fd;
+	void *shm;
+	size_t shm_size;
+	struct newport_proto_shm *hdr;
+	struct newport_proto_cmd *ring;
+	uint32_t *image;
+
+	/*
+	 * Private copies of the ring / image sizes and tail; the ones in the
+	 * shared header are only for the client's benefit.
+	 */
+	uint32_t ring_entries;
+	uint32_t image_size;
+	uint32_t tail;
+
+	uint64_t ncmds;
+	uint64_t nerrors;
+};
+
+struct newport_server {
+	struct gfx_ctx *dc;
+	const char *path;
+	int listen_fd;
+	int fb_width;
+	int fb_height;
+
+	/* Maximum commands run from one client before moving on */
+	int batch_size;
+
+	/* What the hardware was last set up for */
+	NewportProtoCmdType last_type;
+
+	struct newport_server_client clients[NEWPORT_SERVER_MAX_CLIENTS];
+	int nclients;
+
+	volatile sig_atomic_t stop;
+};
+
+extern	bool newport_server_init(struct newport_server *srv,
+	    struct gfx_ctx *dc, const char *path, int fb_width,
+	    int fb_height);
+extern	void newport_server_run(struct newport_server *srv);
+extern	void newport_server_stop(struct newport_server *srv);
+extern	void newport_server_close(struct newport_server *srv);
+
+#endif	/* __NEWPORT_SERVER_H__ */
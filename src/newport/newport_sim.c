@@ -0,0 +1,495 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <strings.h>
+
+#include <sys/param.h>
+
+#include "newport_regs.h"
+#include "newport_ctx.h"
+#include "newport_sim.h"
+
+/*
+ * This is a small in-memory model of the REX3, used to run the
+ * drawing library (and things built on top of it) on hosts that
+ * aren't an Indy.
+ *
+ * It keeps a copy of every register written and runs the drawing
+ * operation when a register is written with the GO bit set.
+ * The status register always reads as idle, and DCB reads always
+ * return all-ones so XMAP9 FIFO polling completes.
+ */
+
+#define	SIM_REG(sim, r)		((sim)->regs[((r) & ~REX3_REG_GO) >> 2])
+
+static inline int
+sim_coord_x(uint32_t val)
+{
+	return (int16_t) (val >> 16);
+}
+
+static inline int
+sim_coord_y(uint32_t val)
+{
+	return (int16_t) (val & 0xffff);
+}
+
+static inline void
+sim_put_pixel(struct newport_sim *sim, int x, int y, uint32_t color)
+{
+	uint32_t wrmask, *p;
+
+	if (x < 0 || x >= sim->width || y < 0 || y >= sim->height)
+		return;
+
+	wrmask = SIM_REG(sim, REX3_REG_WRMASK);
+	p = &sim->fb[y * sim->width + x];
+	*p = (*p & ~wrmask) | (color & wrmask);
+}
+
+static uint32_t
+sim_draw_color(struct newport_sim *sim)
+{
+	if (SIM_REG(sim, REX3_REG_DRAWMODE1) & REX3_DRAWMODE1_FASTCLEAR)
+		return SIM_REG(sim, REX3_REG_COLORVRAM);
+	return SIM_REG(sim, REX3_REG_COLORI);
+}
+
+/*
+ * Draw pixel x of a row, honouring the ZPATTERN stipple if it's
+ * enabled.  The pattern is used MSB first from the start of the row.
+ */
+static inline void
+sim_put_zpattern(struct newport_sim *sim, int x, int y, int i,
+    uint32_t color)
+{
+	uint32_t drawmode0 = SIM_REG(sim, REX3_REG_DRAWMODE0);
+
+	if ((drawmode0 & REX3_DRAWMODE0_ENZPATTERN) == 0)
+		sim_put_pixel(sim, x, y, color);
+	else if (SIM_REG(sim, REX3_REG_ZPATTERN) & (0x80000000U >> (i & 31)))
+		sim_put_pixel(sim, x, y, color);
+	else if (drawmode0 & REX3_DRAWMODE0_ZPOPAQUE)
+		sim_put_pixel(sim, x, y, SIM_REG(sim, REX3_REG_COLORBACK));
+}
+
+/*
+ * BLOCK / SPAN fills from XYSTARTI to XYENDI.
+ */
+static void
+sim_fill(struct newport_sim *sim, uint32_t adrmode)
+{
+	uint32_t color;
+	int xs, ys, xe, ye, x, y, t;
+
+	xs = sim_coord_x(SIM_REG(sim, REX3_REG_XYSTARTI));
+	ys = sim_coord_y(SIM_REG(sim, REX3_REG_XYSTARTI));
+	xe = sim_coord_x(SIM_REG(sim, REX3_REG_XYENDI));
+	ye = sim_coord_y(SIM_REG(sim, REX3_REG_XYENDI));
+
+	if (xe < xs) {
+		t = xs; xs = xe; xe = t;
+	}
+	if (adrmode == REX3_DRAWMODE0_ADRMODE_SPAN)
+		ye = ys;
+	if (ye < ys) {
+		t = ys; ys = ye; ye = t;
+	}
+
+	color = sim_draw_color(sim);
+	for (y = ys; y <= ye; y++)
+		for (x = xs; x <= xe; x++)
+			sim_put_zpattern(sim, x, y, x - xs, color);
+}
+
+/*
+ * A GO write to ZPATTERN draws one row of the block at the current
+ * iterator position with the new pattern, then steps to the next row.
+ */
+static void
+sim_fill_zpattern_row(struct newport_sim *sim)
+{
+	uint32_t color;
+	int xs, xe, x;
+
+	xs = sim_coord_x(SIM_REG(sim, REX3_REG_XYSTARTI));
+	xe = sim_coord_x(SIM_REG(sim, REX3_REG_XYENDI));
+
+	color = sim_draw_color(sim);
+	for (x = xs; x <= xe; x++)
+		sim_put_zpattern(sim, x, sim->cur_y, x - xs, color);
+	sim->cur_x = xs;
+	sim->cur_y++;
+}
+
+/*
+ * Integer line from XYSTARTI to XYENDI, both endpoints inclusive.
+ */
+static void
+sim_line(struct newport_sim *sim)
+{
+	uint32_t color;
+	int x, y, xe, ye, dx, dy, sx, sy, e, e2;
+
+	x = sim_coord_x(SIM_REG(sim, REX3_REG_XYSTARTI));
+	y = sim_coord_y(SIM_REG(sim, REX3_REG_XYSTARTI));
+	xe = sim_coord_x(SIM_REG(sim, REX3_REG_XYENDI));
+	ye = sim_coord_y(SIM_REG(sim, REX3_REG_XYENDI));
+
+	dx = abs(xe - x);
+	dy = -abs(ye - y);
+	sx = (x < xe) ? 1 : -1;
+	sy = (y < ye) ? 1 : -1;
+	e = dx + dy;
+
+	color = sim_draw_color(sim);
+	for (;;) {
+		sim_put_pixel(sim, x, y, color);
+		if (x == xe && y == ye)
+			break;
+		e2 = 2 * e;
+		if (e2 >= dy) {
+			e += dy;
+			x += sx;
+		}
+		if (e2 <= dx) {
+			e += dx;
+			y += sy;
+		}
+	}
+}
+
+/* XSTART etc: 12.4 subpixel coordinates */
+static inline int
+sim_subpixel(uint32_t val)
+{
+	return ((int32_t) val >> REX3_COORD_SHIFT);
+}
+
+/*
+ * Blend a pixel with the given coverage (0..256).  The channels are
+ * blended a byte at a time, which is only right for 24 bit pixels.
+ */
+static void
+sim_blend_pixel(struct newport_sim *sim, int x, int y, uint32_t color,
+    int cov)
+{
+	uint32_t dst, out;
+	int a, c, s, d;
+
+	if (x < 0 || x >= sim->width || y < 0 || y >= sim->height ||
+	    cov <= 0)
+		return;
+
+	if ((SIM_REG(sim, REX3_REG_DRAWMODE1) & REX3_DRAWMODE1_BLEND) == 0) {
+		if (cov >= 128)
+			sim_put_pixel(sim, x, y, color);
+		return;
+	}
+
+	a = (cov * ((SIM_REG(sim, REX3_REG_COLORALPHA) >> REX3_COLOR_SHIFT) &
+	    0xff)) >> 8;
+	dst = newport_sim_get_pixel(sim, x, y);
+	out = 0;
+	for (c = 0; c < 24; c += 8) {
+		s = (color >> c) & 0xff;
+		d = (dst >> c) & 0xff;
+		out |= (uint32_t) ((s * a + d * (255 - a) + 127) / 255) << c;
+	}
+	sim_put_pixel(sim, x, y, out);
+}
+
+/*
+ * Antialiased line from (XSTART, YSTART) to (XEND, YEND).
+ *
+ * This is a Wu style line: each step along the major axis splits
+ * the pixel between the two minor axis pixels the line passes
+ * between.  ENDPTFILTER scales the end pixels by how far along the
+ * major axis the line covers them.  It's a model of what the A_LINE
+ * engine does, not a bit exact copy.
+ */
+static void
+sim_aa_line(struct newport_sim *sim)
+{
+	uint32_t drawmode0, color;
+	int x1, y1, x2, y2, dmaj, dmin, ps, pe, p, step, t, f, cov, q;
+	int64_t m;
+	bool ymajor;
+
+	drawmode0 = SIM_REG(sim, REX3_REG_DRAWMODE0);
+	x1 = sim_subpixel(SIM_REG(sim, REX3_REG_XSTART));
+	y1 = sim_subpixel(SIM_REG(sim, REX3_REG_YSTART));
+	x2 = sim_subpixel(SIM_REG(sim, REX3_REG_XEND));
+	y2 = sim_subpixel(SIM_REG(sim, REX3_REG_YEND));
+	color = sim_draw_color(sim);
+
+	/* Work in (major, minor) coordinates */
+	ymajor = abs(y2 - y1) > abs(x2 - x1);
+	if (ymajor) {
+		t = x1; x1 = y1; y1 = t;
+		t = x2; x2 = y2; y2 = t;
+	}
+	dmaj = x2 - x1;
+	dmin = y2 - y1;
+	step = (dmaj < 0) ? -1 : 1;
+
+	/* Pixel centres are at whole subpixel units */
+	ps = (x1 + 8) >> 4;
+	pe = (x2 + 8) >> 4;
+
+	for (p = ps; ; p += step) {
+		if (! ((p == ps && (drawmode0 & REX3_DRAWMODE0_SKIPFIRST)) ||
+		    (p == pe && (drawmode0 & REX3_DRAWMODE0_SKIPLAST)))) {
+			/* Minor axis position at this pixel centre, in 1/256 */
+			m = (int64_t) y1 * 16;
+			if (dmaj != 0)
+				m += ((int64_t) (p * 16 - x1) * dmin * 16) / dmaj;
+			q = (int) (m >> 8);
+			f = (int) (m & 0xff);
+
+			cov = 256;
+			if (drawmode0 & REX3_DRAWMODE0_ENDPTFILTER) {
+				if (ps == pe)
+					cov = abs(dmaj) * 16;
+				else if (p == ps)
+					cov = (step > 0) ?
+					    (p * 16 + 8 - x1) * 16 :
+					    (x1 - (p * 16 - 8)) * 16;
+				else if (p == pe)
+					cov = (step > 0) ?
+					    (x2 - (p * 16 - 8)) * 16 :
+					    (p * 16 + 8 - x2) * 16;
+				cov = MAX(0, MIN(256, cov));
+			}
+
+			if (ymajor) {
+				sim_blend_pixel(sim, q, p, color,
+				    (cov * (256 - f)) >> 8);
+				sim_blend_pixel(sim, q + 1, p, color,
+				    (cov * f) >> 8);
+			} else {
+				sim_blend_pixel(sim, p, q, color,
+				    (cov * (256 - f)) >> 8);
+				sim_blend_pixel(sim, p, q + 1, color,
+				    (cov * f) >> 8);
+			}
+		}
+		if (p == pe)
+			break;
+	}
+}
+
+/*
+ * Screen to screen copy.  The iteration order follows XYSTARTI
+ * towards XYENDI, so the caller picks the overlap-safe direction
+ * the same way it would for the hardware.
+ */
+static void
+sim_scr2scr(struct newport_sim *sim)
+{
+	int xs, ys, xe, ye, dx, dy, xi, yi, x, y;
+	uint32_t move;
+
+	xs = sim_coord_x(SIM_REG(sim, REX3_REG_XYSTARTI));
+	ys = sim_coord_y(SIM_REG(sim, REX3_REG_XYSTARTI));
+	xe = sim_coord_x(SIM_REG(sim, REX3_REG_XYENDI));
+	ye = sim_coord_y(SIM_REG(sim, REX3_REG_XYENDI));
+	move = SIM_REG(sim, REX3_REG_XYMOVE);
+	dx = (int16_t) (move >> REX3_XYMOVE_XSHIFT);
+	dy = (int16_t) (move & 0xffff);
+
+	xi = (xe < xs) ? -1 : 1;
+	yi = (ye < ys) ? -1 : 1;
+
+	for (y = ys; ; y += yi) {
+		for (x = xs; ; x += xi) {
+			sim_put_pixel(sim, x + dx, y + dy,
+			    newport_sim_get_pixel(sim, x, y));
+			if (x == xe)
+				break;
+		}
+		if (y == ye)
+			break;
+	}
+}
+
+/*
+ * Consume one HOSTRW word worth of pixels at the current
+ * block iterator position.
+ */
+static void
+sim_hostrw(struct newport_sim *sim, uint32_t val)
+{
+	uint32_t drawmode1;
+	int xs, xe, npix, bits, i;
+	uint32_t pix;
+
+	drawmode1 = SIM_REG(sim, REX3_REG_DRAWMODE1);
+	xs = sim_coord_x(SIM_REG(sim, REX3_REG_XYSTARTI));
+	xe = sim_coord_x(SIM_REG(sim, REX3_REG_XYENDI));
+
+	switch (drawmode1 & REX3_DRAWMODE1_HD_MASK) {
+	case REX3_DRAWMODE1_HD_HD4:
+		bits = 4;
+		break;
+	case REX3_DRAWMODE1_HD_HD8:
+		bits = 8;
+		break;
+	case REX3_DRAWMODE1_HD_HD12:
+		/* packed 12 bit pixels live in 16 bit halves */
+		bits = 16;
+		break;
+	default:
+		bits = 32;
+		break;
+	}
+	npix = 1;
+	if (drawmode1 & REX3_DRAWMODE1_RWPACKED)
+		npix = 32 / bits;
+
+	for (i = 0; i < npix; i++) {
+		if (npix == 1)
+			pix = val;
+		else
+			pix = (val >> (32 - bits * (i + 1))) &
+			    ((1U << bits) - 1);
+		sim_put_pixel(sim, sim->cur_x, sim->cur_y, pix);
+		if (sim->cur_x == xe) {
+			sim->cur_x = xs;
+			sim->cur_y++;
+		} else
+			sim->cur_x++;
+	}
+}
+
+static void
+sim_go(struct newport_sim *sim, uint32_t rexreg, uint32_t val)
+{
+	uint32_t drawmode0, adrmode;
+
+	drawmode0 = SIM_REG(sim, REX3_REG_DRAWMODE0);
+	adrmode = drawmode0 & REX3_DRAWMODE0_ADRMODE_MASK;
+
+	switch (drawmode0 & REX3_DRAWMODE0_OPCODE_MASK) {
+	case REX3_DRAWMODE0_OPCODE_DRAW:
+		if (drawmode0 & REX3_DRAWMODE0_COLORHOST) {
+			if ((rexreg & ~REX3_REG_GO) == REX3_REG_HOSTRW0)
+				sim_hostrw(sim, val);
+			break;
+		}
+		if ((rexreg & ~REX3_REG_GO) == REX3_REG_ZPATTERN &&
+		    adrmode == REX3_DRAWMODE0_ADRMODE_BLOCK)
+			sim_fill_zpattern_row(sim);
+		else if (adrmode == REX3_DRAWMODE0_ADRMODE_BLOCK ||
+		    adrmode == REX3_DRAWMODE0_ADRMODE_SPAN)
+			sim_fill(sim, adrmode);
+		else if (adrmode == REX3_DRAWMODE0_ADRMODE_I_LINE)
+			sim_line(sim);
+		else if (adrmode == REX3_DRAWMODE0_ADRMODE_A_LINE)
+			sim_aa_line(sim);
+		break;
+	case REX3_DRAWMODE0_OPCODE_SCR2SCR:
+		sim_scr2scr(sim);
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * Attach a new simulated REX3 and framebuffer to the given context.
+ */
+bool
+newport_sim_attach(struct gfx_ctx *ctx, int width, int height)
+{
+	struct newport_sim *sim;
+
+	sim = calloc(1, sizeof(*sim));
+	if (sim == NULL)
+		return false;
+
+	sim->width = width;
+	sim->height = height;
+	sim->fb = calloc(width * height, sizeof(uint32_t));
+	if (sim->fb == NULL) {
+		free(sim);
+		return false;
+	}
+	SIM_REG(sim, REX3_REG_WRMASK) = 0xffffffff;
+
+	ctx->sim = sim;
+	return true;
+}
+
+void
+newport_sim_detach(struct gfx_ctx *ctx)
+{
+	if (ctx->sim == NULL)
+		return;
+	free(ctx->sim->fb);
+	free(ctx->sim);
+	ctx->sim = NULL;
+}
+
+void
+newport_sim_set_trace(struct newport_sim *sim, newport_sim_trace_cb *cb,
+    void *arg)
+{
+	sim->trace_cb = cb;
+	sim->trace_arg = arg;
+}
+
+void
+newport_sim_write(struct newport_sim *sim, uint32_t rexreg, uint32_t val)
+{
+	sim->nwrites++;
+
+	if ((rexreg & ~REX3_REG_GO) >= NEWPORT_IOSPACE_SIZE) {
+		printf("%s: write to invalid register 0x%04x\n", __func__,
+		    rexreg);
+		return;
+	}
+
+	SIM_REG(sim, rexreg) = val;
+
+	if ((rexreg & ~REX3_REG_GO) == REX3_REG_XYSTARTI) {
+		sim->cur_x = sim_coord_x(val);
+		sim->cur_y = sim_coord_y(val);
+	}
+
+	if (rexreg & REX3_REG_GO) {
+		if (sim->trace_cb != NULL)
+			sim->trace_cb(sim, rexreg, val, sim->trace_arg);
+		sim_go(sim, rexreg, val);
+	}
+}
+
+uint32_t
+newport_sim_read(struct newport_sim *sim, uint32_t rexreg)
+{
+	sim->nreads++;
+
+	switch (rexreg) {
+	case REX3_REG_STATUS:
+		/* Never busy, FIFOs always empty */
+		return (0);
+	case REX3_REG_DCBDATA0:
+	case REX3_REG_DCBDATA1:
+		return (0xffffffff);
+	default:
+		break;
+	}
+
+	if ((rexreg & ~REX3_REG_GO) >= NEWPORT_IOSPACE_SIZE)
+		return (0xffffffff);
+	return SIM_REG(sim, rexreg);
+}
+
+uint32_t
+newport_sim_get_pixel(struct newport_sim *sim, int x, int y)
+{
+	if (x < 0 || x >= sim->width || y < 0 || y >= sim->height)
+		return (0);
+	return sim->fb[y * sim->width + x];
+}
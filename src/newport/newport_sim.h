@@ -0,0 +1,48 @@
+#ifndef	__NEWPORT_SIM_H__
+#define	__NEWPORT_SIM_H__
+
+struct newport_sim;
+
+/*
+ * Called for every register write that has the GO bit set, after
+ * the register has been stored but before the operation is run.
+ */
+typedef void newport_sim_trace_cb(struct newport_sim *sim, uint32_t rexreg,
+	    uint32_t val, void *arg);
+
+/*
+ * An in-memory model of the REX3 register file and a framebuffer.
+ *
+ * This isn't a hardware emulator - it's just enough of the REX3
+ * to run the drawing library on a non-Indy host.  Each framebuffer
+ * pixel holds the raw COLORI / COLORVRAM / HOSTRW value that was
+ * drawn; the DRAWMODE1 pixel format conversion isn't modelled.
+ */
+struct newport_sim {
+	uint32_t regs[NEWPORT_IOSPACE_SIZE / 4];
+
+	int width;
+	int height;
+	uint32_t *fb;
+
+	/* Current block iterator position, used for HOSTRW writes */
+	int cur_x;
+	int cur_y;
+
+	uint64_t nwrites;
+	uint64_t nreads;
+
+	newport_sim_trace_cb *trace_cb;
+	void *trace_arg;
+};
+
+extern	bool newport_sim_attach(struct gfx_ctx *ctx, int width, int height);
+extern	void newport_sim_detach(struct gfx_ctx *ctx);
+extern	void newport_sim_set_trace(struct newport_sim *sim,
+	    newport_sim_trace_cb *cb, void *arg);
+extern	void newport_sim_write(struct newport_sim *sim, uint32_t rexreg,
+	    uint32_t val);
+extern	uint32_t newport_sim_read(struct newport_sim *sim, uint32_t rexreg);
+extern	uint32_t newport_sim_get_pixel(struct newport_sim *sim, int x, int y);
+
+#endif	/* __NEWPORT_SIM_H__ */
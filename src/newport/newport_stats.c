@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <signal.h>
+#include <time.h>
+#include <err.h>
+
+#include <sys/time.h>
+
+#include "newport_regs.h"
+#include "newport_ctx.h"
+#include "newport_stats.h"
+
+/*
+ * Performance counters.
+ *
+ * The counters themselves live in struct gfx_ctx and are bumped
+ * inline by the register IO and drawing code.  They aren't atomic;
+ * snapshots and dumps have to happen on whichever thread owns the
+ * context, which is what newport_stats_poll() is for - a signal (or
+ * the interval timer) just sets a flag, and the next poll from the
+ * drawing loop prints the counters.
+ */
+
+static const char *newport_stats_regclass_names[NewportRegClassMax] = {
+	"mode", "coord", "color", "hostrw", "dcb", "config",
+};
+
+static const char *newport_stats_prim_names[NewportPrimMax] = {
+	"fill", "span", "line", "blit", "upload",
+};
+
+static volatile sig_atomic_t newport_stats_dump_pending = 0;
+
+uint64_t
+newport_stats_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+void
+newport_stats_snapshot(const struct gfx_ctx *dc, struct newport_stats *st)
+{
+	memcpy(st, &dc->stats, sizeof(*st));
+}
+
+void
+newport_stats_reset(struct gfx_ctx *dc)
+{
+	bzero(&dc->stats, sizeof(dc->stats));
+}
+
+void
+newport_stats_print(const struct newport_stats *st, const char *pfx)
+{
+	int i;
+
+	printf("%sregister writes:", pfx);
+	for (i = 0; i < NewportRegClassMax; i++)
+		printf(" %s %llu", newport_stats_regclass_names[i],
+		    (unsigned long long) st->reg_writes[i]);
+	printf(" (go %llu)\n", (unsigned long long) st->go_writes);
+
+	printf("%sregister reads:", pfx);
+	for (i = 0; i < NewportRegClassMax; i++)
+		printf(" %s %llu", newport_stats_regclass_names[i],
+		    (unsigned long long) st->reg_reads[i]);
+	printf("\n");
+
+	printf("%sgfifo: %llu waits, %llu stalls (%llu us); "
+	    "%llu idle waits (%llu us); bfifo: %llu waits; "
+	    "dcb: %llu transactions\n", pfx,
+	    (unsigned long long) st->gfifo_waits,
+	    (unsigned long long) st->gfifo_stalls,
+	    (unsigned long long) st->gfifo_stall_ns / 1000,
+	    (unsigned long long) st->gfifo_idle_waits,
+	    (unsigned long long) st->gfifo_idle_ns / 1000,
+	    (unsigned long long) st->bfifo_waits,
+	    (unsigned long long) st->dcb_xfers);
+
+	printf("%sfences: %llu emitted, %llu stalls (%llu us)\n", pfx,
+	    (unsigned long long) st->fence_emits,
+	    (unsigned long long) st->fence_stalls,
+	    (unsigned long long) st->fence_stall_ns / 1000);
+
+	for (i = 0; i < NewportPrimMax; i++) {
+		if (st->prims[i] == 0)
+			continue;
+		printf("%s%s: %llu primitives, %llu pixels\n", pfx,
+		    newport_stats_prim_names[i],
+		    (unsigned long long) st->prims[i],
+		    (unsigned long long) st->pixels[i]);
+	}
+}
+
+static void
+newport_stats_sighandler(int sig)
+{
+	newport_stats_dump_pending = 1;
+}
+
+/**
+ * Arrange for the counters to be dumped (by newport_stats_poll())
+ * when signo arrives and/or every interval_secs seconds.  Either can
+ * be zero to disable it.  The interval uses SIGALRM.
+ */
+bool
+newport_stats_dump_setup(int signo, int interval_secs)
+{
+	struct sigaction sa;
+	struct itimerval itv;
+
+	bzero(&sa, sizeof(sa));
+	sa.sa_handler = newport_stats_sighandler;
+
+	if (signo > 0 && sigaction(signo, &sa, NULL) != 0) {
+		warn("%s: sigaction(%d)", __func__, signo);
+		return false;
+	}
+
+	if (interval_secs > 0) {
+		if (sigaction(SIGALRM, &sa, NULL) != 0) {
+			warn("%s: sigaction(SIGALRM)", __func__);
+			return false;
+		}
+		bzero(&itv, sizeof(itv));
+		itv.it_interval.tv_sec = interval_secs;
+		itv.it_value.tv_sec = interval_secs;
+		if (setitimer(ITIMER_REAL, &itv, NULL) != 0) {
+			warn("%s: setitimer", __func__);
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Dump the counters if a dump has been asked for.  Call this from
+ * the thread that owns dc, somewhere in its main loop.
+ */
+void
+newport_stats_poll(struct gfx_ctx *dc)
+{
+	struct newport_stats st;
+
+	if (newport_stats_dump_pending == 0)
+		return;
+	newport_stats_dump_pending = 0;
+
+	newport_stats_snapshot(dc, &st);
+	newport_stats_print(&st, "stats: ");
+}
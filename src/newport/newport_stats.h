@@ -0,0 +1,48 @@
+#ifndef	__NEWPORT_STATS_H__
+#define	__NEWPORT_STATS_H__
+
+/*
+ * Which counter class a REX3 register offset (with or without the
+ * GO bit) falls into.
+ */
+static inline NewportRegClass
+newport_stats_regclass(uint32_t rexreg)
+{
+	rexreg &= ~REX3_REG_GO;
+
+	/* 0x0000 - 0x00ff */
+	if (rexreg < REX3_REG_XSTART)
+		return (NewportRegClassMode);
+	/* 0x0100 - 0x01ff */
+	if (rexreg < 0x0200)
+		return (NewportRegClassCoord);
+	if (rexreg == REX3_REG_HOSTRW0 || rexreg == REX3_REG_HOSTRW1)
+		return (NewportRegClassHostRW);
+	/* 0x0200 - 0x0237 */
+	if (rexreg < REX3_REG_DCBMODE)
+		return (NewportRegClassColor);
+	/* DCBMODE, DCBDATA0/1 */
+	if (rexreg < REX3_REG_SMASK1X)
+		return (NewportRegClassDcb);
+	return (NewportRegClassConfig);
+}
+
+static inline void
+newport_stats_prim(struct gfx_ctx *dc, NewportPrim prim, uint64_t npixels)
+{
+	dc->stats.prims[prim]++;
+	dc->stats.pixels[prim] += npixels;
+}
+
+extern	uint64_t newport_stats_now_ns(void);
+
+extern	void newport_stats_snapshot(const struct gfx_ctx *dc,
+	    struct newport_stats *st);
+extern	void newport_stats_reset(struct gfx_ctx *dc);
+extern	void newport_stats_print(const struct newport_stats *st,
+	    const char *pfx);
+
+extern	bool newport_stats_dump_setup(int signo, int interval_secs);
+extern	void newport_stats_poll(struct gfx_ctx *dc);
+
+#endif	/* __NEWPORT_STATS_H__ */
@@ -0,0 +1,1184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+#include <strings.h>
+#include <err.h>
+#include <time.h>
+
+#include <sys/param.h>
+
+#ifndef	nitems
+#define	nitems(x)	(sizeof((x)) / sizeof((x)[0]))
+#endif
+
+#include "newport_regs.h"
+#include "newport_ctx.h"
+#include "newport_regio.h"
+#include "newport_ops.h"
+#include "newport_sim.h"
+#include "newport_fence.h"
+#include "newport_dlist.h"
+#include "newport_stats.h"
+#include "newport_dither.h"
+#include "newport_cmap.h"
+
+#include "point.h"
+#include "scanline.h"
+#include "bres.h"
+#include "polygon.h"
+#include "mesh.h"
+#include "raster_mt.h"
+#include "line.h"
+#include "ellipse.h"
+#include "sbuf.h"
+
+/*
+ * Golden image / performance regression tests for the drawing
+ * library.
+ *
+ * Each test draws into a small simulated REX3 framebuffer.  The
+ * resulting pixels are compared against a stored golden image, and
+ * the number of register writes a run takes against a stored
+ * baseline, so rendering breakage and extra hardware traffic are
+ * caught without an Indy.  The CPU time is in the baseline too, but
+ * it depends on the machine the baseline was written on, so it's
+ * only checked when asked for with -c ("make perf").
+ *
+ * Golden images are binary PPMs holding the low 24 bits of each
+ * raw simulator pixel (which is everything any of the pixel modes
+ * use); they're written by running with -u, which also rewrites
+ * the baseline.
+ */
+
+#define	REGRESS_WIDTH		160
+#define	REGRESS_HEIGHT		120
+
+#define	REGRESS_DIR		"golden"
+#define	REGRESS_BASELINE	"baseline.txt"
+#define	REGRESS_BASELINE_VERSION	1
+
+/* CPU time growth under this is noise, whatever the percentage */
+#define	REGRESS_CPU_SLOP_NS	20000
+
+struct regress_test {
+	const char *name;
+	NewportBppMode fb_mode;
+	NewportBppMode pixel_mode;
+	void (*fn)(struct gfx_ctx *ctx);
+};
+
+struct regress_result {
+	bool valid;
+	uint64_t reg_writes;
+	uint64_t cpu_ns;
+};
+
+/*
+ * Test data has to be the same everywhere the golden images are
+ * checked, so don't use the libc random().
+ */
+static uint32_t regress_seed;
+
+static uint32_t
+regress_random(void)
+{
+	regress_seed = regress_seed * 1103515245 + 12345;
+	return (regress_seed >> 8);
+}
+
+static void
+regress_clear(struct gfx_ctx *ctx)
+{
+	newport_fill_rectangle_fast(ctx, 0, 0, REGRESS_WIDTH,
+	    REGRESS_HEIGHT, 0);
+}
+
+/* A colour gradient with a few hard edges in it */
+static uint32_t *
+regress_image(int w, int h)
+{
+	uint32_t *img;
+	int x, y;
+
+	img = calloc(w * h, sizeof(uint32_t));
+	if (img == NULL)
+		err(1, "%s: calloc", __func__);
+	for (y = 0; y < h; y++)
+		for (x = 0; x < w; x++)
+			img[y * w + x] = ((x * 255 / w) << 16) |
+			    ((y * 255 / h) << 8) |
+			    (((x / 8 + y / 8) & 1) ? 0xc0 : 0x20);
+	return img;
+}
+
+static void
+regress_fill_fast(struct gfx_ctx *ctx)
+{
+	regress_clear(ctx);
+	newport_fill_rectangle_fast(ctx, 10, 10, 60, 40, 0xff0000);
+	newport_fill_rectangle_fast(ctx, 40, 30, 60, 40, 0x00ff00);
+	newport_fill_rectangle_fast(ctx, 90, 5, 1, 100, 0x0000ff);
+	newport_fill_rectangle_fast(ctx, 5, 100, 150, 1, 0xffffff);
+	newport_fill_rectangle_fast(ctx, 150, 110, 20, 20, 0x808080);
+}
+
+static void
+regress_fill_rect(struct gfx_ctx *ctx)
+{
+	int i;
+
+	regress_clear(ctx);
+	newport_fill_rectangle_setup(ctx);
+	for (i = 0; i < 40; i++)
+		newport_fill_rectangle(ctx, (i * 37) % 150, (i * 23) % 110,
+		    1 + (i % 13), 1 + (i % 7), 0x010203 * (i * 6));
+}
+
+static void
+regress_fill_rects(struct gfx_ctx *ctx)
+{
+	struct newport_rect r[100];
+	int i;
+
+	regress_clear(ctx);
+
+	/* Overlapping, drawn in order */
+	regress_seed = 1;
+	for (i = 0; i < 50; i++) {
+		r[i].x = regress_random() % 150;
+		r[i].y = regress_random() % 60;
+		r[i].w = 1 + regress_random() % 30;
+		r[i].h = 1 + regress_random() % 20;
+		r[i].color = (i % 5) * 0x333333;
+	}
+	newport_fill_rectangles(ctx, r, 50, 0);
+
+	/* A non-overlapping grid which can be reordered */
+	for (i = 0; i < 100; i++) {
+		r[i].x = (i % 20) * 8;
+		r[i].y = 64 + (i / 20) * 10;
+		r[i].w = 7;
+		r[i].h = 9;
+		r[i].color = (i % 3) ? 0xff8000 : 0x0080ff;
+	}
+	newport_fill_rectangles(ctx, r, 100, NEWPORT_FILL_ANY_ORDER);
+}
+
+static void
+regress_spans(struct gfx_ctx *ctx)
+{
+	struct scanline_list *sl;
+	int y;
+
+	sl = scanline_list_alloc(REGRESS_HEIGHT);
+	if (sl == NULL)
+		err(1, "%s: scanline_list_alloc", __func__);
+
+	/* A box, a wedge and a bottom up run of reversed spans */
+	for (y = 0; y < 30; y++)
+		scanline_list_push(sl, 20, 140, y);
+	for (y = 30; y < 70; y++)
+		scanline_list_push(sl, 80 - (y - 30), 80 + (y - 30), y);
+	for (y = 119; y >= 70; y--)
+		scanline_list_push(sl, 150, 10 + (y & 7), y);
+
+	regress_clear(ctx);
+	newport_fill_spans(ctx, sl, 0x00ff80);
+	scanline_list_free(sl);
+}
+
+static void
+regress_triangles(struct gfx_ctx *ctx)
+{
+	/* Vertices are given in y order */
+	static const int tri[][6] = {
+		{ 40, 5, 10, 30, 70, 30 },
+		{ 10, 40, 70, 40, 40, 70 },
+		{ 100, 5, 80, 40, 150, 60 },
+		{ 120, 70, 90, 90, 155, 115 },
+		{ 20, 80, 60, 100, 5, 118 },
+	};
+	struct scanline_list *sl;
+	int i;
+
+	regress_clear(ctx);
+	for (i = 0; i < (int) nitems(tri); i++) {
+		bres_triangle_xy(tri[i][0], tri[i][1], tri[i][2], tri[i][3],
+		    tri[i][4], tri[i][5], &sl);
+		if (sl == NULL)
+			err(1, "%s: bres_triangle_xy", __func__);
+		newport_fill_spans(ctx, sl, 0x202020 + i * 0x302010);
+		scanline_list_free(sl);
+	}
+}
+
+/*
+ * Flat triangles through the batch rasteriser: nine of them, so
+ * both the four-at-a-time path and the leftovers get used, with
+ * both orientations and the degenerate shapes.
+ */
+static void
+regress_flat(struct gfx_ctx *ctx)
+{
+	static const struct bres_flat_triangle tris[] = {
+		{ 30, 5, 5, 55, 45 },		/* flat bottom */
+		{ 90, 45, 65, 140, 5 },		/* flat top */
+		{ 5, 55, 5, 40, 95 },		/* left edge vertical */
+		{ 80, 95, 45, 80, 55 },		/* right edge vertical */
+		{ 150, 55, 100, 120, 80 },	/* both edges leaning left */
+		{ 100, 85, 110, 155, 115 },	/* both edges leaning right */
+		{ 20, 105, 5, 60, 105 },	/* zero height */
+		{ 70, 100, 70, 70, 115 },	/* zero width */
+		{ 125, 5, 110, 152, 50 },
+	};
+	struct scanline_list *sl;
+
+	sl = scanline_list_alloc(64);
+	if (sl == NULL)
+		err(1, "%s: scanline_list_alloc", __func__);
+
+	regress_clear(ctx);
+	bres_triangle_flat_batch(sl, tris, 8);
+	newport_fill_spans(ctx, sl, 0x80c0ff);
+	sl->cur = 0;
+	bres_triangle_flat_batch(sl, &tris[8], 1);
+	newport_fill_spans(ctx, sl, 0xff8040);
+
+	scanline_list_free(sl);
+}
+
+static void
+regress_polygon(struct gfx_ctx *ctx)
+{
+	/* Pentagrams, for each fill rule */
+	static const struct point2d star_eo[] = {
+		{ 40, 2 }, { 63, 57 }, { 3, 23 }, { 77, 23 }, { 17, 57 },
+	};
+	static const struct point2d star_nz[] = {
+		{ 40, 62 }, { 63, 117 }, { 3, 83 }, { 77, 83 }, { 17, 117 },
+	};
+	/* Concave, with spikes and horizontal edges */
+	static const struct point2d comb[] = {
+		{ 90, 5 }, { 155, 5 }, { 155, 60 }, { 140, 20 }, { 130, 60 },
+		{ 120, 20 }, { 110, 60 }, { 100, 20 }, { 92, 115 },
+	};
+	struct scanline_list *sl;
+
+	sl = scanline_list_alloc(64);
+	if (sl == NULL)
+		err(1, "%s: scanline_list_alloc", __func__);
+
+	regress_clear(ctx);
+	bres_polygon(sl, star_eo, nitems(star_eo), BresFillRuleEvenOdd);
+	newport_fill_spans(ctx, sl, 0xffff00);
+
+	sl->cur = 0;
+	bres_polygon(sl, star_nz, nitems(star_nz), BresFillRuleNonZero);
+	newport_fill_spans(ctx, sl, 0x40ff80);
+
+	sl->cur = 0;
+	bres_polygon(sl, comb, nitems(comb), BresFillRuleEvenOdd);
+	newport_fill_spans(ctx, sl, 0xff00ff);
+
+	scanline_list_free(sl);
+}
+
+static void
+regress_mesh(struct gfx_ctx *ctx)
+{
+	/* A 4x3 grid with the middle vertices pulled about */
+	static const struct point2d grid[] = {
+		{ 5, 5 }, { 25, 5 }, { 45, 5 }, { 65, 5 }, { 85, 5 },
+		{ 5, 30 }, { 31, 26 }, { 40, 37 }, { 70, 28 }, { 85, 30 },
+		{ 5, 60 }, { 20, 55 }, { 52, 64 }, { 61, 50 }, { 85, 60 },
+		{ 5, 85 }, { 25, 85 }, { 45, 85 }, { 65, 85 }, { 85, 85 },
+	};
+	static const struct point2d strip[] = {
+		{ 95, 110 }, { 100, 60 }, { 110, 115 }, { 118, 70 },
+		{ 130, 100 }, { 135, 40 }, { 150, 90 }, { 155, 10 },
+	};
+	struct scanline_list *sl;
+	int idx[4 * 3 * 6], i, x, y, n;
+
+	n = 0;
+	for (y = 0; y < 3; y++) {
+		for (x = 0; x < 4; x++) {
+			i = y * 5 + x;
+			idx[n++] = i;
+			idx[n++] = i + 1;
+			idx[n++] = i + 5;
+			idx[n++] = i + 1;
+			idx[n++] = i + 6;
+			idx[n++] = i + 5;
+		}
+	}
+
+	sl = scanline_list_alloc(64);
+	if (sl == NULL)
+		err(1, "%s: scanline_list_alloc", __func__);
+
+	regress_clear(ctx);
+	/* Alternate colours so shared edges show up */
+	for (i = 0; i < 24; i++) {
+		sl->cur = 0;
+		bres_triangle_mesh(sl, grid, nitems(grid), &idx[i * 3], 1);
+		newport_fill_spans(ctx, sl, (i & 1) ? 0xff8040 : 0x4080ff);
+	}
+	sl->cur = 0;
+	bres_triangle_strip(sl, strip, nitems(strip));
+	newport_fill_spans(ctx, sl, 0x40ff80);
+
+	scanline_list_free(sl);
+}
+
+/*
+ * The mesh again, with its inside vertices at fractional positions
+ * and drawn through the 28.4 top-left rule path.
+ */
+static void
+regress_mesh_subpixel(struct gfx_ctx *ctx)
+{
+	static const struct point2d grid[] = {
+		{ 80, 80 }, { 400, 80 }, { 720, 80 }, { 1040, 80 },
+		{ 1360, 80 },
+		{ 80, 480 }, { 501, 419 }, { 643, 597 }, { 1127, 453 },
+		{ 1360, 480 },
+		{ 80, 960 }, { 326, 883 }, { 837, 1029 }, { 979, 803 },
+		{ 1360, 960 },
+		{ 80, 1360 }, { 400, 1360 }, { 720, 1360 }, { 1040, 1360 },
+		{ 1360, 1360 },
+	};
+	static const struct point2d strip[] = {
+		{ 1523, 1763 }, { 1605, 965 }, { 1767, 1843 }, { 1890, 1127 },
+		{ 2083, 1601 }, { 2165, 643 }, { 2405, 1443 }, { 2483, 165 },
+	};
+	struct scanline_list *sl;
+	int idx[4 * 3 * 6], i, x, y, n;
+
+	n = 0;
+	for (y = 0; y < 3; y++) {
+		for (x = 0; x < 4; x++) {
+			i = y * 5 + x;
+			idx[n++] = i;
+			idx[n++] = i + 1;
+			idx[n++] = i + 5;
+			idx[n++] = i + 1;
+			idx[n++] = i + 6;
+			idx[n++] = i + 5;
+		}
+	}
+
+	sl = scanline_list_alloc(64);
+	if (sl == NULL)
+		err(1, "%s: scanline_list_alloc", __func__);
+
+	regress_clear(ctx);
+	for (i = 0; i < 24; i++) {
+		sl->cur = 0;
+		bres_triangle_mesh_subpixel(sl, grid, nitems(grid),
+		    &idx[i * 3], 1);
+		newport_fill_spans(ctx, sl, (i & 1) ? 0xff8040 : 0x4080ff);
+	}
+	sl->cur = 0;
+	bres_triangle_strip_subpixel(sl, strip, nitems(strip));
+	newport_fill_spans(ctx, sl, 0x40ff80);
+
+	scanline_list_free(sl);
+}
+
+/*
+ * The tile binned rasteriser, on one thread so the CPU time is
+ * repeatable; the server's raster-mt mode covers the threading.
+ */
+static void
+regress_raster_mt(struct gfx_ctx *ctx)
+{
+	struct bres_raster_mt *rm;
+	struct scanline_list *sl;
+	struct point2d pts[60];
+	int idx[60], i;
+
+	for (i = 0; i < 60; i++) {
+		pts[i].x = (int) (regress_random() % 200) - 20;
+		pts[i].y = (int) (regress_random() % 150) - 15;
+		idx[i] = i;
+	}
+
+	rm = bres_raster_mt_create(1, REGRESS_WIDTH, REGRESS_HEIGHT);
+	sl = scanline_list_alloc(64);
+	if (rm == NULL || sl == NULL)
+		err(1, "%s: alloc", __func__);
+
+	regress_clear(ctx);
+	for (i = 0; i < 4; i++) {
+		sl->cur = 0;
+		bres_raster_mt_triangles(rm, sl, pts, 60, &idx[i * 15], 5);
+		newport_fill_spans(ctx, sl, 0x206080 + i * 0x402010);
+	}
+
+	scanline_list_free(sl);
+	bres_raster_mt_free(rm);
+}
+
+static void
+regress_lines(struct gfx_ctx *ctx)
+{
+	int i;
+
+	regress_clear(ctx);
+	for (i = 0; i < 160; i += 8) {
+		newport_draw_line(ctx, 80, 60, i, 0, 0xff0000 + i);
+		newport_draw_line(ctx, 80, 60, 159 - i, 119, 0x00ff00 + i);
+	}
+	for (i = 0; i < 120; i += 8) {
+		newport_draw_line(ctx, 80, 60, 0, 119 - i, 0x0000ff + (i << 8));
+		newport_draw_line(ctx, 80, 60, 159, i, 0xffff00 + i);
+	}
+}
+
+/*
+ * The same lines as spans; this should match the lines golden
+ * image exactly.
+ */
+static void
+regress_line_spans(struct gfx_ctx *ctx)
+{
+	struct scanline_list *sl;
+	int i;
+
+	sl = scanline_list_alloc(64);
+	if (sl == NULL)
+		err(1, "%s: scanline_list_alloc", __func__);
+
+	regress_clear(ctx);
+	for (i = 0; i < 160; i += 8) {
+		sl->cur = 0;
+		bres_line(sl, 80, 60, i, 0);
+		newport_fill_spans(ctx, sl, 0xff0000 + i);
+		sl->cur = 0;
+		bres_line(sl, 80, 60, 159 - i, 119);
+		newport_fill_spans(ctx, sl, 0x00ff00 + i);
+	}
+	for (i = 0; i < 120; i += 8) {
+		sl->cur = 0;
+		bres_line(sl, 80, 60, 0, 119 - i);
+		newport_fill_spans(ctx, sl, 0x0000ff + (i << 8));
+		sl->cur = 0;
+		bres_line(sl, 80, 60, 159, i);
+		newport_fill_spans(ctx, sl, 0xffff00 + i);
+	}
+
+	scanline_list_free(sl);
+}
+
+static void
+regress_line_thick(struct gfx_ctx *ctx)
+{
+	struct scanline_list *sl;
+	int i;
+
+	sl = scanline_list_alloc(64);
+	if (sl == NULL)
+		err(1, "%s: scanline_list_alloc", __func__);
+
+	regress_clear(ctx);
+	for (i = 0; i < 8; i++) {
+		sl->cur = 0;
+		bres_line_thick(sl, 10 + i * 18, 10, 30 + i * 12, 110, i + 1);
+		newport_fill_spans(ctx, sl, 0x4080ff + i * 0x201000);
+	}
+	for (i = 0; i < 5; i++) {
+		sl->cur = 0;
+		bres_line_thick(sl, 5, 20 + i * 20, 155, 30 + i * 14, i * 2 + 1);
+		newport_fill_spans(ctx, sl, 0xff8040 - i * 0x100020);
+	}
+
+	scanline_list_free(sl);
+}
+
+static void
+regress_ellipse(struct gfx_ctx *ctx)
+{
+	struct scanline_list *sl;
+	int i;
+
+	sl = scanline_list_alloc(64);
+	if (sl == NULL)
+		err(1, "%s: scanline_list_alloc", __func__);
+
+	regress_clear(ctx);
+	/* A gauge: a ring, a dial and some pips */
+	bres_circle_ring(sl, 40, 40, 35, 4);
+	newport_fill_spans(ctx, sl, 0xc0c0c0);
+	sl->cur = 0;
+	bres_circle(sl, 40, 40, 20);
+	newport_fill_spans(ctx, sl, 0x204080);
+	for (i = 0; i < 8; i++) {
+		sl->cur = 0;
+		bres_circle(sl, 10 + i * 9, 90, i);
+		newport_fill_spans(ctx, sl, 0xff4040 + i * 0x001810);
+	}
+	sl->cur = 0;
+	bres_ellipse(sl, 115, 30, 40, 22);
+	newport_fill_spans(ctx, sl, 0x40ff80);
+	sl->cur = 0;
+	bres_ellipse_ring(sl, 115, 30, 30, 12, 3);
+	newport_fill_spans(ctx, sl, 0x8040ff);
+	sl->cur = 0;
+	bres_rounded_rect(sl, 85, 62, 70, 24, 8);
+	newport_fill_spans(ctx, sl, 0xffc040);
+	sl->cur = 0;
+	bres_rounded_rect(sl, 85, 92, 70, 24, 30);
+	newport_fill_spans(ctx, sl, 0x40c0ff);
+
+	scanline_list_free(sl);
+}
+
+static void
+regress_sbuf(struct gfx_ctx *ctx)
+{
+	static const uint32_t colors[4] = {
+		0x4040ff, 0xff40c0, 0x40ff80, 0xffff40
+	};
+	struct scanline_list *sl, *vis[4];
+	struct bres_sbuf *sb;
+	int i;
+
+	sl = scanline_list_alloc(64);
+	sb = bres_sbuf_create(160, 120);
+	if (sl == NULL || sb == NULL)
+		err(1, "%s: alloc", __func__);
+	for (i = 0; i < 4; i++) {
+		vis[i] = scanline_list_alloc(64);
+		if (vis[i] == NULL)
+			err(1, "%s: scanline_list_alloc", __func__);
+	}
+
+	/* Added near to far; the dial goes between the two windows */
+	bres_rounded_rect(sl, 70, 50, 80, 60, 6);
+	bres_sbuf_add(sb, sl, 0, 0);
+	sl->cur = 0;
+	bres_circle(sl, 60, 50, 35);
+	bres_sbuf_add(sb, sl, 1, 1);
+	sl->cur = 0;
+	bres_rounded_rect(sl, 10, 10, 100, 70, 10);
+	bres_sbuf_add(sb, sl, 2, 2);
+	/* Half off screen, behind everything */
+	sl->cur = 0;
+	bres_circle(sl, 150, 10, 40);
+	bres_sbuf_add(sb, sl, 3, 3);
+	bres_sbuf_resolve(sb, vis, 4);
+
+	regress_clear(ctx);
+	for (i = 0; i < 4; i++) {
+		newport_fill_spans(ctx, vis[i], colors[i]);
+		scanline_list_free(vis[i]);
+	}
+	bres_sbuf_free(sb);
+	scanline_list_free(sl);
+}
+
+static void
+regress_aalines(struct gfx_ctx *ctx)
+{
+	struct newport_subpoint pts[40];
+	int i;
+
+	regress_clear(ctx);
+	for (i = 0; i < 160; i += 10)
+		newport_draw_line_aa(ctx, NEWPORT_INT_TO_SUBPIXEL(80),
+		    NEWPORT_INT_TO_SUBPIXEL(60), i * NEWPORT_SUBPIXEL_ONE + 5,
+		    i % 20 == 0 ? 3 : NEWPORT_INT_TO_SUBPIXEL(119) - 3,
+		    0x4080ff, NEWPORT_AA_ENDPTFILTER);
+	for (i = 0; i < 40; i++) {
+		pts[i].x = i * 4 * NEWPORT_SUBPIXEL_ONE + 7;
+		pts[i].y = NEWPORT_INT_TO_SUBPIXEL(60) +
+		    (int) (regress_random() % (40 * NEWPORT_SUBPIXEL_ONE)) -
+		    NEWPORT_INT_TO_SUBPIXEL(20);
+	}
+	newport_draw_polyline_aa(ctx, pts, 40, 0x40ff80, 0);
+}
+
+static void
+regress_bitblt(struct gfx_ctx *ctx)
+{
+	regress_clear(ctx);
+	newport_fill_rectangle_fast(ctx, 10, 10, 30, 30, 0xff0000);
+	newport_fill_rectangle_fast(ctx, 20, 20, 30, 30, 0x00ff00);
+	newport_draw_line(ctx, 10, 10, 49, 49, 0xffffff);
+
+	/* Non-overlapping, then overlapping in each direction */
+	newport_bitblt(ctx, 10, 10, 100, 10, 40, 40,
+	    REX3_DRAWMODE1_LO_SRC);
+	newport_bitblt(ctx, 10, 10, 15, 60, 40, 40,
+	    REX3_DRAWMODE1_LO_SRC);
+	newport_bitblt(ctx, 100, 10, 95, 5, 40, 40,
+	    REX3_DRAWMODE1_LO_SRC);
+	newport_bitblt(ctx, 15, 60, 100, 70, 40, 40,
+	    REX3_DRAWMODE1_LO_XOR);
+}
+
+static void
+regress_pattern(struct gfx_ctx *ctx)
+{
+	static const uint8_t hatch[8] = {
+		0x81, 0x42, 0x24, 0x18, 0x18, 0x24, 0x42, 0x81,
+	};
+	struct newport_pattern pat;
+	int y;
+
+	regress_clear(ctx);
+	newport_fill_rectangle_fast(ctx, 0, 60, REGRESS_WIDTH, 60, 0x404040);
+
+	newport_pattern_init_8x8(&pat, hatch);
+	newport_fill_pattern(ctx, 3, 5, 70, 50, &pat, 0xffffff, 0x0000ff,
+	    NEWPORT_PATTERN_OPAQUE);
+	newport_fill_pattern(ctx, 5, 65, 150, 20, &pat, 0xff0000, 0, 0);
+
+	/* A 32x32 pattern that isn't just a replicated 8x8 one */
+	for (y = 0; y < 32; y++)
+		pat.rows[y] = (0xffff0000U >> (y / 2)) ^ (y * 0x01234567U);
+	newport_fill_pattern(ctx, 80, 7, 77, 45, &pat, 0x00ff00, 0xff00ff,
+	    NEWPORT_PATTERN_OPAQUE);
+	newport_fill_pattern(ctx, 31, 90, 97, 29, &pat, 0xffff00, 0, 0);
+}
+
+static void
+regress_dlist(struct gfx_ctx *ctx)
+{
+	struct newport_dlist *dl;
+	int i;
+
+	dl = newport_dlist_create(ctx);
+	if (dl == NULL)
+		err(1, "%s: newport_dlist_create", __func__);
+
+	for (i = 0; i < 120; i += 6)
+		newport_dlist_line(dl, 0, i, 159, 119 - i, 0x00ffff);
+	for (i = 0; i < 10; i++)
+		newport_dlist_fill_rectangle(dl, i * 16, i * 12, 12, 8,
+		    0x102030 * i);
+	for (i = 0; i < 20; i++)
+		newport_dlist_fill_span(dl, 100 - i, 140 + i, 90 + i,
+		    0xff00ff);
+	newport_dlist_bitblt(dl, 0, 0, 80, 10, 40, 30,
+	    REX3_DRAWMODE1_LO_SRC);
+
+	regress_clear(ctx);
+	newport_dlist_replay(ctx, dl);
+	newport_dlist_destroy(dl);
+}
+
+/*
+ * Colour conversion: fills, lines and an image upload in whatever
+ * framebuffer / pixel mode the test is run in.
+ */
+static void
+regress_formats(struct gfx_ctx *ctx)
+{
+	static const uint32_t colors[] = {
+		0xffffff, 0xff0000, 0x00ff00, 0x0000ff, 0x123456,
+		0x808080, 0xfedcba, 0x0f0f0f,
+	};
+	uint32_t *img;
+	int i;
+
+	img = regress_image(61, 37);
+
+	regress_clear(ctx);
+	for (i = 0; i < (int) nitems(colors); i++) {
+		newport_fill_rectangle_fast(ctx, i * 20, 0, 18, 20, colors[i]);
+		newport_draw_line(ctx, i * 20, 25, i * 20 + 17, 45, colors[i]);
+	}
+	newport_fill_rectangle_setup(ctx);
+	for (i = 0; i < (int) nitems(colors); i++)
+		newport_fill_rectangle(ctx, i * 20, 50, 18, 10, colors[i]);
+	newport_upload_image(ctx, 3, 70, 61, 37, img, 61);
+
+	free(img);
+}
+
+static void
+regress_dither_ordered(struct gfx_ctx *ctx)
+{
+	uint32_t *img;
+
+	img = regress_image(REGRESS_WIDTH, REGRESS_HEIGHT);
+	newport_upload_image_dither(ctx, 0, 0, REGRESS_WIDTH, REGRESS_HEIGHT,
+	    img, REGRESS_WIDTH, NewportDitherOrdered);
+	free(img);
+}
+
+static void
+regress_dither_diffuse(struct gfx_ctx *ctx)
+{
+	uint32_t *img;
+
+	img = regress_image(REGRESS_WIDTH, REGRESS_HEIGHT);
+	newport_upload_image_dither(ctx, 0, 0, REGRESS_WIDTH, REGRESS_HEIGHT,
+	    img, REGRESS_WIDTH, NewportDitherDiffuse);
+	free(img);
+}
+
+static void
+regress_cmap(struct gfx_ctx *ctx)
+{
+	struct newport_cmap *cm;
+	uint32_t *img;
+	int i;
+
+	cm = newport_cmap_create(ctx, 0, 0, NEWPORT_CMAP_NENTRIES);
+	if (cm == NULL)
+		err(1, "%s: newport_cmap_create", __func__);
+	for (i = 0; i < 64; i++)
+		newport_cmap_alloc(cm, ((i & 3) * 0x55) << 16 |
+		    (((i >> 2) & 3) * 0x55) << 8 | ((i >> 4) & 3) * 0x55);
+
+	img = regress_image(REGRESS_WIDTH, REGRESS_HEIGHT);
+	newport_cmap_upload_image(cm, 0, 0, REGRESS_WIDTH, REGRESS_HEIGHT,
+	    img, REGRESS_WIDTH);
+	free(img);
+	newport_cmap_destroy(cm);
+}
+
+static const struct regress_test regress_tests[] = {
+	{ "fill_fast", NewportBppModeRgb8, NewportBppModeRgb24,
+	    regress_fill_fast },
+	{ "fill_rect", NewportBppModeRgb8, NewportBppModeRgb24,
+	    regress_fill_rect },
+	{ "fill_rects", NewportBppModeRgb8, NewportBppModeRgb24,
+	    regress_fill_rects },
+	{ "spans", NewportBppModeRgb8, NewportBppModeRgb24,
+	    regress_spans },
+	{ "triangles", NewportBppModeRgb8, NewportBppModeRgb24,
+	    regress_triangles },
+	{ "flat", NewportBppModeRgb8, NewportBppModeRgb24,
+	    regress_flat },
+	{ "polygon", NewportBppModeRgb8, NewportBppModeRgb24,
+	    regress_polygon },
+	{ "lines", NewportBppModeRgb8, NewportBppModeRgb24,
+	    regress_lines },
+	{ "line_spans", NewportBppModeRgb8, NewportBppModeRgb24,
+	    regress_line_spans },
+	{ "line_thick", NewportBppModeRgb8, NewportBppModeRgb24,
+	    regress_line_thick },
+	{ "ellipse", NewportBppModeRgb8, NewportBppModeRgb24,
+	    regress_ellipse },
+	{ "sbuf", NewportBppModeRgb24, NewportBppModeRgb24,
+	    regress_sbuf },
+	{ "mesh", NewportBppModeRgb8, NewportBppModeRgb24,
+	    regress_mesh },
+	{ "mesh_subpixel", NewportBppModeRgb8, NewportBppModeRgb24,
+	    regress_mesh_subpixel },
+	{ "raster_mt", NewportBppModeRgb8, NewportBppModeRgb24,
+	    regress_raster_mt },
+	{ "aalines", NewportBppModeRgb24, NewportBppModeRgb24,
+	    regress_aalines },
+	{ "bitblt", NewportBppModeRgb8, NewportBppModeRgb24,
+	    regress_bitblt },
+	{ "pattern", NewportBppModeRgb8, NewportBppModeRgb24,
+	    regress_pattern },
+	{ "dlist", NewportBppModeRgb8, NewportBppModeRgb24,
+	    regress_dlist },
+	{ "formats_rgb8", NewportBppModeRgb8, NewportBppModeRgb24,
+	    regress_formats },
+	{ "formats_rgb12", NewportBppModeRgb12, NewportBppModeRgb24,
+	    regress_formats },
+	{ "formats_rgb12_12", NewportBppModeRgb12, NewportBppModeRgb12,
+	    regress_formats },
+	{ "formats_rgb24", NewportBppModeRgb24, NewportBppModeRgb24,
+	    regress_formats },
+	{ "formats_ci8", NewportBppModeCi8, NewportBppModeCi8,
+	    regress_formats },
+	{ "formats_ci4", NewportBppModeCi4, NewportBppModeCi4,
+	    regress_formats },
+	{ "dither_ordered", NewportBppModeRgb8, NewportBppModeRgb24,
+	    regress_dither_ordered },
+	{ "dither_diffuse", NewportBppModeRgb8, NewportBppModeRgb24,
+	    regress_dither_diffuse },
+	{ "cmap", NewportBppModeCi8, NewportBppModeCi8,
+	    regress_cmap },
+};
+
+static int
+regress_find(const char *name)
+{
+	int i;
+
+	for (i = 0; i < (int) nitems(regress_tests); i++)
+		if (strcmp(regress_tests[i].name, name) == 0)
+			return (i);
+	return (-1);
+}
+
+static uint64_t
+regress_cpu_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+static bool
+regress_ppm_write(const char *path, const uint32_t *fb, int w, int h)
+{
+	FILE *fp;
+	int i;
+
+	fp = fopen(path, "w");
+	if (fp == NULL) {
+		warn("%s: fopen(%s)", __func__, path);
+		return false;
+	}
+	fprintf(fp, "P6\n%d %d\n255\n", w, h);
+	for (i = 0; i < w * h; i++) {
+		fputc((fb[i] >> 16) & 0xff, fp);
+		fputc((fb[i] >> 8) & 0xff, fp);
+		fputc(fb[i] & 0xff, fp);
+	}
+	if (fclose(fp) != 0) {
+		warn("%s: fclose(%s)", __func__, path);
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Read a golden image written by regress_ppm_write(); returns NULL
+ * if it's missing or isn't a (w x h) image.
+ */
+static uint32_t *
+regress_ppm_read(const char *path, int w, int h)
+{
+	uint32_t *fb;
+	FILE *fp;
+	int i, pw, ph, maxval, r, g, b;
+
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return NULL;
+	if (fscanf(fp, "P6 %d %d %d", &pw, &ph, &maxval) != 3 ||
+	    fgetc(fp) == EOF || pw != w || ph != h || maxval != 255) {
+		printf("%s: %s isn't a %dx%d PPM\n", __func__, path, w, h);
+		fclose(fp);
+		return NULL;
+	}
+
+	fb = calloc(w * h, sizeof(uint32_t));
+	if (fb == NULL)
+		err(1, "%s: calloc", __func__);
+	for (i = 0; i < w * h; i++) {
+		r = fgetc(fp);
+		g = fgetc(fp);
+		b = fgetc(fp);
+		if (b == EOF) {
+			printf("%s: %s is truncated\n", __func__, path);
+			free(fb);
+			fb = NULL;
+			break;
+		}
+		fb[i] = (r << 16) | (g << 8) | b;
+	}
+	fclose(fp);
+	return fb;
+}
+
+static void
+regress_baseline_load(const char *path, struct regress_result *base)
+{
+	char buf[256], name[64];
+	unsigned long long nw, ns;
+	FILE *fp;
+	int v, i;
+
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return;
+	if (fgets(buf, sizeof(buf), fp) == NULL ||
+	    sscanf(buf, "version %d", &v) != 1 ||
+	    v != REGRESS_BASELINE_VERSION) {
+		printf("%s: ignoring %s; wrong version\n", __func__, path);
+		fclose(fp);
+		return;
+	}
+	while (fgets(buf, sizeof(buf), fp) != NULL) {
+		if (buf[0] == '#' ||
+		    sscanf(buf, "%63s %llu %llu", name, &nw, &ns) != 3)
+			continue;
+		i = regress_find(name);
+		if (i < 0)
+			continue;
+		base[i].valid = true;
+		base[i].reg_writes = nw;
+		base[i].cpu_ns = ns;
+	}
+	fclose(fp);
+}
+
+static bool
+regress_baseline_save(const char *path, const struct regress_result *base)
+{
+	FILE *fp;
+	int i;
+
+	fp = fopen(path, "w");
+	if (fp == NULL) {
+		warn("%s: fopen(%s)", __func__, path);
+		return false;
+	}
+	fprintf(fp, "version %d\n", REGRESS_BASELINE_VERSION);
+	fprintf(fp, "# test register-writes cpu-ns\n");
+	for (i = 0; i < (int) nitems(regress_tests); i++) {
+		if (! base[i].valid)
+			continue;
+		fprintf(fp, "%s %llu %llu\n", regress_tests[i].name,
+		    (unsigned long long) base[i].reg_writes,
+		    (unsigned long long) base[i].cpu_ns);
+	}
+	if (fclose(fp) != 0) {
+		warn("%s: fclose(%s)", __func__, path);
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Run a test against a freshly reset simulator: once for the image
+ * and register count, then nruns more times for the CPU time (the
+ * fastest run, which is the least noisy).
+ */
+static uint32_t *
+regress_run(const struct regress_test *t, int nruns,
+    struct regress_result *res)
+{
+	struct gfx_ctx ctx;
+	uint64_t start, ns;
+	uint32_t *fb;
+	int i;
+
+	bzero(&ctx, sizeof(ctx));
+	ctx.fd = -1;
+	if (! newport_sim_attach(&ctx, REGRESS_WIDTH, REGRESS_HEIGHT))
+		err(1, "%s: newport_sim_attach", __func__);
+	ctx.fb_mode = t->fb_mode;
+	ctx.pixel_mode = t->pixel_mode;
+	ctx.display_buffer = NewportDoubleBufferNone;
+	ctx.draw_buffer = NewportDoubleBufferNone;
+	ctx.cfreq = 70;
+	newport_setup_hw(&ctx);
+
+	newport_stats_reset(&ctx);
+	regress_seed = 1;
+	t->fn(&ctx);
+
+	res->valid = true;
+	res->reg_writes = 0;
+	for (i = 0; i < NewportRegClassMax; i++)
+		res->reg_writes += ctx.stats.reg_writes[i];
+
+	fb = malloc(REGRESS_WIDTH * REGRESS_HEIGHT * sizeof(uint32_t));
+	if (fb == NULL)
+		err(1, "%s: malloc", __func__);
+	for (i = 0; i < REGRESS_WIDTH * REGRESS_HEIGHT; i++)
+		fb[i] = ctx.sim->fb[i] & 0xffffff;
+
+	res->cpu_ns = UINT64_MAX;
+	for (i = 0; i < nruns; i++) {
+		regress_seed = 1;
+		start = regress_cpu_ns();
+		t->fn(&ctx);
+		ns = regress_cpu_ns() - start;
+		res->cpu_ns = MIN(res->cpu_ns, ns);
+	}
+	if (nruns == 0)
+		res->cpu_ns = 0;
+
+	newport_sim_detach(&ctx);
+	return fb;
+}
+
+static bool
+regress_check_image(const struct regress_test *t, const char *dir,
+    const uint32_t *fb)
+{
+	char path[1024];
+	uint32_t *golden;
+	int i, ndiff = 0, first = -1;
+
+	snprintf(path, sizeof(path), "%s/%s.ppm", dir, t->name);
+	golden = regress_ppm_read(path, REGRESS_WIDTH, REGRESS_HEIGHT);
+	if (golden == NULL) {
+		printf("%s: no golden image %s\n", t->name, path);
+		return false;
+	}
+
+	for (i = 0; i < REGRESS_WIDTH * REGRESS_HEIGHT; i++) {
+		if (fb[i] == golden[i])
+			continue;
+		if (first < 0)
+			first = i;
+		ndiff++;
+	}
+	if (ndiff != 0) {
+		printf("%s: %d pixels differ; first at (%d,%d): "
+		    "0x%06x, expected 0x%06x\n", t->name, ndiff,
+		    first % REGRESS_WIDTH, first / REGRESS_WIDTH,
+		    fb[first], golden[first]);
+		snprintf(path, sizeof(path), "regress-%s.ppm", t->name);
+		if (regress_ppm_write(path, fb, REGRESS_WIDTH, REGRESS_HEIGHT))
+			printf("%s: wrote %s\n", t->name, path);
+	}
+	free(golden);
+	return (ndiff == 0);
+}
+
+static bool
+regress_check_perf(const struct regress_test *t,
+    const struct regress_result *res, const struct regress_result *base,
+    int writes_pct, int cpu_pct)
+{
+	bool ret = true;
+
+	if (! base->valid) {
+		printf("%s: no baseline\n", t->name);
+		return false;
+	}
+	if (res->reg_writes * 100 > base->reg_writes * (100 + writes_pct)) {
+		printf("%s: %llu register writes, baseline %llu\n", t->name,
+		    (unsigned long long) res->reg_writes,
+		    (unsigned long long) base->reg_writes);
+		ret = false;
+	}
+	if (cpu_pct >= 0 &&
+	    res->cpu_ns * 100 > base->cpu_ns * (100 + cpu_pct) &&
+	    res->cpu_ns > base->cpu_ns + REGRESS_CPU_SLOP_NS) {
+		printf("%s: %llu ns CPU, baseline %llu ns\n", t->name,
+		    (unsigned long long) res->cpu_ns,
+		    (unsigned long long) base->cpu_ns);
+		ret = false;
+	}
+	return ret;
+}
+
+static void
+usage(void)
+{
+	int i;
+
+	fprintf(stderr, "Usage: regress [-u] [-c pct] [-d dir] [-n runs] "
+	    "[-w pct] [test ...]\n");
+	fprintf(stderr, "  -c: allowed CPU time growth, -1 to not check "
+	    "(default -1)\n");
+	fprintf(stderr, "  -d: golden image / baseline directory "
+	    "(default %s)\n", REGRESS_DIR);
+	fprintf(stderr, "  -n: timed runs per test (default 20)\n");
+	fprintf(stderr, "  -u: update the golden images and baseline\n");
+	fprintf(stderr, "  -w: allowed register write growth (default 0%%)\n");
+	fprintf(stderr, "  tests:");
+	for (i = 0; i < (int) nitems(regress_tests); i++)
+		fprintf(stderr, " %s", regress_tests[i].name);
+	fprintf(stderr, "\n");
+	exit(127);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct regress_result base[nitems(regress_tests)];
+	struct regress_result res;
+	const struct regress_test *t;
+	const char *dir = REGRESS_DIR;
+	char path[1024];
+	bool update = false, ok, run[nitems(regress_tests)];
+	int ch, i, nruns = 20, writes_pct = 0, cpu_pct = -1;
+	int nfail = 0, nrun = 0;
+	uint32_t *fb;
+
+	while ((ch = getopt(argc, argv, "c:d:n:uw:")) != -1) {
+		switch (ch) {
+		case 'c':
+			cpu_pct = strtol(optarg, NULL, 0);
+			break;
+		case 'd':
+			dir = optarg;
+			break;
+		case 'n':
+			nruns = strtoul(optarg, NULL, 0);
+			break;
+		case 'u':
+			update = true;
+			break;
+		case 'w':
+			writes_pct = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	for (i = 0; i < (int) nitems(regress_tests); i++)
+		run[i] = (argc == 0);
+	for (; argc > 0; argc--, argv++) {
+		i = regress_find(argv[0]);
+		if (i < 0) {
+			printf("regress: unknown test '%s'\n", argv[0]);
+			usage();
+		}
+		run[i] = true;
+	}
+
+	bzero(base, sizeof(base));
+	snprintf(path, sizeof(path), "%s/%s", dir, REGRESS_BASELINE);
+	regress_baseline_load(path, base);
+
+	for (i = 0; i < (int) nitems(regress_tests); i++) {
+		if (! run[i])
+			continue;
+		t = &regress_tests[i];
+		nrun++;
+
+		fb = regress_run(t, nruns, &res);
+		printf("%s: %llu register writes, %llu ns CPU",
+		    t->name, (unsigned long long) res.reg_writes,
+		    (unsigned long long) res.cpu_ns);
+		if (base[i].valid)
+			printf(" (baseline %llu, %llu ns)",
+			    (unsigned long long) base[i].reg_writes,
+			    (unsigned long long) base[i].cpu_ns);
+		printf("\n");
+
+		if (update) {
+			snprintf(path, sizeof(path), "%s/%s.ppm", dir, t->name);
+			if (! regress_ppm_write(path, fb, REGRESS_WIDTH,
+			    REGRESS_HEIGHT))
+				nfail++;
+			base[i] = res;
+		} else {
+			ok = regress_check_image(t, dir, fb);
+			if (! regress_check_perf(t, &res, &base[i], writes_pct,
+			    cpu_pct))
+				ok = false;
+			if (! ok) {
+				printf("%s: FAILED\n", t->name);
+				nfail++;
+			}
+		}
+		free(fb);
+	}
+
+	if (update) {
+		snprintf(path, sizeof(path), "%s/%s", dir, REGRESS_BASELINE);
+		if (! regress_baseline_save(path, base))
+			nfail++;
+		printf("regress: updated %d tests in %s\n", nrun, dir);
+	} else
+		printf("regress: %d of %d tests passed\n", nrun - nfail, nrun);
+
+	exit(nfail == 0 ? 0 : 1);
+}
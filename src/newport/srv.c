@@ -5,30 +5,73 @@
 #include <unistd.h>
 #include <stdint.h>
 #include <fcntl.h>
+#include <string.h>
 #include <strings.h>
-#include <dev/wscons/wsconsio.h>
 #include <err.h>
 #include <time.h>
+#include <pthread.h>
+#include <signal.h>
+#include <math.h>
+#ifdef __NetBSD__
+#include <dev/wscons/wsconsio.h>
+#endif
 
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/param.h>
 
 #include "newport_regs.h"
 #include "newport_ctx.h"
 #include "newport_regio.h"
 #include "newport_hwops.h"
 #include "newport_ops.h"
+#include "newport_sim.h"
+#include "newport_cmdq.h"
+#include "newport_proto.h"
+#include "newport_server.h"
+#include "newport_fence.h"
+#include "newport_dlist.h"
+#include "newport_fillpath.h"
+#include "newport_stats.h"
+#include "newport_dither.h"
+#include "newport_cmap.h"
+
+#include "point.h"
+#include "scanline.h"
+#include "bres.h"
+#include "polygon.h"
+#include "mesh.h"
+#include "raster_mt.h"
+#include "arena.h"
+#include "line.h"
+#include "ellipse.h"
+#include "sbuf.h"
+
+static struct newport_server server;
+
+static void
+serve_sighandler(int sig)
+{
+	newport_server_stop(&server);
+}
 
 static bool
-verify_newport(void)
+serve(struct gfx_ctx *ctx, const char *path)
 {
-	int fd, type, i;
+	struct sigaction sa;
 
-	fd = open("/dev/ttyE0", O_RDONLY, 0);
-	i = ioctl(fd, WSDISPLAYIO_GTYPE, &type);
-	close(fd);
+	if (! newport_server_init(&server, ctx, path, 1280, 1024))
+		return false;
 
-	return ((i == 0) && (type == WSDISPLAY_TYPE_NEWPORT));
+	bzero(&sa, sizeof(sa));
+	sa.sa_handler = serve_sighandler;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	printf("newport: serving on %s\n", path);
+	newport_server_run(&server);
+	newport_server_close(&server);
+	return true;
 }
 
 static void
@@ -46,6 +89,19 @@ gfx_ctx_init(struct gfx_ctx *ctx)
 	ctx->cfreq = 70; /* 1024x768 60Hz */
 }
 
+#ifdef __NetBSD__
+static bool
+verify_newport(void)
+{
+	int fd, type, i;
+
+	fd = open("/dev/ttyE0", O_RDONLY, 0);
+	i = ioctl(fd, WSDISPLAYIO_GTYPE, &type);
+	close(fd);
+
+	return ((i == 0) && (type == WSDISPLAY_TYPE_NEWPORT));
+}
+
 static bool
 newport_open(struct gfx_ctx *ctx)
 {
@@ -104,6 +160,7 @@ newport_close(struct gfx_ctx *ctx)
 		ctx->fd = -1;
 	}
 }
+#endif	/* __NetBSD__ */
 
 static void
 benchmark_rectangle(struct gfx_ctx *ctx, int tw, int th, int tcount)
@@ -141,39 +198,1948 @@ benchmark_rectangle(struct gfx_ctx *ctx, int tw, int th, int tcount)
 	    "%.3f fills/sec, %.3f pixels/sec\n",
 	    tw, th,
 	    tcount,
-	    ts / 1000,
+	    (unsigned long long) ts / 1000,
 	    fills_per_sec,
 	    pixels_per_sec);
 }
 
+/*
+ * Compare per-call rectangle fills against newport_fill_rectangles(),
+ * heatmap style: lots of small rectangles from a small palette.
+ */
+static void
+benchmark_rectangles(struct gfx_ctx *ctx, int tcount)
+{
+	static const uint32_t palette[8] = {
+		0x000080, 0x0000ff, 0x0080ff, 0x00ffff,
+		0x80ff80, 0xffff00, 0xff8000, 0xff0000,
+	};
+	struct newport_rect *rects;
+	struct timespec ts[4];
+	uint64_t nw[4], t;
+	int i;
+
+	rects = calloc(tcount, sizeof(*rects));
+	if (rects == NULL)
+		err(1, "%s: calloc", __func__);
+	for (i = 0; i < tcount; i++) {
+		rects[i].x = (i * 8) % 1280;
+		rects[i].y = ((i * 8) / 1280 * 8) % 1024;
+		rects[i].w = 8;
+		rects[i].h = 8;
+		rects[i].color = palette[random() % 8];
+	}
+
+	newport_fill_rectangle_setup(ctx);
+
+	clock_gettime(CLOCK_MONOTONIC, &ts[0]);
+	nw[0] = ctx->sim ? ctx->sim->nwrites : 0;
+	for (i = 0; i < tcount; i++)
+		newport_fill_rectangle(ctx, rects[i].x, rects[i].y,
+		    rects[i].w, rects[i].h, rects[i].color);
+	clock_gettime(CLOCK_MONOTONIC, &ts[1]);
+	nw[1] = ctx->sim ? ctx->sim->nwrites : 0;
+	newport_fill_rectangles(ctx, rects, tcount, 0);
+	clock_gettime(CLOCK_MONOTONIC, &ts[2]);
+	nw[2] = ctx->sim ? ctx->sim->nwrites : 0;
+	newport_fill_rectangles(ctx, rects, tcount, NEWPORT_FILL_ANY_ORDER);
+	clock_gettime(CLOCK_MONOTONIC, &ts[3]);
+	nw[3] = ctx->sim ? ctx->sim->nwrites : 0;
+
+	for (i = 1; i < 4; i++) {
+		t = (ts[i].tv_sec * 1000000) + (ts[i].tv_nsec / 1000);
+		t -= (ts[i - 1].tv_sec * 1000000) +
+		    (ts[i - 1].tv_nsec / 1000);
+		printf("newport: rects: %s: %d fills in %llu us, "
+		    "%llu register writes\n",
+		    i == 1 ? "single" : (i == 2 ? "batch" : "batch/sorted"),
+		    tcount, (unsigned long long) t,
+		    (unsigned long long) (nw[i] - nw[i - 1]));
+	}
+
+	free(rects);
+}
+
+/*
+ * Compare drawing a static grid in immediate mode against replaying
+ * it from a display list.
+ */
+static void
+benchmark_dlist(struct gfx_ctx *ctx, int tcount)
+{
+	struct newport_dlist *dl;
+	struct timespec ts_start, ts_mid, ts_end;
+	uint64_t ts_imm, ts_dl;
+	int i, x, y;
+
+	dl = newport_dlist_create(ctx);
+	if (dl == NULL)
+		err(1, "%s: newport_dlist_create", __func__);
+
+	for (y = 0; y < 1024; y += 32) {
+		newport_dlist_line(dl, 0, y, 1279, y, 0xffffff);
+		for (x = 0; x < 1280; x += 32)
+			newport_dlist_fill_rectangle(dl, x + 1, y + 1, 31, 31,
+			    ((x ^ y) & 32) ? 0x404040 : 0x808080);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts_start);
+	for (i = 0; i < tcount; i++) {
+		for (y = 0; y < 1024; y += 32) {
+			newport_draw_line(ctx, 0, y, 1279, y, 0xffffff);
+			newport_fill_rectangle_setup(ctx);
+			for (x = 0; x < 1280; x += 32)
+				newport_fill_rectangle(ctx, x + 1, y + 1,
+				    31, 31,
+				    ((x ^ y) & 32) ? 0x404040 : 0x808080);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts_mid);
+	for (i = 0; i < tcount; i++)
+		newport_dlist_replay(ctx, dl);
+	clock_gettime(CLOCK_MONOTONIC, &ts_end);
+
+	ts_imm = (ts_mid.tv_sec * 1000000) + (ts_mid.tv_nsec / 1000);
+	ts_imm -= (ts_start.tv_sec * 1000000) + (ts_start.tv_nsec / 1000);
+	ts_dl = (ts_end.tv_sec * 1000000) + (ts_end.tv_nsec / 1000);
+	ts_dl -= (ts_mid.tv_sec * 1000000) + (ts_mid.tv_nsec / 1000);
+
+	printf("newport: dlist: %d ops, %d register writes; "
+	    "%d frames immediate %llu ms, replayed %llu ms\n",
+	    dl->nops, dl->count, tcount,
+	    (unsigned long long) ts_imm / 1000,
+	    (unsigned long long) ts_dl / 1000);
+
+	newport_dlist_destroy(dl);
+}
+
+/*
+ * Draw frames of random rectangles, building each frame's list on
+ * the CPU.  First drain the pipeline after every frame, then just
+ * keep at most two frames in flight with fences, so building the
+ * next frame overlaps drawing the current one.
+ */
+static void
+benchmark_frames(struct gfx_ctx *ctx, int tcount)
+{
+	const int nrects = 2048;
+	struct newport_rect *rects;
+	struct newport_stats st;
+	newport_fence_t fence[2] = { NEWPORT_FENCE_NONE, NEWPORT_FENCE_NONE };
+	struct timespec ts[2];
+	uint64_t t;
+	int i, j, pass;
+
+	rects = calloc(nrects, sizeof(*rects));
+	if (rects == NULL)
+		err(1, "%s: calloc", __func__);
+
+	for (pass = 0; pass < 2; pass++) {
+		newport_fence_sync(ctx);
+		newport_stats_reset(ctx);
+		clock_gettime(CLOCK_MONOTONIC, &ts[0]);
+		for (i = 0; i < tcount; i++) {
+			for (j = 0; j < nrects; j++) {
+				rects[j].x = random() % 1216;
+				rects[j].y = random() % 960;
+				rects[j].w = 1 + random() % 64;
+				rects[j].h = 1 + random() % 64;
+				rects[j].color = random() & 0xffffff;
+			}
+
+			if (pass == 0) {
+				newport_fill_rectangles(ctx, rects, nrects, 0);
+				newport_fence_sync(ctx);
+			} else {
+				/* Frame i - 2 has to be done before frame i */
+				newport_fence_wait(ctx, fence[i & 1]);
+				newport_fill_rectangles(ctx, rects, nrects, 0);
+				fence[i & 1] = newport_fence_emit(ctx);
+			}
+		}
+		newport_fence_sync(ctx);
+		clock_gettime(CLOCK_MONOTONIC, &ts[1]);
+
+		newport_stats_snapshot(ctx, &st);
+		t = (ts[1].tv_sec * 1000000) + (ts[1].tv_nsec / 1000);
+		t -= (ts[0].tv_sec * 1000000) + (ts[0].tv_nsec / 1000);
+		printf("newport: frames: %s: %d frames in %llu ms, "
+		    "%llu fence stalls (%llu us)\n",
+		    pass == 0 ? "drained" : "fenced", tcount,
+		    (unsigned long long) t / 1000,
+		    (unsigned long long) st.fence_stalls,
+		    (unsigned long long) st.fence_stall_ns / 1000);
+	}
+
+	free(rects);
+}
+
+/*
+ * Compare drawing a span list one span at a time against
+ * newport_fill_spans().  The list is a stack of window-ish boxes
+ * (long runs of identical spans) with a triangle-ish wedge in
+ * between; with the simulated REX3 the two framebuffers are compared.
+ */
+static bool
+benchmark_spans(struct gfx_ctx *ctx, int tcount)
+{
+	struct scanline_list *sl;
+	struct timespec ts[4];
+	uint64_t nw[4], t;
+	uint32_t *fb = NULL;
+	size_t fbsize = 0;
+	bool ret = true;
+	int i, y;
+
+	sl = scanline_list_alloc(1024);
+	if (sl == NULL)
+		err(1, "%s: scanline_list_alloc", __func__);
+	for (y = 0; y < 256; y++)
+		scanline_list_push(sl, 100, 900, y);
+	for (y = 256; y < 512; y++)
+		scanline_list_push(sl, 640 - (y - 256), 640 + (y - 256), y);
+	/* Bottom up, as a flat top triangle would come out */
+	for (y = 1023; y >= 512; y--)
+		scanline_list_push(sl, 1000, 200, y);
+
+	newport_fill_rectangle_fast(ctx, 0, 0, 1280, 1024, 0);
+
+	clock_gettime(CLOCK_MONOTONIC, &ts[0]);
+	nw[0] = ctx->sim ? ctx->sim->nwrites : 0;
+	for (i = 0; i < tcount; i++) {
+		newport_fill_rectangle_setup(ctx);
+		for (y = 0; y < sl->cur; y++)
+			newport_fill_rectangle(ctx,
+			    MIN(sl->list[y].x1, sl->list[y].x2),
+			    sl->list[y].y,
+			    abs(sl->list[y].x2 - sl->list[y].x1) + 1, 1,
+			    0x00ff80);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts[1]);
+	nw[1] = ctx->sim ? ctx->sim->nwrites : 0;
+
+	if (ctx->sim != NULL) {
+		fbsize = ctx->sim->width * ctx->sim->height * sizeof(uint32_t);
+		fb = malloc(fbsize);
+		if (fb == NULL)
+			err(1, "%s: malloc", __func__);
+		memcpy(fb, ctx->sim->fb, fbsize);
+		newport_fill_rectangle_fast(ctx, 0, 0, 1280, 1024, 0);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts[2]);
+	nw[2] = ctx->sim ? ctx->sim->nwrites : 0;
+	for (i = 0; i < tcount; i++)
+		newport_fill_spans(ctx, sl, 0x00ff80);
+	clock_gettime(CLOCK_MONOTONIC, &ts[3]);
+	nw[3] = ctx->sim ? ctx->sim->nwrites : 0;
+
+	if (fb != NULL) {
+		if (memcmp(fb, ctx->sim->fb, fbsize) != 0) {
+			printf("newport: spans: framebuffer mismatch\n");
+			ret = false;
+		}
+		free(fb);
+	}
+
+	for (i = 0; i < 4; i += 2) {
+		t = (ts[i + 1].tv_sec * 1000000) + (ts[i + 1].tv_nsec / 1000);
+		t -= (ts[i].tv_sec * 1000000) + (ts[i].tv_nsec / 1000);
+		printf("newport: spans: %s: %d x %d spans in %llu us, "
+		    "%llu register writes\n",
+		    i == 0 ? "single" : "list", tcount, sl->cur,
+		    (unsigned long long) t,
+		    (unsigned long long) (nw[i + 1] - nw[i]));
+	}
+
+	scanline_list_free(sl);
+	return ret;
+}
+
+/*
+ * Polygon scan conversion: a many sided "map" outline timed, then
+ * drawn with a self-intersecting star over it.  The spans are
+ * checked by the bres selfcheck program.
+ */
+static void
+benchmark_polygon(struct gfx_ctx *ctx, int tcount)
+{
+	const int nmap = 600;
+	struct point2d star[5], *map;
+	struct scanline_list *sl;
+	struct timespec ts_start, ts_end;
+	uint64_t t;
+	double a, r;
+	int i;
+
+	sl = scanline_list_alloc(1024);
+	map = calloc(nmap, sizeof(*map));
+	if (sl == NULL || map == NULL)
+		err(1, "%s: alloc", __func__);
+
+	/* Pentagram; the middle is a hole with the even-odd rule */
+	for (i = 0; i < 5; i++) {
+		a = (i * 2 * 2 * M_PI) / 5 - M_PI / 2;
+		star[i].x = 320 + (int) (300 * cos(a));
+		star[i].y = 320 + (int) (300 * sin(a));
+	}
+	/* A wobbly coastline with a few deep inlets */
+	for (i = 0; i < nmap; i++) {
+		a = (i * 2 * M_PI) / nmap;
+		r = 300 + 60 * sin(a * 7) + 25 * sin(a * 31) +
+		    ((i % 97) < 3 ? -200 : 0);
+		map[i].x = 960 + (int) (r * cos(a));
+		map[i].y = 512 + (int) (r * sin(a));
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts_start);
+	for (i = 0; i < tcount; i++) {
+		sl->cur = 0;
+		if (! bres_polygon(sl, map, nmap, BresFillRuleEvenOdd))
+			err(1, "%s: bres_polygon", __func__);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts_end);
+	t = (ts_end.tv_sec * 1000000) + (ts_end.tv_nsec / 1000);
+	t -= (ts_start.tv_sec * 1000000) + (ts_start.tv_nsec / 1000);
+	printf("newport: polygon: %d vertices -> %d spans, %d x in %llu us\n",
+	    nmap, sl->cur, tcount, (unsigned long long) t);
+
+	newport_fill_rectangle_fast(ctx, 0, 0, 1280, 1024, 0);
+	newport_fill_spans(ctx, sl, 0x40c040);
+	sl->cur = 0;
+	bres_polygon(sl, star, 5, BresFillRuleEvenOdd);
+	newport_fill_spans(ctx, sl, 0xffff00);
+
+	scanline_list_free(sl);
+	free(map);
+}
+
+static uint64_t
+aalines_writes(struct gfx_ctx *ctx)
+{
+	return (ctx->stats.reg_writes[NewportRegClassColor] +
+	    ctx->stats.reg_writes[NewportRegClassMode] +
+	    ctx->stats.reg_writes[NewportRegClassCoord]);
+}
+
+static bool
+aalines_check_row(struct gfx_ctx *ctx, const char *name, int x1, int x2,
+    int y, uint32_t want)
+{
+	uint32_t got;
+	int x;
+
+	for (x = x1; x <= x2; x++) {
+		got = newport_sim_get_pixel(ctx->sim, x, y);
+		if (got != want) {
+			printf("newport: aalines: %s: (%d,%d) is 0x%08x, "
+			    "expected 0x%08x\n", name, x, y, got, want);
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Antialiased lines: a waveform drawn as one batched polyline
+ * against one newport_draw_line_aa() call per segment.  With the
+ * simulated REX3 in rgb24 a few coverage cases are checked too.
+ */
+static bool
+benchmark_aalines(struct gfx_ctx *ctx, int tcount)
+{
+	const int npts = 1024;
+	const uint32_t color = 0x40ff80;
+	struct newport_subpoint *pts, jp[3];
+	struct timespec ts[3];
+	uint32_t want, half, got;
+	uint64_t nw[3], t;
+	bool ret = true;
+	int i, j;
+
+	pts = calloc(npts, sizeof(*pts));
+	if (pts == NULL)
+		err(1, "%s: calloc", __func__);
+	for (i = 0; i < npts; i++) {
+		pts[i].x = NEWPORT_INT_TO_SUBPIXEL(128) + i * 16;
+		pts[i].y = NEWPORT_INT_TO_SUBPIXEL(512) +
+		    (int) (NEWPORT_SUBPIXEL_ONE * (300 * sin(i / 40.0) +
+		    40 * sin(i / 3.0)));
+	}
+
+	if (ctx->sim != NULL && ctx->fb_mode == NewportBppModeRgb24 &&
+	    ctx->pixel_mode == NewportBppModeRgb24) {
+		want = newport_calc_colori_color(ctx, color) & 0xffffff;
+
+		/* On pixel centres: fully covered, nothing either side */
+		newport_fill_rectangle_fast(ctx, 0, 0, 1280, 1024, 0);
+		newport_draw_line_aa(ctx, NEWPORT_INT_TO_SUBPIXEL(10),
+		    NEWPORT_INT_TO_SUBPIXEL(100), NEWPORT_INT_TO_SUBPIXEL(50),
+		    NEWPORT_INT_TO_SUBPIXEL(100), color, 0);
+		ret &= aalines_check_row(ctx, "centred", 10, 50, 100, want);
+		ret &= aalines_check_row(ctx, "centred", 9, 51, 99, 0);
+		ret &= aalines_check_row(ctx, "centred", 9, 51, 101, 0);
+
+		/* Half way between rows: split evenly */
+		newport_draw_line_aa(ctx, NEWPORT_INT_TO_SUBPIXEL(10),
+		    NEWPORT_INT_TO_SUBPIXEL(200) + NEWPORT_SUBPIXEL_ONE / 2,
+		    NEWPORT_INT_TO_SUBPIXEL(50),
+		    NEWPORT_INT_TO_SUBPIXEL(200) + NEWPORT_SUBPIXEL_ONE / 2,
+		    color, 0);
+		half = 0;
+		for (j = 0; j < 24; j += 8)
+			half |= ((((want >> j) & 0xff) * 127 + 127) / 255) << j;
+		ret &= aalines_check_row(ctx, "half", 10, 50, 200, half);
+		ret &= aalines_check_row(ctx, "half", 10, 50, 201, half);
+
+		/* A polyline joint mustn't be blended twice */
+		for (i = 0; i < 3; i++) {
+			jp[i].x = NEWPORT_INT_TO_SUBPIXEL(10 + i * 20);
+			jp[i].y = NEWPORT_INT_TO_SUBPIXEL(300) + 4;
+		}
+		newport_draw_polyline_aa(ctx, jp, 3, color, 0);
+		newport_draw_line_aa(ctx, jp[0].x, jp[0].y +
+		    NEWPORT_INT_TO_SUBPIXEL(10), jp[2].x,
+		    jp[2].y + NEWPORT_INT_TO_SUBPIXEL(10), color, 0);
+		for (i = 10; i <= 50 && ret; i++) {
+			for (j = 300; j <= 301; j++) {
+				got = newport_sim_get_pixel(ctx->sim, i, j);
+				want = newport_sim_get_pixel(ctx->sim, i,
+				    j + 10);
+				if (got != want) {
+					printf("newport: aalines: joint: "
+					    "(%d,%d) is 0x%08x, expected "
+					    "0x%08x\n", i, j, got, want);
+					ret = false;
+					break;
+				}
+			}
+		}
+	}
+
+	newport_fill_rectangle_fast(ctx, 0, 0, 1280, 1024, 0);
+	clock_gettime(CLOCK_MONOTONIC, &ts[0]);
+	nw[0] = aalines_writes(ctx);
+	for (i = 0; i < tcount; i++)
+		newport_draw_polyline_aa(ctx, pts, npts, color, 0);
+	newport_fence_sync(ctx);
+	clock_gettime(CLOCK_MONOTONIC, &ts[1]);
+	nw[1] = aalines_writes(ctx);
+	for (i = 0; i < tcount; i++)
+		for (j = 1; j < npts; j++)
+			newport_draw_line_aa(ctx, pts[j - 1].x, pts[j - 1].y,
+			    pts[j].x, pts[j].y, color, 0);
+	newport_fence_sync(ctx);
+	clock_gettime(CLOCK_MONOTONIC, &ts[2]);
+	nw[2] = aalines_writes(ctx);
+
+	for (i = 0; i < 2; i++) {
+		t = (ts[i + 1].tv_sec * 1000000) + (ts[i + 1].tv_nsec / 1000);
+		t -= (ts[i].tv_sec * 1000000) + (ts[i].tv_nsec / 1000);
+		printf("newport: aalines: %s: %d x %d segments in %llu us, "
+		    "%llu register writes\n",
+		    i == 0 ? "polyline" : "single lines", tcount, npts - 1,
+		    (unsigned long long) t,
+		    (unsigned long long) (nw[i + 1] - nw[i]));
+	}
+
+	printf("newport: aalines: %s\n", ret ? "OK" : "FAILED");
+	free(pts);
+	return ret;
+}
+
+/*
+ * Spans from drawing each of ntris triangles with bres_polygon(),
+ * the per triangle path bres_triangle_mesh() is timed against.
+ */
+static void
+mesh_reference(struct scanline_list *sl, const struct point2d *pts,
+    const int *idx, int ntris)
+{
+	struct point2d tri[3];
+	int i, j;
+
+	for (i = 0; i < ntris; i++) {
+		for (j = 0; j < 3; j++)
+			tri[j] = pts[idx[i * 3 + j]];
+		if (! bres_polygon(sl, tri, 3, BresFillRuleNonZero))
+			err(1, "%s: bres_polygon", __func__);
+	}
+}
+
+/*
+ * Triangle strips and meshes: a jittered grid mesh timed against
+ * bres_polygon() and bres_triangle_xy() per triangle, then drawn
+ * with a zig-zag strip.
+ */
+static void
+benchmark_mesh(struct gfx_ctx *ctx, int tcount)
+{
+	const int gw = 48, gh = 40, cw = 24, ch = 24, gx = 40, gy = 32;
+	const int npts = (gw + 1) * (gh + 1), ntris = gw * gh * 2;
+	const int nstrip = 200;
+	struct point2d *pts, *strip;
+	struct scanline_list *sl, *ref, *tsl;
+	struct timespec ts[4];
+	uint64_t t;
+	int *idx, i, j, x, y, n;
+
+	pts = calloc(npts, sizeof(*pts));
+	idx = calloc(ntris * 3, sizeof(int));
+	strip = calloc(nstrip, sizeof(*strip));
+	sl = scanline_list_alloc(1024);
+	ref = scanline_list_alloc(1024);
+	if (pts == NULL || idx == NULL || strip == NULL || sl == NULL ||
+	    ref == NULL)
+		err(1, "%s: alloc", __func__);
+
+	/* Interior vertices are jittered; the border stays straight */
+	for (y = 0; y <= gh; y++) {
+		for (x = 0; x <= gw; x++) {
+			i = y * (gw + 1) + x;
+			pts[i].x = gx + x * cw;
+			pts[i].y = gy + y * ch;
+			if (x > 0 && x < gw && y > 0 && y < gh) {
+				pts[i].x += (int) (9 * sin(i * 1.7));
+				pts[i].y += (int) (9 * cos(i * 2.3));
+			}
+		}
+	}
+	n = 0;
+	for (y = 0; y < gh; y++) {
+		for (x = 0; x < gw; x++) {
+			i = y * (gw + 1) + x;
+			idx[n++] = i;
+			idx[n++] = i + 1;
+			idx[n++] = i + gw + 1;
+			idx[n++] = i + 1;
+			idx[n++] = i + gw + 2;
+			idx[n++] = i + gw + 1;
+		}
+	}
+	for (i = 0; i < nstrip; i++) {
+		strip[i].x = 20 + (i / 2) * 12 + (int) (5 * sin(i));
+		strip[i].y = 980 - (i & 1) * 30 - (int) (20 * sin(i / 9.0));
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts[0]);
+	for (i = 0; i < tcount; i++) {
+		ref->cur = 0;
+		mesh_reference(ref, pts, idx, ntris);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts[1]);
+	for (i = 0; i < tcount; i++) {
+		for (j = 0; j < ntris; j++) {
+			bres_triangle_xy(pts[idx[j * 3]].x, pts[idx[j * 3]].y,
+			    pts[idx[j * 3 + 1]].x, pts[idx[j * 3 + 1]].y,
+			    pts[idx[j * 3 + 2]].x, pts[idx[j * 3 + 2]].y,
+			    &tsl);
+			scanline_list_free(tsl);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts[2]);
+	for (i = 0; i < tcount; i++) {
+		sl->cur = 0;
+		if (! bres_triangle_mesh(sl, pts, npts, idx, ntris))
+			err(1, "%s: bres_triangle_mesh", __func__);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts[3]);
+
+	for (i = 0; i < 3; i++) {
+		t = (ts[i + 1].tv_sec * 1000000) + (ts[i + 1].tv_nsec / 1000);
+		t -= (ts[i].tv_sec * 1000000) + (ts[i].tv_nsec / 1000);
+		printf("newport: mesh: %s: %d x %d triangles in %llu us\n",
+		    i == 0 ? "bres_polygon" :
+		    i == 1 ? "bres_triangle_xy" : "bres_triangle_mesh",
+		    tcount, ntris, (unsigned long long) t);
+	}
+
+	newport_fill_rectangle_fast(ctx, 0, 0, 1280, 1024, 0);
+	newport_fill_spans(ctx, sl, 0x40c040);
+	sl->cur = 0;
+	bres_triangle_strip(sl, strip, nstrip);
+	newport_fill_spans(ctx, sl, 0xffff00);
+
+	scanline_list_free(sl);
+	scanline_list_free(ref);
+	free(strip);
+	free(idx);
+	free(pts);
+}
+
+/*
+ * Subpixel meshes: a grid with fractional jitter timed against the
+ * same grid on whole pixels through the integer mesh path.
+ */
+static void
+benchmark_subpixel(struct gfx_ctx *ctx, int tcount)
+{
+	const int gw = 48, gh = 40, cw = 24, ch = 24, gx = 40, gy = 32;
+	const int npts = (gw + 1) * (gh + 1), ntris = gw * gh * 2;
+	struct point2d *pts, *ipts;
+	struct scanline_list *sl;
+	struct timespec ts[3];
+	uint64_t t;
+	int *idx, i, x, y, n;
+
+	pts = calloc(npts, sizeof(*pts));
+	ipts = calloc(npts, sizeof(*ipts));
+	idx = calloc(ntris * 3, sizeof(int));
+	sl = scanline_list_alloc(1024);
+	if (pts == NULL || ipts == NULL || idx == NULL || sl == NULL)
+		err(1, "%s: alloc", __func__);
+
+	/* The grid; the border stays on whole pixels */
+	for (y = 0; y <= gh; y++) {
+		for (x = 0; x <= gw; x++) {
+			i = y * (gw + 1) + x;
+			ipts[i].x = gx + x * cw;
+			ipts[i].y = gy + y * ch;
+			pts[i].x = BRES_INT_TO_SUBPIXEL(ipts[i].x);
+			pts[i].y = BRES_INT_TO_SUBPIXEL(ipts[i].y);
+			if (x > 0 && x < gw && y > 0 && y < gh) {
+				pts[i].x += (int) (150 * sin(i * 1.7));
+				pts[i].y += (int) (150 * cos(i * 2.3));
+			}
+		}
+	}
+	n = 0;
+	for (y = 0; y < gh; y++) {
+		for (x = 0; x < gw; x++) {
+			i = y * (gw + 1) + x;
+			idx[n++] = i;
+			idx[n++] = i + 1;
+			idx[n++] = i + gw + 1;
+			idx[n++] = i + 1;
+			idx[n++] = i + gw + 2;
+			idx[n++] = i + gw + 1;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts[0]);
+	for (i = 0; i < tcount; i++) {
+		sl->cur = 0;
+		bres_triangle_mesh(sl, ipts, npts, idx, ntris);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts[1]);
+	for (i = 0; i < tcount; i++) {
+		sl->cur = 0;
+		bres_triangle_mesh_subpixel(sl, pts, npts, idx, ntris);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts[2]);
+
+	for (i = 0; i < 2; i++) {
+		t = (ts[i + 1].tv_sec * 1000000) + (ts[i + 1].tv_nsec / 1000);
+		t -= (ts[i].tv_sec * 1000000) + (ts[i].tv_nsec / 1000);
+		printf("newport: subpixel: %s: %d x %d triangles in %llu us\n",
+		    i == 0 ? "bres_triangle_mesh" :
+		    "bres_triangle_mesh_subpixel", tcount, ntris,
+		    (unsigned long long) t);
+	}
+
+	newport_fill_rectangle_fast(ctx, 0, 0, 1280, 1024, 0);
+	newport_fill_spans(ctx, sl, 0x40c0c0);
+
+	scanline_list_free(sl);
+	free(idx);
+	free(ipts);
+	free(pts);
+}
+
+/*
+ * Tile binned multithreaded rasterisation of a big random scene,
+ * timed serially and with 1 and nthreads workers.
+ */
+static void
+benchmark_raster_mt(struct gfx_ctx *ctx, int tcount, int nthreads)
+{
+	const int w = 1280, h = 1024, ntris = 20000;
+	struct bres_raster_mt *rm[2];
+	struct scanline_list *sl, *ref;
+	struct point2d *pts;
+	struct timespec ts[4];
+	uint64_t t, ntiles, nsteals;
+	int *idx, i, j, r, cx, cy;
+
+	pts = calloc(ntris * 3, sizeof(*pts));
+	idx = calloc(ntris * 3, sizeof(int));
+	sl = scanline_list_alloc(1024);
+	ref = scanline_list_alloc(1024);
+	rm[0] = bres_raster_mt_create(1, w, h);
+	rm[1] = bres_raster_mt_create(nthreads, w, h);
+	if (pts == NULL || idx == NULL || sl == NULL || ref == NULL ||
+	    rm[0] == NULL || rm[1] == NULL)
+		err(1, "%s: alloc", __func__);
+
+	/* Mostly small triangles, some big ones, some hanging off screen */
+	srandom(1234);
+	for (i = 0; i < ntris; i++) {
+		r = (i % 50 == 0) ? 300 : 8 + random() % 40;
+		cx = random() % (w + 100) - 50;
+		cy = random() % (h + 100) - 50;
+		for (j = 0; j < 3; j++) {
+			pts[i * 3 + j].x = cx + random() % (2 * r) - r;
+			pts[i * 3 + j].y = cy + random() % (2 * r) - r;
+			idx[i * 3 + j] = i * 3 + j;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts[0]);
+	for (i = 0; i < tcount; i++) {
+		ref->cur = 0;
+		bres_triangle_mesh(ref, pts, ntris * 3, idx, ntris);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts[1]);
+	for (j = 0; j < 2; j++) {
+		for (i = 0; i < tcount; i++) {
+			sl->cur = 0;
+			bres_raster_mt_triangles(rm[j], sl, pts, ntris * 3,
+			    idx, ntris);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &ts[j + 2]);
+	}
+
+	for (i = 0; i < 3; i++) {
+		t = (ts[i + 1].tv_sec * 1000000) + (ts[i + 1].tv_nsec / 1000);
+		t -= (ts[i].tv_sec * 1000000) + (ts[i].tv_nsec / 1000);
+		printf("newport: raster_mt: %s: %d x %d triangles in %llu us\n",
+		    i == 0 ? "bres_triangle_mesh" :
+		    i == 1 ? "1 thread" : "n threads", tcount, ntris,
+		    (unsigned long long) t);
+	}
+	bres_raster_mt_stats(rm[1], &ntiles, &nsteals);
+	printf("newport: raster_mt: %d threads: %llu tiles, %llu stolen\n",
+	    nthreads, (unsigned long long) ntiles,
+	    (unsigned long long) nsteals);
+
+	newport_fill_rectangle_fast(ctx, 0, 0, 1280, 1024, 0);
+	newport_fill_spans(ctx, sl, 0x40c040);
+
+	bres_raster_mt_free(rm[0]);
+	bres_raster_mt_free(rm[1]);
+	scanline_list_free(sl);
+	scanline_list_free(ref);
+	free(idx);
+	free(pts);
+}
+
+/*
+ * Flat top / bottom triangles: a pile of random ones (including
+ * zero height and zero width ones) through the batch path, timed
+ * against bres_triangle_flat() one at a time.
+ */
+static void
+benchmark_flat(struct gfx_ctx *ctx, int tcount)
+{
+	const int ntris = 10000;
+	struct bres_flat_triangle *tris;
+	struct scanline_list *sl, *ref;
+	struct timespec ts[3];
+	uint64_t t;
+	int i, j, n, h, w;
+
+	tris = calloc(ntris, sizeof(*tris));
+	sl = scanline_list_alloc(1024);
+	ref = scanline_list_alloc(1024);
+	if (tris == NULL || sl == NULL || ref == NULL)
+		err(1, "%s: alloc", __func__);
+
+	srandom(4321);
+	n = 0;
+	for (i = 0; i < ntris; i++) {
+		h = (i % 100 == 0) ? 400 : random() % 48;
+		w = (i % 100 == 1) ? 600 : 1 + random() % 64;
+		tris[i].x1 = random() % 1280;
+		tris[i].y1 = random() % 1024;
+		tris[i].y2 = tris[i].y1 + ((i & 1) ? -h : h);
+		tris[i].x2l = tris[i].x1 - random() % w;
+		tris[i].x2r = tris[i].x1 + random() % w - w / 4;
+		if (tris[i].x2r < tris[i].x2l)
+			tris[i].x2r = tris[i].x2l;
+		n += h + 1;
+	}
+
+	if (! scanline_list_reserve(ref, n))
+		err(1, "%s: scanline_list_reserve", __func__);
+
+	clock_gettime(CLOCK_MONOTONIC, &ts[0]);
+	for (j = 0; j < tcount; j++) {
+		ref->cur = 0;
+		for (i = 0; i < ntris; i++)
+			bres_triangle_flat(ref, tris[i].x1, tris[i].y1,
+			    tris[i].x2l, tris[i].x2r, tris[i].y2);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts[1]);
+	for (j = 0; j < tcount; j++) {
+		sl->cur = 0;
+		bres_triangle_flat_batch(sl, tris, ntris);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts[2]);
+
+	for (i = 0; i < 2; i++) {
+		t = (ts[i + 1].tv_sec * 1000000) + (ts[i + 1].tv_nsec / 1000);
+		t -= (ts[i].tv_sec * 1000000) + (ts[i].tv_nsec / 1000);
+		printf("newport: flat: %s: %d x %d triangles, %d spans "
+		    "in %llu us\n", i == 0 ? "bres_triangle_flat" :
+		    "bres_triangle_flat_batch", tcount, ntris, n,
+		    (unsigned long long) t);
+	}
+
+	newport_fill_rectangle_fast(ctx, 0, 0, 1280, 1024, 0);
+	newport_fill_spans(ctx, sl, 0xc08040);
+
+	scanline_list_free(sl);
+	scanline_list_free(ref);
+	free(tris);
+}
+
+/*
+ * Circles, rings and rounded rectangles: a gauge's worth of circles
+ * timed against the same circles as 64-gons through bres_polygon(),
+ * then some dials drawn.
+ */
+static void
+benchmark_ellipse(struct gfx_ctx *ctx, int tcount)
+{
+	const int ncircles = 1000, nsides = 64;
+	struct scanline_list *sl;
+	struct point2d *poly;
+	struct timespec ts[3];
+	uint64_t t, nspans[2] = { 0, 0 };
+	int i, j, n, r;
+
+	sl = scanline_list_alloc(1024);
+	poly = calloc(ncircles * nsides, sizeof(*poly));
+	if (sl == NULL || poly == NULL)
+		err(1, "%s: alloc", __func__);
+
+	/* Gauges: lots of small and medium circles */
+	for (i = 0; i < ncircles; i++) {
+		r = 4 + i % 60;
+		for (n = 0; n < nsides; n++) {
+			poly[i * nsides + n].x = 640 + (i % 40) * 4 +
+			    (int) ((r + 0.5) * cos(n * 2 * M_PI / nsides) + 0.5);
+			poly[i * nsides + n].y = 512 + (i % 30) * 4 +
+			    (int) ((r + 0.5) * sin(n * 2 * M_PI / nsides) + 0.5);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts[0]);
+	for (j = 0; j < tcount; j++) {
+		for (i = 0; i < ncircles; i++) {
+			sl->cur = 0;
+			bres_polygon(sl, &poly[i * nsides], nsides,
+			    BresFillRuleNonZero);
+			nspans[0] += sl->cur;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts[1]);
+	for (j = 0; j < tcount; j++) {
+		for (i = 0; i < ncircles; i++) {
+			sl->cur = 0;
+			bres_circle(sl, 640 + (i % 40) * 4, 512 + (i % 30) * 4,
+			    4 + i % 60);
+			nspans[1] += sl->cur;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts[2]);
+
+	for (i = 0; i < 2; i++) {
+		t = (ts[i + 1].tv_sec * 1000000) + (ts[i + 1].tv_nsec / 1000);
+		t -= (ts[i].tv_sec * 1000000) + (ts[i].tv_nsec / 1000);
+		printf("newport: ellipse: %s: %d x %d circles, %llu spans in "
+		    "%llu us\n", i == 0 ? "64-gon bres_polygon" : "bres_circle",
+		    tcount, ncircles, (unsigned long long) nspans[i],
+		    (unsigned long long) t);
+	}
+
+	newport_fill_rectangle_fast(ctx, 0, 0, 1280, 1024, 0);
+	for (i = 0; i < 12; i++) {
+		sl->cur = 0;
+		bres_circle_ring(sl, 120 + (i % 6) * 200, 200 + (i / 6) * 400,
+		    90, 12);
+		newport_fill_spans(ctx, sl, 0x808080);
+		sl->cur = 0;
+		bres_rounded_rect(sl, 60 + (i % 6) * 200, 320 + (i / 6) * 400,
+		    120, 40, 10);
+		newport_fill_spans(ctx, sl, 0x40c040 + i * 0x100000);
+	}
+
+	scanline_list_free(sl);
+	free(poly);
+}
+
+static uint32_t
+sbuf_color(int i)
+{
+	return ((((i * 53) & 0xff) << 16) | (((i * 101 + 64) & 0xff) << 8) |
+	    ((i * 31 + 128) & 0xff));
+}
+
+/*
+ * Span buffer hidden surface removal on a stack of overlapping
+ * windows and dials: drawing the lot in painter order is timed
+ * against adding it to a span buffer and drawing just what's
+ * visible.
+ */
+static void
+benchmark_sbuf(struct gfx_ctx *ctx, int tcount)
+{
+	const int w = 1280, h = 1024, nshapes = 80;
+	struct scanline_list **shape, **vis;
+	struct bres_sbuf *sb;
+	struct timespec ts[4];
+	uint64_t t, nw[4], npixels, nvisible, nspans[2] = { 0, 0 };
+	int *depth, *order, i, j, k, x, y, nsegs;
+
+	shape = calloc(nshapes, sizeof(*shape));
+	vis = calloc(nshapes, sizeof(*vis));
+	depth = calloc(nshapes, sizeof(int));
+	order = calloc(nshapes, sizeof(int));
+	sb = bres_sbuf_create(w, h);
+	if (shape == NULL || vis == NULL || depth == NULL || order == NULL ||
+	    sb == NULL)
+		err(1, "%s: alloc", __func__);
+
+	/* Windows and dials at shuffled depths */
+	srandom(24680);
+	for (i = 0; i < nshapes; i++)
+		depth[i] = i;
+	for (i = nshapes - 1; i > 0; i--) {
+		j = random() % (i + 1);
+		k = depth[i];
+		depth[i] = depth[j];
+		depth[j] = k;
+	}
+	for (i = 0; i < nshapes; i++) {
+		shape[i] = scanline_list_alloc(256);
+		vis[i] = scanline_list_alloc(256);
+		if (shape[i] == NULL || vis[i] == NULL)
+			err(1, "%s: scanline_list_alloc", __func__);
+		if (i % 4 == 0) {
+			k = 20 + random() % 120;
+			x = k + random() % (w - 2 * k);
+			y = k + random() % (h - 2 * k);
+			if (! bres_circle(shape[i], x, y, k))
+				err(1, "%s: bres_circle", __func__);
+		} else {
+			j = 100 + random() % 400;
+			k = 80 + random() % 300;
+			x = random() % (w - j);
+			y = random() % (h - k);
+			if (! bres_rounded_rect(shape[i], x, y, j, k,
+			    random() % 16))
+				err(1, "%s: bres_rounded_rect", __func__);
+		}
+		order[nshapes - 1 - depth[i]] = i;
+	}
+
+	/* Shapes go in in submission order, not depth order */
+	for (i = 0; i < nshapes; i++)
+		bres_sbuf_add(sb, shape[i], depth[i], i);
+	bres_sbuf_resolve(sb, vis, nshapes);
+	bres_sbuf_stats(sb, &npixels, &nvisible, &nsegs);
+	printf("newport: sbuf: %llu pixels, %llu visible (%.2fx overdraw), "
+	    "%d segments\n", (unsigned long long) npixels,
+	    (unsigned long long) nvisible,
+	    (double) npixels / (nvisible + 1), nsegs);
+
+	newport_fill_rectangle_fast(ctx, 0, 0, 1280, 1024, 0);
+	clock_gettime(CLOCK_MONOTONIC, &ts[0]);
+	nw[0] = ctx->sim ? ctx->sim->nwrites : 0;
+	for (j = 0; j < tcount; j++) {
+		for (i = 0; i < nshapes; i++) {
+			newport_fill_spans(ctx, shape[order[i]],
+			    sbuf_color(order[i]));
+			nspans[0] += shape[order[i]]->cur;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts[1]);
+	nw[1] = ctx->sim ? ctx->sim->nwrites : 0;
+
+	newport_fill_rectangle_fast(ctx, 0, 0, 1280, 1024, 0);
+
+	clock_gettime(CLOCK_MONOTONIC, &ts[2]);
+	nw[2] = ctx->sim ? ctx->sim->nwrites : 0;
+	for (j = 0; j < tcount; j++) {
+		bres_sbuf_reset(sb);
+		for (i = 0; i < nshapes; i++) {
+			bres_sbuf_add(sb, shape[i], depth[i], i);
+			vis[i]->cur = 0;
+		}
+		bres_sbuf_resolve(sb, vis, nshapes);
+		for (i = 0; i < nshapes; i++) {
+			newport_fill_spans(ctx, vis[i], sbuf_color(i));
+			nspans[1] += vis[i]->cur;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts[3]);
+	nw[3] = ctx->sim ? ctx->sim->nwrites : 0;
+
+	for (i = 0; i < 4; i += 2) {
+		t = (ts[i + 1].tv_sec * 1000000) + (ts[i + 1].tv_nsec / 1000);
+		t -= (ts[i].tv_sec * 1000000) + (ts[i].tv_nsec / 1000);
+		printf("newport: sbuf: %s: %d x %d shapes, %llu spans in "
+		    "%llu us, %llu register writes\n",
+		    i == 0 ? "painter" : "span buffer", tcount, nshapes,
+		    (unsigned long long) nspans[i / 2],
+		    (unsigned long long) t,
+		    (unsigned long long) (nw[i + 1] - nw[i]));
+	}
+
+	for (i = 0; i < nshapes; i++) {
+		scanline_list_free(shape[i]);
+		scanline_list_free(vis[i]);
+	}
+	bres_sbuf_free(sb);
+	free(order);
+	free(depth);
+	free(vis);
+	free(shape);
+}
+
+/*
+ * The REX3 model's I_LINE loop, a pixel at a time, as one pixel
+ * spans.
+ */
+static void
+linespans_reference(struct scanline_list *sl, int x, int y, int xe, int ye)
+{
+	int dx, dy, sx, sy, e, e2;
+
+	dx = abs(xe - x);
+	dy = -abs(ye - y);
+	sx = (x < xe) ? 1 : -1;
+	sy = (y < ye) ? 1 : -1;
+	e = dx + dy;
+
+	if (! scanline_list_reserve(sl, dx - dy + 1))
+		err(1, "%s: scanline_list_reserve", __func__);
+	for (;;) {
+		scanline_list_push(sl, x, x, y);
+		if (x == xe && y == ye)
+			break;
+		e2 = 2 * e;
+		if (e2 >= dy) {
+			e += dy;
+			x += sx;
+		}
+		if (e2 <= dx) {
+			e += dx;
+			y += sy;
+		}
+	}
+}
+
+/*
+ * Run-slice lines: random lines as spans against the I_LINE loop a
+ * pixel at a time, span counts and times compared, then some thick
+ * ones drawn.
+ */
+static void
+benchmark_linespans(struct gfx_ctx *ctx, int tcount)
+{
+	const int nlines = 2000;
+	struct scanline_list *sl, *ref;
+	struct timespec ts[3];
+	uint64_t t, npix, nspans;
+	int *lines, i, j, r;
+
+	lines = calloc(nlines * 4, sizeof(int));
+	sl = scanline_list_alloc(1024);
+	ref = scanline_list_alloc(1024);
+	if (lines == NULL || sl == NULL || ref == NULL)
+		err(1, "%s: alloc", __func__);
+
+	/* Mostly long shallow or steep lines, like UI and CAD work */
+	srandom(1357);
+	for (i = 0; i < nlines; i++) {
+		r = (i % 10 == 0) ? 8 : 480;
+		for (j = 0; j < 4; j++)
+			lines[i * 4 + j] = random() % (2 * r) - r;
+		if (i % 3 != 2)
+			lines[i * 4 + 3] = lines[i * 4 + 1] + random() % 40 - 20;
+	}
+
+	npix = nspans = 0;
+	clock_gettime(CLOCK_MONOTONIC, &ts[0]);
+	for (j = 0; j < tcount; j++) {
+		for (i = 0; i < nlines; i++) {
+			ref->cur = 0;
+			linespans_reference(ref, lines[i * 4], lines[i * 4 + 1],
+			    lines[i * 4 + 2], lines[i * 4 + 3]);
+			npix += ref->cur;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts[1]);
+	for (j = 0; j < tcount; j++) {
+		for (i = 0; i < nlines; i++) {
+			sl->cur = 0;
+			bres_line(sl, lines[i * 4], lines[i * 4 + 1],
+			    lines[i * 4 + 2], lines[i * 4 + 3]);
+			nspans += sl->cur;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts[2]);
+
+	for (i = 0; i < 2; i++) {
+		t = (ts[i + 1].tv_sec * 1000000) + (ts[i + 1].tv_nsec / 1000);
+		t -= (ts[i].tv_sec * 1000000) + (ts[i].tv_nsec / 1000);
+		printf("newport: linespans: %s: %d x %d lines, %llu spans "
+		    "in %llu us\n", i == 0 ? "per pixel" : "bres_line",
+		    tcount, nlines, (unsigned long long)
+		    (i == 0 ? npix : nspans), (unsigned long long) t);
+	}
+
+	newport_fill_rectangle_fast(ctx, 0, 0, 1280, 1024, 0);
+	for (i = 0; i < 200; i++) {
+		sl->cur = 0;
+		bres_line_thick(sl, 640 + lines[i * 4], 512 + lines[i * 4 + 1],
+		    640 + lines[i * 4 + 2], 512 + lines[i * 4 + 3], 1 + i % 9);
+		newport_fill_spans(ctx, sl, 0x406080 + (i & 7) * 0x201008);
+	}
+
+	scanline_list_free(sl);
+	scanline_list_free(ref);
+	free(lines);
+}
+
+/*
+ * Per triangle scan lists from malloc() against a frame arena: a
+ * frame of small random triangles timed both ways, then drawn from
+ * the arena.
+ */
+static void
+benchmark_arena(struct gfx_ctx *ctx, int tcount)
+{
+	const int ntris = 20000;
+	struct scanline_list *sl, *asl;
+	struct bres_arena *arena;
+	struct point2d *pts;
+	struct timespec ts[3];
+	uint64_t t;
+	int i, j, f, r, cx, cy;
+
+	pts = calloc(ntris * 3, sizeof(*pts));
+	arena = bres_arena_create(0);
+	if (pts == NULL || arena == NULL)
+		err(1, "%s: alloc", __func__);
+
+	srandom(2468);
+	for (i = 0; i < ntris; i++) {
+		r = 4 + random() % 24;
+		cx = random() % 1280;
+		cy = random() % 1024;
+		for (j = 0; j < 3; j++) {
+			pts[i * 3 + j].x = cx + random() % (2 * r) - r;
+			pts[i * 3 + j].y = cy + random() % (2 * r) - r;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts[0]);
+	for (f = 0; f < tcount; f++) {
+		for (i = 0; i < ntris; i++) {
+			bres_triangle_xy(pts[i * 3].x, pts[i * 3].y,
+			    pts[i * 3 + 1].x, pts[i * 3 + 1].y,
+			    pts[i * 3 + 2].x, pts[i * 3 + 2].y, &sl);
+			scanline_list_free(sl);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts[1]);
+	for (f = 0; f < tcount; f++) {
+		for (i = 0; i < ntris; i++)
+			bres_triangle_xy_arena(pts[i * 3].x, pts[i * 3].y,
+			    pts[i * 3 + 1].x, pts[i * 3 + 1].y,
+			    pts[i * 3 + 2].x, pts[i * 3 + 2].y, arena, &asl);
+		bres_arena_reset(arena);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts[2]);
+
+	for (i = 0; i < 2; i++) {
+		t = (ts[i + 1].tv_sec * 1000000) + (ts[i + 1].tv_nsec / 1000);
+		t -= (ts[i].tv_sec * 1000000) + (ts[i].tv_nsec / 1000);
+		printf("newport: arena: %s: %d frames x %d triangles in "
+		    "%llu us\n", i == 0 ? "malloc" : "arena", tcount, ntris,
+		    (unsigned long long) t);
+	}
+	printf("newport: arena: peak %zu bytes per frame\n", arena->peak);
+
+	newport_fill_rectangle_fast(ctx, 0, 0, 1280, 1024, 0);
+	for (i = 0; i < ntris; i++) {
+		bres_triangle_xy_arena(pts[i * 3].x, pts[i * 3].y,
+		    pts[i * 3 + 1].x, pts[i * 3 + 1].y,
+		    pts[i * 3 + 2].x, pts[i * 3 + 2].y, arena, &asl);
+		newport_fill_spans(ctx, asl, 0x204060 + (i & 7) * 0x182010);
+	}
+	bres_arena_reset(arena);
+
+	bres_arena_destroy(arena);
+	free(pts);
+}
+
+/*
+ * Stippled fills through ZPATTERN, against uploading the same area
+ * expanded on the CPU.  With the simulated REX3 the pattern fills
+ * are checked against the expected pixels.
+ */
+static bool
+benchmark_pattern(struct gfx_ctx *ctx, int tcount)
+{
+	static const uint8_t hatch[8] = {
+		0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+	};
+	const int x1 = 37, y1 = 21, w = 301, h = 203;
+	const uint32_t fg = 0xff8000, bg = 0x0000ff, under = 0x00ff00;
+	struct newport_pattern pat;
+	struct timespec ts[3];
+	uint32_t *img, want, got;
+	uint64_t nw[3], t;
+	bool ret = true;
+	int i, x, y, pass;
+
+	newport_pattern_init_8x8(&pat, hatch);
+	img = calloc(w * h, sizeof(uint32_t));
+	if (img == NULL)
+		err(1, "%s: calloc", __func__);
+
+	/* Opaque, then transparent over a solid fill */
+	for (pass = 0; pass < 2; pass++) {
+		newport_fill_rectangle_fast(ctx, 0, 0, 1280, 1024, under);
+		newport_fill_pattern(ctx, x1, y1, w, h, &pat, fg, bg,
+		    pass == 0 ? NEWPORT_PATTERN_OPAQUE : 0);
+		if (ctx->sim == NULL)
+			continue;
+		for (y = y1 - 1; y <= y1 + h && ret; y++) {
+			for (x = x1 - 1; x <= x1 + w; x++) {
+				if (x < x1 || x >= x1 + w || y < y1 ||
+				    y >= y1 + h)
+					want = newport_calc_colorvram(ctx, under);
+				else if (pat.rows[y & 31] &
+				    (0x80000000U >> (x & 31)))
+					want = newport_calc_colori_color(ctx,
+					    fg);
+				else if (pass == 0)
+					want = newport_calc_colori_color(ctx,
+					    bg);
+				else
+					want = newport_calc_colorvram(ctx, under);
+				/* Only the planes in WRMASK are written */
+				want &= newport_calc_wrmode(ctx, 0xffffffff);
+				got = newport_sim_get_pixel(ctx->sim, x, y);
+				if (got != want) {
+					printf("newport: pattern: (%d,%d) is "
+					    "0x%08x, expected 0x%08x\n",
+					    x, y, got, want);
+					ret = false;
+					break;
+				}
+			}
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts[0]);
+	nw[0] = ctx->stats.reg_writes[NewportRegClassColor] +
+	    ctx->stats.reg_writes[NewportRegClassMode] +
+	    ctx->stats.reg_writes[NewportRegClassCoord] +
+	    ctx->stats.reg_writes[NewportRegClassHostRW];
+	for (i = 0; i < tcount; i++)
+		newport_fill_pattern(ctx, x1, y1, w, h, &pat, fg, bg,
+		    NEWPORT_PATTERN_OPAQUE);
+	newport_fence_sync(ctx);
+	clock_gettime(CLOCK_MONOTONIC, &ts[1]);
+	nw[1] = ctx->stats.reg_writes[NewportRegClassColor] +
+	    ctx->stats.reg_writes[NewportRegClassMode] +
+	    ctx->stats.reg_writes[NewportRegClassCoord] +
+	    ctx->stats.reg_writes[NewportRegClassHostRW];
+	for (i = 0; i < tcount; i++) {
+		for (y = 0; y < h; y++)
+			for (x = 0; x < w; x++)
+				img[y * w + x] = (pat.rows[(y1 + y) & 31] &
+				    (0x80000000U >> ((x1 + x) & 31))) ? fg : bg;
+		newport_upload_image(ctx, x1, y1, w, h, img, w);
+	}
+	newport_fence_sync(ctx);
+	clock_gettime(CLOCK_MONOTONIC, &ts[2]);
+	nw[2] = ctx->stats.reg_writes[NewportRegClassColor] +
+	    ctx->stats.reg_writes[NewportRegClassMode] +
+	    ctx->stats.reg_writes[NewportRegClassCoord] +
+	    ctx->stats.reg_writes[NewportRegClassHostRW];
+
+	for (i = 0; i < 2; i++) {
+		t = (ts[i + 1].tv_sec * 1000000) + (ts[i + 1].tv_nsec / 1000);
+		t -= (ts[i].tv_sec * 1000000) + (ts[i].tv_nsec / 1000);
+		printf("newport: pattern: %s: %d x %dx%d in %llu us, "
+		    "%llu register writes\n",
+		    i == 0 ? "zpattern" : "expanded upload", tcount, w, h,
+		    (unsigned long long) t,
+		    (unsigned long long) (nw[i + 1] - nw[i]));
+	}
+
+	free(img);
+	return ret;
+}
+
+static bool
+calibrate_fillpath(struct gfx_ctx *ctx, const char *profile)
+{
+	struct newport_fillpath fp;
+
+	newport_fillpath_init(&fp, ctx);
+	printf("newport: calibrating fill paths\n");
+	if (! newport_fillpath_calibrate(&fp))
+		return false;
+
+	printf("newport: setup: block %u ns, span %u ns; "
+	    "128x128: fast %u ns, block %u ns, span %u ns\n",
+	    fp.prof.setup_ns[NewportFillPathBlock],
+	    fp.prof.setup_ns[NewportFillPathSpan],
+	    fp.prof.fill_ns[NewportFillPathFast][7][7],
+	    fp.prof.fill_ns[NewportFillPathBlock][7][7],
+	    fp.prof.fill_ns[NewportFillPathSpan][7][7]);
+
+	if (! newport_fillpath_save(&fp, profile))
+		return false;
+	printf("newport: wrote %s\n", profile);
+	return true;
+}
+
+/*
+ * Random sized fills, all down the block path and then through the
+ * dispatcher using the given profile.
+ */
+static void
+benchmark_fillpath(struct gfx_ctx *ctx, const char *profile, int tcount)
+{
+	struct newport_fillpath fp;
+	struct timespec ts_start, ts_mid, ts_end;
+	uint64_t ts_block, ts_disp;
+	int *sz, i, p;
+
+	newport_fillpath_init(&fp, ctx);
+	if (! newport_fillpath_load(&fp, profile))
+		printf("newport: no usable profile, using the block path\n");
+
+	sz = calloc(tcount * 2, sizeof(int));
+	if (sz == NULL)
+		err(1, "%s: calloc", __func__);
+	for (i = 0; i < tcount * 2; i++)
+		sz[i] = 1 << (random() % 11);
+
+	clock_gettime(CLOCK_MONOTONIC, &ts_start);
+	newport_fill_rectangle_setup(ctx);
+	for (i = 0; i < tcount; i++)
+		newport_fill_rectangle(ctx, 0, 0, sz[i * 2], sz[i * 2 + 1],
+		    i & 0xff);
+	newport_fence_sync(ctx);
+	clock_gettime(CLOCK_MONOTONIC, &ts_mid);
+	for (i = 0; i < tcount; i++)
+		newport_fillpath_fill(&fp, 0, 0, sz[i * 2], sz[i * 2 + 1],
+		    i & 0xff);
+	newport_fence_sync(ctx);
+	clock_gettime(CLOCK_MONOTONIC, &ts_end);
+
+	ts_block = (ts_mid.tv_sec * 1000000) + (ts_mid.tv_nsec / 1000);
+	ts_block -= (ts_start.tv_sec * 1000000) + (ts_start.tv_nsec / 1000);
+	ts_disp = (ts_end.tv_sec * 1000000) + (ts_end.tv_nsec / 1000);
+	ts_disp -= (ts_mid.tv_sec * 1000000) + (ts_mid.tv_nsec / 1000);
+
+	printf("newport: fillpath: %d fills; block only %llu ms, "
+	    "dispatched %llu ms (", tcount,
+	    (unsigned long long) ts_block / 1000,
+	    (unsigned long long) ts_disp / 1000);
+	for (p = 0; p < NewportFillPathMax; p++)
+		printf("%s%s %llu", p ? ", " : "", newport_fillpath_name(p),
+		    (unsigned long long) fp.nfills[p]);
+	printf(")\n");
+
+	free(sz);
+}
+
+static const struct {
+	const char *name;
+	NewportBppMode fb_mode;
+	NewportBppMode pixel_mode;
+} pixfmt_modes[] = {
+	{ "rgb8", NewportBppModeRgb8, NewportBppModeRgb24 },
+	{ "rgb12", NewportBppModeRgb12, NewportBppModeRgb24 },
+	{ "rgb12/12", NewportBppModeRgb12, NewportBppModeRgb12 },
+	{ "rgb24", NewportBppModeRgb24, NewportBppModeRgb24 },
+	{ "ci8", NewportBppModeCi8, NewportBppModeCi8 },
+	{ "ci4", NewportBppModeCi4, NewportBppModeCi4 },
+	{ "ci4/8", NewportBppModeCi4, NewportBppModeCi8 },
+	{ NULL, 0, 0 },
+};
+
+static bool
+pixfmt_lookup(const char *name, NewportBppMode *fb_mode,
+    NewportBppMode *pixel_mode)
+{
+	int i;
+
+	for (i = 0; pixfmt_modes[i].name != NULL; i++) {
+		if (strcmp(name, pixfmt_modes[i].name) == 0) {
+			*fb_mode = pixfmt_modes[i].fb_mode;
+			*pixel_mode = pixfmt_modes[i].pixel_mode;
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Upload an odd sized image in every framebuffer / pixel mode and
+ * check that the simulated REX3 unpacks the same HOSTRW pixels
+ * that were packed.
+ */
+static bool
+check_pixfmt(struct gfx_ctx *ctx)
+{
+	uint32_t img[37 * 5], want, got, mask;
+	NewportBppMode fb_mode = ctx->fb_mode, pixel_mode = ctx->pixel_mode;
+	bool ret = true;
+	int i, x, y, nerr;
+
+	if (ctx->sim == NULL) {
+		printf("pixfmt: this needs the simulated REX3\n");
+		return false;
+	}
+
+	for (i = 0; i < 37 * 5; i++)
+		img[i] = (i * 0x010203 + 0x3c5a96) & 0xffffff;
+
+	for (i = 0; pixfmt_modes[i].name != NULL; i++) {
+		ctx->fb_mode = pixfmt_modes[i].fb_mode;
+		ctx->pixel_mode = pixfmt_modes[i].pixel_mode;
+
+		switch (newport_calc_drawmode1(ctx) & REX3_DRAWMODE1_HD_MASK) {
+		case REX3_DRAWMODE1_HD_HD4:
+			mask = 0xf;
+			break;
+		case REX3_DRAWMODE1_HD_HD8:
+			mask = 0xff;
+			break;
+		case REX3_DRAWMODE1_HD_HD12:
+			mask = 0xffff;
+			break;
+		default:
+			mask = 0xffffffff;
+			break;
+		}
+		mask &= newport_calc_wrmode(ctx, 0xffffffff);
+
+		newport_fill_rectangle_fast(ctx, 0, 0, 64, 64, 0);
+		newport_upload_image(ctx, 3, 2, 37, 5, img, 37);
+
+		nerr = 0;
+		for (y = 0; y < 5; y++) {
+			for (x = 0; x < 37; x++) {
+				want = newport_calc_hostrw_color(ctx,
+				    img[y * 37 + x]) & mask;
+				/* Bits outside WRMASK are left from before */
+				got = newport_sim_get_pixel(ctx->sim, 3 + x,
+				    2 + y) & mask;
+				if (got != want && nerr++ < 4)
+					printf("pixfmt: %s: (%d,%d) got 0x%x, "
+					    "expected 0x%x\n",
+					    pixfmt_modes[i].name, x, y, got,
+					    want);
+			}
+		}
+		printf("pixfmt: %s: drawmode1 0x%08x, %s\n",
+		    pixfmt_modes[i].name, newport_calc_drawmode1(ctx),
+		    nerr ? "FAILED" : "OK");
+		if (nerr)
+			ret = false;
+	}
+
+	ctx->fb_mode = fb_mode;
+	ctx->pixel_mode = pixel_mode;
+	return ret;
+}
+
+/*
+ * Time converting a 1280x1024 RGB888 image to 8 bits a pixel at a
+ * time against the row dither, check the row dither against the
+ * per pixel reference, and time the dithered uploads.
+ */
+static bool
+benchmark_dither(struct gfx_ctx *ctx, int tcount)
+{
+	const int w = 1280, h = 1024;
+	NewportDitherFmt fmt;
+	struct timespec ts[7];
+	uint32_t *img;
+	uint8_t *out, *ref;
+	uint64_t t;
+	bool ret = true;
+	int i, x, y, nerr = 0;
+
+	fmt = (ctx->fb_mode == NewportBppModeCi8) ?
+	    NewportDitherFmtCi332 : NewportDitherFmtFbRgb332;
+
+	img = calloc(w * h, sizeof(uint32_t));
+	out = calloc(w * h, 1);
+	ref = calloc(w * h, 1);
+	if (img == NULL || out == NULL || ref == NULL)
+		err(1, "%s: calloc", __func__);
+	for (y = 0; y < h; y++)
+		for (x = 0; x < w; x++)
+			img[y * w + x] = ((x * 255 / w) << 16) |
+			    ((y * 255 / h) << 8) | ((x ^ y) & 0xff);
+
+	clock_gettime(CLOCK_MONOTONIC, &ts[0]);
+	for (i = 0; i < tcount; i++)
+		for (y = 0; y < w * h; y++)
+			out[y] = newport_calc_rgb888_to_fb_rgb332(img[y]);
+	clock_gettime(CLOCK_MONOTONIC, &ts[1]);
+	for (i = 0; i < tcount; i++)
+		for (y = 0; y < h; y++)
+			for (x = 0; x < w; x++)
+				ref[y * w + x] = newport_dither_pixel(
+				    img[y * w + x], x, y, fmt);
+	clock_gettime(CLOCK_MONOTONIC, &ts[2]);
+	for (i = 0; i < tcount; i++)
+		for (y = 0; y < h; y++)
+			newport_dither_row(&img[y * w], &out[y * w], w, 0, y,
+			    fmt);
+	clock_gettime(CLOCK_MONOTONIC, &ts[3]);
+
+	for (y = 0; y < w * h; y++)
+		if (out[y] != ref[y] && nerr++ < 4)
+			printf("dither: pixel %d: row 0x%02x, "
+			    "reference 0x%02x\n", y, out[y], ref[y]);
+
+	for (i = 0; i < tcount; i++)
+		newport_upload_image_dither(ctx, 0, 0, w, h, img, w,
+		    NewportDitherOrdered);
+	clock_gettime(CLOCK_MONOTONIC, &ts[4]);
+
+	/* The simulated framebuffer should hold the row dither output */
+	if (ctx->sim != NULL) {
+		for (y = 0; y < h; y++)
+			for (x = 0; x < w; x++)
+				if ((newport_sim_get_pixel(ctx->sim, x, y) &
+				    0xff) != out[y * w + x] && nerr++ < 4)
+					printf("dither: upload (%d,%d) "
+					    "mismatch\n", x, y);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts[5]);
+	for (i = 0; i < tcount; i++)
+		newport_upload_image_dither(ctx, 0, 0, w, h, img, w,
+		    NewportDitherDiffuse);
+	clock_gettime(CLOCK_MONOTONIC, &ts[6]);
+
+	for (i = 0; i < 6; i++) {
+		static const char *names[] = { "convert only",
+		    "dither per pixel", "dither rows", "upload ordered",
+		    NULL, "upload diffused" };
+
+		/* ts[4] -> ts[5] is the upload check */
+		if (names[i] == NULL)
+			continue;
+		t = (ts[i + 1].tv_sec * 1000000) + (ts[i + 1].tv_nsec / 1000);
+		t -= (ts[i].tv_sec * 1000000) + (ts[i].tv_nsec / 1000);
+		printf("dither: %s: %d frames in %llu ms\n", names[i],
+		    tcount, (unsigned long long) t / 1000);
+	}
+
+	if (nerr != 0) {
+		printf("dither: %d mismatches\n", nerr);
+		ret = false;
+	}
+	free(img);
+	free(out);
+	free(ref);
+	return ret;
+}
+
+/*
+ * Palette manager: allocate a palette for an image, compare the
+ * lookup table against a brute force nearest colour search, and
+ * exercise eviction.
+ */
+static bool
+benchmark_cmap(struct gfx_ctx *ctx, int tcount)
+{
+	const int w = 640, h = 480, npal = 200;
+	struct newport_cmap *cm;
+	struct timespec ts[3];
+	uint32_t pal[200], *img, c, d, best;
+	uint64_t t, err_lut = 0, err_best = 0;
+	uint8_t *out;
+	bool ret = true;
+	int i, j, k, idx[200];
+
+	cm = newport_cmap_create(ctx, 0, 0, NEWPORT_CMAP_NENTRIES);
+	img = calloc(w * h, sizeof(uint32_t));
+	out = calloc(w * h, 1);
+	if (cm == NULL || img == NULL || out == NULL)
+		err(1, "%s: alloc", __func__);
+
+	for (i = 0; i < npal; i++)
+		pal[i] = random() & 0xffffff;
+	for (i = 0; i < w * h; i++)
+		img[i] = pal[random() % npal] ^ (random() & 0x070707);
+	for (i = 0; i < npal; i++)
+		idx[i] = newport_cmap_alloc(cm, pal[i]);
+
+	clock_gettime(CLOCK_MONOTONIC, &ts[0]);
+	for (k = 0; k < tcount; k++)
+		newport_cmap_convert(cm, img, out, w * h);
+	clock_gettime(CLOCK_MONOTONIC, &ts[1]);
+	for (k = 0; k < tcount; k++) {
+		for (i = 0; i < w * h; i++) {
+			best = UINT32_MAX;
+			for (j = 0; j < npal; j++) {
+				c = img[i];
+				d = (((c >> 16) & 0xff) - ((pal[j] >> 16) & 0xff)) *
+				    (((c >> 16) & 0xff) - ((pal[j] >> 16) & 0xff)) +
+				    (((c >> 8) & 0xff) - ((pal[j] >> 8) & 0xff)) *
+				    (((c >> 8) & 0xff) - ((pal[j] >> 8) & 0xff)) +
+				    ((c & 0xff) - (pal[j] & 0xff)) *
+				    ((c & 0xff) - (pal[j] & 0xff));
+				if (d < best)
+					best = d;
+			}
+			if (k == 0) {
+				err_best += best;
+				c = img[i];
+				j = out[i];
+				err_lut +=
+				    (((c >> 16) & 0xff) - ((cm->rgb[j] >> 16) & 0xff)) *
+				    (((c >> 16) & 0xff) - ((cm->rgb[j] >> 16) & 0xff)) +
+				    (((c >> 8) & 0xff) - ((cm->rgb[j] >> 8) & 0xff)) *
+				    (((c >> 8) & 0xff) - ((cm->rgb[j] >> 8) & 0xff)) +
+				    ((c & 0xff) - (cm->rgb[j] & 0xff)) *
+				    ((c & 0xff) - (cm->rgb[j] & 0xff));
+			}
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts[2]);
+
+	for (i = 0; i < 2; i++) {
+		t = (ts[i + 1].tv_sec * 1000000) + (ts[i + 1].tv_nsec / 1000);
+		t -= (ts[i].tv_sec * 1000000) + (ts[i].tv_nsec / 1000);
+		printf("cmap: %s: %d x %dx%d in %llu ms, mean error %.1f\n",
+		    i == 0 ? "lookup table" : "nearest search", tcount, w, h,
+		    (unsigned long long) t / 1000,
+		    (double) (i == 0 ? err_lut : err_best) / (w * h));
+	}
+
+	if (ctx->fb_mode == NewportBppModeCi8 && ctx->sim != NULL) {
+		newport_cmap_upload_image(cm, 0, 0, w, h, img, w);
+		for (i = 0; i < w * h; i++) {
+			if ((newport_sim_get_pixel(ctx->sim, i % w, i / w) &
+			    0xff) != out[i]) {
+				printf("cmap: upload mismatch at %d\n", i);
+				ret = false;
+				break;
+			}
+		}
+	}
+
+	/* Release everything; the next colours fill the free entries first */
+	for (i = 0; i < npal; i++)
+		newport_cmap_release(cm, idx[i]);
+	for (i = 0; i < npal; i++)
+		newport_cmap_alloc(cm, pal[i] ^ 0x808080);
+	if (cm->nevictions != npal - (NEWPORT_CMAP_NENTRIES - npal)) {
+		printf("cmap: %llu evictions, expected %d\n",
+		    (unsigned long long) cm->nevictions,
+		    npal - (NEWPORT_CMAP_NENTRIES - npal));
+		ret = false;
+	}
+	/* Evict the rest of the old colours, then nothing can be added */
+	for (i = 0; i < NEWPORT_CMAP_NENTRIES - npal; i++)
+		newport_cmap_alloc(cm, 0x010101 * i + 0x404000);
+	newport_cmap_alloc(cm, 0x123456);
+	if (cm->nfull != 1) {
+		printf("cmap: full map wasn't detected\n");
+		ret = false;
+	}
+	/* The LUT must not return evicted colours */
+	newport_cmap_convert(cm, img, out, w * h);
+	for (i = 0; i < w * h; i++) {
+		if (cm->refcnt[out[i]] == 0) {
+			printf("cmap: lookup returned an evicted entry\n");
+			ret = false;
+			break;
+		}
+	}
+
+	printf("cmap: %llu allocations, %llu hits, %llu evictions: %s\n",
+	    (unsigned long long) cm->nallocs, (unsigned long long) cm->nhits,
+	    (unsigned long long) cm->nevictions, ret ? "OK" : "FAILED");
+
+	newport_cmap_destroy(cm);
+	free(img);
+	free(out);
+	return ret;
+}
+
+/*
+ * Command queue stress test.
+ *
+ * Each producer thread enqueues tcount 1x1 fills at (seq % 1024, id),
+ * with the odd upload and blit mixed in.  A trace hook on the
+ * simulated REX3 checks that every producer's fills reach the
+ * hardware in the order they were enqueued, with none lost or
+ * duplicated.
+ */
+#define	CMDQ_STRESS_MAX_THREADS		64
+
+struct cmdq_stress_producer {
+	pthread_t thread;
+	struct newport_cmdq *q;
+	int id;
+	int count;
+};
+
+struct cmdq_stress_check {
+	int next[CMDQ_STRESS_MAX_THREADS];
+	uint64_t errors;
+};
+
+static const uint32_t cmdq_stress_pixels[16] = {
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+	0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff,
+};
+
+static void
+cmdq_stress_trace(struct newport_sim *sim, uint32_t rexreg, uint32_t val,
+    void *arg)
+{
+	struct cmdq_stress_check *chk = arg;
+	uint32_t xy;
+	int x, y;
+
+	/* Only rectangle fills GO on XYENDI */
+	if (rexreg != (REX3_REG_XYENDI | REX3_REG_GO))
+		return;
+
+	xy = sim->regs[REX3_REG_XYSTARTI >> 2];
+	x = xy >> REX3_XYSTARTI_XSHIFT;
+	y = xy & 0xffff;
+	if (y < 0 || y >= CMDQ_STRESS_MAX_THREADS) {
+		chk->errors++;
+		return;
+	}
+	if (x != chk->next[y] % 1024) {
+		if (chk->errors < 10)
+			printf("cmdq: producer %d: got %d, expected %d\n",
+			    y, x, chk->next[y] % 1024);
+		chk->errors++;
+	}
+	chk->next[y]++;
+}
+
+static void *
+cmdq_stress_producer_thread(void *arg)
+{
+	struct cmdq_stress_producer *p = arg;
+	int i;
+
+	for (i = 0; i < p->count; i++) {
+		newport_cmdq_fill(p->q, i % 1024, p->id, 1, 1, i & 0xff);
+		if ((i % 256) == 255)
+			newport_cmdq_upload(p->q, 0, 100 + p->id, 16, 1,
+			    cmdq_stress_pixels, 16, NULL, NULL);
+		if ((i % 1024) == 1023)
+			newport_cmdq_blit(p->q, 0, 100 + p->id, 16,
+			    100 + p->id, 16, 1, REX3_DRAWMODE1_LO_SRC);
+	}
+	return (NULL);
+}
+
+static bool
+stress_cmdq(struct gfx_ctx *ctx, int nthreads, int tcount)
+{
+	struct cmdq_stress_producer prod[CMDQ_STRESS_MAX_THREADS];
+	struct cmdq_stress_check chk;
+	struct timespec ts_start, ts_end;
+	struct newport_cmdq *q;
+	uint64_t ts;
+	bool ret = true;
+	int i;
+
+	if (ctx->sim == NULL) {
+		printf("cmdq: the stress test needs the simulated REX3\n");
+		return false;
+	}
+	if (nthreads > CMDQ_STRESS_MAX_THREADS)
+		nthreads = CMDQ_STRESS_MAX_THREADS;
+
+	bzero(&chk, sizeof(chk));
+	newport_sim_set_trace(ctx->sim, cmdq_stress_trace, &chk);
+
+	q = newport_cmdq_create(ctx, 1024);
+	if (q == NULL)
+		err(1, "%s: newport_cmdq_create", __func__);
+
+	clock_gettime(CLOCK_MONOTONIC, &ts_start);
+	if (! newport_cmdq_start(q))
+		exit(1);
+
+	for (i = 0; i < nthreads; i++) {
+		prod[i].q = q;
+		prod[i].id = i;
+		prod[i].count = tcount;
+		if (pthread_create(&prod[i].thread, NULL,
+		    cmdq_stress_producer_thread, &prod[i]) != 0)
+			err(1, "%s: pthread_create", __func__);
+	}
+	for (i = 0; i < nthreads; i++)
+		pthread_join(prod[i].thread, NULL);
+
+	newport_cmdq_flush(q);
+	newport_cmdq_stop(q);
+	clock_gettime(CLOCK_MONOTONIC, &ts_end);
+
+	newport_sim_set_trace(ctx->sim, NULL, NULL);
+	newport_cmdq_destroy(q);
+
+	for (i = 0; i < nthreads; i++) {
+		if (chk.next[i] != tcount) {
+			printf("cmdq: producer %d: %d of %d fills submitted\n",
+			    i, chk.next[i], tcount);
+			ret = false;
+		}
+	}
+	if (chk.errors != 0) {
+		printf("cmdq: %llu ordering errors\n",
+		    (unsigned long long) chk.errors);
+		ret = false;
+	}
+
+	ts = (ts_end.tv_sec * 1000000) + (ts_end.tv_nsec / 1000);
+	ts = ts - ((ts_start.tv_sec * 1000000) + (ts_start.tv_nsec / 1000));
+	printf("cmdq: %d producers x %d fills in %llu milliseconds: %s\n",
+	    nthreads, tcount, (unsigned long long) ts / 1000,
+	    ret ? "OK" : "FAILED");
+	return ret;
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: server [-cs] [-f profile] [-i secs] "
+	    "[-m fbmode] [-p path] [mode] [arg2] [arg3]\n");
+	fprintf(stderr, "  -c: print the performance counters on exit\n");
+	fprintf(stderr, "  -s: use the in-memory REX3 model\n");
+	fprintf(stderr, "  -f: fill path profile (default %s)\n",
+	    NEWPORT_FILLPATH_PROFILE);
+	fprintf(stderr, "  -i: print the performance counters every secs "
+	    "seconds (and on SIGUSR1)\n");
+	fprintf(stderr, "  -m: framebuffer[/input] pixel mode: rgb8, rgb12, "
+	    "rgb12/12, rgb24, ci8, ci4, ci4/8 (default rgb8)\n");
+	fprintf(stderr, "  -p: socket path for serve (default %s)\n",
+	    NEWPORT_PROTO_SOCKET);
+	fprintf(stderr, "  modes: benchmark [count]\n");
+	fprintf(stderr, "         rects [count]\n");
+	fprintf(stderr, "         dlist [count]\n");
+	fprintf(stderr, "         spans [count]\n");
+	fprintf(stderr, "         frames [count]\n");
+	fprintf(stderr, "         pattern [count]\n");
+	fprintf(stderr, "         polygon [count]\n");
+	fprintf(stderr, "         mesh [count]\n");
+	fprintf(stderr, "         subpixel [count]\n");
+	fprintf(stderr, "         raster-mt [count] [nthreads]\n");
+	fprintf(stderr, "         flat [count]\n");
+	fprintf(stderr, "         arena [count]\n");
+	fprintf(stderr, "         linespans [count]\n");
+	fprintf(stderr, "         ellipse [count]\n");
+	fprintf(stderr, "         sbuf [count]\n");
+	fprintf(stderr, "         aalines [count]\n");
+	fprintf(stderr, "         calibrate\n");
+	fprintf(stderr, "         fillpath [count]\n");
+	fprintf(stderr, "         pixfmt\n");
+	fprintf(stderr, "         dither [count]\n");
+	fprintf(stderr, "         cmap [count]\n");
+	fprintf(stderr, "         serve\n");
+	fprintf(stderr, "         cmdq-stress [count] [nthreads]\n");
+	exit(127);
+}
+
 int
-main(int argc, const char *argv[])
+main(int argc, char *argv[])
 {
 	struct gfx_ctx ctx;
-	const char *mode;
-	uint32_t arg2;
+	const char *mode, *path = NEWPORT_PROTO_SOCKET;
+	const char *profile = NEWPORT_FILLPATH_PROFILE;
+	uint32_t arg2, arg3;
+	bool use_sim = false, ok = true, print_stats = false;
+	int ch, stats_interval = 0;
+	NewportBppMode fb_mode = NewportBppModeRgb8; /* output is rgb8 */
+	NewportBppMode pixel_mode = NewportBppModeRgb24; /* input is rgb888 */
 
-	if (! verify_newport()) {
-		err(127, "Not a newport!\n");
+	while ((ch = getopt(argc, argv, "cf:i:m:p:s")) != -1) {
+		switch (ch) {
+		case 'c':
+			print_stats = true;
+			break;
+		case 'i':
+			stats_interval = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			profile = optarg;
+			break;
+		case 'm':
+			if (! pixfmt_lookup(optarg, &fb_mode, &pixel_mode))
+				usage();
+			break;
+		case 'p':
+			path = optarg;
+			break;
+		case 's':
+			use_sim = true;
+			break;
+		default:
+			usage();
+		}
 	}
-	printf("Hi! It's a newport!\n");
+	argc -= optind - 1;
+	argv += optind - 1;
+
+#ifndef __NetBSD__
+	/* There's no real hardware to talk to */
+	use_sim = true;
+#endif
 
 	gfx_ctx_init(&ctx);
-	if (!newport_open(&ctx))
-		exit(127);
+
+	if (use_sim) {
+		if (! newport_sim_attach(&ctx, 1280, 1024))
+			err(127, "couldn't create the simulated REX3");
+		printf("Using the simulated REX3\n");
+	} else {
+#ifdef __NetBSD__
+		if (! verify_newport()) {
+			err(127, "Not a newport!\n");
+		}
+		printf("Hi! It's a newport!\n");
+
+		if (!newport_open(&ctx))
+			exit(127);
+#endif
+	}
 
 	printf("DRAWMODE0: 0x%08x\n", rex3_read(&ctx, REX3_REG_DRAWMODE0));
 	printf("DRAWMODE1: 0x%08x\n", rex3_read(&ctx, REX3_REG_DRAWMODE1));
 
 	/* Set configuration to use */
-	ctx.fb_mode = NewportBppModeRgb8; /* output is rgb8 */
-	ctx.pixel_mode = NewportBppModeRgb24; /* input is rgb888 */
+	ctx.fb_mode = fb_mode;
+	ctx.pixel_mode = pixel_mode;
 	ctx.display_buffer = NewportDoubleBufferNone;
 	ctx.draw_buffer = NewportDoubleBufferNone;
 	ctx.cfreq = 70; /* 1024x768 60Hz */
 
 	newport_setup_hw(&ctx);
 
+	/* Only count what the selected mode does */
+	newport_stats_reset(&ctx);
+	if (! newport_stats_dump_setup(SIGUSR1, stats_interval))
+		exit(127);
+
 	mode = "benchmark";
 
 	if (argc > 1)
@@ -183,6 +2149,10 @@ main(int argc, const char *argv[])
 	if (argc > 2)
 		arg2 = strtoul(argv[2], NULL, 0);
 
+	arg3 = 4;
+	if (argc > 3)
+		arg3 = strtoul(argv[3], NULL, 0);
+
 	if (strcmp(mode, "benchmark") == 0) {
 		newport_fill_rectangle_fast(&ctx, 0, 0, 1280, 1024, 0);
 
@@ -191,11 +2161,68 @@ main(int argc, const char *argv[])
 		benchmark_rectangle(&ctx, 32, 32, arg2);
 		benchmark_rectangle(&ctx, 64, 64, arg2);
 		benchmark_rectangle(&ctx, 128, 128, arg2);
+	} else if (strcmp(mode, "rects") == 0) {
+		benchmark_rectangles(&ctx, arg2);
+	} else if (strcmp(mode, "dlist") == 0) {
+		benchmark_dlist(&ctx, arg2);
+	} else if (strcmp(mode, "polygon") == 0) {
+		benchmark_polygon(&ctx, arg2);
+	} else if (strcmp(mode, "raster-mt") == 0) {
+		benchmark_raster_mt(&ctx, arg2, arg3);
+	} else if (strcmp(mode, "ellipse") == 0) {
+		benchmark_ellipse(&ctx, arg2);
+	} else if (strcmp(mode, "sbuf") == 0) {
+		benchmark_sbuf(&ctx, arg2);
+	} else if (strcmp(mode, "linespans") == 0) {
+		benchmark_linespans(&ctx, arg2);
+	} else if (strcmp(mode, "arena") == 0) {
+		benchmark_arena(&ctx, arg2);
+	} else if (strcmp(mode, "flat") == 0) {
+		benchmark_flat(&ctx, arg2);
+	} else if (strcmp(mode, "subpixel") == 0) {
+		benchmark_subpixel(&ctx, arg2);
+	} else if (strcmp(mode, "mesh") == 0) {
+		benchmark_mesh(&ctx, arg2);
+	} else if (strcmp(mode, "aalines") == 0) {
+		ok = benchmark_aalines(&ctx, arg2);
+	} else if (strcmp(mode, "pattern") == 0) {
+		ok = benchmark_pattern(&ctx, arg2);
+	} else if (strcmp(mode, "frames") == 0) {
+		benchmark_frames(&ctx, arg2);
+	} else if (strcmp(mode, "spans") == 0) {
+		ok = benchmark_spans(&ctx, arg2);
+	} else if (strcmp(mode, "calibrate") == 0) {
+		ok = calibrate_fillpath(&ctx, profile);
+	} else if (strcmp(mode, "fillpath") == 0) {
+		benchmark_fillpath(&ctx, profile, arg2);
+	} else if (strcmp(mode, "pixfmt") == 0) {
+		ok = check_pixfmt(&ctx);
+	} else if (strcmp(mode, "dither") == 0) {
+		ok = benchmark_dither(&ctx, arg2);
+	} else if (strcmp(mode, "cmap") == 0) {
+		ok = benchmark_cmap(&ctx, arg2);
+	} else if (strcmp(mode, "serve") == 0) {
+		ok = serve(&ctx, path);
+	} else if (strcmp(mode, "cmdq-stress") == 0) {
+		ok = stress_cmdq(&ctx, arg3, arg2);
 	} else {
-		printf("newport: unknown mode '%s'\n", __func__);
+		printf("newport: unknown mode '%s'\n", mode);
+		ok = false;
+	}
+
+	if (print_stats) {
+		struct newport_stats st;
+
+		newport_stats_snapshot(&ctx, &st);
+		newport_stats_print(&st, "stats: ");
 	}
 
-	newport_close(&ctx);
+	if (ctx.sim != NULL)
+		newport_sim_detach(&ctx);
+#ifdef __NetBSD__
+	else
+		newport_close(&ctx);
+#endif
 
-	exit(0);
+	exit(ok ? 0 : 1);
 }